@@ -0,0 +1,165 @@
+#! /usr/bin/perl -w
+
+# make-acl-bench.pl -- make a ClassBench-style packet filter benchmark
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, subject to the conditions
+# listed in the Click LICENSE file. These conditions include: you must
+# preserve this copyright notice, and you cannot mention the copyright
+# holders in advertising related to the Software without their permission.
+# The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+# notice is a summary of the Click LICENSE file; the license in that file is
+# legally binding.
+
+# Generates a synthetic access control list of N 5-tuple rules, shaped
+# roughly like the ClassBench ACL seeds (mostly long address prefixes, exact
+# and wildcard ports, some port ranges), and a trace of packet headers drawn
+# from the rules.  Prints a configuration that loads the trace into a queue,
+# then classifies it over and over with IPTupleFilter (or IPFilter) for a
+# few seconds and reports the rate.
+#
+#   ./make-acl-bench.pl 10000 > acl.click && click acl.click
+#   ./make-acl-bench.pl -e IPFilter 1000 > acl.click && click acl.click
+#
+# Options:
+#   -e ELEMENT   filter element class (default IPTupleFilter)
+#   -p PACKETS   number of distinct packets in the trace (default 10000)
+#   -s SEED      random seed (default 1)
+#   -t SECONDS   measurement time (default 5)
+#   -o FILE      trace file name (default acl-bench.trace)
+
+use strict;
+use Getopt::Std;
+
+my %opt;
+getopts('e:p:s:t:o:', \%opt) && @ARGV == 1 && $ARGV[0] =~ /^\d+$/
+    or die "usage: make-acl-bench.pl [-e ELEMENT] [-p PACKETS] [-s SEED] [-t SECONDS] [-o FILE] NRULES\n";
+my $nrules = $ARGV[0];
+my $element = $opt{e} || 'IPTupleFilter';
+my $npackets = $opt{p} || 10000;
+my $seconds = $opt{t} || 5;
+my $trace = $opt{o} || 'acl-bench.trace';
+srand(defined $opt{s} ? $opt{s} : 1);
+
+# Picks a key of %$dist with probability proportional to its value.
+sub pick ($) {
+    my($dist) = @_;
+    my $total = 0;
+    $total += $_ foreach values %$dist;
+    my $r = rand($total);
+    foreach my $k (sort keys %$dist) {
+	return $k if ($r -= $dist->{$k}) < 0;
+    }
+    return (sort keys %$dist)[0];
+}
+
+my %prefix_len = (0 => 4, 8 => 2, 16 => 8, 20 => 6, 24 => 25, 28 => 10, 32 => 45);
+my %proto = ('tcp' => 55, 'udp' => 35, 'icmp' => 4, '' => 6);
+my %port = ('wc' => 40, 'hi' => 12, 'lo' => 6, 'em' => 32, 'ar' => 10);
+
+# Addresses come from a few hundred /16s, so that prefixes overlap.
+my @src_nets = map { [10, int(rand(256))] } 1..200;
+my @dst_nets = map { [172, 16 + int(rand(16)), int(rand(256))] } 1..400;
+
+sub prefix ($$) {
+    my($net, $len) = @_;
+    my @a = (@$net, map { int(rand(256)) } 1..4)[0..3];
+    my $addr = ($a[0] << 24) | ($a[1] << 16) | ($a[2] << 8) | $a[3];
+    $addr &= $len ? (0xFFFFFFFF << (32 - $len)) & 0xFFFFFFFF : 0;
+    return [$addr, $len];
+}
+
+sub port_range () {
+    my $c = pick(\%port);
+    if ($c eq 'wc') {
+	return [0, 65535];
+    } elsif ($c eq 'hi') {
+	return [1024, 65535];
+    } elsif ($c eq 'lo') {
+	return [0, 1023];
+    } elsif ($c eq 'em') {
+	my $p = rand() < 0.7 ? (21, 22, 25, 53, 80, 110, 123, 143, 443, 993, 3306, 8080)[int(rand(12))] : int(rand(65536));
+	return [$p, $p];
+    } else {
+	my $lo = int(rand(60000));
+	return [$lo, $lo + 1 + int(rand(5000))];
+    }
+}
+
+sub unparse_addr ($) {
+    my($a) = @_;
+    return join('.', ($a >> 24) & 255, ($a >> 16) & 255, ($a >> 8) & 255, $a & 255);
+}
+
+sub unparse_ports ($$) {
+    my($dir, $r) = @_;
+    return () if $r->[0] == 0 && $r->[1] == 65535;
+    return ("$dir port $r->[0]") if $r->[0] == $r->[1];
+    return ("$dir port > " . ($r->[0] - 1)) if $r->[1] == 65535;
+    return ("$dir port < " . ($r->[1] + 1)) if $r->[0] == 0;
+    return ("$dir port >= $r->[0]", "$dir port <= $r->[1]");
+}
+
+my(@rules, @text);
+for (my $i = 0; $i < $nrules; $i++) {
+    my $src = prefix($src_nets[int(rand(@src_nets))], pick(\%prefix_len));
+    my $dst = prefix($dst_nets[int(rand(@dst_nets))], pick(\%prefix_len));
+    my $p = pick(\%proto);
+    my($sp, $dp) = ([0, 65535], [0, 65535]);
+    if ($p eq 'tcp' || $p eq 'udp') {
+	$sp = rand() < 0.85 ? [0, 65535] : port_range();
+	$dp = port_range();
+    }
+    my @t;
+    push @t, "src net " . unparse_addr($src->[0]) . "/$src->[1]" if $src->[1];
+    push @t, "dst net " . unparse_addr($dst->[0]) . "/$dst->[1]" if $dst->[1];
+    push @t, $p if $p ne '';
+    push @t, unparse_ports('src', $sp), unparse_ports('dst', $dp);
+    push @t, "all" if !@t;
+    push @rules, [$src, $dst, $p, $sp, $dp];
+    push @text, (rand() < 0.5 ? "0 " : "1 ") . join(' && ', @t);
+}
+
+# Each trace packet matches a random rule, though an earlier rule may match
+# it first.  One in ten is random.
+open(TRACE, ">$trace") or die "$trace: $!\n";
+print TRACE "!data src sport dst dport proto\n";
+for (my $i = 0; $i < $npackets; $i++) {
+    my($src, $dst, $p, $sp, $dp);
+    if (@rules && rand() >= 0.1) {
+	($src, $dst, $p, $sp, $dp) = @{$rules[int(rand(@rules))]};
+    } else {
+	($src, $dst, $p, $sp, $dp) = ([0, 0], [0, 0], '', [0, 65535], [0, 65535]);
+    }
+    $p = (rand() < 0.6 ? 'tcp' : 'udp') if $p eq '';
+    my $s = $src->[0] | int(rand(2 ** (32 - $src->[1])));
+    my $d = $dst->[0] | int(rand(2 ** (32 - $dst->[1])));
+    my $P = {'tcp' => 'T', 'udp' => 'U', 'icmp' => 'I'}->{$p};
+    if ($p eq 'icmp') {
+	print TRACE unparse_addr($s), " - ", unparse_addr($d), " - I\n";
+    } else {
+	my $x = $sp->[0] + int(rand($sp->[1] - $sp->[0] + 1));
+	my $y = $dp->[0] + int(rand($dp->[1] - $dp->[0] + 1));
+	print TRACE unparse_addr($s), " $x ", unparse_addr($d), " $y $P\n";
+    }
+}
+close(TRACE);
+
+print "// Generated by make-acl-bench.pl: $nrules rules, $element\n\n";
+print "f :: $element(", join(",\n\t", @text, "1 all"), ");\n\n";
+print <<"EOF";
+FromIPSummaryDump($trace, STOP true, CHECKSUM true)
+    -> q :: Queue(@{[$npackets + 1]});
+q -> uq :: Unqueue(ACTIVE false, BURST 32)
+    -> c :: Counter
+    -> CheckIPHeader
+    -> f;
+f[0] -> c0 :: Counter -> q;
+f[1] -> q;
+
+DriverManager(pause, print startup_time,
+	      write uq.active true, wait 0.5s, write c.reset, write c0.reset,
+	      wait ${seconds}s, print c.count, print c0.count,
+	      print "packets/s: \$(idiv \$(c.count) $seconds)", stop);
+EOF
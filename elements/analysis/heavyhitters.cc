@@ -0,0 +1,469 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * heavyhitters.{cc,hh} -- find heavy hitters with a count-min or count sketch
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "heavyhitters.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+#define INDEX_SEED	0x9E3779B9U
+
+HeavyHitters::HeavyHitters()
+    : _states(0), _nstates(0), _epoch(0), _timer(this)
+{
+}
+
+HeavyHitters::~HeavyHitters()
+{
+}
+
+int
+HeavyHitters::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String key, sketch = "CM";
+    int prefix = 32;
+    uint32_t width = 2048;
+    _k = 16;
+    _depth = 4;
+    _conservative = _bytes = false;
+    _interval = Timestamp();
+    if (Args(conf, this, errh)
+	.read("KEY", WordArg(), key)
+	.read("PREFIX", prefix)
+	.read("K", _k)
+	.read("WIDTH", width)
+	.read("DEPTH", _depth)
+	.read("SKETCH", WordArg(), sketch)
+	.read("CONSERVATIVE", _conservative)
+	.read("BYTES", _bytes)
+	.read("INTERVAL", _interval)
+	.complete() < 0)
+	return -1;
+    if (_key.configure(key, prefix, errh) < 0)
+	return -1;
+    if (sketch.equals("CM", -1))
+	_count_sketch = false;
+    else if (sketch.equals("CS", -1))
+	_count_sketch = true;
+    else
+	return errh->error("SKETCH must be CM or CS");
+    if (_conservative && _count_sketch)
+	return errh->error("CONSERVATIVE requires SKETCH CM");
+    if (_k == 0 || _k > 65536)
+	return errh->error("K out of range");
+    if (_depth == 0 || _depth > MAX_DEPTH)
+	return errh->error("DEPTH out of range");
+    if (width == 0 || width > (1U << 26))
+	return errh->error("WIDTH out of range");
+    for (_width = 16; _width < width; _width <<= 1)
+	/* nada */;
+    for (_index_mask = 15; _index_mask < 4 * _k - 1; _index_mask = 2 * _index_mask + 1)
+	/* nada */;
+    return 0;
+}
+
+int
+HeavyHitters::initialize(ErrorHandler *errh)
+{
+    _nstates = click_max_cpu_ids();
+    if (!(_states = new State[_nstates]))
+	return errh->error("out of memory");
+    memset(_states, 0, sizeof(State) * _nstates);
+    for (unsigned i = 0; i < _nstates; i++)
+	for (int j = 0; j < 2; j++) {
+	    Epoch &e = _states[i].ep[j];
+	    e.counters = new uint32_t[_width * _depth];
+	    e.heap = new Entry[_k];
+	    e.index = new uint32_t[_index_mask + 1];
+	    if (!e.counters || !e.heap || !e.index)
+		return errh->error("out of memory");
+	    clear(e);
+	}
+    for (uint32_t r = 0; r < _depth; r++)
+	_seeds[r] = click_random() | (click_random() << 16);
+    _timer.initialize(this);
+    if (_interval)
+	_timer.schedule_after(_interval);
+    return 0;
+}
+
+void
+HeavyHitters::cleanup(CleanupStage)
+{
+    for (unsigned i = 0; _states && i < _nstates; i++)
+	for (int j = 0; j < 2; j++) {
+	    delete[] _states[i].ep[j].counters;
+	    delete[] _states[i].ep[j].heap;
+	    delete[] _states[i].ep[j].index;
+	}
+    delete[] _states;
+    _states = 0;
+}
+
+void
+HeavyHitters::clear(Epoch &e)
+{
+    memset(e.counters, 0, sizeof(uint32_t) * _width * _depth);
+    memset(e.index, 0, sizeof(uint32_t) * (_index_mask + 1));
+    e.nheap = 0;
+    e.total = 0;
+}
+
+void
+HeavyHitters::rotate(State &st)
+{
+    uint32_t epoch = _epoch;
+    if (st.epoch + 1 != epoch)
+	clear(st.ep[(epoch + 1) & 1]);
+    clear(st.ep[epoch & 1]);
+    st.epoch = epoch;
+}
+
+inline uint32_t
+HeavyHitters::estimate(const uint32_t *counters, uint32_t key) const
+{
+    if (!_count_sketch) {
+	uint32_t m = 0xFFFFFFFFU;
+	for (uint32_t r = 0; r < _depth; r++, counters += _width) {
+	    uint32_t c = counters[SketchKey::hash(key, _seeds[r]) & (_width - 1)];
+	    if (c < m)
+		m = c;
+	}
+	return m;
+    }
+
+    // count sketch: median of signed estimates
+    int32_t v[MAX_DEPTH] = { 0 };
+    for (uint32_t r = 0; r < _depth; r++, counters += _width) {
+	uint32_t h = SketchKey::hash(key, _seeds[r]);
+	int32_t c = counters[h & (_width - 1)];
+	int32_t x = (h & 0x80000000U ? -c : c);
+	uint32_t i = r;
+	for (; i > 0 && v[i - 1] > x; --i)
+	    v[i] = v[i - 1];
+	v[i] = x;
+    }
+    int64_t m = v[_depth / 2];
+    if (!(_depth & 1))
+	m = ((int64_t) v[_depth / 2 - 1] + m) / 2;
+    return m > 0 ? m : 0;
+}
+
+
+// TOP-K HEAPS
+
+inline uint32_t
+HeavyHitters::find_index(const Epoch &e, uint32_t key) const
+{
+    uint32_t i = SketchKey::hash(key, INDEX_SEED) & _index_mask;
+    while (e.index[i] && e.heap[e.index[i] - 1].key != key)
+	i = (i + 1) & _index_mask;
+    return i;
+}
+
+void
+HeavyHitters::remove_index(Epoch &e, uint32_t key)
+{
+    uint32_t i = find_index(e, key), j = i;
+    while (1) {
+	j = (j + 1) & _index_mask;
+	if (!e.index[j])
+	    break;
+	uint32_t home = SketchKey::hash(e.heap[e.index[j] - 1].key, INDEX_SEED) & _index_mask;
+	// move j to i unless its home lies cyclically in (i, j]
+	if ((j > i && (home <= i || home > j))
+	    || (j < i && home <= i && home > j)) {
+	    e.index[i] = e.index[j];
+	    i = j;
+	}
+    }
+    e.index[i] = 0;
+}
+
+void
+HeavyHitters::sift_up(Epoch &e, uint32_t pos)
+{
+    Entry x = e.heap[pos];
+    uint32_t xi = find_index(e, x.key);
+    while (pos > 0) {
+	uint32_t parent = (pos - 1) / 2;
+	if (e.heap[parent].count <= x.count)
+	    break;
+	e.heap[pos] = e.heap[parent];
+	e.index[find_index(e, e.heap[pos].key)] = pos + 1;
+	pos = parent;
+    }
+    e.heap[pos] = x;
+    e.index[xi] = pos + 1;
+}
+
+void
+HeavyHitters::sift_down(Epoch &e, uint32_t pos)
+{
+    Entry x = e.heap[pos];
+    uint32_t xi = find_index(e, x.key);
+    while (1) {
+	uint32_t child = 2 * pos + 1;
+	if (child >= e.nheap)
+	    break;
+	if (child + 1 < e.nheap && e.heap[child + 1].count < e.heap[child].count)
+	    ++child;
+	if (x.count <= e.heap[child].count)
+	    break;
+	e.heap[pos] = e.heap[child];
+	e.index[find_index(e, e.heap[pos].key)] = pos + 1;
+	pos = child;
+    }
+    e.heap[pos] = x;
+    e.index[xi] = pos + 1;
+}
+
+/* Records that key's estimated count is now count. */
+void
+HeavyHitters::offer(Epoch &e, uint32_t key, uint32_t count)
+{
+    uint32_t i = find_index(e, key);
+    if (e.index[i]) {
+	uint32_t pos = e.index[i] - 1, old_count = e.heap[pos].count;
+	e.heap[pos].count = count;
+	// count sketch estimates can decrease as other keys collide
+	if (count < old_count)
+	    sift_up(e, pos);
+	else
+	    sift_down(e, pos);
+    } else if (e.nheap < _k) {
+	uint32_t pos = e.nheap++;
+	e.heap[pos].key = key;
+	e.heap[pos].count = count;
+	e.index[i] = pos + 1;
+	sift_up(e, pos);
+    } else if (count > e.heap[0].count) {
+	remove_index(e, e.heap[0].key);
+	e.heap[0].key = key;
+	e.heap[0].count = count;
+	e.index[find_index(e, key)] = 1;
+	sift_down(e, 0);
+    }
+}
+
+
+// PACKETS
+
+Packet *
+HeavyHitters::simple_action(Packet *p)
+{
+    uint32_t key;
+    if (!_key.extract(p, key))
+	return p;
+    State &st = state();
+    if (st.epoch != _epoch)
+	rotate(st);
+    Epoch &e = st.ep[st.epoch & 1];
+    uint32_t w = _bytes ? p->length() + EXTRA_LENGTH_ANNO(p) : 1;
+    e.total += w;
+
+    uint32_t *c[MAX_DEPTH] = { 0 };
+    uint32_t *counters = e.counters;
+    for (uint32_t r = 0; r < _depth; r++, counters += _width)
+	c[r] = &counters[SketchKey::hash(key, _seeds[r]) & (_width - 1)];
+
+    uint32_t est;
+    if (_count_sketch) {
+	for (uint32_t r = 0; r < _depth; r++)
+	    if (SketchKey::hash(key, _seeds[r]) & 0x80000000U)
+		*c[r] -= w;
+	    else
+		*c[r] += w;
+	est = estimate(e.counters, key);
+    } else if (_conservative) {
+	uint32_t m = *c[0];
+	for (uint32_t r = 1; r < _depth; r++)
+	    if (*c[r] < m)
+		m = *c[r];
+	est = m + w;
+	for (uint32_t r = 0; r < _depth; r++)
+	    if (*c[r] < est)
+		*c[r] = est;
+    } else {
+	est = 0xFFFFFFFFU;
+	for (uint32_t r = 0; r < _depth; r++) {
+	    *c[r] += w;
+	    if (*c[r] < est)
+		est = *c[r];
+	}
+    }
+    offer(e, key, est);
+    return p;
+}
+
+void
+HeavyHitters::run_timer(Timer *)
+{
+    ++_epoch;
+    _timer.reschedule_after(_interval);
+}
+
+
+// READING
+
+/* Returns a thread's data for the given epoch, or null if it has none. */
+const HeavyHitters::Epoch *
+HeavyHitters::epoch_data(const State &st, uint32_t epoch) const
+{
+    if (st.epoch == epoch || st.epoch == epoch + 1)
+	return &st.ep[epoch & 1];
+    else
+	return 0;
+}
+
+void
+HeavyHitters::merge(uint32_t epoch, Vector<uint32_t> &counters, uint64_t &total) const
+{
+    counters.assign(_width * _depth, 0);
+    total = 0;
+    for (unsigned i = 0; i < _nstates; i++)
+	if (const Epoch *e = epoch_data(_states[i], epoch)) {
+	    for (uint32_t j = 0; j < _width * _depth; j++)
+		counters[j] += e->counters[j];
+	    total += e->total;
+	}
+}
+
+static int
+entry_compare(const void *a, const void *b, void *)
+{
+    const uint32_t *ea = static_cast<const uint32_t *>(a);
+    const uint32_t *eb = static_cast<const uint32_t *>(b);
+    if (ea[1] != eb[1])
+	return ea[1] > eb[1] ? -1 : 1;
+    else
+	return ea[0] < eb[0] ? -1 : (ea[0] != eb[0]);
+}
+
+String
+HeavyHitters::unparse_top(uint32_t epoch) const
+{
+    Vector<uint32_t> counters;
+    uint64_t total;
+    merge(epoch, counters, total);
+
+    // re-estimate every thread's candidates against the merged sketch
+    Vector<uint32_t> keys;
+    for (unsigned i = 0; i < _nstates; i++)
+	if (const Epoch *e = epoch_data(_states[i], epoch))
+	    for (uint32_t j = 0; j < e->nheap; j++)
+		keys.push_back(e->heap[j].key);
+    click_qsort(keys.begin(), keys.size());
+    Vector<Entry> top;
+    for (int i = 0; i < keys.size(); i++)
+	if (i == 0 || keys[i] != keys[i - 1]) {
+	    Entry x;
+	    x.key = keys[i];
+	    x.count = estimate(counters.begin(), keys[i]);
+	    if (x.count)
+		top.push_back(x);
+	}
+    click_qsort(top.begin(), top.size(), sizeof(Entry), entry_compare);
+
+    StringAccum sa;
+    for (int i = 0; i < top.size() && i < (int) _k; i++) {
+	_key.unparse(sa, top[i].key);
+	sa << ' ' << top[i].count << '\n';
+    }
+    return sa.take_string();
+}
+
+String
+HeavyHitters::read_handler(Element *e, void *user_data)
+{
+    HeavyHitters *hh = static_cast<HeavyHitters *>(e);
+    uint32_t epoch = hh->_epoch;
+    switch ((intptr_t) user_data) {
+    case h_top:
+	return hh->unparse_top(epoch);
+    case h_last_top:
+	return epoch ? hh->unparse_top(epoch - 1) : String();
+    case h_last_count:
+	if (!epoch)
+	    return "0";
+	--epoch;
+	/* fallthru */
+    case h_count: {
+	uint64_t total = 0;
+	for (unsigned i = 0; i < hh->_nstates; i++)
+	    if (const Epoch *ep = hh->epoch_data(hh->_states[i], epoch))
+		total += ep->total;
+	return String(total);
+    }
+    case h_epoch:
+	return String(epoch);
+    default:
+	return String();
+    }
+}
+
+int
+HeavyHitters::read_param_handler(int, String &s, Element *e, const Handler *, ErrorHandler *errh)
+{
+    HeavyHitters *hh = static_cast<HeavyHitters *>(e);
+    uint32_t key;
+    if (!hh->_key.parse(cp_uncomment(s), key))
+	return errh->error("syntax error");
+    Vector<uint32_t> counters;
+    uint64_t total;
+    hh->merge(hh->_epoch, counters, total);
+    s = String(hh->estimate(counters.begin(), key));
+    return 0;
+}
+
+int
+HeavyHitters::write_handler(const String &, Element *e, void *user_data, ErrorHandler *)
+{
+    HeavyHitters *hh = static_cast<HeavyHitters *>(e);
+    uint32_t epoch = hh->_epoch + 1;
+    if ((intptr_t) user_data == h_rotate) {
+	hh->_epoch = epoch;
+	return 0;
+    }
+    for (unsigned i = 0; i < hh->_nstates; i++) {
+	State &st = hh->_states[i];
+	hh->clear(st.ep[0]);
+	hh->clear(st.ep[1]);
+	st.epoch = epoch;
+    }
+    hh->_epoch = epoch;
+    if (hh->_interval)
+	hh->_timer.reschedule_after(hh->_interval);
+    return 0;
+}
+
+void
+HeavyHitters::add_handlers()
+{
+    add_read_handler("top", read_handler, h_top, Handler::f_expensive);
+    add_read_handler("last_top", read_handler, h_last_top, Handler::f_expensive);
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("last_count", read_handler, h_last_count);
+    set_handler("estimate", Handler::f_read | Handler::f_read_param, read_param_handler, h_estimate);
+    add_read_handler("epoch", read_handler, h_epoch);
+    add_write_handler("rotate", write_handler, h_rotate);
+    add_write_handler("reset", write_handler, h_reset);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(HeavyHitters)
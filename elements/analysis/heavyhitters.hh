@@ -0,0 +1,228 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HEAVYHITTERS_HH
+#define CLICK_HEAVYHITTERS_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include "sketchkey.hh"
+CLICK_DECLS
+
+/*
+=c
+
+HeavyHitters([I<keywords> KEY, PREFIX, K, WIDTH, DEPTH, SKETCH, CONSERVATIVE, BYTES, INTERVAL])
+
+=s ipmeasure
+
+finds the largest aggregates in fixed memory
+
+=d
+
+HeavyHitters estimates how many packets (or bytes) it has seen for each key
+and keeps track of the K keys with the largest estimates.  Unlike
+AggregateCounter, which counts exactly and grows without bound, it uses a
+fixed amount of memory however many distinct keys there are.
+
+Keys are aggregate annotations by default, so HeavyHitters can follow
+AggregateIPFlows or AggregateIP to find the heaviest flows or prefixes.  Set
+KEY to SRC or DST to count source or destination addresses directly, masked
+to PREFIX bits.
+
+Counts are kept in a sketch of DEPTH rows of WIDTH counters.  Each packet
+adds its count to one counter in each row, chosen by a per-row hash of its
+key.  A count-min sketch (SKETCH CM, the default) estimates a key's count as
+its smallest counter, which never underestimates and overestimates by at
+most about e/WIDTH of the total with probability 1 - exp(-DEPTH).  With
+CONSERVATIVE, counters are raised only as far as needed, which reduces the
+error further.  A count sketch (SKETCH CS) adds or subtracts each count
+according to another hash and takes the median over rows; its estimates are
+unbiased, which suits heavy-tailed traffic with many small keys.
+
+Each thread updates its own sketch and top-K list without locking.  Reading
+the handlers merges them: the sketches are summed, and every thread's
+candidates are re-estimated against the sum.
+
+If INTERVAL is set, HeavyHitters divides time into epochs of that length.
+Each epoch starts with an empty sketch, and the previous epoch's results
+remain readable through the C<last_> handlers.
+
+Keyword arguments are:
+
+=over 8
+
+=item KEY
+
+AGGREGATE, SRC, or DST.  Default is AGGREGATE.
+
+=item PREFIX
+
+Integer between 0 and 32.  For SRC and DST keys, count addresses masked to
+this many bits.  Default is 32.
+
+=item K
+
+Unsigned integer.  Number of heavy hitters to track.  Default is 16.
+
+=item WIDTH
+
+Unsigned integer.  Counters per row, rounded up to a power of two.
+Default is 2048.
+
+=item DEPTH
+
+Unsigned integer between 1 and 16.  Number of rows.  Default is 4.
+
+=item SKETCH
+
+CM or CS.  Default is CM.
+
+=item CONSERVATIVE
+
+Boolean.  Use conservative update; CM only.  Default is false.
+
+=item BYTES
+
+Boolean.  Count bytes, including extra length annotations, rather than
+packets.  Default is false.
+
+=item INTERVAL
+
+Time.  Epoch length.  Default is 0, which means a single epoch that lasts
+until C<reset>.
+
+=back
+
+Memory use is 8 x WIDTH x DEPTH bytes per thread, plus a little for the
+top-K lists.
+
+=h top read-only
+
+Returns the current epoch's heavy hitters, one per line, largest first: the
+key and its estimated count.
+
+=h last_top read-only
+
+Returns the previous epoch's heavy hitters.
+
+=h count read-only
+
+Returns the total count of the current epoch.
+
+=h last_count read-only
+
+Returns the total count of the previous epoch.
+
+=h estimate read-only
+
+Takes a key as a parameter, and returns its estimated count in the current
+epoch.
+
+=h epoch read-only
+
+Returns the current epoch number, starting from 0.
+
+=h rotate write-only
+
+Starts a new epoch, as if INTERVAL had elapsed.
+
+=h reset write-only
+
+Clears all counts and starts a new epoch.
+
+=e
+
+  FromDump(trace.pcap, STOP true)
+    -> CheckIPHeader(14)
+    -> AggregateIPFlows
+    -> hh :: HeavyHitters(K 10, INTERVAL 10s)
+    -> Discard;
+
+=a
+
+HyperLogLog, AggregateCounter, AggregateIPFlows, AggregateIP, IPRateMonitor */
+
+class HeavyHitters : public Element { public:
+
+    HeavyHitters() CLICK_COLD;
+    ~HeavyHitters() CLICK_COLD;
+
+    const char *class_name() const	{ return "HeavyHitters"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    Packet *simple_action(Packet *);
+    void run_timer(Timer *);
+
+  private:
+
+    enum { MAX_DEPTH = 16 };
+
+    struct Entry {
+	uint32_t key;
+	uint32_t count;
+    };
+
+    // One epoch's data for one thread.  The top-K list is a min-heap on
+    // count, with an open-addressed index from key to heap position.
+    struct Epoch {
+	uint32_t *counters;
+	Entry *heap;
+	uint32_t *index;	// heap position + 1, or 0
+	uint32_t nheap;
+	uint64_t total;
+    };
+
+    // Per-thread state.  Epoch e lives in ep[e & 1]; the other is the
+    // previous epoch.
+    struct State {
+	uint32_t epoch;
+	Epoch ep[2];
+    };
+
+    State *_states;
+    unsigned _nstates;
+    volatile uint32_t _epoch;
+    Timer _timer;
+
+    SketchKey _key;
+    uint32_t _k;
+    uint32_t _width;
+    uint32_t _depth;
+    uint32_t _index_mask;
+    uint32_t _seeds[MAX_DEPTH];
+    Timestamp _interval;
+    bool _count_sketch;
+    bool _conservative;
+    bool _bytes;
+
+    inline State &state();
+    inline uint32_t estimate(const uint32_t *counters, uint32_t key) const;
+    void rotate(State &);
+    void clear(Epoch &);
+    void offer(Epoch &, uint32_t key, uint32_t count);
+    void sift_down(Epoch &, uint32_t pos);
+    void sift_up(Epoch &, uint32_t pos);
+    inline uint32_t find_index(const Epoch &, uint32_t key) const;
+    void remove_index(Epoch &, uint32_t key);
+    const Epoch *epoch_data(const State &, uint32_t epoch) const;
+    void merge(uint32_t epoch, Vector<uint32_t> &counters, uint64_t &total) const;
+    String unparse_top(uint32_t epoch) const;
+
+    enum { h_top, h_last_top, h_count, h_last_count, h_estimate, h_epoch, h_rotate, h_reset };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int read_param_handler(int, String &, Element *, const Handler *, ErrorHandler *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+inline HeavyHitters::State &
+HeavyHitters::state()
+{
+    return _states[click_current_cpu_id() % _nstates];
+}
+
+CLICK_ENDDECLS
+#endif
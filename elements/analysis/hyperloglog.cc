@@ -0,0 +1,203 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hyperloglog.{cc,hh} -- estimate distinct aggregates with HyperLogLog
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hyperloglog.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/integers.hh>
+#include <math.h>
+CLICK_DECLS
+
+HyperLogLog::HyperLogLog()
+    : _states(0), _nstates(0), _epoch(0), _timer(this)
+{
+}
+
+HyperLogLog::~HyperLogLog()
+{
+}
+
+int
+HyperLogLog::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String key;
+    int prefix = 32;
+    _precision = 12;
+    _interval = Timestamp();
+    if (Args(conf, this, errh)
+	.read("KEY", WordArg(), key)
+	.read("PREFIX", prefix)
+	.read("PRECISION", _precision)
+	.read("INTERVAL", _interval)
+	.complete() < 0)
+	return -1;
+    if (_key.configure(key, prefix, errh) < 0)
+	return -1;
+    if (_precision < 4 || _precision > 18)
+	return errh->error("PRECISION out of range");
+    return 0;
+}
+
+int
+HyperLogLog::initialize(ErrorHandler *errh)
+{
+    _nstates = click_max_cpu_ids();
+    if (!(_states = new State[_nstates]))
+	return errh->error("out of memory");
+    memset(_states, 0, sizeof(State) * _nstates);
+    uint32_t m = 1U << _precision;
+    for (unsigned i = 0; i < _nstates; i++)
+	for (int j = 0; j < 2; j++) {
+	    if (!(_states[i].regs[j] = new uint8_t[m]))
+		return errh->error("out of memory");
+	    memset(_states[i].regs[j], 0, m);
+	}
+    _seed = click_random() | ((uint64_t) click_random() << 31);
+    _timer.initialize(this);
+    if (_interval)
+	_timer.schedule_after(_interval);
+    return 0;
+}
+
+void
+HyperLogLog::cleanup(CleanupStage)
+{
+    for (unsigned i = 0; _states && i < _nstates; i++) {
+	delete[] _states[i].regs[0];
+	delete[] _states[i].regs[1];
+    }
+    delete[] _states;
+    _states = 0;
+}
+
+void
+HyperLogLog::rotate(State &st)
+{
+    uint32_t epoch = _epoch;
+    if (st.epoch + 1 != epoch)
+	memset(st.regs[(epoch + 1) & 1], 0, 1U << _precision);
+    memset(st.regs[epoch & 1], 0, 1U << _precision);
+    st.epoch = epoch;
+}
+
+Packet *
+HyperLogLog::simple_action(Packet *p)
+{
+    uint32_t key;
+    if (!_key.extract(p, key))
+	return p;
+    State &st = state();
+    if (st.epoch != _epoch)
+	rotate(st);
+
+    // The top PRECISION bits choose a register; the register records the
+    // longest run of leading zeros seen in the remaining bits.
+    uint64_t h = SketchKey::hash64(key, _seed);
+    uint32_t r = h >> (64 - _precision);
+    uint8_t rho = ffs_msb((h << _precision) | (1ULL << (_precision - 1)));
+    uint8_t &reg = st.regs[st.epoch & 1][r];
+    if (rho > reg)
+	reg = rho;
+    return p;
+}
+
+void
+HyperLogLog::run_timer(Timer *)
+{
+    ++_epoch;
+    _timer.reschedule_after(_interval);
+}
+
+double
+HyperLogLog::estimate(uint32_t epoch) const
+{
+    uint32_t m = 1U << _precision;
+    Vector<uint8_t> regs(m, 0);
+    for (unsigned i = 0; i < _nstates; i++) {
+	const State &st = _states[i];
+	if (st.epoch != epoch && st.epoch != epoch + 1)
+	    continue;
+	const uint8_t *r = st.regs[epoch & 1];
+	for (uint32_t j = 0; j < m; j++)
+	    if (r[j] > regs[j])
+		regs[j] = r[j];
+    }
+
+    double sum = 0;
+    uint32_t zeros = 0;
+    for (uint32_t j = 0; j < m; j++) {
+	sum += ldexp(1.0, -regs[j]);
+	zeros += !regs[j];
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    // small range correction: linear counting
+    if (e <= 2.5 * m && zeros)
+	e = m * log((double) m / zeros);
+    return e;
+}
+
+String
+HyperLogLog::read_handler(Element *e, void *user_data)
+{
+    HyperLogLog *hll = static_cast<HyperLogLog *>(e);
+    uint32_t epoch = hll->_epoch;
+    switch ((intptr_t) user_data) {
+    case h_count:
+	return String((uint64_t) (hll->estimate(epoch) + 0.5));
+    case h_last_count:
+	return String(epoch ? (uint64_t) (hll->estimate(epoch - 1) + 0.5) : 0);
+    case h_epoch:
+	return String(epoch);
+    default:
+	return String();
+    }
+}
+
+int
+HyperLogLog::write_handler(const String &, Element *e, void *user_data, ErrorHandler *)
+{
+    HyperLogLog *hll = static_cast<HyperLogLog *>(e);
+    uint32_t epoch = hll->_epoch + 1;
+    if ((intptr_t) user_data == h_rotate) {
+	hll->_epoch = epoch;
+	return 0;
+    }
+    for (unsigned i = 0; i < hll->_nstates; i++) {
+	State &st = hll->_states[i];
+	memset(st.regs[0], 0, 1U << hll->_precision);
+	memset(st.regs[1], 0, 1U << hll->_precision);
+	st.epoch = epoch;
+    }
+    hll->_epoch = epoch;
+    if (hll->_interval)
+	hll->_timer.reschedule_after(hll->_interval);
+    return 0;
+}
+
+void
+HyperLogLog::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("last_count", read_handler, h_last_count);
+    add_read_handler("epoch", read_handler, h_epoch);
+    add_write_handler("rotate", write_handler, h_rotate);
+    add_write_handler("reset", write_handler, h_reset);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(HyperLogLog)
@@ -0,0 +1,146 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HYPERLOGLOG_HH
+#define CLICK_HYPERLOGLOG_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include "sketchkey.hh"
+CLICK_DECLS
+
+/*
+=c
+
+HyperLogLog([I<keywords> KEY, PREFIX, PRECISION, INTERVAL])
+
+=s ipmeasure
+
+estimates the number of distinct aggregates in fixed memory
+
+=d
+
+HyperLogLog estimates how many distinct keys it has seen, such as distinct
+source addresses, destination prefixes, or flows, using the HyperLogLog
+algorithm.  It uses 2^PRECISION one-byte registers per thread however many
+keys there are, and its estimates have a standard error of about
+1.04/sqrt(2^PRECISION): 1.6% for the default PRECISION of 12.
+
+Keys are aggregate annotations by default, so HyperLogLog can follow
+AggregateIPFlows to count distinct flows.  Set KEY to SRC or DST to count
+source or destination addresses directly, masked to PREFIX bits.
+
+Each thread updates its own registers without locking.  Reading the handlers
+merges them by taking each register's maximum, which gives the same estimate
+as if one thread had seen all the packets.
+
+If INTERVAL is set, HyperLogLog divides time into epochs of that length.
+Each epoch starts with empty registers, and the previous epoch's estimate
+remains readable through C<last_count>.
+
+Keyword arguments are:
+
+=over 8
+
+=item KEY
+
+AGGREGATE, SRC, or DST.  Default is AGGREGATE.
+
+=item PREFIX
+
+Integer between 0 and 32.  For SRC and DST keys, count addresses masked to
+this many bits.  Default is 32.
+
+=item PRECISION
+
+Integer between 4 and 18.  Use 2^PRECISION registers.  Default is 12.
+
+=item INTERVAL
+
+Time.  Epoch length.  Default is 0, which means a single epoch that lasts
+until C<reset>.
+
+=back
+
+=h count read-only
+
+Returns the estimated number of distinct keys in the current epoch.
+
+=h last_count read-only
+
+Returns the estimate for the previous epoch.
+
+=h epoch read-only
+
+Returns the current epoch number, starting from 0.
+
+=h rotate write-only
+
+Starts a new epoch, as if INTERVAL had elapsed.
+
+=h reset write-only
+
+Clears the registers and starts a new epoch.
+
+=e
+
+  FromDump(trace.pcap, STOP true)
+    -> CheckIPHeader(14)
+    -> src :: HyperLogLog(KEY SRC)
+    -> dst24 :: HyperLogLog(KEY DST, PREFIX 24, INTERVAL 1s)
+    -> Discard;
+
+=a
+
+HeavyHitters, AggregateCounter, AggregateIPFlows */
+
+class HyperLogLog : public Element { public:
+
+    HyperLogLog() CLICK_COLD;
+    ~HyperLogLog() CLICK_COLD;
+
+    const char *class_name() const	{ return "HyperLogLog"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    Packet *simple_action(Packet *);
+    void run_timer(Timer *);
+
+  private:
+
+    // Per-thread state.  Epoch e's registers are regs[e & 1]; the others
+    // are the previous epoch's.
+    struct State {
+	uint32_t epoch;
+	uint8_t *regs[2];
+    };
+
+    State *_states;
+    unsigned _nstates;
+    volatile uint32_t _epoch;
+    Timer _timer;
+
+    SketchKey _key;
+    int _precision;
+    uint64_t _seed;
+    Timestamp _interval;
+
+    inline State &state();
+    void rotate(State &);
+    double estimate(uint32_t epoch) const;
+
+    enum { h_count, h_last_count, h_epoch, h_rotate, h_reset };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+inline HyperLogLog::State &
+HyperLogLog::state()
+{
+    return _states[click_current_cpu_id() % _nstates];
+}
+
+CLICK_ENDDECLS
+#endif
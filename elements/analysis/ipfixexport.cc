@@ -0,0 +1,329 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipfixexport.{cc,hh} -- flow metering and IPFIX export
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipfixexport.hh"
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+// Information elements in template 256, as (IE identifier, length) pairs.
+static const uint16_t template_fields[] = {
+    8, 4,			// sourceIPv4Address
+    12, 4,			// destinationIPv4Address
+    7, 2,			// sourceTransportPort
+    11, 2,			// destinationTransportPort
+    4, 1,			// protocolIdentifier
+    5, 1,			// ipClassOfService
+    6, 2,			// tcpControlBits
+    2, 8,			// packetDeltaCount
+    1, 8,			// octetDeltaCount
+    152, 8,			// flowStartMilliseconds
+    153, 8,			// flowEndMilliseconds
+    136, 1			// flowEndReason
+};
+
+enum {
+    nfields = sizeof(template_fields) / sizeof(template_fields[0]) / 2,
+    header_size = 16, set_header_size = 4,
+    template_set_size = set_header_size + 4 + nfields * 4
+};
+
+static inline unsigned char *
+put16(unsigned char *x, uint16_t v)
+{
+    x[0] = v >> 8;
+    x[1] = v;
+    return x + 2;
+}
+
+static inline unsigned char *
+put32(unsigned char *x, uint32_t v)
+{
+    return put16(put16(x, v >> 16), v);
+}
+
+static inline unsigned char *
+put64(unsigned char *x, uint64_t v)
+{
+    return put32(put32(x, v >> 32), v);
+}
+
+IPFIXExport::IPFIXExport()
+    : _table(Flow()), _agg_notifier(0), _timer(this),
+      _nrecords(0), _sequence(0), _nmessages(0)
+{
+}
+
+IPFIXExport::~IPFIXExport()
+{
+}
+
+int
+IPFIXExport::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Element *e = 0;
+    _active_timeout = Timestamp(1800);
+    _idle_timeout = Timestamp(15);
+    _mtu = 1400;
+    _domain = 0;
+    _template_refresh = 20;
+
+    if (Args(conf, this, errh)
+	.read("NOTIFIER", e)
+	.read("ACTIVE_TIMEOUT", _active_timeout)
+	.read("IDLE_TIMEOUT", _idle_timeout)
+	.read("MTU", _mtu)
+	.read("DOMAIN", _domain)
+	.read("TEMPLATE_REFRESH", _template_refresh)
+	.complete() < 0)
+	return -1;
+
+    if (e && !(_agg_notifier = (AggregateNotifier *)e->cast("AggregateNotifier")))
+	return errh->error("%s is not an AggregateNotifier", e->name().c_str());
+    if (_mtu < header_size + template_set_size + set_header_size + record_size
+	|| _mtu > 65535)
+	return errh->error("MTU out of range");
+    return 0;
+}
+
+int
+IPFIXExport::initialize(ErrorHandler *)
+{
+    if (_agg_notifier)
+	_agg_notifier->add_listener(this);
+    _timer.initialize(this);
+    _timer.schedule_after_sec(1);
+    return 0;
+}
+
+void
+IPFIXExport::cleanup(CleanupStage)
+{
+    _table.clear();
+}
+
+void
+IPFIXExport::export_record(const Flow &f, int reason)
+{
+    bool need_template = _nmessages == 0
+	|| (_template_refresh && _nmessages % _template_refresh == 0);
+    uint32_t len = header_size + (need_template ? template_set_size : 0)
+	+ set_header_size + (_nrecords + 1) * record_size;
+    if (len > _mtu)
+	send_message();
+
+    unsigned char *x = reinterpret_cast<unsigned char *>(_records.extend(record_size));
+    if (!x)
+	return;
+    // Addresses and ports are already in network byte order.
+    memcpy(x, f.flowid.saddr().data(), 4);
+    memcpy(x + 4, f.flowid.daddr().data(), 4);
+    uint16_t ports[2] = { f.flowid.sport(), f.flowid.dport() };
+    memcpy(x + 8, ports, 4);
+    x[12] = f.proto;
+    x[13] = f.tos;
+    x = put16(x + 14, f.tcp_flags);
+    x = put64(x, f.packets);
+    x = put64(x, f.octets);
+    x = put64(x, f.first.msecval());
+    x = put64(x, f.last.msecval());
+    x[0] = reason;
+    ++_nrecords;
+}
+
+void
+IPFIXExport::send_message()
+{
+    if (!_nrecords)
+	return;
+
+    bool need_template = _nmessages == 0
+	|| (_template_refresh && _nmessages % _template_refresh == 0);
+    uint32_t len = header_size + (need_template ? template_set_size : 0)
+	+ set_header_size + _records.length();
+    WritablePacket *p = Packet::make(len);
+    if (!p) {
+	_records.clear();
+	_nrecords = 0;
+	return;
+    }
+
+    Timestamp now = _now ? _now : Timestamp::now();
+    unsigned char *x = p->data();
+    x = put16(x, 10);		// version
+    x = put16(x, len);
+    x = put32(x, now.sec());	// export time
+    x = put32(x, _sequence);
+    x = put32(x, _domain);
+    if (need_template) {
+	x = put16(x, 2);	// template set
+	x = put16(x, template_set_size);
+	x = put16(x, template_id);
+	x = put16(x, nfields);
+	for (int i = 0; i < nfields * 2; ++i)
+	    x = put16(x, template_fields[i]);
+    }
+    x = put16(x, template_id);	// data set
+    x = put16(x, set_header_size + _records.length());
+    memcpy(x, _records.data(), _records.length());
+
+    p->timestamp_anno() = now;
+    _sequence += _nrecords;
+    ++_nmessages;
+    _records.clear();
+    _nrecords = 0;
+    output(1).push(p);
+}
+
+/* Exports f's record and starts a new one. */
+void
+IPFIXExport::expire(Flow &f, int reason)
+{
+    export_record(f, reason);
+    f.packets = f.octets = 0;
+    f.tcp_flags = 0;
+}
+
+void
+IPFIXExport::scan()
+{
+    for (Table::iterator it = _table.begin(); it; ) {
+	Flow &f = it.value();
+	if (_now - f.last >= _idle_timeout) {
+	    if (f.packets)
+		export_record(f, reason_idle);
+	    it = _table.erase(it);
+	} else {
+	    if (f.packets && _now - f.first >= _active_timeout)
+		expire(f, reason_active);
+	    ++it;
+	}
+    }
+    send_message();
+    _next_scan = _now + Timestamp(1);
+}
+
+void
+IPFIXExport::run_timer(Timer *)
+{
+    // No packet has advanced the flow clock for a second or more; advance it
+    // by the system time that has passed.
+    Timestamp now_steady = Timestamp::now_steady();
+    if (_now && now_steady - _now_steady >= Timestamp(1)) {
+	_now += now_steady - _now_steady;
+	_now_steady = now_steady;
+	scan();
+    }
+    _timer.reschedule_after_sec(1);
+}
+
+void
+IPFIXExport::flush()
+{
+    for (Table::iterator it = _table.begin(); it; ++it)
+	if (it.value().packets)
+	    export_record(it.value(), reason_forced);
+    _table.clear();
+    send_message();
+}
+
+void
+IPFIXExport::meter(Packet *p)
+{
+    uint32_t agg = AGGREGATE_ANNO(p);
+    int paint = PAINT_ANNO(p);
+    if (!agg || paint > 1 || !p->has_network_header())
+	return;
+
+    const click_ip *iph = p->ip_header();
+    const Timestamp &ts = p->timestamp_anno();
+    if (_now < ts) {
+	_now = ts;
+	_now_steady = Timestamp::recent_steady();
+    }
+
+    Flow &f = _table.find_insert(((uint64_t) agg << 1) | paint).value();
+    if (f.packets && ts - f.last >= _idle_timeout)
+	expire(f, reason_idle);
+    else if (f.packets && ts - f.first >= _active_timeout)
+	expire(f, reason_active);
+    if (!f.packets) {
+	if (!f.flowid) {
+	    f.flowid = IPFlowID(p);
+	    f.proto = iph->ip_p;
+	    f.tos = iph->ip_tos;
+	}
+	f.first = ts;
+    }
+    f.packets += 1 + EXTRA_PACKETS_ANNO(p);
+    f.octets += p->length() + EXTRA_LENGTH_ANNO(p);
+    f.last = ts;
+    if (iph->ip_p == IP_PROTO_TCP && IP_FIRSTFRAG(iph)
+	&& p->transport_length() >= 14)
+	f.tcp_flags |= p->tcp_header()->th_flags;
+
+    if (_now >= _next_scan)
+	scan();
+}
+
+void
+IPFIXExport::push(int, Packet *p)
+{
+    meter(p);
+    output(0).push(p);
+}
+
+void
+IPFIXExport::aggregate_notify(uint32_t agg, AggregateEvent event, const Packet *)
+{
+    if (event != DELETE_AGG)
+	return;
+    for (int paint = 0; paint < 2; ++paint)
+	if (Table::iterator it = _table.find(((uint64_t) agg << 1) | paint)) {
+	    if (it.value().packets)
+		export_record(it.value(), reason_end);
+	    _table.erase(it);
+	}
+}
+
+String
+IPFIXExport::read_handler(Element *e, void *)
+{
+    return String(static_cast<IPFIXExport *>(e)->_table.size());
+}
+
+int
+IPFIXExport::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<IPFIXExport *>(e)->flush();
+    return 0;
+}
+
+void
+IPFIXExport::add_handlers()
+{
+    add_write_handler("flush", write_handler, 0, Handler::f_button);
+    add_data_handlers("records", Handler::f_read, &_sequence);
+    add_data_handlers("messages", Handler::f_read, &_nmessages);
+    add_read_handler("count", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(AggregateNotifier int64)
+EXPORT_ELEMENT(IPFIXExport)
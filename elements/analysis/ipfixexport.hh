@@ -0,0 +1,196 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPFIXEXPORT_HH
+#define CLICK_IPFIXEXPORT_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/ipflowid.hh>
+#include <click/straccum.hh>
+#include <click/timer.hh>
+#include "aggregatenotifier.hh"
+CLICK_DECLS
+
+/*
+=c
+
+IPFIXExport([I<keywords>])
+
+=s ipmeasure
+
+meters flows and exports IPFIX records
+
+=d
+
+IPFIXExport meters the flows identified by the aggregate and paint annotations
+that AggregateIPFlows sets, and exports a record for each flow as an IPFIX
+(RFC 7011) data record.  Incoming packets are emitted unchanged on output 0.
+Records are batched into IPFIX messages, which are emitted on output 1.  Each
+message packet contains only the IPFIX message; use UDPIPEncap to make a UDP
+packet, or send the message directly with ToSocket("UDP", ...).
+
+Each direction of an aggregate (paint 0 or 1) is metered as a separate flow.
+Packets with aggregate annotation 0, or with paint annotations other than 0 or
+1 (ICMP errors), are passed through without being metered.  The flow clock is
+the packets' timestamp annotations, so traces are metered in trace time.
+
+A flow's record is exported when the flow has seen no packets for
+IDLE_TIMEOUT, when the NOTIFIER reports that the aggregate has ended, or when
+the C<flush> handler is written.  Long-lived flows also export a record every
+ACTIVE_TIMEOUT; the packet and octet counts in each record cover only the
+period since the previous record for that flow.  A packet that arrives after
+its flow has been idle for IDLE_TIMEOUT starts a new record.  Other flows'
+timeouts are checked once per second of packet time, and, while no packets
+arrive, once per second by a timer that advances the flow clock by the
+elapsed system time.
+
+Every record contains, in order: sourceIPv4Address (IE 8),
+destinationIPv4Address (12), sourceTransportPort (7),
+destinationTransportPort (11), protocolIdentifier (4), ipClassOfService (5),
+tcpControlBits (6, two bytes), packetDeltaCount (2), octetDeltaCount (1),
+flowStartMilliseconds (152), flowEndMilliseconds (153), and flowEndReason
+(136).  These are described by template 256, which is sent in the first
+message and then in every TEMPLATE_REFRESH'th message.
+
+Keyword arguments are:
+
+=over 8
+
+=item NOTIFIER
+
+An AggregateNotifier element, such as AggregateIPFlows.  If given,
+IPFIXExport exports a flow's record as soon as its aggregate is deleted.
+
+=item ACTIVE_TIMEOUT
+
+Time value.  Default is 30 minutes.
+
+=item IDLE_TIMEOUT
+
+Time value.  Default is 15 seconds.
+
+=item MTU
+
+Unsigned integer.  Maximum length of an IPFIX message in bytes.  Default is
+1400.
+
+=item DOMAIN
+
+Unsigned integer.  The IPFIX observation domain ID.  Default is 0.
+
+=item TEMPLATE_REFRESH
+
+Unsigned integer.  Include the template set in every TEMPLATE_REFRESH'th
+message.  Zero means send it only in the first message.  Default is 20.
+
+=back
+
+=h flush write-only
+
+Export records for every flow (with flowEndReason 4, forced end), clear the
+flow table, and send any pending message.
+
+=h count read-only
+
+Returns the number of flows currently being metered.
+
+=h records read-only
+
+Returns the number of data records sent so far.
+
+=h messages read-only
+
+Returns the number of IPFIX messages emitted so far.
+
+=n
+
+The octet count of a packet is its length plus its extra length annotation,
+and its packet count is one plus its extra packets annotation.
+
+=e
+
+  FromDump(trace.pcap, STOP true, FORCE_IP true)
+    -> af :: AggregateIPFlows
+    -> fx :: IPFIXExport(NOTIFIER af)
+    -> Discard;
+  fx[1] -> ToSocket(UDP, 10.0.0.1, 4739);
+  DriverManager(wait, write fx.flush, wait 1s);
+
+=a
+
+AggregateIPFlows, ToIPFlowDumps, FromNetFlowSummaryDump, UDPIPEncap,
+ToSocket */
+
+class IPFIXExport : public Element, public AggregateListener { public:
+
+    IPFIXExport() CLICK_COLD;
+    ~IPFIXExport() CLICK_COLD;
+
+    const char *class_name() const	{ return "IPFIXExport"; }
+    const char *port_count() const	{ return "1/2"; }
+    const char *processing() const	{ return PUSH; }
+    const char *flow_code() const	{ return "x/xy"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    void run_timer(Timer *);
+    void aggregate_notify(uint32_t, AggregateEvent, const Packet *);
+
+    enum {
+	reason_idle = 1, reason_active = 2, reason_end = 3, reason_forced = 4
+    };
+
+  private:
+
+    struct Flow {
+	IPFlowID flowid;
+	uint8_t proto;
+	uint8_t tos;
+	uint16_t tcp_flags;
+	uint64_t packets;
+	uint64_t octets;
+	Timestamp first;
+	Timestamp last;
+	Flow()
+	    : proto(0), tos(0),
+	      tcp_flags(0), packets(0), octets(0) {
+	}
+    };
+
+    typedef HashTable<uint64_t, Flow> Table;
+    Table _table;
+
+    AggregateNotifier *_agg_notifier;
+    Timestamp _active_timeout;
+    Timestamp _idle_timeout;
+    Timestamp _now;
+    Timestamp _now_steady;	// system steady time when _now was set
+    Timestamp _next_scan;
+    Timer _timer;
+    uint32_t _mtu;
+    uint32_t _domain;
+    uint32_t _template_refresh;
+
+    StringAccum _records;
+    uint32_t _nrecords;
+    uint32_t _sequence;
+    uint32_t _nmessages;
+
+    enum { record_size = 49, template_id = 256 };
+
+    void meter(Packet *p);
+    void scan();
+    void expire(Flow &f, int reason);
+    void export_record(const Flow &f, int reason);
+    void send_message();
+    void flush();
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
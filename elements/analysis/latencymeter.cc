@@ -0,0 +1,227 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * latencymeter.{cc,hh} -- measure latency, loss, and reordering
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "latencymeter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+LatencyMeter::LatencyMeter()
+    : _states(0), _nstates(0)
+{
+    _generation = 0;
+}
+
+int
+LatencyMeter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    int offset = -1, anno = -1;
+    bool tail = false;
+    String clock = "steady";
+    if (Args(conf, this, errh)
+	.read("OFFSET", offset)
+	.read("TAIL", tail)
+	.read("ANNO", AnnoArg(4), anno)
+	.read("CLOCK", WordArg(), clock)
+	.complete() < 0)
+	return -1;
+    return _loc.assign(offset, tail, anno, clock, errh);
+}
+
+int
+LatencyMeter::initialize(ErrorHandler *errh)
+{
+    _nstates = click_max_cpu_ids();
+    if (!(_states = new State[_nstates]))
+	return errh->error("out of memory");
+    for (unsigned i = 0; i < _nstates; ++i) {
+	_states[i].generation = 0;
+	_states[i].started = false;
+	_states[i].reordered = 0;
+    }
+    return 0;
+}
+
+void
+LatencyMeter::cleanup(CleanupStage)
+{
+    delete[] _states;
+    _states = 0;
+}
+
+Packet *
+LatencyMeter::simple_action(Packet *p)
+{
+    uint32_t seq;
+    uint64_t sent;
+    if (_loc.anno >= 0) {
+	seq = p->anno_u32(_loc.anno);
+	sent = p->timestamp_anno().nsecval();
+    } else {
+	int offset = (_loc.offset < 0 ? (int) p->length() - LatencyStamp::record_size : _loc.offset);
+	if (offset < 0 || offset + LatencyStamp::record_size > (int) p->length())
+	    return p;
+	memcpy(&seq, p->data() + offset, 4);
+	memcpy(&sent, p->data() + offset + 4, 8);
+	seq = ntohl(seq);
+	sent = net_to_host_order(sent);
+    }
+    uint64_t now = _loc.now();
+
+    // A reset bumps the generation; each thread clears its own state when
+    // it notices, so the packet path never takes a lock.
+    State &s = _states[click_current_cpu_id()];
+    uint32_t generation = _generation.value();
+    if (s.generation != generation) {
+	s.hist.clear();
+	s.started = false;
+	s.reordered = 0;
+	s.generation = generation;
+    }
+
+    if (!s.started) {
+	s.min_seq = s.max_seq = seq;
+	s.started = true;
+    } else if (seq > s.max_seq)
+	s.max_seq = seq;
+    else {
+	++s.reordered;
+	if (seq < s.min_seq)
+	    s.min_seq = seq;
+    }
+    s.hist.add(now > sent ? now - sent : 0);
+    return p;
+}
+
+void
+LatencyMeter::totals(Totals &t) const
+{
+    uint32_t generation = _generation.value();
+    bool started = false;
+    uint32_t min_seq = 0, max_seq = 0;
+    t.reordered = 0;
+    t.hist.clear();
+    for (unsigned i = 0; i < _nstates; ++i) {
+	const State &s = _states[i];
+	if (s.generation != generation || !s.started)
+	    continue;
+	if (!started || s.min_seq < min_seq)
+	    min_seq = s.min_seq;
+	if (!started || s.max_seq > max_seq)
+	    max_seq = s.max_seq;
+	started = true;
+	t.reordered += s.reordered;
+	t.hist.merge(s.hist);
+    }
+    t.count = t.hist.count();
+    uint64_t expected = started ? (uint64_t) (max_seq - min_seq) + 1 : 0;
+    t.lost = expected > t.count ? expected - t.count : 0;
+}
+
+enum { h_count, h_lost, h_reordered, h_min, h_max, h_mean, h_p50, h_p99,
+       h_p999, h_histogram, h_percentile };
+
+String
+LatencyMeter::read_handler(Element *e, void *user_data)
+{
+    LatencyMeter *lm = static_cast<LatencyMeter *>(e);
+    Totals *t = new Totals;
+    lm->totals(*t);
+    StringAccum sa;
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_count:
+	sa << t->count;
+	break;
+    case h_lost:
+	sa << t->lost;
+	break;
+    case h_reordered:
+	sa << t->reordered;
+	break;
+    case h_min:
+	sa << t->hist.min();
+	break;
+    case h_max:
+	sa << t->hist.max();
+	break;
+    case h_mean:
+	sa << t->hist.mean();
+	break;
+    case h_p50:
+	sa << t->hist.value_at_percentile(500000);
+	break;
+    case h_p99:
+	sa << t->hist.value_at_percentile(990000);
+	break;
+    case h_p999:
+	sa << t->hist.value_at_percentile(999000);
+	break;
+    case h_histogram:
+	for (int i = 0; i < HdrHistogram::nbuckets; ++i)
+	    if (uint64_t n = t->hist.bucket_count(i))
+		sa << HdrHistogram::lowest_equivalent(i) << ' '
+		   << HdrHistogram::highest_equivalent(i) << ' ' << n << '\n';
+	break;
+    }
+    delete t;
+    return sa.take_string();
+}
+
+int
+LatencyMeter::read_param_handler(int, String &s, Element *e, const Handler *, ErrorHandler *errh)
+{
+    LatencyMeter *lm = static_cast<LatencyMeter *>(e);
+    uint32_t pct;
+    if (!DecimalFixedPointArg(4).parse(s, pct) || pct > 1000000)
+	return errh->error("expected percentile between 0 and 100");
+    Totals *t = new Totals;
+    lm->totals(*t);
+    s = String(t->hist.value_at_percentile(pct * 100));
+    delete t;
+    return 0;
+}
+
+int
+LatencyMeter::reset_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    LatencyMeter *lm = static_cast<LatencyMeter *>(e);
+    lm->_generation.fetch_and_add(1);
+    return 0;
+}
+
+void
+LatencyMeter::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("lost", read_handler, h_lost);
+    add_read_handler("reordered", read_handler, h_reordered);
+    add_read_handler("min", read_handler, h_min);
+    add_read_handler("max", read_handler, h_max);
+    add_read_handler("mean", read_handler, h_mean);
+    add_read_handler("p50", read_handler, h_p50);
+    add_read_handler("p99", read_handler, h_p99);
+    add_read_handler("p999", read_handler, h_p999);
+    add_read_handler("histogram", read_handler, h_histogram);
+    set_handler("percentile", Handler::f_read | Handler::f_read_param, read_param_handler, h_percentile);
+    add_write_handler("reset", reset_handler, 0, Handler::f_button);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(LatencyStamp)
+EXPORT_ELEMENT(LatencyMeter)
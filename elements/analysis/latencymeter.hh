@@ -0,0 +1,176 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LATENCYMETER_HH
+#define CLICK_LATENCYMETER_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/hdrhistogram.hh>
+#include "latencystamp.hh"
+CLICK_DECLS
+
+/*
+=c
+
+LatencyMeter([I<keywords> OFFSET, TAIL, ANNO, CLOCK])
+
+=s timestamps
+
+measures latency, loss, and reordering of stamped packets
+
+=d
+
+LatencyMeter reads the sequence number and send time that an upstream
+LatencyStamp stored in each passing packet, and measures the packet's one-way
+latency: the difference between the current time and the send time.
+Latencies are recorded in nanoseconds in a high-dynamic-range histogram,
+whose buckets are within about 1.6% of the true value.  Packets pass through
+unchanged.  Packets too short to hold a record are not measured.
+
+The OFFSET, TAIL, ANNO, and CLOCK keywords say where the record is and which
+clock stamped it, and must match the LatencyStamp's.
+
+LatencyMeter also counts lost and reordered packets.  A packet is reordered
+if it arrives after a packet with a higher sequence number.  Lost packets are
+those missing from the range of sequence numbers seen; a reordered packet is
+not counted as lost once it arrives.  Sequence number wraparound is not
+handled.
+
+LatencyMeter may be used from several threads at once.  Each thread records
+into its own histogram and counters, which are merged when a handler reads
+them.  Packets from one LatencyStamp that are split across threads will be
+counted as reordered if their threads interleave them.
+
+Keyword arguments are:
+
+=over 8
+
+=item OFFSET
+
+Integer.  The record starts OFFSET bytes into the packet.
+
+=item TAIL
+
+Boolean.  If true, the record is the last 12 bytes of the packet.
+
+=item ANNO
+
+Annotation name.  The sequence number is in this 4-byte annotation, and the
+send time in the timestamp annotation.
+
+=item CLOCK
+
+Either C<steady> or C<system>.  Default is C<steady>.
+
+=back
+
+=h count read-only
+
+Returns the number of packets measured.
+
+=h lost read-only
+
+Returns the number of lost packets.
+
+=h reordered read-only
+
+Returns the number of reordered packets.
+
+=h min read-only
+
+Returns the minimum latency in nanoseconds.
+
+=h max read-only
+
+Returns the maximum latency in nanoseconds.
+
+=h mean read-only
+
+Returns the mean latency in nanoseconds.
+
+=h p50 read-only
+
+Returns the median latency in nanoseconds.
+
+=h p99 read-only
+
+Returns the 99th percentile latency in nanoseconds.
+
+=h p999 read-only
+
+Returns the 99.9th percentile latency in nanoseconds.
+
+=h percentile read-only
+
+Takes a percentile parameter, such as 99.99, and returns the latency in
+nanoseconds at that percentile.
+
+=h histogram read-only
+
+Returns one line per nonempty histogram bucket: the bucket's lowest and
+highest latency in nanoseconds, and its packet count.
+
+=h reset write-only
+
+Clears the histogram and counters.  Resetting does not stop packet
+processing: each thread clears its own statistics when it next measures a
+packet, and until then its old statistics are ignored.
+
+=e
+
+Measure latency and loss through a device under test:
+
+  FastUDPGen(SRCIP 10.0.0.1, DSTIP 10.1.0.1, LENGTH 100, RATE 100000,
+	     CHECKSUM false)
+    -> LatencyStamp(OFFSET 42) -> ToDevice(eth0);
+  FromDevice(eth1) -> lm :: LatencyMeter(OFFSET 42) -> Discard;
+
+=a
+
+LatencyStamp, TimestampAccum, StoreTimestamp */
+
+class LatencyMeter : public Element { public:
+
+    LatencyMeter() CLICK_COLD;
+
+    const char *class_name() const	{ return "LatencyMeter"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    Packet *simple_action(Packet *);
+
+  private:
+
+    struct State {
+	uint32_t generation;
+	bool started;
+	uint32_t min_seq;
+	uint32_t max_seq;
+	uint64_t reordered;
+	HdrHistogram hist;
+    };
+
+    struct Totals {
+	uint64_t count;
+	uint64_t lost;
+	uint64_t reordered;
+	HdrHistogram hist;
+    };
+
+    LatencyStamp::Location _loc;
+    State *_states;
+    unsigned _nstates;
+    atomic_uint32_t _generation;
+
+    void totals(Totals &t) const;
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int read_param_handler(int, String &, Element *, const Handler *, ErrorHandler *) CLICK_COLD;
+    static int reset_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
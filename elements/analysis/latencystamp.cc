@@ -0,0 +1,100 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * latencystamp.{cc,hh} -- store sequence numbers and send times
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "latencystamp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/integers.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+LatencyStamp::LatencyStamp()
+{
+    _seq = 0;
+}
+
+int
+LatencyStamp::Location::assign(int offset_, bool tail, int anno_,
+			       const String &clock, ErrorHandler *errh)
+{
+    if ((offset_ >= 0) + tail + (anno_ >= 0) != 1)
+	return errh->error("supply exactly one of OFFSET, TAIL, and ANNO");
+    offset = offset_;
+    anno = anno_;
+    if (clock == "steady")
+	system_clock = false;
+    else if (clock == "system")
+	system_clock = true;
+    else
+	return errh->error("CLOCK must be %<steady%> or %<system%>");
+    return 0;
+}
+
+int
+LatencyStamp::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    int offset = -1, anno = -1;
+    bool tail = false;
+    String clock = "steady";
+    if (Args(conf, this, errh)
+	.read("OFFSET", offset)
+	.read("TAIL", tail)
+	.read("ANNO", AnnoArg(4), anno)
+	.read("CLOCK", WordArg(), clock)
+	.complete() < 0)
+	return -1;
+    return _loc.assign(offset, tail, anno, clock, errh);
+}
+
+Packet *
+LatencyStamp::simple_action(Packet *p)
+{
+    uint32_t seq = _seq.fetch_and_add(1);
+    uint64_t now = _loc.now();
+    if (_loc.anno >= 0) {
+	p->set_anno_u32(_loc.anno, seq);
+	p->timestamp_anno() = Timestamp::make_nsec(now);
+	return p;
+    }
+
+    int offset = (_loc.offset < 0 ? (int) p->length() : _loc.offset);
+    int delta = offset + record_size - p->length();
+    if (WritablePacket *q = p->put(delta < 0 ? 0 : delta)) {
+	uint32_t nseq = htonl(seq);
+	uint64_t nnow = host_to_net_order(now);
+	memcpy(q->data() + offset, &nseq, 4);
+	memcpy(q->data() + offset + 4, &nnow, 8);
+	return q;
+    } else
+	return 0;
+}
+
+int
+LatencyStamp::reset_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<LatencyStamp *>(e)->_seq = 0;
+    return 0;
+}
+
+void
+LatencyStamp::add_handlers()
+{
+    add_data_handlers("count", Handler::f_read, &_seq);
+    add_write_handler("reset", reset_handler, 0, Handler::f_button);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(LatencyStamp)
@@ -0,0 +1,106 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LATENCYSTAMP_HH
+#define CLICK_LATENCYSTAMP_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+LatencyStamp([I<keywords> OFFSET, TAIL, ANNO, CLOCK])
+
+=s timestamps
+
+stores sequence numbers and send times for LatencyMeter
+
+=d
+
+LatencyStamp gives each passing packet the next sequence number, starting at
+0, and stores it with the current time, for a downstream LatencyMeter to
+measure one-way latency, loss, and reordering.  Supply exactly one of the
+OFFSET, TAIL, and ANNO keywords.
+
+In the packet data, the record is 12 bytes: a 4-byte sequence number
+followed by an 8-byte time in nanoseconds, both in network byte order.
+
+Keyword arguments are:
+
+=over 8
+
+=item OFFSET
+
+Integer.  Store the record starting OFFSET bytes into the packet.  The
+packet will be extended, if necessary, so that it's at least OFFSET+12 bytes
+long.  For UDP packets built by UDPIPEncap, for example, OFFSET 28 stores the
+record at the start of the UDP payload.
+
+=item TAIL
+
+Boolean.  If true, append the record to the end of the packet.
+
+=item ANNO
+
+Annotation name.  Store the sequence number in this 4-byte annotation and
+the time in the timestamp annotation.
+
+=item CLOCK
+
+Either C<steady> or C<system>.  The steady clock never goes backwards, but is
+only comparable within a single host.  Use C<system> to measure between hosts
+with synchronized clocks.  Default is C<steady>.
+
+=back
+
+=h count read-only
+
+Returns the number of packets stamped.
+
+=h reset write-only
+
+Restart sequence numbers at 0.
+
+=a
+
+LatencyMeter, StoreTimestamp, SetTimestamp */
+
+class LatencyStamp : public Element { public:
+
+    LatencyStamp() CLICK_COLD;
+
+    const char *class_name() const	{ return "LatencyStamp"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    Packet *simple_action(Packet *);
+
+    enum { record_size = 12 };
+
+    // Where records are kept; shared with LatencyMeter.
+    struct Location {
+	int offset;		// -1 means the packet tail
+	int anno;		// -1 means in packet data
+	bool system_clock;
+
+	int assign(int offset, bool tail, int anno, const String &clock,
+		   ErrorHandler *errh) CLICK_COLD;
+	inline uint64_t now() const {
+	    Timestamp t = system_clock ? Timestamp::now() : Timestamp::now_steady();
+	    return t.nsecval();
+	}
+    };
+
+  private:
+
+    Location _loc;
+    atomic_uint32_t _seq;
+
+    static int reset_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,94 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SKETCHKEY_HH
+#define CLICK_SKETCHKEY_HH
+#include <click/packet_anno.hh>
+#include <click/ipaddress.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+/* Which 32-bit key of a packet a sketch element (HeavyHitters,
+ * HyperLogLog) counts: the aggregate annotation, as set by
+ * AggregateIPFlows and friends, or a prefix of the source or destination
+ * IP address. */
+class SketchKey { public:
+
+    enum { k_aggregate, k_src, k_dst };
+
+    SketchKey()
+	: _type(k_aggregate), _mask(0xFFFFFFFFU) {
+    }
+
+    int configure(const String &type, int prefix, ErrorHandler *errh) {
+	if (!type || type.equals("AGGREGATE", -1))
+	    _type = k_aggregate;
+	else if (type.equals("SRC", -1))
+	    _type = k_src;
+	else if (type.equals("DST", -1))
+	    _type = k_dst;
+	else
+	    return errh->error("KEY must be AGGREGATE, SRC, or DST");
+	if (prefix < 0 || prefix > 32)
+	    return errh->error("PREFIX out of range");
+	_mask = prefix ? 0xFFFFFFFFU << (32 - prefix) : 0;
+	return 0;
+    }
+
+    // Sets key to p's key.  Returns false if p has none.
+    inline bool extract(const Packet *p, uint32_t &key) const {
+	if (_type == k_aggregate) {
+	    key = AGGREGATE_ANNO(p);
+	    return true;
+	} else if (!p->has_network_header())
+	    return false;
+	const click_ip *iph = p->ip_header();
+	key = ntohl(_type == k_src ? iph->ip_src.s_addr : iph->ip_dst.s_addr) & _mask;
+	return true;
+    }
+
+    bool parse(const String &str, uint32_t &key) const {
+	IPAddress a;
+	if (_type == k_aggregate)
+	    return IntArg().parse(str, key);
+	else if (IPAddressArg().parse(str, a)) {
+	    key = ntohl(a.addr()) & _mask;
+	    return true;
+	} else
+	    return false;
+    }
+
+    void unparse(StringAccum &sa, uint32_t key) const {
+	if (_type == k_aggregate)
+	    sa << key;
+	else
+	    sa << IPAddress(htonl(key));
+    }
+
+    static inline uint32_t hash(uint32_t x, uint32_t seed) {
+	x ^= seed;
+	x ^= x >> 16;
+	x *= 0x85EBCA6BU;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35U;
+	return x ^ (x >> 16);
+    }
+
+    static inline uint64_t hash64(uint32_t x, uint64_t seed) {
+	uint64_t h = x ^ seed;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	return h ^ (h >> 33);
+    }
+
+  private:
+
+    int _type;
+    uint32_t _mask;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -54,9 +54,9 @@ ARPQuerier::cast(const char *name)
 int
 ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    uint32_t capacity, entry_capacity, entry_packet_capacity, capacity_slim_factor;
+    uint32_t capacity, entry_capacity, entry_packet_capacity, capacity_slim_factor, lookup_cache;
     Timestamp timeout, poll_timeout(60);
-    bool have_capacity, have_entry_capacity, have_entry_packet_capacity, have_capacity_slim_factor, have_timeout, have_broadcast,
+    bool have_capacity, have_entry_capacity, have_entry_packet_capacity, have_capacity_slim_factor, have_timeout, have_lookup_cache, have_broadcast,
 	broadcast_poll = false;
     _arpt = 0;
     if (Args(this, errh).bind(conf)
@@ -65,6 +65,7 @@ ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ENTRY_PACKET_CAPACITY", entry_packet_capacity).read_status(have_entry_packet_capacity)
 	.read("CAPACITY_SLIM_FACTOR", capacity_slim_factor).read_status(have_capacity_slim_factor)
 	.read("TIMEOUT", timeout).read_status(have_timeout)
+	.read("LOOKUP_CACHE", lookup_cache).read_status(have_lookup_cache)
 	.read("BROADCAST", _my_bcast_ip).read_status(have_broadcast)
 	.read("TABLE", ElementCastArg("ARPTable"), _arpt)
 	.read("POLL_TIMEOUT", poll_timeout)
@@ -84,6 +85,8 @@ ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 	    subconf.push_back("CAPACITY_SLIM_FACTOR " + String(capacity_slim_factor));
 	if (have_timeout)
 	    subconf.push_back("TIMEOUT " + timeout.unparse());
+	if (have_lookup_cache)
+	    subconf.push_back("LOOKUP_CACHE " + String(lookup_cache));
 	_arpt = new ARPTable;
 	_arpt->attach_router(router(), -1);
 	_arpt->configure(subconf, errh);
@@ -129,6 +132,7 @@ ARPQuerier::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ENTRY_PACKET_CAPACITY", entry_packet_capacity).read_status(have_entry_packet_capacity)
 	.read("CAPACITY_SLIM_FACTOR", capacity_slim_factor).read_status(have_capacity_slim_factor)
 	.read("TIMEOUT", timeout).read_status(have_timeout)
+	.read_with("LOOKUP_CACHE", AnyArg())
 	.read("BROADCAST", my_bcast_ip).read_status(have_broadcast)
 	.read_with("TABLE", AnyArg())
 	.read("POLL_TIMEOUT", poll_timeout)
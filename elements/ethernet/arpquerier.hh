@@ -56,7 +56,7 @@ Keyword arguments are:
 Element.  Names an ARPTable element that holds this element's corresponding
 ARP state.  By default ARPQuerier creates its own internal ARPTable and uses
 that.  If TABLE is specified, CAPACITY, ENTRY_CAPACITY, ENTRY_PACKET_CAPACITY,
-and TIMEOUT are ignored.
+TIMEOUT, and LOOKUP_CACHE are ignored.
 
 =item CAPACITY
 
@@ -77,6 +77,11 @@ for any given ARP entry at a time.  Default is 0, which means unlimited.
 
 Amount of time before an ARP entry expires.  Defaults to 5 minutes.
 
+=item LOOKUP_CACHE
+
+Unsigned integer.  Number of slots in the table's lock-free lookup cache; see
+ARPTable.  Defaults to 1024.  Cannot be changed by live reconfiguration.
+
 =item POLL_TIMEOUT
 
 Amount of time after which ARPQuerier will start polling for renewal.  0 means
@@ -31,30 +31,47 @@
 CLICK_DECLS
 
 ARPTable::ARPTable()
-    : _entry_capacity(0), _packet_capacity(2048), _entry_packet_capacity(0), _capacity_slim_factor(2), _expire_timer(this)
+    : _cache(0), _cache_mask(0),
+      _entry_capacity(0), _packet_capacity(2048), _entry_packet_capacity(0), _capacity_slim_factor(2), _expire_timer(this)
 {
     _entry_count = _packet_count = _drops = 0;
 }
 
 ARPTable::~ARPTable()
 {
+    delete[] _cache;
 }
 
 int
 ARPTable::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     Timestamp timeout(300);
+    uint32_t cache_size = 1024;
     if (Args(conf, this, errh)
 	.read("CAPACITY", _packet_capacity)
 	.read("ENTRY_CAPACITY", _entry_capacity)
 	.read("ENTRY_PACKET_CAPACITY", _entry_packet_capacity)
 	.read("CAPACITY_SLIM_FACTOR", _capacity_slim_factor)
 	.read("TIMEOUT", timeout)
+	.read("LOOKUP_CACHE", cache_size)
 	.complete() < 0)
 	return -1;
     if (_capacity_slim_factor == 0)
 	return errh->error("CAPACITY_SLIM_FACTOR cannot be zero");
+    if (cache_size > 0x1000000)
+	return errh->error("LOOKUP_CACHE too large");
     set_timeout(timeout);
+
+    // Readers may access the cache concurrently with a live reconfiguration,
+    // so it is never reallocated.
+    if (!_cache && cache_size) {
+	uint32_t n = 1;
+	while (n < cache_size)
+	    n <<= 1;
+	if (!(_cache = new CacheSlot[n]))
+	    return errh->error("out of memory");
+	_cache_mask = n - 1;
+    }
     if (_timeout_j) {
 	_expire_timer.initialize(this);
 	_expire_timer.schedule_after_sec(_timeout_j / CLICK_HZ);
@@ -71,6 +88,8 @@ ARPTable::cleanup(CleanupStage)
 void
 ARPTable::clear()
 {
+    _lock.acquire();
+    cache_clear();
     // Walk the arp cache table and free any stored packets and arp entries.
     for (Table::iterator it = _table.begin(); it; ) {
 	ARPEntry *ae = _table.erase(it);
@@ -83,6 +102,53 @@ ARPTable::clear()
     }
     _entry_count = _packet_count = 0;
     _age.__clear();
+    _lock.release();
+}
+
+void
+ARPTable::cache_store(const ARPEntry *ae)
+{
+    // Called with _lock held, so writers never race with each other.
+    if (!_cache)
+	return;
+    CacheSlot &s = cache_slot(ae->_ip);
+    s._seq++;
+    click_write_fence();
+    s._ip = ae->_ip;
+    s._live_at_j = ae->_live_at_j;
+    s._eth = ae->_eth;
+    click_write_fence();
+    s._seq++;
+}
+
+void
+ARPTable::cache_erase(IPAddress ip)
+{
+    if (!_cache)
+	return;
+    CacheSlot &s = cache_slot(ip);
+    if (s._ip == ip && !s._eth.is_broadcast()) {
+	s._seq++;
+	click_write_fence();
+	s._eth = EtherAddress::make_broadcast();
+	click_write_fence();
+	s._seq++;
+    }
+}
+
+void
+ARPTable::cache_clear()
+{
+    if (!_cache)
+	return;
+    for (uint32_t i = 0; i <= _cache_mask; ++i)
+	if (!_cache[i]._eth.is_broadcast()) {
+	    _cache[i]._seq++;
+	    click_write_fence();
+	    _cache[i]._eth = EtherAddress::make_broadcast();
+	    click_write_fence();
+	    _cache[i]._seq++;
+	}
 }
 
 void
@@ -96,6 +162,8 @@ ARPTable::take_state(Element *e, ErrorHandler *errh)
 	return;
     }
 
+    arpt->_lock.acquire();
+    arpt->cache_clear();
     _table.swap(arpt->_table);
     _age.swap(arpt->_age);
     _entry_count = arpt->_entry_count;
@@ -105,6 +173,13 @@ ARPTable::take_state(Element *e, ErrorHandler *errh)
 
     arpt->_entry_count = 0;
     arpt->_packet_count = 0;
+    arpt->_lock.release();
+
+    _lock.acquire();
+    for (ARPEntry *ae = _age.front(); ae; ae = ae->_age_link.next())
+	if (ae->_known)
+	    cache_store(ae);
+    _lock.release();
 }
 
 void
@@ -118,6 +193,7 @@ ARPTable::slim(click_jiffies_t now)
 	       || (_entry_capacity && _entry_count > _entry_capacity))) {
 	_table.erase(ae->_ip);
 	_age.pop_front();
+	cache_erase(ae->_ip);
 
 	while (Packet *p = ae->_head) {
 	    ae->_head = p->next();
@@ -155,9 +231,9 @@ ARPTable::run_timer(Timer *timer)
 {
     // Expire any old entries, and make sure there's room for at least one
     // packet.
-    _lock.acquire_write();
+    _lock.acquire();
     slim(click_jiffies());
-    _lock.release_write();
+    _lock.release();
     if (_timeout_j)
 	timer->schedule_after_sec(_timeout_j / CLICK_HZ + 1);
 }
@@ -165,12 +241,12 @@ ARPTable::run_timer(Timer *timer)
 ARPTable::ARPEntry *
 ARPTable::ensure(IPAddress ip, click_jiffies_t now)
 {
-    _lock.acquire_write();
+    _lock.acquire();
     Table::iterator it = _table.find(ip);
     if (!it) {
 	void *x = _alloc.allocate();
 	if (!x) {
-	    _lock.release_write();
+	    _lock.release();
 	    return 0;
 	}
 
@@ -203,6 +279,11 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
     ae->_num_polls_since_reply = 0;
     ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
 
+    if (ae->_known)
+	cache_store(ae);
+    else
+	cache_erase(ip);
+
     if (ae->_age_link.next()) {
 	_age.erase(ae);
 	_age.push_back(ae);
@@ -216,7 +297,7 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
     }
 
     _table.balance();
-    _lock.release_write();
+    _lock.release();
     return 0;
 }
 
@@ -229,7 +310,7 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 	return -ENOMEM;
 
     if (ae->known(now, _timeout_j)) {
-	_lock.release_write();
+	_lock.release();
 	return -EAGAIN;
     }
 
@@ -255,7 +336,7 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 
     if (_entry_packet_capacity && ae->_entry_packet_count >= _entry_packet_capacity) {
 	_drops++;
-	_lock.release_write();
+	_lock.release();
 	return -ENOMEM;
     }
 
@@ -279,14 +360,14 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 	r = 0;
 
     _table.balance();
-    _lock.release_write();
+    _lock.release();
     return r;
 }
 
 IPAddress
 ARPTable::reverse_lookup(const EtherAddress &eth)
 {
-    _lock.acquire_read();
+    _lock.acquire();
 
     IPAddress ip;
     for (Table::iterator it = _table.begin(); it; ++it)
@@ -295,7 +376,7 @@ ARPTable::reverse_lookup(const EtherAddress &eth)
 	    break;
 	}
 
-    _lock.release_read();
+    _lock.release();
     return ip;
 }
 
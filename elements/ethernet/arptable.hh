@@ -57,6 +57,22 @@ service attack.
 Time value.  The amount of time after which an ARP entry will expire.  Default
 is 5 minutes.  Zero means ARP entries never expire.
 
+=item LOOKUP_CACHE
+
+Unsigned integer.  The number of slots in the lock-free lookup cache, rounded
+up to a power of two.  Default is 1024; zero disables the cache.  See below.
+The cache size is fixed the first time ARPTable is configured.
+
+=back
+
+ARPTable answers most lookups from a direct-mapped cache of known entries that
+readers access without taking any lock.  Each cache slot is protected by a
+sequence counter: writers, which are serialized by the table lock, make the
+counter odd while they update a slot, and readers retry through the locked
+path if the counter changed during their read.  Lookups that miss the cache,
+find an entry that needs to be polled, or race with a writer fall back to the
+locked table, so results are identical with or without the cache.
+
 =h table r
 
 Return a table of the ARP entries.  The returned string has four
@@ -166,6 +182,17 @@ class ARPTable : public Element { public:
     static String read_handler(Element *e, void *user_data) CLICK_COLD;
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
 
+    struct CacheSlot {		// Seqlock-protected copy of a known entry.
+	atomic_uint32_t _seq;	// Odd while a writer updates the slot.
+	IPAddress _ip;
+	click_jiffies_t _live_at_j;
+	EtherAddress _eth;	// Broadcast means the slot is empty.
+	CacheSlot()
+	    : _live_at_j(0), _eth(EtherAddress::make_broadcast()) {
+	    _seq = 0;
+	}
+    };
+
     struct ARPEntry {		// This structure is now larger than I'd like
 	IPAddress _ip;		// (40B) but probably still fine.
 	ARPEntry *_hashnext;
@@ -208,7 +235,10 @@ class ARPTable : public Element { public:
 
   private:
 
-    ReadWriteLock _lock;
+    Spinlock _lock;
+
+    CacheSlot *_cache;
+    uint32_t _cache_mask;
 
     typedef HashContainer<ARPEntry> Table;
     Table _table;
@@ -228,12 +258,62 @@ class ARPTable : public Element { public:
     ARPEntry *ensure(IPAddress ip, click_jiffies_t now);
     void slim(click_jiffies_t now);
 
+    inline CacheSlot &cache_slot(IPAddress ip) const;
+    inline bool cache_lookup(IPAddress ip, EtherAddress *eth,
+			     click_jiffies_t &live_at_j) const;
+    void cache_store(const ARPEntry *ae);
+    void cache_erase(IPAddress ip);
+    void cache_clear();
+
 };
 
+inline ARPTable::CacheSlot &
+ARPTable::cache_slot(IPAddress ip) const
+{
+    uint32_t h = ip.hashcode();
+    h ^= h >> 16;
+    h *= 0x45D9F3BU;
+    h ^= h >> 16;
+    return _cache[h & _cache_mask];
+}
+
+/** @brief Look up @a ip in the lock-free cache.
+ *
+ * Returns true and sets @a eth and @a live_at_j iff a consistent copy of a
+ * known entry for @a ip was read.  Returns false on a miss or when a writer
+ * updated the slot concurrently; the caller should then use the locked path. */
+inline bool
+ARPTable::cache_lookup(IPAddress ip, EtherAddress *eth,
+		       click_jiffies_t &live_at_j) const
+{
+    if (!_cache)
+	return false;
+    const CacheSlot &s = cache_slot(ip);
+    uint32_t seq = s._seq.value();
+    if (seq & 1)
+	return false;
+    click_read_fence();
+    bool match = s._ip == ip;
+    *eth = s._eth;
+    live_at_j = s._live_at_j;
+    click_read_fence();
+    return match && s._seq.value() == seq && !eth->is_broadcast();
+}
+
 inline int
 ARPTable::lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
 {
-    _lock.acquire_read();
+    // Fast path: no locks, no writes to shared memory.
+    click_jiffies_t live_at_j;
+    if (cache_lookup(ip, eth, live_at_j)) {
+	click_jiffies_t now = click_jiffies();
+	if ((!_timeout_j || !click_jiffies_less(live_at_j + _timeout_j, now))
+	    && (!poll_timeout_j
+		|| click_jiffies_less(now, live_at_j + poll_timeout_j)))
+	    return 0;
+    }
+
+    _lock.acquire();
     int r = -1;
     if (Table::iterator it = _table.find(ip)) {
 	click_jiffies_t now = click_jiffies();
@@ -248,7 +328,7 @@ ARPTable::lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
 		r = 0;
 	}
     }
-    _lock.release_read();
+    _lock.release();
     return r;
 }
 
@@ -26,7 +26,9 @@
 CLICK_DECLS
 
 EtherSwitch::EtherSwitch()
-    : _table(AddrInfo(-1, Timestamp())), _timeout(300)
+    : _table(AddrInfo(-1, Timestamp())), _timeout(300),
+      _slots(0), _bucket_mask(0), _refresh(1), _locks(0),
+      _age_timer(this), _mt(false)
 {
 }
 
@@ -38,9 +40,159 @@ EtherSwitch::~EtherSwitch()
 int
 EtherSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh)
+    uint32_t capacity = 8192;
+    if (Args(conf, this, errh)
 	.read("TIMEOUT", SecondsArg(), _timeout)
-	.complete();
+	.read("MULTITHREAD", _mt)
+	.read("CAPACITY", capacity)
+	.read("REFRESH", SecondsArg(), _refresh)
+	.complete() < 0)
+	return -1;
+    if (_mt && (capacity < bucket_size || capacity > 0x4000000))
+	return errh->error("CAPACITY out of range");
+    if (_mt) {
+	uint32_t nbuckets = 1;
+	while (nbuckets * bucket_size < capacity)
+	    nbuckets <<= 1;
+	_bucket_mask = nbuckets - 1;
+    }
+    return 0;
+}
+
+int
+EtherSwitch::initialize(ErrorHandler *errh)
+{
+    if (_mt) {
+	uint32_t nslots = (_bucket_mask + 1) * bucket_size;
+	if (!(_slots = new MTSlot[nslots])
+	    || !(_locks = new SimpleSpinlock[nlocks]))
+	    return errh->error("out of memory");
+	for (uint32_t i = 0; i < nslots; ++i) {
+	    _slots[i].seq = 0;
+	    _slots[i].stamp = 0;
+	    _slots[i].port = -1;
+	}
+	_age_timer.initialize(this);
+	_age_timer.schedule_after_sec(1);
+    }
+    return 0;
+}
+
+void
+EtherSwitch::cleanup(CleanupStage)
+{
+    delete[] _slots;
+    delete[] _locks;
+    _slots = 0;
+    _locks = 0;
+}
+
+inline EtherSwitch::MTSlot *
+EtherSwitch::mt_bucket(const EtherAddress &addr) const
+{
+    uint32_t h = addr.hashcode();
+    h *= 0x9E3779B1U;
+    h ^= h >> 15;
+    return _slots + (h & _bucket_mask) * bucket_size;
+}
+
+inline SimpleSpinlock &
+EtherSwitch::mt_lock(const MTSlot *bucket) const
+{
+    return _locks[((bucket - _slots) / bucket_size) & (nlocks - 1)];
+}
+
+/* Read a consistent copy of slot and return its port, or -1 if the slot is
+   empty or a writer is updating it.  Takes no locks. */
+inline int
+EtherSwitch::mt_read(const MTSlot &slot, EtherAddress &addr, uint32_t &stamp)
+{
+    uint32_t seq = slot.seq.value();
+    if (seq & 1)
+	return -1;
+    click_read_fence();
+    int port = slot.port;
+    addr = slot.addr;
+    stamp = slot.stamp;
+    click_read_fence();
+    return slot.seq.value() == seq ? port : -1;
+}
+
+inline int
+EtherSwitch::mt_find(const MTSlot *bucket, const EtherAddress &addr,
+		     uint32_t &stamp) const
+{
+    EtherAddress a;
+    for (int i = 0; i < bucket_size; ++i) {
+	int port = mt_read(bucket[i], a, stamp);
+	if (port >= 0 && a == addr)
+	    return port;
+    }
+    return -1;
+}
+
+inline void
+EtherSwitch::mt_write(MTSlot &slot, const EtherAddress &addr, int port,
+		      uint32_t stamp)
+{
+    slot.seq++;
+    click_write_fence();
+    slot.addr = addr;
+    slot.port = port;
+    slot.stamp = stamp;
+    click_write_fence();
+    slot.seq++;
+}
+
+void
+EtherSwitch::mt_learn(const EtherAddress &addr, int port, uint32_t now)
+{
+    MTSlot *bucket = mt_bucket(addr);
+
+    // Most packets come from addresses we already know; avoid writing to
+    // shared memory unless the association changed or is getting old.
+    uint32_t stamp = 0;
+    if (mt_find(bucket, addr, stamp) == port
+	&& (int32_t) (now - stamp) < (int32_t) _refresh)
+	return;
+
+    SimpleSpinlock &lock = mt_lock(bucket);
+    lock.acquire();
+    MTSlot *victim = 0;
+    for (int i = 0; i < bucket_size && !victim; ++i)
+	if (bucket[i].port >= 0 && bucket[i].addr == addr)
+	    victim = &bucket[i];
+    for (int i = 0; i < bucket_size && !victim; ++i)
+	if (bucket[i].port < 0)
+	    victim = &bucket[i];
+    if (!victim) {
+	victim = &bucket[0];
+	for (int i = 1; i < bucket_size; ++i)
+	    if ((int32_t) (bucket[i].stamp - victim->stamp) < 0)
+		victim = &bucket[i];
+    }
+    mt_write(*victim, addr, port, now);
+    lock.release();
+}
+
+void
+EtherSwitch::run_timer(Timer *)
+{
+    uint32_t timeout = _timeout;
+    if (timeout) {
+	uint32_t now = Timestamp::now_steady().sec();
+	for (uint32_t b = 0; b <= _bucket_mask; ++b) {
+	    MTSlot *bucket = _slots + b * bucket_size;
+	    SimpleSpinlock &lock = mt_lock(bucket);
+	    lock.acquire();
+	    for (int i = 0; i < bucket_size; ++i)
+		if (bucket[i].port >= 0
+		    && (int32_t) (now - bucket[i].stamp) >= (int32_t) timeout)
+		    mt_write(bucket[i], bucket[i].addr, -1, bucket[i].stamp);
+	    lock.release();
+	}
+    }
+    _age_timer.reschedule_after_sec(timeout > 4 ? timeout / 4 : 1);
 }
 
 void
@@ -58,28 +210,47 @@ EtherSwitch::broadcast(int source, Packet *p)
   assert(sent == n - 1);
 }
 
-void
-EtherSwitch::push(int source, Packet *p)
+int
+EtherSwitch::route(int source, Packet *p)
 {
-    click_ether* e = (click_ether*) p->data();
+    const click_ether* e = (const click_ether*) p->data();
     int outport = -1;		// Broadcast
 
     // 0 timeout means dumb switch
-    if (_timeout != 0) {
-	_table.set(EtherAddress(e->ether_shost), AddrInfo(source, p->timestamp_anno()));
-
-	// Set outport if dst is unicast, we have info about it, and the
-	// info is still valid.
-	EtherAddress dst(e->ether_dhost);
-	if (!dst.is_group()) {
-	    if (Table::iterator dst_info = _table.find(dst)) {
-		if (p->timestamp_anno() < dst_info.value().stamp + Timestamp(_timeout, 0))
-		    outport = dst_info.value().port;
-		else
-		    _table.erase(dst_info);
-	    }
+    if (_timeout == 0)
+	return outport;
+
+    EtherAddress dst(e->ether_dhost);
+    if (_mt) {
+	uint32_t now = Timestamp::recent_steady().sec();
+	mt_learn(EtherAddress(e->ether_shost), source, now);
+	uint32_t stamp;
+	if (!dst.is_group()
+	    && (outport = mt_find(mt_bucket(dst), dst, stamp)) >= 0
+	    && (int32_t) (now - stamp) >= (int32_t) _timeout)
+	    outport = -1;	// expired; the aging timer will remove it
+	return outport;
+    }
+
+    _table.set(EtherAddress(e->ether_shost), AddrInfo(source, p->timestamp_anno()));
+
+    // Set outport if dst is unicast, we have info about it, and the
+    // info is still valid.
+    if (!dst.is_group()) {
+	if (Table::iterator dst_info = _table.find(dst)) {
+	    if (p->timestamp_anno() < dst_info.value().stamp + Timestamp(_timeout, 0))
+		outport = dst_info.value().port;
+	    else
+		_table.erase(dst_info);
 	}
     }
+    return outport;
+}
+
+void
+EtherSwitch::push(int source, Packet *p)
+{
+  int outport = route(source, p);
 
   if (outport < 0)
     broadcast(source, p);
@@ -96,8 +267,17 @@ EtherSwitch::reader(Element* f, void *thunk)
     switch ((intptr_t) thunk) {
     case 0: {
 	StringAccum sa;
-	for (Table::iterator iter = sw->_table.begin(); iter.live(); iter++)
-	    sa << iter.key() << ' ' << iter.value().port << '\n';
+	if (sw->_mt) {
+	    uint32_t nslots = (sw->_bucket_mask + 1) * bucket_size, stamp;
+	    EtherAddress addr;
+	    for (uint32_t i = 0; sw->_slots && i < nslots; ++i) {
+		int port = mt_read(sw->_slots[i], addr, stamp);
+		if (port >= 0)
+		    sa << addr << ' ' << port << '\n';
+	    }
+	} else
+	    for (Table::iterator iter = sw->_table.begin(); iter.live(); iter++)
+		sa << iter.key() << ' ' << iter.value().port << '\n';
 	return sa.take_string();
     }
     case 1:
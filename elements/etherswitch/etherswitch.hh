@@ -3,6 +3,8 @@
 #include <click/element.hh>
 #include <click/etheraddress.hh>
 #include <click/hashtable.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
 CLICK_DECLS
 
 /*
@@ -39,12 +41,43 @@ The timeout for port associations, in seconds.  Any port mapping (i.e.,
 binding between an address and a port number) is dropped after TIMEOUT seconds
 of inactivity.  If 0, the element acts like a dumb hub.  Default is 300.
 
+=item MULTITHREAD
+
+Boolean.  If true, use a table that is safe for concurrent use by several
+threads; see below.  Default is false.
+
+=item CAPACITY
+
+Unsigned integer.  The number of addresses the multithreaded table can hold,
+rounded up to a power of two.  Default is 8192.  Ignored unless MULTITHREAD is
+true.
+
+=item REFRESH
+
+The minimum interval, in seconds, between updates of a known address's
+timestamp in the multithreaded table.  Default is 1.  Ignored unless
+MULTITHREAD is true.
+
 =back
 
+In multithreaded mode, EtherSwitch stores associations in a fixed-size
+set-associative table.  Each four-entry bucket fits in a cache line, and
+writers to a bucket are serialized by one of a set of shard locks.
+Destination lookups take no locks: every entry has a sequence counter, and
+readers skip entries that a writer is updating.  Source learning first checks
+the table without locking and writes only when an address is new, has moved
+to another port, or has a timestamp older than REFRESH, so frequent senders
+do not cause a write on every packet.  When a bucket is full, the oldest
+association is replaced.  Associations are aged against the system's steady
+clock rather than packet timestamps, and a timer removes expired associations
+in the background.  A lookup that misses because of a concurrent update is treated
+like an unknown destination, and the packet is flooded.
+
 =n
 
-The EtherSwitch element has no limit on the memory consumed by cached Ethernet
-addresses.
+Without MULTITHREAD, the EtherSwitch element has no limit on the memory
+consumed by cached Ethernet addresses, and must not be used by more than one
+thread at a time.
 
 =h table read-only
 
@@ -70,9 +103,12 @@ class EtherSwitch : public Element { public:
   const char *flow_code() const			{ return "#/[^#]"; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
     void add_handlers() CLICK_COLD;
 
   void push(int port, Packet* p);
+  void run_timer(Timer *);
 
     struct AddrInfo {
 	int port;
@@ -80,12 +116,41 @@ class EtherSwitch : public Element { public:
 	inline AddrInfo(int p, const Timestamp &t);
     };
 
+    struct MTSlot {
+	atomic_uint32_t seq;	// odd while a writer updates the slot
+	uint32_t stamp;		// seconds
+	EtherAddress addr;
+	int16_t port;		// negative if the slot is empty
+    };
+
+  protected:
+
+    int route(int source, Packet *p);
+
   private:
 
     typedef HashTable<EtherAddress, AddrInfo> Table;
     Table _table;
     uint32_t _timeout;
 
+    enum { bucket_size = 4, nlocks = 256 };
+    MTSlot *_slots;
+    uint32_t _bucket_mask;
+    uint32_t _refresh;
+    SimpleSpinlock *_locks;
+    Timer _age_timer;
+    bool _mt;
+
+    inline MTSlot *mt_bucket(const EtherAddress &addr) const;
+    inline SimpleSpinlock &mt_lock(const MTSlot *bucket) const;
+    static inline int mt_read(const MTSlot &slot, EtherAddress &addr,
+			      uint32_t &stamp);
+    inline int mt_find(const MTSlot *bucket, const EtherAddress &addr,
+		       uint32_t &stamp) const;
+    void mt_learn(const EtherAddress &addr, int port, uint32_t now);
+    static inline void mt_write(MTSlot &slot, const EtherAddress &addr,
+				int port, uint32_t stamp);
+
     void broadcast(int source, Packet*);
 
     static String reader(Element *, void *);
@@ -119,7 +119,7 @@ class ICMPPingRewriter : public IPRewriterBase { public:
     SizedHashAllocator<sizeof(ICMPPingFlow)> _allocator;
     unsigned _annos;
 
-    static String dump_mappings_handler(Element *, void *);
+    static int dump_mappings_handler(Element *, void *, StringAccum &, uint64_t &);
 
 };
 
@@ -0,0 +1,673 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * conntracker.{cc,hh} -- stateful firewall connection tracker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "conntracker.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/master.hh>
+#include <clicknet/udp.h>
+#include <clicknet/icmp.h>
+CLICK_DECLS
+
+ConnTracker::State::State()
+    : conns(0), nconns(0), free(0), count(0), tick(0),
+      stat_created(0), stat_expired(0), stat_evicted(0)
+{
+    memset(wheel, 0, sizeof(wheel));
+    memset(stat_packets, 0, sizeof(stat_packets));
+}
+
+ConnTracker::ConnTracker()
+    : _states(0), _nstates(0)
+{
+}
+
+ConnTracker::~ConnTracker()
+{
+}
+
+int
+ConnTracker::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _capacity = 1 << 20;
+    _tcp_timeout = 86400;	// 24 hours
+    _tcp_syn_timeout = 60;
+    _tcp_done_timeout = 240;	// 4 minutes
+    _udp_timeout = 300;		// 5 minutes
+    _icmp_timeout = 30;
+    if (Args(conf, this, errh)
+	.read("CAPACITY", _capacity)
+	.read("TCP_TIMEOUT", SecondsArg(), _tcp_timeout)
+	.read("TCP_SYN_TIMEOUT", SecondsArg(), _tcp_syn_timeout)
+	.read("TCP_DONE_TIMEOUT", SecondsArg(), _tcp_done_timeout)
+	.read("UDP_TIMEOUT", SecondsArg(), _udp_timeout)
+	.read("ICMP_TIMEOUT", SecondsArg(), _icmp_timeout)
+	.complete() < 0)
+	return -1;
+    if (_capacity == 0)
+	return errh->error("CAPACITY must be positive");
+    // keep expiry times from overflowing
+    uint32_t *timeouts[] = { &_tcp_timeout, &_tcp_syn_timeout,
+			     &_tcp_done_timeout, &_udp_timeout, &_icmp_timeout };
+    for (int i = 0; i < 5; ++i)
+	if (*timeouts[i] > 0x3FFFFFFF)
+	    *timeouts[i] = 0x3FFFFFFF;
+    return 0;
+}
+
+int
+ConnTracker::initialize(ErrorHandler *errh)
+{
+    _nstates = click_max_cpu_ids();
+    if (!(_states = new State[_nstates]))
+	return errh->error("out of memory");
+    int nthreads = master()->nthreads();
+    if (nthreads <= 0)
+	nthreads = 1;
+    _thread_capacity = _capacity / nthreads ? _capacity / nthreads : 1;
+    return 0;
+}
+
+void
+ConnTracker::cleanup(CleanupStage)
+{
+    for (unsigned i = 0; i < _nstates; i++)
+	delete[] _states[i].conns;
+    delete[] _states;
+    _states = 0;
+}
+
+
+// TABLE AND TIMING WHEEL
+
+bool
+ConnTracker::grow_conns(State &st)
+{
+    uint32_t n = st.nconns ? st.nconns * 2 : (uint32_t) INITIAL_CONNS;
+    if (n > _thread_capacity + 1)
+	n = _thread_capacity + 1;
+    if (n <= st.nconns)
+	return false;
+    Conn *conns = new Conn[n];
+    if (!conns)
+	return false;
+    if (st.nconns)
+	memcpy(conns, st.conns, sizeof(Conn) * st.nconns);
+    // chain the new connections onto the free list; index 0 is never used
+    for (uint32_t ci = n - 1; ci >= st.nconns && ci > 0; --ci) {
+	conns[ci].flags = 0;
+	conns[ci].wheel_next = st.free;
+	st.free = ci;
+    }
+    delete[] st.conns;
+    st.conns = conns;
+    st.nconns = n;
+    return true;
+}
+
+/* Links connection ci onto the wheel bucket for its expiry time.  Times
+ * beyond the wheel's reach go on its last bucket and are rescheduled when
+ * that bucket comes due. */
+inline void
+ConnTracker::wheel_link(State &st, uint32_t ci)
+{
+    Conn &c = st.conns[ci];
+    int32_t t = c.expires;
+    if (t - st.tick <= 0)
+	t = st.tick + 1;
+    else if (t - st.tick >= WHEEL_SIZE)
+	t = st.tick + WHEEL_SIZE - 1;
+    c.sched = t;
+    uint32_t &head = st.wheel[(uint32_t) t % WHEEL_SIZE];
+    c.wheel_prev = 0;
+    c.wheel_next = head;
+    if (head)
+	st.conns[head].wheel_prev = ci;
+    head = ci;
+}
+
+inline void
+ConnTracker::wheel_unlink(State &st, uint32_t ci)
+{
+    Conn &c = st.conns[ci];
+    if (c.wheel_prev)
+	st.conns[c.wheel_prev].wheel_next = c.wheel_next;
+    else
+	st.wheel[(uint32_t) c.sched % WHEEL_SIZE] = c.wheel_next;
+    if (c.wheel_next)
+	st.conns[c.wheel_next].wheel_prev = c.wheel_prev;
+}
+
+/* Sets ci's expiry time.  A later time just waits for the connection's
+ * bucket to come due; an earlier one moves the connection to an earlier
+ * bucket. */
+inline void
+ConnTracker::set_expiry(State &st, uint32_t ci, int32_t expires)
+{
+    Conn &c = st.conns[ci];
+    c.expires = expires;
+    if (expires - c.sched < 0 && c.sched - st.tick > 1) {
+	wheel_unlink(st, ci);
+	wheel_link(st, ci);
+    }
+}
+
+uint32_t
+ConnTracker::new_conn(State &st, const Key &key, bool swapped, int32_t expires)
+{
+    if (st.count >= _thread_capacity)
+	evict(st);
+    if (!st.free && !grow_conns(st))
+	return 0;
+    uint32_t ci = st.free;
+    if (!st.map.set(key, ci))
+	return 0;
+    Conn &c = st.conns[ci];
+    st.free = c.wheel_next;
+    c.key = key;
+    c.state = s_none;
+    memset(c.tcp, 0, sizeof(c.tcp));
+    c.flags = f_live | (swapped ? f_orig_b : 0);
+    c.expires = expires;
+    wheel_link(st, ci);
+    ++st.count;
+    ++st.stat_created;
+    return ci;
+}
+
+void
+ConnTracker::remove_conn(State &st, uint32_t ci)
+{
+    Conn &c = st.conns[ci];
+    wheel_unlink(st, ci);
+    st.map.erase(c.key);
+    c.flags = 0;
+    c.wheel_next = st.free;
+    st.free = ci;
+    --st.count;
+}
+
+/* Makes room for a new connection.  Looks through the connections in the
+ * wheel's earliest buckets and evicts the one that expires first among those
+ * that have never seen a reply, or else the one that expires first.  A
+ * refreshed connection stays in its old bucket, so buckets only bound the
+ * expiry times; the times themselves are compared. */
+void
+ConnTracker::evict(State &st)
+{
+    uint32_t victim = 0, unreplied = 0;
+    int n = 0;
+    for (int32_t t = st.tick + 1; t - st.tick < WHEEL_SIZE && n < EVICT_SCAN; ++t)
+	for (uint32_t ci = st.wheel[(uint32_t) t % WHEEL_SIZE];
+	     ci && n < EVICT_SCAN; ci = st.conns[ci].wheel_next, ++n) {
+	    const Conn &c = st.conns[ci];
+	    if (!victim || c.expires - st.conns[victim].expires < 0)
+		victim = ci;
+	    if (!(c.flags & f_replied)
+		&& (!unreplied || c.expires - st.conns[unreplied].expires < 0))
+		unreplied = ci;
+	}
+    if (unreplied)
+	victim = unreplied;
+    if (victim) {
+	remove_conn(st, victim);
+	++st.stat_evicted;
+    }
+}
+
+/* Processes the wheel's buckets through tick now, forgetting expired
+ * connections and rescheduling the rest. */
+void
+ConnTracker::advance(State &st, int32_t now)
+{
+    if (now - st.tick <= 0)
+	return;
+    if (!st.count) {
+	st.tick = now;
+	return;
+    }
+    int32_t t = st.tick + 1;
+    if (now - st.tick > WHEEL_SIZE)
+	t = now - WHEEL_SIZE + 1;
+    for (; t - now <= 0; ++t) {
+	st.tick = t;
+	uint32_t &head = st.wheel[(uint32_t) t % WHEEL_SIZE];
+	while (uint32_t ci = head)
+	    if (st.conns[ci].expires - now <= 0) {
+		remove_conn(st, ci);
+		++st.stat_expired;
+	    } else {
+		wheel_unlink(st, ci);
+		wheel_link(st, ci);
+	    }
+    }
+}
+
+
+// CLASSIFICATION
+
+uint32_t
+ConnTracker::tcp_timeout(int state) const
+{
+    switch (state) {
+    case s_syn_sent:
+    case s_syn_recv:
+	return _tcp_syn_timeout;
+    case s_established:
+	return _tcp_timeout;
+    case s_close:
+	return _tcp_done_timeout < (uint32_t) CLOSE_TIMEOUT ? _tcp_done_timeout : (uint32_t) CLOSE_TIMEOUT;
+    default:
+	return _tcp_done_timeout;
+    }
+}
+
+/* Returns the window scale option from a SYN, or -1 if it has none. */
+int
+ConnTracker::tcp_wscale(const click_tcp *tcph)
+{
+    const uint8_t *opt = reinterpret_cast<const uint8_t *>(tcph + 1);
+    const uint8_t *end = reinterpret_cast<const uint8_t *>(tcph) + (tcph->th_off << 2);
+    while (opt < end && *opt != TCPOPT_EOL)
+	if (*opt == TCPOPT_NOP)
+	    ++opt;
+	else if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end)
+	    break;
+	else if (opt[0] == TCPOPT_WSCALE && opt[1] == TCPOLEN_WSCALE)
+	    return opt[2] > 14 ? 14 : opt[2];
+	else
+	    opt += opt[1];
+    return -1;
+}
+
+/* Checks that a segment lies within the windows of direction d of
+ * connection c, and if so, advances the windows.  This is the window
+ * tracking of Guido van Rooij, "Real Stateful TCP Packet Filtering in IP
+ * Filter": a segment is acceptable if its sequence numbers fall in the
+ * receiver's advertised window and its acknowledgement covers data the
+ * receiver has actually sent. */
+bool
+ConnTracker::tcp_in_window(Conn &c, int d, const click_tcp *tcph, uint32_t len)
+{
+    TCPDir &snd = c.tcp[d], &rcv = c.tcp[!d];
+    int flags = tcph->th_flags;
+    uint32_t seq = ntohl(tcph->th_seq), ack = ntohl(tcph->th_ack);
+    uint32_t win = ntohs(tcph->th_win);
+    uint32_t end = seq + len + (flags & TH_SYN ? 1 : 0) + (flags & TH_FIN ? 1 : 0);
+
+    if (!snd.maxwin
+	|| ((flags & (TH_SYN | TH_ACK)) == TH_SYN && SEQ_GT(end, snd.end))) {
+	// first segment in this direction, or a SYN with a new initial
+	// sequence number
+	if (flags & TH_SYN) {
+	    snd.end = snd.maxend = end;
+	    snd.maxwin = win ? win : 1;
+	    int ws = tcp_wscale(tcph);
+	    snd.scale = ws >= 0 ? ws : 0;
+	    snd.flags = ws >= 0 ? d_wscale : 0;
+	    // once both SYNs are in, scaling applies only if both ends
+	    // offered it
+	    if (rcv.maxwin && !(snd.flags & rcv.flags & d_wscale))
+		snd.scale = rcv.scale = 0;
+	    if (!(flags & TH_ACK))
+		return true;
+	} else {
+	    snd.end = end;
+	    snd.maxwin = (win << snd.scale) ? win << snd.scale : 1;
+	    snd.maxend = end + snd.maxwin;
+	}
+    }
+
+    if (!(flags & TH_ACK) || ((flags & TH_RST) && ack == 0))
+	ack = rcv.end;
+    // judge empty segments, such as pure acknowledgements and keepalives,
+    // by the data already sent
+    if (seq == end && !(flags & TH_RST))
+	seq = end = snd.end;
+
+    uint32_t maxackwin = snd.maxwin > 66000 ? snd.maxwin : 66000;
+    if (!(SEQ_LEQ(seq, snd.maxend)
+	  && SEQ_GEQ(end, snd.end - rcv.maxwin)
+	  && SEQ_LEQ(ack, rcv.end)
+	  && SEQ_GEQ(ack, rcv.end - maxackwin)))
+	return false;
+
+    if (!(flags & TH_SYN))
+	win <<= snd.scale;
+    if (snd.maxwin < win)
+	snd.maxwin = win;
+    if (rcv.maxwin && SEQ_GT(end, snd.maxend))
+	rcv.maxwin += end - snd.maxend;
+    if (SEQ_GT(end, snd.end))
+	snd.end = end;
+    if (SEQ_GEQ(ack + win, rcv.maxend))
+	rcv.maxend = ack + win + (win ? 0 : 1);
+    return true;
+}
+
+int
+ConnTracker::track_tcp(State &st, Packet *p, const Key &key, bool swapped,
+		       int32_t now)
+{
+    const click_ip *iph = p->ip_header();
+    const click_tcp *tcph = p->tcp_header();
+    uint32_t hl = tcph->th_off << 2;
+    uint32_t iplen = ntohs(iph->ip_len);
+    uint32_t off = p->transport_header() - p->network_header() + hl;
+    if (hl < sizeof(click_tcp) || p->transport_header() + hl > p->end_data()
+	|| iplen < off)
+	return c_invalid;
+    uint32_t len = iplen - off;
+
+    int flags = tcph->th_flags & (TH_FIN | TH_SYN | TH_RST | TH_ACK);
+    if (flags != TH_SYN && flags != (TH_SYN | TH_ACK) && flags != TH_RST
+	&& flags != (TH_RST | TH_ACK) && flags != (TH_FIN | TH_ACK)
+	&& flags != TH_ACK)
+	return c_invalid;
+
+    uint32_t ci = st.map.get(key);
+    // a SYN restarts a closed connection
+    if (ci && flags == TH_SYN
+	&& (st.conns[ci].state == s_time_wait || st.conns[ci].state == s_close)) {
+	remove_conn(st, ci);
+	ci = 0;
+    }
+    if (!ci) {
+	if (flags != TH_SYN
+	    || !(ci = new_conn(st, key, swapped, now + _tcp_syn_timeout)))
+	    return c_invalid;
+	Conn &c = st.conns[ci];
+	c.state = s_syn_sent;
+	tcp_in_window(c, 0, tcph, len);
+	return c_new;
+    }
+
+    Conn &c = st.conns[ci];
+    int d = swapped != !!(c.flags & f_orig_b);
+    int state = c.state;
+    switch (flags) {
+    case TH_SYN:
+	// retransmitted SYN
+	if (d != 0 || state != s_syn_sent)
+	    return c_invalid;
+	break;
+    case TH_SYN | TH_ACK:
+	if (d != 1 || (state != s_syn_sent && state != s_syn_recv))
+	    return c_invalid;
+	state = s_syn_recv;
+	break;
+    case TH_RST:
+    case TH_RST | TH_ACK:
+	state = s_close;
+	break;
+    case TH_FIN | TH_ACK:
+	if (state == s_syn_sent)
+	    return c_invalid;
+	if (state != s_close)
+	    state = c.tcp[!d].flags & d_fin ? s_time_wait : s_fin_wait;
+	break;
+    default:
+	if (state == s_syn_sent)
+	    return c_invalid;
+	if (state == s_syn_recv && d == 0)
+	    state = s_established;
+	break;
+    }
+    if (!tcp_in_window(c, d, tcph, len))
+	return c_invalid;
+    if (flags == (TH_FIN | TH_ACK))
+	c.tcp[d].flags |= d_fin;
+    c.state = state;
+    if (d)
+	c.flags |= f_replied;
+    set_expiry(st, ci, now + tcp_timeout(state));
+    return c.flags & f_replied ? c_established : c_new;
+}
+
+int
+ConnTracker::track_icmp(State &st, Packet *p, int32_t now)
+{
+    const click_ip *iph = p->ip_header();
+    const unsigned char *th = p->transport_header();
+    if (th + sizeof(click_icmp) > p->end_data())
+	return c_invalid;
+    const click_icmp_sequenced *icmph = reinterpret_cast<const click_icmp_sequenced *>(th);
+
+    int request;
+    switch (icmph->icmp_type) {
+    case ICMP_ECHO:
+    case ICMP_TSTAMP:
+    case ICMP_IREQ:
+    case ICMP_MASKREQ:
+	request = icmph->icmp_type;
+	break;
+    case ICMP_ECHOREPLY:
+	request = ICMP_ECHO;
+	break;
+    case ICMP_TSTAMPREPLY:
+    case ICMP_IREQREPLY:
+    case ICMP_MASKREQREPLY:
+	request = icmph->icmp_type - 1;
+	break;
+    case ICMP_UNREACH:
+    case ICMP_SOURCEQUENCH:
+    case ICMP_REDIRECT:
+    case ICMP_TIMXCEED:
+    case ICMP_PARAMPROB: {
+	// an error is related to the connection of the packet it quotes
+	const click_ip *qiph = reinterpret_cast<const click_ip *>(th + sizeof(click_icmp));
+	if (reinterpret_cast<const unsigned char *>(qiph + 1) > p->end_data()
+	    || qiph->ip_v != 4 || qiph->ip_hl < 5)
+	    return c_invalid;
+	const unsigned char *qth = reinterpret_cast<const unsigned char *>(qiph) + (qiph->ip_hl << 2);
+	uint16_t sport = 0, dport = 0;
+	if (qiph->ip_p == IP_PROTO_TCP || qiph->ip_p == IP_PROTO_UDP) {
+	    if (qth + 4 > p->end_data())
+		return c_invalid;
+	    const click_udp *qudph = reinterpret_cast<const click_udp *>(qth);
+	    sport = qudph->uh_sport;
+	    dport = qudph->uh_dport;
+	} else if (qiph->ip_p == IP_PROTO_ICMP) {
+	    if (qth + sizeof(click_icmp) > p->end_data()
+		|| (qth[0] != ICMP_ECHO && qth[0] != ICMP_TSTAMP
+		    && qth[0] != ICMP_IREQ && qth[0] != ICMP_MASKREQ))
+		return c_invalid;
+	    sport = dport = reinterpret_cast<const click_icmp_sequenced *>(qth)->icmp_identifier;
+	}
+	bool swapped;
+	Key key(qiph->ip_src.s_addr, sport, qiph->ip_dst.s_addr, dport, qiph->ip_p, swapped);
+	return st.map.get(key) ? c_related : c_invalid;
+    }
+    default:
+	return c_invalid;
+    }
+
+    bool swapped;
+    Key key(iph->ip_src.s_addr, icmph->icmp_identifier,
+	    iph->ip_dst.s_addr, icmph->icmp_identifier, IP_PROTO_ICMP, swapped);
+    uint32_t ci = st.map.get(key);
+    if (request == icmph->icmp_type) {
+	if (!ci) {
+	    if (!(ci = new_conn(st, key, swapped, now + _icmp_timeout)))
+		return c_invalid;
+	    st.conns[ci].state = request;
+	    return c_new;
+	}
+    } else if (!ci)
+	return c_invalid;
+
+    Conn &c = st.conns[ci];
+    int d = swapped != !!(c.flags & f_orig_b);
+    if (c.state != request || d != (request == icmph->icmp_type ? 0 : 1))
+	return c_invalid;
+    if (d)
+	c.flags |= f_replied;
+    set_expiry(st, ci, now + _icmp_timeout);
+    return c.flags & f_replied ? c_established : c_new;
+}
+
+int
+ConnTracker::classify(State &st, Packet *p, int32_t now)
+{
+    if (!p->has_network_header())
+	return c_invalid;
+    const click_ip *iph = p->ip_header();
+    if (!IP_FIRSTFRAG(iph))
+	return c_invalid;
+    int proto = iph->ip_p;
+    if (proto == IP_PROTO_ICMP)
+	return track_icmp(st, p, now);
+
+    uint16_t sport = 0, dport = 0;
+    if (proto == IP_PROTO_TCP || proto == IP_PROTO_UDP) {
+	if (p->transport_header() + (proto == IP_PROTO_TCP ? sizeof(click_tcp) : sizeof(click_udp)) > p->end_data())
+	    return c_invalid;
+	sport = p->udp_header()->uh_sport;
+	dport = p->udp_header()->uh_dport;
+    }
+    bool swapped;
+    Key key(iph->ip_src.s_addr, sport, iph->ip_dst.s_addr, dport, proto, swapped);
+    if (proto == IP_PROTO_TCP)
+	return track_tcp(st, p, key, swapped, now);
+
+    // UDP and other protocols
+    uint32_t ci = st.map.get(key);
+    if (!ci)
+	return new_conn(st, key, swapped, now + _udp_timeout) ? c_new : c_invalid;
+    Conn &c = st.conns[ci];
+    if (swapped != !!(c.flags & f_orig_b))
+	c.flags |= f_replied;
+    set_expiry(st, ci, now + _udp_timeout);
+    return c.flags & f_replied ? c_established : c_new;
+}
+
+void
+ConnTracker::push(int, Packet *p)
+{
+    State &st = state();
+    int32_t now = p->timestamp_anno() ? p->timestamp_anno().sec() : Timestamp::recent().sec();
+    advance(st, now);
+    int c = classify(st, p, now);
+    ++st.stat_packets[c];
+    checked_output_push(c, p);
+}
+
+
+// HANDLERS
+
+String
+ConnTracker::read_handler(Element *e, void *user_data)
+{
+    ConnTracker *ct = static_cast<ConnTracker *>(e);
+    uint64_t v[7];
+    memset(v, 0, sizeof(v));
+    uint32_t count = 0;
+    StringAccum sa;
+    for (unsigned i = 0; i < ct->_nstates; i++) {
+	const State &st = ct->_states[i];
+	count += st.count;
+	for (int j = 0; j < 4; j++)
+	    v[j] += st.stat_packets[j];
+	v[4] += st.stat_created;
+	v[5] += st.stat_expired;
+	v[6] += st.stat_evicted;
+	if ((intptr_t) user_data != h_table)
+	    continue;
+	for (uint32_t ci = 1; ci < st.nconns; ci++) {
+	    const Conn &c = st.conns[ci];
+	    if (!(c.flags & f_live))
+		continue;
+	    const Key &k = c.key;
+	    IPAddress src(k.a), dst(k.b);
+	    uint16_t sport = ntohs(k.aport), dport = ntohs(k.bport);
+	    if (c.flags & f_orig_b) {
+		click_swap(src, dst);
+		click_swap(sport, dport);
+	    }
+	    if (k.proto == IP_PROTO_TCP)
+		sa << "tcp";
+	    else if (k.proto == IP_PROTO_UDP)
+		sa << "udp";
+	    else if (k.proto == IP_PROTO_ICMP)
+		sa << "icmp";
+	    else
+		sa << "proto" << k.proto;
+	    sa << ' ' << src;
+	    if (k.proto == IP_PROTO_TCP || k.proto == IP_PROTO_UDP || k.proto == IP_PROTO_ICMP)
+		sa << ':' << sport;
+	    sa << ' ' << dst;
+	    if (k.proto == IP_PROTO_TCP || k.proto == IP_PROTO_UDP || k.proto == IP_PROTO_ICMP)
+		sa << ':' << dport;
+	    static const char * const tcp_states[] = {
+		"none", "syn_sent", "syn_recv", "established", "fin_wait",
+		"time_wait", "close"
+	    };
+	    if (k.proto == IP_PROTO_TCP)
+		sa << ' ' << tcp_states[c.state];
+	    else
+		sa << (c.flags & f_replied ? " replied" : " unreplied");
+	    sa << ' ' << (c.expires - st.tick) << '\n';
+	}
+    }
+    switch ((intptr_t) user_data) {
+    case h_count:
+	return String(count);
+    case h_capacity:
+	return String(ct->_capacity);
+    case h_evictions:
+	return String(v[6]);
+    case h_table:
+	return sa.take_string();
+    default: {
+	static const char * const names[] = {
+	    "new", "established", "related", "invalid",
+	    "created", "expired", "evicted"
+	};
+	for (int i = 0; i < 7; i++)
+	    sa << names[i] << ' ' << v[i] << '\n';
+	sa << "count " << count << '\n';
+	return sa.take_string();
+    }
+    }
+}
+
+int
+ConnTracker::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ConnTracker *ct = static_cast<ConnTracker *>(e);
+    for (unsigned i = 0; i < ct->_nstates; i++) {
+	State &st = ct->_states[i];
+	for (uint32_t ci = 1; ci < st.nconns; ci++)
+	    if (st.conns[ci].flags & f_live)
+		ct->remove_conn(st, ci);
+    }
+    return 0;
+}
+
+void
+ConnTracker::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("capacity", read_handler, h_capacity);
+    add_read_handler("evictions", read_handler, h_evictions);
+    add_read_handler("stats", read_handler, h_stats);
+    add_read_handler("table", read_handler, h_table);
+    add_write_handler("clear", write_handler, h_clear);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(ConnTracker)
@@ -0,0 +1,306 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CONNTRACKER_HH
+#define CLICK_CONNTRACKER_HH
+#include <click/element.hh>
+#include <click/flathashtable.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+CLICK_DECLS
+
+/*
+=c
+
+ConnTracker([I<keywords> CAPACITY, TCP_TIMEOUT, TCP_SYN_TIMEOUT, ...])
+
+=s ip
+
+stateful firewall connection tracker
+
+=d
+
+Expects IP packets with their IP header annotations set (by CheckIPHeader,
+for example) on its input, tracks the connections they belong to, and
+classifies each packet by connection state:
+
+=over 5
+
+=item 0
+
+New: the packet starts a connection, or belongs to a connection that has not
+yet seen a reply.
+
+=item 1
+
+Established: the packet belongs to a connection that has seen traffic in both
+directions, or is itself a reply.
+
+=item 2
+
+Related: the packet is an ICMP error about a tracked connection.
+
+=item 3
+
+Invalid: the packet fits no connection, or does not fit the state of its
+connection.  Invalid packets are dropped if output 3 does not exist.
+
+=back
+
+A stateful firewall typically sends established and related packets on,
+filters new packets through its policy, and drops invalid packets:
+
+  ct :: ConnTracker;
+  ct[0] -> IPFilter(allow dst tcp port 22 or 80, deny all) -> out;
+  ct[1] -> out;
+  ct[2] -> out;
+
+ConnTracker follows TCP connections through their handshake and teardown and
+checks that every segment's sequence and acknowledgement numbers lie within
+the windows its peer has advertised, taking window scaling into account.
+Only a SYN starts a TCP connection; other segments without a connection are
+invalid, as are segments with impossible flag combinations, segments that
+violate the handshake, and segments outside the windows.  A SYN on a closed
+connection starts it afresh.  An RST within the window closes the
+connection at once.
+
+UDP packets form pseudo-connections between address and port pairs.  Other
+IP protocols, except ICMP, are tracked the same way by address pair.  ICMP
+echo, timestamp, information, and address mask requests form connections
+with their identifiers; replies without a request are invalid.  ICMP errors
+are related if the packet they quote belongs to a tracked connection, and
+invalid otherwise.  Fragments after the first cannot be classified and are
+invalid, so reassemble with IPReassembler first.
+
+A new connection is entered in the table with its first packet, whether or
+not the firewall goes on to accept that packet.  Each connection times out
+after a period without traffic that depends on its state.  Expiry is
+processed in bulk by a timing wheel with one-second ticks, so connections may
+outlive their timeouts by up to a second.  Time is measured by packet
+timestamps, or the current time for packets without timestamps.
+
+Connections are kept in per-thread tables, so both directions of a
+connection must arrive on the same thread, as they do with symmetric
+receive-side scaling.  Each connection takes about 100 bytes.  When a
+thread's table reaches its share of CAPACITY, ConnTracker evicts the
+connection closest to expiry to make room, preferring one that has never
+seen a reply.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned integer.  Maximum number of connections.  Default is 1048576.
+
+=item TCP_TIMEOUT
+
+Time in seconds.  Timeout for established TCP connections.  Default is 24
+hours.
+
+=item TCP_SYN_TIMEOUT
+
+Time in seconds.  Timeout for TCP connections during their handshake.
+Default is 60.
+
+=item TCP_DONE_TIMEOUT
+
+Time in seconds.  Timeout for TCP connections that have seen a FIN.  Default
+is 240.  Connections closed by RST time out after 10 seconds or
+TCP_DONE_TIMEOUT, whichever is less.
+
+=item UDP_TIMEOUT
+
+Time in seconds.  Timeout for UDP and other connections.  Default is 300.
+
+=item ICMP_TIMEOUT
+
+Time in seconds.  Timeout for ICMP query connections.  Default is 30.
+
+=back
+
+=h count read-only
+
+Returns the number of connections.
+
+=h capacity read-only
+
+Returns CAPACITY.
+
+=h evictions read-only
+
+Returns the number of connections evicted to make room for new ones.
+
+=h stats read-only
+
+Returns statistics: new, established, related, and invalid packets;
+connections created, timed out, and evicted; and the number of connections.
+
+=h table read-only
+
+Returns the connections, one per line: protocol, original source address
+and port, original destination address and port, state, and seconds until
+timeout.
+
+=h clear write-only
+
+Forgets every connection.
+
+=a
+
+IPFilter, IPTupleFilter, IPRewriter, IPReassembler, TCPReassembler */
+
+class ConnTracker : public Element { public:
+
+    ConnTracker() CLICK_COLD;
+    ~ConnTracker() CLICK_COLD;
+
+    const char *class_name() const	{ return "ConnTracker"; }
+    const char *port_count() const	{ return "1/3-4"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+
+  private:
+
+    enum { c_new = 0, c_established = 1, c_related = 2, c_invalid = 3 };
+    enum { INITIAL_CONNS = 64, WHEEL_SIZE = 1024, CLOSE_TIMEOUT = 10,
+	   EVICT_SCAN = 64 };
+
+    // TCP states.  For ICMP queries, Conn::state holds the request type.
+    enum { s_none = 0, s_syn_sent, s_syn_recv, s_established, s_fin_wait,
+	   s_time_wait, s_close };
+
+    // Connection key.  The address and port pairs are sorted so that both
+    // directions of a connection share a key.  ICMP queries use their
+    // identifier as both ports.
+    struct Key {
+	uint32_t a;
+	uint32_t b;
+	uint16_t aport;
+	uint16_t bport;
+	uint32_t proto;
+	inline Key() {
+	}
+	inline Key(uint32_t saddr, uint16_t sport, uint32_t daddr,
+		   uint16_t dport, int p, bool &swapped);
+	inline hashcode_t hashcode() const {
+	    hashcode_t h = a;
+	    h = h * 0x9E3779B1U + b;
+	    h = h * 0x9E3779B1U + (aport | ((uint32_t) bport << 16));
+	    return h ^ proto;
+	}
+	inline bool operator==(const Key &x) const {
+	    return a == x.a && b == x.b && aport == x.aport
+		&& bport == x.bport && proto == x.proto;
+	}
+    };
+
+    // Window tracking for one direction of a TCP connection: the highest
+    // sequence number sent, the highest sequence number the peer will
+    // accept, and the largest window seen.
+    struct TCPDir {
+	uint32_t end;
+	uint32_t maxend;
+	uint32_t maxwin;
+	uint8_t scale;
+	uint8_t flags;
+    };
+    enum { d_wscale = 1, d_fin = 2 };
+
+    // One connection.  Connections live in a per-thread array and refer to
+    // each other by index; index 0 is never used.  Each connection is on
+    // the timing wheel bucket for tick sched; free connections are chained
+    // through wheel_next.
+    struct Conn {
+	Key key;
+	int32_t expires;
+	int32_t sched;
+	uint32_t wheel_prev;
+	uint32_t wheel_next;
+	uint8_t state;
+	uint8_t flags;
+	TCPDir tcp[2];
+    };
+    enum { f_orig_b = 1, f_replied = 2, f_live = 4 };
+
+    // Tracking state for one thread.  wheel[t % WHEEL_SIZE] heads the list
+    // of connections scheduled for tick t; ticks up to tick have been
+    // processed.
+    struct State {
+	FlatHashTable<Key, uint32_t> map;
+	Conn *conns;
+	uint32_t nconns;
+	uint32_t free;
+	uint32_t count;
+	int32_t tick;
+	uint32_t wheel[WHEEL_SIZE];
+	uint64_t stat_packets[4];
+	uint64_t stat_created;
+	uint64_t stat_expired;
+	uint64_t stat_evicted;
+	State();
+    };
+
+    State *_states;
+    unsigned _nstates;
+
+    uint32_t _capacity;
+    uint32_t _thread_capacity;
+    uint32_t _tcp_timeout;
+    uint32_t _tcp_syn_timeout;
+    uint32_t _tcp_done_timeout;
+    uint32_t _udp_timeout;
+    uint32_t _icmp_timeout;
+
+    inline State &state();
+
+    bool grow_conns(State &);
+    uint32_t new_conn(State &, const Key &, bool, int32_t);
+    void remove_conn(State &, uint32_t);
+    void evict(State &);
+    static inline void wheel_link(State &, uint32_t);
+    static inline void wheel_unlink(State &, uint32_t);
+    static inline void set_expiry(State &, uint32_t, int32_t);
+    void advance(State &, int32_t);
+    uint32_t tcp_timeout(int) const;
+
+    int classify(State &, Packet *, int32_t);
+    int track_tcp(State &, Packet *, const Key &, bool, int32_t);
+    int track_icmp(State &, Packet *, int32_t);
+    static bool tcp_in_window(Conn &, int, const click_tcp *, uint32_t);
+    static int tcp_wscale(const click_tcp *);
+
+    enum { h_count, h_capacity, h_evictions, h_stats, h_table, h_clear };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+
+inline ConnTracker::State &
+ConnTracker::state()
+{
+    return _states[click_current_cpu_id() % _nstates];
+}
+
+inline
+ConnTracker::Key::Key(uint32_t saddr, uint16_t sport, uint32_t daddr,
+		      uint16_t dport, int p, bool &swapped)
+    : proto(p)
+{
+    swapped = ntohl(saddr) > ntohl(daddr)
+	|| (saddr == daddr && ntohs(sport) > ntohs(dport));
+    if (!swapped) {
+	a = saddr, aport = sport, b = daddr, bport = dport;
+    } else {
+	a = daddr, aport = dport, b = saddr, bport = sport;
+    }
+}
+
+CLICK_ENDDECLS
+#endif
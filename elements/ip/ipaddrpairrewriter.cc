@@ -161,25 +161,18 @@ IPAddrPairRewriter::push(int port, Packet *p_in)
 }
 
 
-String
-IPAddrPairRewriter::dump_mappings_handler(Element *e, void *)
+int
+IPAddrPairRewriter::dump_mappings_handler(Element *e, void *, StringAccum &sa, uint64_t &cursor)
 {
     IPAddrPairRewriter *rw = (IPAddrPairRewriter *)e;
-    click_jiffies_t now = click_jiffies();
-    StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); iter++) {
-	IPAddrPairFlow *f = static_cast<IPAddrPairFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
-    return sa.take_string();
+    return unparse_mappings_chunk<IPAddrPairFlow>(rw->_map, sa, cursor);
 }
 
 void
 IPAddrPairRewriter::add_handlers()
 {
-    add_read_handler("table", dump_mappings_handler);
-    add_read_handler("mappings", dump_mappings_handler, 0, Handler::h_deprecated);
+    add_read_stream_handler("table", dump_mappings_handler);
+    add_read_stream_handler("mappings", dump_mappings_handler, 0, Handler::h_deprecated);
     add_rewriter_handlers(true);
 }
 
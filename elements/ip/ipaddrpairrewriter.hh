@@ -154,7 +154,7 @@ class IPAddrPairRewriter : public IPRewriterBase { public:
     SizedHashAllocator<sizeof(IPAddrPairFlow)> _allocator;
     unsigned _annos;
 
-    static String dump_mappings_handler(Element *, void *);
+    static int dump_mappings_handler(Element *, void *, StringAccum &, uint64_t &);
 
 };
 
@@ -172,25 +172,18 @@ IPAddrRewriter::push(int port, Packet *p_in)
 }
 
 
-String
-IPAddrRewriter::dump_mappings_handler(Element *e, void *)
+int
+IPAddrRewriter::dump_mappings_handler(Element *e, void *, StringAccum &sa, uint64_t &cursor)
 {
     IPAddrRewriter *rw = (IPAddrRewriter *)e;
-    StringAccum sa;
-    click_jiffies_t now = click_jiffies();
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); iter++) {
-	IPAddrFlow *f = static_cast<IPAddrFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
-    return sa.take_string();
+    return unparse_mappings_chunk<IPAddrFlow>(rw->_map, sa, cursor);
 }
 
 void
 IPAddrRewriter::add_handlers()
 {
-    add_read_handler("table", dump_mappings_handler);
-    add_read_handler("mappings", dump_mappings_handler, 0, Handler::h_deprecated);
+    add_read_stream_handler("table", dump_mappings_handler);
+    add_read_stream_handler("mappings", dump_mappings_handler, 0, Handler::h_deprecated);
     add_rewriter_handlers(true);
 }
 
@@ -153,7 +153,7 @@ class IPAddrRewriter : public IPRewriterBase { public:
     SizedHashAllocator<sizeof(IPAddrFlow)> _allocator;
     unsigned _annos;
 
-    static String dump_mappings_handler(Element *, void *);
+    static int dump_mappings_handler(Element *, void *, StringAccum &, uint64_t &);
 
 };
 
@@ -29,6 +29,7 @@
 #include <click/packet_anno.hh>
 #include <click/straccum.hh>
 #include <click/ipflowid.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 #define PACKET_CHUNK(p)		(*((ChunkLink *)((p)->anno_u8() + IPREASSEMBLER_ANNO_OFFSET)))
@@ -36,10 +37,8 @@ CLICK_DECLS
 #define IP_BYTE_OFF(iph)	((ntohs((iph)->ip_off) & IP_OFFMASK) << 3)
 
 IPReassembler::IPReassembler()
-    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0), _stat_bad_pkts(0)
+    : _states(0), _nstates(0)
 {
-    for (int i = 0; i < NMAP; i++)
-	_map[i] = 0;
     static_assert(IPREASSEMBLER_ANNO_OFFSET + IPREASSEMBLER_ANNO_SIZE <= Packet::anno_size, "anno too big");
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE, "sizeof(ChunkLink) is expected to equal IPREASSEMBLER_ANNO_SIZE.");
 }
@@ -59,36 +58,44 @@ IPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
 	.complete() < 0)
 	return -1;
     _mtu_anno = mtu_anno;
-    _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
     return 0;
 }
 
 int
-IPReassembler::initialize(ErrorHandler *)
+IPReassembler::initialize(ErrorHandler *errh)
 {
-    _mem_used = 0;
-    _reap_time = 0;
+    _nstates = click_max_cpu_ids();
+    if (!(_states = new State[_nstates]))
+	return errh->error("out of memory");
+    memset(_states, 0, sizeof(State) * _nstates);
+    int nthreads = master()->nthreads();
+    _mem_thread_thresh = _mem_high_thresh / (nthreads > 0 ? nthreads : 1);
+    _hash_seed = click_random();
     return 0;
 }
 
 void
 IPReassembler::cleanup(CleanupStage)
 {
-    for (int i = 0; i < NMAP; i++)
-	while (_map[i]) {
-	    WritablePacket *next = (WritablePacket *)(_map[i]->next());
-	    _map[i]->kill();
-	    _map[i] = next;
+    for (unsigned i = 0; i < _nstates; i++) {
+	State &st = _states[i];
+	while (WritablePacket *q = st.lru_head) {
+	    st.lru_head = static_cast<WritablePacket *>(q->next());
+	    q->kill();
 	}
+	delete[] st.slots;
+    }
+    delete[] _states;
+    _states = 0;
 }
 
 void
-IPReassembler::check_error(ErrorHandler *errh, int bucket, const Packet *p, const char *format, ...)
+IPReassembler::check_error(ErrorHandler *errh, int slot, const Packet *p, const char *format, ...)
 {
     va_list val;
     va_start(val, format);
     StringAccum sa;
-    sa << "buck " << bucket << ": ";
+    sa << "slot " << slot << ": ";
     if (p->has_network_header()) {
 	const click_ip *iph = p->ip_header();
 	sa << iph->ip_src << " > " << iph->ip_dst << " [" << ntohs(iph->ip_id) << ':' << PACKET_DLEN(p) << ((iph->ip_off & htons(IP_MF)) ? "+]: " : "]: ");
@@ -103,13 +110,20 @@ IPReassembler::check(ErrorHandler *errh)
 {
     if (!errh)
 	errh = ErrorHandler::default_handler();
-    uint32_t mem_used = 0;
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = _map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (q->has_network_header()) {
+    for (unsigned t = 0; t < _nstates; t++) {
+	State &st = _states[t];
+	uint32_t mem_used = 0, count = 0;
+	for (uint32_t b = 0; st.slots && b <= st.mask; b++)
+	    if (WritablePacket *q = st.slots[b].q) {
+		++count;
+		if (!q->has_network_header()) {
+		    errh->error("slot %d: missing IP header", b);
+		    continue;
+		}
 		const click_ip *qip = q->ip_header();
-		if (bucketno(qip) != b)
-		    check_error(errh, b, q, "in wrong bucket");
+		if (hash_key(qip, _hash_seed) != st.slots[b].hash
+		    || find_slot(st, qip, st.slots[b].hash) != b)
+		    check_error(errh, b, q, "in wrong slot");
 		mem_used += IPH_MEM_USED + q->transport_length();
 		ChunkLink *chunk = &PACKET_CHUNK(q);
 		int off = 0;
@@ -135,27 +149,50 @@ IPReassembler::check(ErrorHandler *errh)
 		    off = chunk->lastoff;
 		    chunk = next_chunk(q, chunk);
 		}
-	    } else
-		errh->error("buck %d: missing IP header", b);
-    if (mem_used != _mem_used)
-	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
+	    }
+	uint32_t lru_count = 0;
+	for (Packet *q = st.lru_head; q; q = q->next())
+	    ++lru_count;
+	if (count != st.count || lru_count != st.count)
+	    errh->error("thread %u: bad count: have %u, LRU %u, claim %u", t, count, lru_count, st.count);
+	if (mem_used != st.mem_used)
+	    errh->error("thread %u: bad mem_used: have %u, claim %u", t, mem_used, st.mem_used);
+    }
     return 0;
 }
 
+String
+IPReassembler::read_handler(Element *e, void *user_data)
+{
+    IPReassembler *r = (IPReassembler *) e;
+    uint32_t v = 0;
+    for (unsigned t = 0; t < r->_nstates; t++)
+	v += (user_data ? r->_states[t].mem_used : r->_states[t].count);
+    return String(v);
+}
+
 String
 IPReassembler::debug_dump(Element *e, void *)
 {
     IPReassembler *r = (IPReassembler *) e;
     r->check();
+    uint32_t frags_seen = 0, good_assem = 0, failed_assem = 0, bad_pkts = 0;
+    for (unsigned t = 0; t < r->_nstates; t++) {
+	frags_seen += r->_states[t].stat_frags_seen;
+	good_assem += r->_states[t].stat_good_assem;
+	failed_assem += r->_states[t].stat_failed_assem;
+	bad_pkts += r->_states[t].stat_bad_pkts;
+    }
     StringAccum sa;
     sa <<
-	"frags seen total:    " << r->_stat_frags_seen << "\n"
-	"good reassemblies:   " << r->_stat_good_assem << "\n"
-	"failed reassemblies: " << r->_stat_failed_assem << "\n"
-	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
+	"frags seen total:    " << frags_seen << "\n"
+	"good reassemblies:   " << good_assem << "\n"
+	"failed reassemblies: " << failed_assem << "\n"
+	"bad fragments seen:  " << bad_pkts << "\n"
 	"cached chunk data:\n";
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = r->_map[b]; q; q = (WritablePacket *)(q->next()))
+    for (unsigned t = 0; t < r->_nstates; t++)
+	for (Packet *p = r->_states[t].lru_head; p; p = p->next()) {
+	    WritablePacket *q = static_cast<WritablePacket *>(p);
 	    if (const click_ip *qip = q->ip_header()) {
 		sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
 		ChunkLink *chunk = &PACKET_CHUNK(q);
@@ -167,33 +204,79 @@ IPReassembler::debug_dump(Element *e, void *)
 		}
 		sa << '\n';
 	    }
+	}
     return sa.take_string();
 }
 
-WritablePacket *
-IPReassembler::find_queue(Packet *p, WritablePacket ***store_pprev)
+/* Returns the slot holding iph's datagram, or the empty slot where it would
+ * be inserted.  The table is never full, so the probe terminates. */
+uint32_t
+IPReassembler::find_slot(State &st, const click_ip *iph, uint32_t hash) const
 {
-    const click_ip *iph = p->ip_header();
-    int bucket = bucketno(iph);
-    WritablePacket **pprev = &_map[bucket];
-    WritablePacket *q;
-    for (q = *pprev; q; pprev = (WritablePacket **)&q->next(), q = *pprev) {
-	const click_ip *qiph = q->ip_header();
-	if (same_segment(iph, qiph)) {
-	    *store_pprev = pprev;
-	    return q;
+    uint32_t i = hash & st.mask;
+    while (WritablePacket *q = st.slots[i].q) {
+	if (st.slots[i].hash == hash && same_segment(iph, q->ip_header()))
+	    break;
+	i = (i + 1) & st.mask;
+    }
+    return i;
+}
+
+uint32_t
+IPReassembler::find_queue_slot(State &st, WritablePacket *q) const
+{
+    uint32_t i = find_slot(st, q->ip_header(), hash_key(q->ip_header(), _hash_seed));
+    assert(st.slots[i].q == q);
+    return i;
+}
+
+bool
+IPReassembler::grow(State &st)
+{
+    uint32_t nslots = st.slots ? (st.mask + 1) * 2 : (uint32_t) INITIAL_SLOTS;
+    Slot *slots = new Slot[nslots];
+    if (!slots)
+	return false;
+    memset(slots, 0, sizeof(Slot) * nslots);
+    for (uint32_t b = 0; st.slots && b <= st.mask; b++)
+	if (st.slots[b].q) {
+	    uint32_t i = st.slots[b].hash & (nslots - 1);
+	    while (slots[i].q)
+		i = (i + 1) & (nslots - 1);
+	    slots[i] = st.slots[b];
+	}
+    delete[] st.slots;
+    st.slots = slots;
+    st.mask = nslots - 1;
+    return true;
+}
+
+/* Empties slot i, shifting later members of its probe sequence back so
+ * that lookups never need tombstones. */
+void
+IPReassembler::remove_slot(State &st, uint32_t i)
+{
+    uint32_t j = i;
+    while (1) {
+	j = (j + 1) & st.mask;
+	if (!st.slots[j].q)
+	    break;
+	uint32_t home = st.slots[j].hash & st.mask;
+	// move j to i unless its home lies cyclically in (i, j]
+	if ((j > i && (home <= i || home > j))
+	    || (j < i && home <= i && home > j)) {
+	    st.slots[i] = st.slots[j];
+	    i = j;
 	}
     }
-    *store_pprev = &_map[bucket];
-    return 0;
+    st.slots[i].q = 0;
+    --st.count;
 }
 
 Packet *
-IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
-				 Packet *p_in)
+IPReassembler::emit_whole_packet(State &st, WritablePacket *q)
 {
-    ++_stat_good_assem;
-    *q_pprev = (WritablePacket *)q->next();
+    ++st.stat_good_assem;
 
     click_ip *q_iph = q->ip_header();
     q_iph->ip_len = htons(q->network_length());
@@ -202,42 +285,40 @@ IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
 
     // zero out the annotations we used
     memset(&PACKET_CHUNK(q), 0, sizeof(ChunkLink));
-    q->set_timestamp_anno(p_in->timestamp_anno());
-    q->set_next(0);
-
-    p_in->kill();
-    _mem_used -= IPH_MEM_USED + q->transport_length();
+    st.mem_used -= IPH_MEM_USED + q->transport_length();
     return q;
 }
 
-void
-IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
+WritablePacket *
+IPReassembler::make_queue(State &st, Packet *p)
 {
     int p_off = IP_BYTE_OFF(p->ip_header());
     int p_lastoff = p_off + PACKET_DLEN(p);
     WritablePacket *q;
 
     if (p_off == 0) {
+	// In-order start: keep the fragment itself, without copying.
 	q = p->uniqueify();
 	if (!q) {
 	    click_chatter("out of memory");
-	    return;
+	    return 0;
 	}
     } else {
 	q = Packet::make(p->headroom() + p->ip_header_offset(), 0, 20 + p_lastoff, 0);
 	if (!q) {
 	    p->kill();
 	    click_chatter("out of memory");
-	    return;
+	    return 0;
 	}
 	q->set_ip_header((click_ip *)q->data(), 20);
 	memcpy(q->ip_header(), p->ip_header(), 20);
 	// copy data
 	memcpy(q->transport_header() + p_off, p->transport_header(), PACKET_DLEN(p));
+	q->set_timestamp_anno(p->timestamp_anno());
 	p->kill();
     }
 
-    _mem_used += IPH_MEM_USED + p_lastoff;
+    st.mem_used += IPH_MEM_USED + p_lastoff;
 
     click_ip *q_iph = q->ip_header();
     q_iph->ip_off = (q_iph->ip_off & ~htons(IP_OFFMASK)); // leave MF, DF, RF
@@ -247,12 +328,127 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
 
     PACKET_CHUNK(q).off = p_off;
     PACKET_CHUNK(q).lastoff = p_lastoff;
+    return q;
+}
 
-    // link it up
-    q->set_next(*q_pprev);
-    *q_pprev = q;
+/* Extends q's data to p_lastoff bytes and adds an empty final chunk.  When
+ * more fragments are expected, reserves tailroom for the datagram to double,
+ * so in-order reassembly does a logarithmic number of copies. */
+WritablePacket *
+IPReassembler::extend_queue(WritablePacket *q, int p_lastoff, bool more)
+{
+    int old_transport_length = q->transport_length();
+    assert((old_transport_length & 7) == 0);
+    // Add 8 extra bytes to ensure room for a ChunkLink.
+    int want_space = p_lastoff - old_transport_length + 8;
+    if (more)
+	want_space += (p_lastoff < 0xFFFF - p_lastoff ? p_lastoff : 0xFFFF - p_lastoff);
+    if (!(q = q->put(want_space)))
+	return 0;
+    // get rid of extra space
+    q->take(q->transport_length() - p_lastoff);
+    ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
+    last_chunk->off = last_chunk->lastoff = p_lastoff;
+    return q;
+}
+
+/* Merges fragment p into partial datagram q.  Returns the possibly moved q,
+ * or null if q was freed.  Consumes p.  The caller updates memory
+ * accounting. */
+WritablePacket *
+IPReassembler::add_fragment(WritablePacket *q, Packet *p, int p_off, int p_lastoff)
+{
+    const click_ip *iph = p->ip_header();
+    bool more = (iph->ip_off & htons(IP_MF)) != 0;
+
+    if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
+	q->set_anno_u16(_mtu_anno, p->network_length());
+
+    // fast path: p directly follows a complete prefix
+    ChunkLink &first = PACKET_CHUNK(q);
+    if (p_off != 0 && first.off == 0 && first.lastoff == p_off
+	&& p_off == q->transport_length()
+	&& (q->ip_header()->ip_off & htons(IP_MF))) {
+	if (!(q = extend_queue(q, p_lastoff, more)))
+	    goto oom;
+	memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
+	PACKET_CHUNK(q).lastoff = p_lastoff;
+	goto merged;
+    }
+
+    // extend the packet if necessary
+    if (p_lastoff > q->transport_length()) {
+	// error if packet already completed
+	if (!(q->ip_header()->ip_off & htons(IP_MF))) {
+	    p->kill();
+	    return q;
+	}
+	if (!(q = extend_queue(q, p_lastoff, more)))
+	    goto oom;
+    }
+
+    {
+	// find chunks before and after p
+	ChunkLink *chunk = &PACKET_CHUNK(q);
+	while (chunk->lastoff < p_off)
+	    chunk = next_chunk(q, chunk);
+	ChunkLink *last = chunk;
+	while (last && last->lastoff < p_lastoff)
+	    last = next_chunk(q, last);
+
+	// patch chunks
+	assert(chunk && last);
+	if (p_lastoff < last->off) {
+	    ChunkLink *new_chunk = (ChunkLink *)(q->transport_header() + p_lastoff);
+	    *new_chunk = *last;
+	    chunk->lastoff = p_lastoff;
+	} else
+	    chunk->lastoff = last->lastoff;
+	if (p_off < chunk->off)
+	    chunk->off = p_off;
+    }
 
-    check();
+    // copy p's data into q
+    memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
+
+    // copy p's annotations and IP header if it is the first packet
+    if (p_off == 0) {
+	uint16_t old_ip_off = q->ip_header()->ip_off;
+	int header_delta = p->ip_header_offset() - q->ip_header_offset();
+	if (header_delta > 0) {
+	    if (!(q = q->push(header_delta)))
+		goto oom;
+	} else if (header_delta < 0)
+	    q->pull(-header_delta);
+	q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
+        if (p->has_mac_header())
+	    q->set_mac_header((q->data() + p->mac_header_offset()), p->mac_header_length());
+	memcpy(q->data(), p->data(), p->ip_header_offset() + p->ip_header_length());
+	q->ip_header()->ip_off = old_ip_off;
+	ChunkLink old_chunk = PACKET_CHUNK(q);
+	if (_mtu_anno >= 0) {
+	    uint16_t old_mtu = q->anno_u16(_mtu_anno);
+	    q->copy_annotations(p);
+	    q->set_anno_u16(_mtu_anno, old_mtu);
+	} else {
+	    q->copy_annotations(p);
+	}
+	PACKET_CHUNK(q) = old_chunk;
+    }
+
+  merged:
+    // clear MF if incoming packet has it cleared
+    if (!more)
+	q->ip_header()->ip_off &= ~htons(IP_MF);
+    // the LRU list is ordered by last activity
+    q->set_timestamp_anno(p->timestamp_anno());
+    p->kill();
+    return q;
+
+  oom:
+    click_chatter("out of memory");
+    p->kill();
+    return 0;
 }
 
 IPReassembler::ChunkLink *
@@ -264,6 +460,7 @@ IPReassembler::next_chunk(WritablePacket *q, ChunkLink *chunk)
 	return (ChunkLink *)(q->transport_header() + chunk->lastoff);
 }
 
+
 Packet *
 IPReassembler::simple_action(Packet *p)
 {
@@ -273,7 +470,8 @@ IPReassembler::simple_action(Packet *p)
     if (!IP_ISFRAG(iph))
 	return p;
 
-    ++_stat_frags_seen;
+    State &st = state();
+    ++st.stat_frags_seen;
 
     // reap if necessary
     int now = p->timestamp_anno().sec();
@@ -281,8 +479,8 @@ IPReassembler::simple_action(Packet *p)
 	p->timestamp_anno().assign_now();
 	now = p->timestamp_anno().sec();
     }
-    if (now >= _reap_time)
-	reap(now);
+    if (now >= st.reap_time)
+	reap(st, now);
 
     // calculate packet edges
     int p_off = IP_BYTE_OFF(iph);
@@ -294,177 +492,97 @@ IPReassembler::simple_action(Packet *p)
 	|| ((p_lastoff & 7) != 0 && (iph->ip_off & htons(IP_MF)) != 0)
 	|| PACKET_DLEN(p) < p_lastoff - p_off) {
 	p->kill();
-	++_stat_bad_pkts;
+	++st.stat_bad_pkts;
 	return 0;
     }
     p->take(PACKET_DLEN(p) - (p_lastoff - p_off));
 
     // otherwise, we need to keep the packet
 
-    // clean up memory if necessary
-    if (_mem_used > _mem_high_thresh)
-	reap_overfull(now);
-
-    // get its Packet queue
-    WritablePacket **q_pprev;
-    WritablePacket *q = find_queue(p, &q_pprev);
-    if (!q) {			// make a new queue
-	make_queue(p, q_pprev);
+    // keep the table at most half full, so probe sequences stay short
+    if (st.count >= (st.slots ? (st.mask + 1) / 2 : 0) && !grow(st)) {
+	click_chatter("out of memory");
+	p->kill();
 	return 0;
     }
-    WritablePacket *q_bucket_next = (WritablePacket *)(q->next());
 
-    if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
-	q->set_anno_u16(_mtu_anno, p->network_length());
-
-    // extend the packet if necessary
-    if (p_lastoff > q->transport_length()) {
-	// error if packet already completed
-	if (!(q->ip_header()->ip_off & htons(IP_MF))) {
-	    p->kill();
+    // find its partial datagram
+    uint32_t hash = hash_key(iph, _hash_seed);
+    uint32_t slot = find_slot(st, iph, hash);
+    WritablePacket *q = st.slots[slot].q;
+    if (!q) {			// make a new partial datagram
+	if (!(q = make_queue(st, p)))
 	    return 0;
-	}
-	// Figure out how much space to request. Add 8 extra bytes to ensure
-	// room for a ChunkLink, and request extra space if this packet has MF
-	// set. XXX This algorithm could result in a number of intermediate
-	// packet copies linear in the final packet length.
-	int old_transport_length = q->transport_length();
-	assert((old_transport_length & 7) == 0);
-	int want_space = p_lastoff - old_transport_length + 8;
-	if (iph->ip_off & htons(IP_MF))
-	    want_space += (p_lastoff - p_off);
-	// request space
-	if (!(q = q->put(want_space))) {
-	    click_chatter("out of memory");
-	    *q_pprev = q_bucket_next;
-	    _mem_used -= IPH_MEM_USED + old_transport_length;
-	    p->kill();
-	    return 0;
-	}
-	// get rid of extra space
-	q->take(q->transport_length() - p_lastoff);
-	// hook up packet, and add final chunk
-	*q_pprev = q;
-	ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
-	last_chunk->off = last_chunk->lastoff = p_lastoff;
-	_mem_used += p_lastoff - old_transport_length;
+	st.slots[slot].q = q;
+	st.slots[slot].hash = hash;
+	++st.count;
+	lru_append(st, q);
+	if (st.mem_used > _mem_thread_thresh)
+	    reap_overfull(st);
+	return 0;
     }
 
-    // find chunks before and after p
-    ChunkLink *chunk = &PACKET_CHUNK(q);
-    while (chunk->lastoff < p_off)
-	chunk = next_chunk(q, chunk);
-    ChunkLink *last = chunk;
-    while (last && last->lastoff < p_lastoff)
-	last = next_chunk(q, last);
-
-    // patch chunks
-    assert(chunk && last);
-    if (p_lastoff < last->off) {
-	ChunkLink *new_chunk = (ChunkLink *)(q->transport_header() + p_lastoff);
-	*new_chunk = *last;
-	chunk->lastoff = p_lastoff;
-    } else
-	chunk->lastoff = last->lastoff;
-    if (p_off < chunk->off)
-	chunk->off = p_off;
-
-    // copy p's data into q
-    memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
-
-    // copy p's annotations and IP header if it is the first packet
-    if (p_off == 0) {
-	uint16_t old_ip_off = q->ip_header()->ip_off;
-	int header_delta = p->ip_header_offset() - q->ip_header_offset();
-	if (header_delta > 0)
-	    q = q->push(header_delta);
-	else if (header_delta < 0)
-	    q->pull(-header_delta);
-	q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
-        if (p->has_mac_header())
-	    q->set_mac_header((q->data() + p->mac_header_offset()), p->mac_header_length());
-	memcpy(q->data(), p->data(), p->ip_header_offset() + p->ip_header_length());
-	q->ip_header()->ip_off = old_ip_off;
-	ChunkLink old_chunk = PACKET_CHUNK(q);
-	if (_mtu_anno >= 0) {
-	    uint16_t old_mtu = q->anno_u16(_mtu_anno);
-	    q->copy_annotations(p);
-	    q->set_anno_u16(_mtu_anno, old_mtu);
-	} else {
-	    q->copy_annotations(p);
-	}
-	PACKET_CHUNK(q) = old_chunk;
+    lru_unlink(st, q);
+    uint32_t q_mem = IPH_MEM_USED + q->transport_length();
+    if (!(q = add_fragment(q, p, p_off, p_lastoff))) {
+	remove_slot(st, slot);
+	st.mem_used -= q_mem;
+	return 0;
     }
-
-    // clear MF if incoming packet has it cleared
-    if (!(iph->ip_off & htons(IP_MF)))
-	q->ip_header()->ip_off &= ~htons(IP_MF);
+    st.mem_used += IPH_MEM_USED + q->transport_length() - q_mem;
 
     // Are we done with this packet?
     if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
 	&& PACKET_CHUNK(q).off == 0
-	&& PACKET_CHUNK(q).lastoff == q->transport_length())
-	return emit_whole_packet(q, q_pprev, p);
+	&& PACKET_CHUNK(q).lastoff == q->transport_length()) {
+	remove_slot(st, slot);
+	return emit_whole_packet(st, q);
+    }
 
     // Otherwise, done for now
-    //check();
-    p->kill();
+    st.slots[slot].q = q;
+    lru_append(st, q);
+    if (st.mem_used > _mem_thread_thresh)
+	reap_overfull(st);
     return 0;
 }
 
 void
-IPReassembler::reap_overfull(int now)
+IPReassembler::expire(State &st, WritablePacket *q)
 {
-    check();
-
-    // First throw away fragments at least 10 seconds old, then at least 5
-    // seconds old, then any fragments.
-    for (int delta = 10; delta >= 0; delta -= 5)
-	for (int bucket = 0; bucket < NMAP; bucket++) {
-	    WritablePacket **pprev = &_map[bucket];
-	    for (WritablePacket *q = *pprev; q; q = *pprev)
-		if (!delta || q->timestamp_anno().sec() < now - delta) {
-		    *pprev = (WritablePacket *)q->next();
-		    _mem_used -= IPH_MEM_USED + q->transport_length();
-		    q->set_next(0);
-		    checked_output_push(1, q);
-		    ++_stat_failed_assem;
-		    if (_mem_used <= _mem_low_thresh)
-			return;
-		} else
-		    pprev = (WritablePacket **)&q->next();
-	}
-
-    click_chatter("IPReassembler: cannot free enough memory!");
+    remove_slot(st, find_queue_slot(st, q));
+    lru_unlink(st, q);
+    st.mem_used -= IPH_MEM_USED + q->transport_length();
+    ++st.stat_failed_assem;
+    checked_output_push(1, q);
 }
 
 void
-IPReassembler::reap(int now)
+IPReassembler::reap_overfull(State &st)
 {
-    // look at all queues. If no activity for 30 seconds, kill that queue
+    // Throw away least recently used partial datagrams until this thread is
+    // back under its memory limit.
+    while (st.mem_used > _mem_thread_thresh && st.lru_head)
+	expire(st, st.lru_head);
+}
 
+void
+IPReassembler::reap(State &st, int now)
+{
+    // The LRU list is in order of last activity, so the partial datagrams
+    // with no activity for 30 seconds are at its head.
     int kill_time = now - REAP_TIMEOUT;
+    while (st.lru_head && st.lru_head->timestamp_anno().sec() < kill_time)
+	expire(st, st.lru_head);
 
-    for (int i = 0; i < NMAP; i++) {
-	WritablePacket **q_pprev = &_map[i];
-	for (WritablePacket *q = *q_pprev; q; ) {
-	    if (q->timestamp_anno().sec() < kill_time) {
-		*q_pprev = (WritablePacket *)q->next();
-		q->set_next(0);
-		_mem_used -= IPH_MEM_USED + q->transport_length();
-		checked_output_push(1, q);
-	    } else
-		q_pprev = (WritablePacket **)&q->next();
-	    q = *q_pprev;
-	}
-    }
-
-    _reap_time = now + REAP_INTERVAL;
+    st.reap_time = now + REAP_INTERVAL;
 }
 
 void
 IPReassembler::add_handlers()
 {
+    add_read_handler("count", read_handler, 0);
+    add_read_handler("mem_used", read_handler, 1);
     add_read_handler("dump", debug_dump);
 }
 
@@ -26,9 +26,20 @@ seconds, the fragments are generally dropped. If IPReassembler has two
 outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
-IPReassembler's memory usage is bounded. When memory consumption rises above
-HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+Partial datagrams are kept in per-thread hash tables keyed on the fragments'
+source, destination, protocol, and IP ID, so fragments of one datagram must
+all arrive on the same thread.  The tables use open addressing with a randomly
+seeded hash and grow as needed.
+
+IPReassembler's memory usage is bounded. Each thread may hold at most HIMEM/N
+bytes of fragments, where N is the number of Click threads.  When a thread
+goes over its limit, IPReassembler throws away that thread's least recently
+used partial datagrams until it is back under the limit. Default HIMEM is
+256K.
+
+Fragments that arrive in order are appended to the partial datagram directly,
+and the reassembly buffer grows geometrically, so an in-order datagram is
+copied only a few times however many fragments it has.
 
 Output packets have the same MAC header as the fragment that contains
 offset 0.  Other than that, input MAC headers are ignored.
@@ -53,6 +64,18 @@ is unchanged.
 
 =back
 
+=h count read-only
+
+Returns the number of partial datagrams currently held.
+
+=h mem_used read-only
+
+Returns the number of bytes of fragment memory currently in use.
+
+=h dump read-only
+
+Returns statistics and a description of every partial datagram.
+
 =n
 
 You may want to attach an C<ICMPError(ADDR, timeexceeded, reassembly)> to the
@@ -90,42 +113,82 @@ class IPReassembler : public Element { public:
 
     enum { REAP_TIMEOUT = 30, // seconds
 	   REAP_INTERVAL = 10, // seconds
-	   IPH_MEM_USED = 40 };
+	   IPH_MEM_USED = 40,
+	   INITIAL_SLOTS = 64 };
 
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
+    struct Slot {
+	WritablePacket *q;
+	uint32_t hash;
+    };
 
-    int _reap_time;
+    // Reassembly state for one thread.  Partial datagrams live in an
+    // open-addressed table and on an LRU list linked through their
+    // next()/prev() annotations; lru_head is least recently used.
+    struct State {
+	Slot *slots;
+	uint32_t mask;
+	uint32_t count;
+	uint32_t mem_used;
+	WritablePacket *lru_head;
+	WritablePacket *lru_tail;
+	int reap_time;
+	uint32_t stat_frags_seen;
+	uint32_t stat_good_assem;
+	uint32_t stat_failed_assem;
+	uint32_t stat_bad_pkts;
+    };
 
-    uint32_t _stat_frags_seen;
-    uint32_t _stat_good_assem;
-    uint32_t _stat_failed_assem;
-    uint32_t _stat_bad_pkts;
+    State *_states;
+    unsigned _nstates;
+    uint32_t _hash_seed;
 
-    uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
-    uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
+    uint32_t _mem_thread_thresh; // _mem_high_thresh / nthreads
     int8_t _mtu_anno;
 
-    static inline int bucketno(const click_ip *);
+    inline State &state();
+    static inline uint32_t hash_key(const click_ip *, uint32_t);
     static inline bool same_segment(const click_ip *, const click_ip *);
+    static String read_handler(Element *, void *);
     static String debug_dump(Element *e, void *);
 
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
+    uint32_t find_slot(State &, const click_ip *, uint32_t) const;
+    uint32_t find_queue_slot(State &, WritablePacket *) const;
+    bool grow(State &);
+    static void remove_slot(State &, uint32_t);
+    static inline void lru_append(State &, WritablePacket *);
+    static inline void lru_unlink(State &, WritablePacket *);
+
+    WritablePacket *make_queue(State &, Packet *);
+    static WritablePacket *extend_queue(WritablePacket *, int, bool);
+    WritablePacket *add_fragment(WritablePacket *, Packet *, int, int);
     static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
-    void reap_overfull(int);
-    void reap(int);
+    Packet *emit_whole_packet(State &, WritablePacket *);
+    void expire(State &, WritablePacket *);
+    void reap_overfull(State &);
+    void reap(State &, int);
     static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
 
 };
 
 
-inline int
-IPReassembler::bucketno(const click_ip *h)
+inline IPReassembler::State &
+IPReassembler::state()
 {
-    return (h->ip_id % NMAP);
+    return _states[click_current_cpu_id() % _nstates];
+}
+
+inline uint32_t
+IPReassembler::hash_key(const click_ip *h, uint32_t seed)
+{
+    uint32_t x = seed ^ h->ip_src.s_addr;
+    x = (x * 0x9E3779B1U) ^ h->ip_dst.s_addr;
+    x = (x * 0x9E3779B1U) ^ (h->ip_id | (h->ip_p << 16));
+    x ^= x >> 16;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35U;
+    return x ^ (x >> 16);
 }
 
 inline bool
@@ -136,5 +199,34 @@ IPReassembler::same_segment(const click_ip *h, const click_ip *h2)
 	&& h->ip_dst.s_addr == h2->ip_dst.s_addr;
 }
 
+inline void
+IPReassembler::lru_append(State &st, WritablePacket *q)
+{
+    q->set_next(0);
+    q->set_prev(st.lru_tail);
+    if (st.lru_tail)
+	st.lru_tail->set_next(q);
+    else
+	st.lru_head = q;
+    st.lru_tail = q;
+}
+
+inline void
+IPReassembler::lru_unlink(State &st, WritablePacket *q)
+{
+    WritablePacket *next = static_cast<WritablePacket *>(q->next());
+    WritablePacket *prev = static_cast<WritablePacket *>(q->prev());
+    if (prev)
+	prev->set_next(next);
+    else
+	st.lru_head = next;
+    if (next)
+	next->set_prev(prev);
+    else
+	st.lru_tail = prev;
+    q->set_next(0);
+    q->set_prev(0);
+}
+
 CLICK_ENDDECLS
 #endif
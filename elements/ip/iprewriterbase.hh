@@ -4,6 +4,7 @@
 #include <click/timer.hh>
 #include "elements/ip/iprwmapping.hh"
 #include <click/bitvector.hh>
+#include <click/straccum.hh>
 CLICK_DECLS
 class IPMapper;
 class IPRewriterPattern;
@@ -131,6 +132,10 @@ class IPRewriterBase : public Element { public:
 
   protected:
 
+    template <typename F>
+    static int unparse_mappings_chunk(Map &map, StringAccum &sa,
+				      uint64_t &cursor);
+
     Map _map;
 
     Vector<IPRewriterInput> _input_specs;
@@ -245,5 +250,34 @@ IPRewriterBase::unmap_flow(IPRewriterFlow *flow, Map &map,
 	reply_map_ptr->erase(it);
 }
 
+/* Appends whole buckets of map, starting at bucket number cursor, to sa until
+ * about Handler::stream_chunk_size bytes have been added.  Used by streaming
+ * "table" handlers; F is the flow class whose unparse() to call. */
+template <typename F> int
+IPRewriterBase::unparse_mappings_chunk(Map &map, StringAccum &sa,
+				       uint64_t &cursor)
+{
+    if (cursor >= map.bucket_count())
+	return 0;
+    click_jiffies_t now = click_jiffies();
+    int start = sa.length();
+    Map::iterator it = map.begin((Map::bucket_count_type) cursor);
+    if (!it.live())
+	++it;
+    while (it.live()) {
+	if (sa.length() - start >= Handler::stream_chunk_size) {
+	    cursor = it.bucket();
+	    return 1;
+	}
+	Map::bucket_count_type b = it.bucket();
+	for (; it.live() && it.bucket() == b; ++it) {
+	    static_cast<F *>(it->flow())->unparse(sa, it->direction(), now);
+	    sa << '\n';
+	}
+    }
+    cursor = map.bucket_count();
+    return 0;
+}
+
 CLICK_ENDDECLS
 #endif
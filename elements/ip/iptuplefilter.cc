@@ -0,0 +1,534 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iptuplefilter.{cc,hh} -- 5-tuple packet filter using tuple space search
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iptuplefilter.hh"
+#include <click/args.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/ipaddress.hh>
+#include <click/nameinfo.hh>
+#include <click/straccum.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+IPTupleFilter::IPTupleFilter()
+    : _free_entry(NONE), _nentries(0)
+{
+}
+
+IPTupleFilter::~IPTupleFilter()
+{
+}
+
+// Splits a rule into words and the operators "&&", "||", "!", "(", ")",
+// "=", "==", "!=", "<", "<=", ">", and ">=".
+static void
+tokenize(const String &text, Vector<String> &words)
+{
+    const char *s = text.begin(), *end = text.end();
+    while (s != end) {
+	if (isspace((unsigned char) *s))
+	    ++s;
+	else if (strchr("&|!()<>=", *s)) {
+	    const char *t = s + 1;
+	    if (t != end && (*t == '=' || (*t == *s && (*s == '&' || *s == '|'))))
+		++t;
+	    words.push_back(text.substring(s, t));
+	    s = t;
+	} else {
+	    const char *t = s;
+	    while (t != end && !isspace((unsigned char) *t) && !strchr("&|!()<>=", *t))
+		++t;
+	    words.push_back(text.substring(s, t));
+	    s = t;
+	}
+    }
+}
+
+static inline bool
+has_ports(uint32_t proto)
+{
+    return proto == IP_PROTO_TCP || proto == IP_PROTO_UDP;
+}
+
+int
+IPTupleFilter::parse_rule(const String &text, Rule &r, ErrorHandler *errh) const
+{
+    Vector<String> words;
+    tokenize(text, words);
+    if (words.size() < 2)
+	return errh->error("missing pattern");
+
+    if (words[0] == "allow")
+	r.action = 0;
+    else if (words[0] == "drop" || words[0] == "deny")
+	r.action = -1;
+    else if (!IntArg().parse(words[0], r.action) || r.action < 0)
+	return errh->error("bad action %<%s%>", words[0].c_str());
+    else if (r.action >= noutputs())
+	return errh->error("action %d out of range", r.action);
+
+    memset(&r.value, 0, sizeof(Key));
+    memset(&r.mask, 0, sizeof(Key));
+    r.sport[0] = r.dport[0] = 0;
+    r.sport[1] = r.dport[1] = 0xFFFF;
+    ArgContext args(this, errh);
+
+    for (int i = 1; i < words.size(); ) {
+	const String &w = words[i];
+	if (w == "&&" || w == "and" || w == "all" || w == "-" || w == "true") {
+	    ++i;
+	    continue;
+	}
+
+	int proto = -1;
+	if (w == "tcp")
+	    proto = IP_PROTO_TCP, ++i;
+	else if (w == "udp")
+	    proto = IP_PROTO_UDP, ++i;
+	else if (w == "icmp")
+	    proto = IP_PROTO_ICMP, ++i;
+	else if ((w == "ip" && i + 2 < words.size() && words[i + 1] == "proto")
+		 || (w == "proto" && i + 1 < words.size())) {
+	    i += (w == "ip" ? 2 : 1);
+	    if (!NamedIntArg(NameInfo::T_IP_PROTO).parse(words[i], proto, args)
+		|| proto < 0 || proto > 255)
+		return errh->error("bad protocol %<%s%>", words[i].c_str());
+	    ++i;
+	}
+	if (proto >= 0) {
+	    if (r.mask.proto && r.value.proto != (uint32_t) proto)
+		return errh->error("conflicting protocols");
+	    r.value.proto = proto;
+	    r.mask.proto = 0xFF;
+	    continue;
+	}
+
+	if ((w != "src" && w != "dst") || i + 1 >= words.size())
+	    return errh->error("unsupported pattern %<%s%>, use IPFilter", w.c_str());
+	bool src = (w == "src");
+	++i;
+
+	if (words[i] == "port") {
+	    // PORTS is [OP] PORT or LOW-HIGH
+	    String op = "=";
+	    if (++i < words.size() && strchr("<>=!", words[i][0]))
+		op = words[i++];
+	    if (i >= words.size())
+		return errh->error("missing port");
+	    const String &pw = words[i++];
+	    int ipp = (r.mask.proto && r.value.proto == IP_PROTO_UDP ? IP_PROTO_UDP : IP_PROTO_TCP);
+	    uint16_t lo, hi;
+	    int dash = pw.find_left('-', 1);
+	    if (op == "=" || op == "==") {
+		if (dash > 0 && IPPortArg(ipp).parse(pw.substring(0, dash), lo, args)
+		    && IPPortArg(ipp).parse(pw.substring(dash + 1), hi, args)
+		    && lo <= hi)
+		    /* range */;
+		else if (IPPortArg(ipp).parse(pw, lo, args))
+		    hi = lo;
+		else
+		    return errh->error("bad port %<%s%>", pw.c_str());
+	    } else {
+		uint16_t v;
+		if (!IPPortArg(ipp).parse(pw, v, args))
+		    return errh->error("bad port %<%s%>", pw.c_str());
+		lo = 0, hi = 0xFFFF;
+		if (op == ">" && v < 0xFFFF)
+		    lo = v + 1;
+		else if (op == ">=")
+		    lo = v;
+		else if (op == "<" && v > 0)
+		    hi = v - 1;
+		else if (op == "<=")
+		    hi = v;
+		else
+		    return errh->error("unsupported port comparison %<%s %s%>", op.c_str(), pw.c_str());
+	    }
+	    uint16_t *range = (src ? r.sport : r.dport);
+	    range[0] = (lo > range[0] ? lo : range[0]);
+	    range[1] = (hi < range[1] ? hi : range[1]);
+	    if (range[0] > range[1])
+		return errh->error("port ranges never match");
+	    continue;
+	}
+
+	if (words[i] == "host" || words[i] == "net")
+	    ++i;
+	IPAddress addr, mask;
+	if (i >= words.size() || !IPPrefixArg(true).parse(words[i], addr, mask, args))
+	    return errh->error("bad address %<%s%>", i < words.size() ? words[i].c_str() : "");
+	++i;
+	uint32_t &value = (src ? r.value.src : r.value.dst);
+	uint32_t &vmask = (src ? r.mask.src : r.mask.dst);
+	if ((value ^ addr.addr()) & vmask & mask.addr())
+	    return errh->error("address prefixes never match");
+	if (mask.mask_as_specific(IPAddress(vmask))) {
+	    value = addr.addr() & mask.addr();
+	    vmask = mask.addr();
+	}
+    }
+
+    r.ports = (r.sport[0] != 0 || r.sport[1] != 0xFFFF
+	       || r.dport[0] != 0 || r.dport[1] != 0xFFFF);
+    if (r.ports && r.mask.proto && !has_ports(r.value.proto))
+	return errh->error("ports require TCP or UDP");
+    r.text = text.trim_space();
+    return 0;
+}
+
+void
+IPTupleFilter::expand(const Rule &r, Vector<Key> &values, Vector<Key> &masks) const
+{
+    // Exact ports are part of the key; other port ranges are wildcarded in
+    // the key and checked against each entry, which keeps the number of
+    // tuples small.
+    Key v = r.value, m = r.mask;
+    if (r.sport[0] == r.sport[1])
+	v.sport = r.sport[0], m.sport = 0xFFFF;
+    if (r.dport[0] == r.dport[1])
+	v.dport = r.dport[0], m.dport = 0xFFFF;
+    if (r.ports && !r.mask.proto) {
+	m.proto = 0xFF;
+	v.proto = IP_PROTO_TCP;
+	values.push_back(v);
+	masks.push_back(m);
+	v.proto = IP_PROTO_UDP;
+    }
+    values.push_back(v);
+    masks.push_back(m);
+}
+
+void
+IPTupleFilter::insert_entry(uint32_t rule, const Key &value, const Key &mask)
+{
+    Tuple *&tslot = _tuple_map.find_insert(mask, 0).value();
+    if (!tslot) {
+	tslot = new Tuple;
+	tslot->mask = mask;
+	tslot->ports = mask.sport || mask.dport;
+	tslot->min_order = NONE;
+	tslot->nentries = 0;
+	_tuples.push_back(tslot);
+    }
+    Tuple *t = tslot;
+
+    uint32_t ei = _free_entry;
+    if (ei != NONE)
+	_free_entry = _entries[ei].next;
+    else {
+	ei = _entries.size();
+	_entries.push_back(Entry());
+    }
+    Entry &e = _entries[ei];
+    e.order = _rules[rule].order;
+    e.action = _rules[rule].action;
+    e.rule = rule;
+    e.ports = _rules[rule].ports;
+    memcpy(e.sport, _rules[rule].sport, sizeof(e.sport));
+    memcpy(e.dport, _rules[rule].dport, sizeof(e.dport));
+
+    // keep the chain sorted by order
+    uint32_t *prev = &t->table.find_insert(value).value();
+    while (*prev != NONE && _entries[*prev].order < e.order)
+	prev = &_entries[*prev].next;
+    e.next = *prev;
+    *prev = ei;
+
+    ++t->nentries;
+    ++_nentries;
+    if (e.order < t->min_order)
+	t->min_order = e.order;
+}
+
+void
+IPTupleFilter::update_min_order(Tuple *t)
+{
+    t->min_order = NONE;
+    for (HashTable<Key, uint32_t>::iterator it = t->table.begin(); it.live(); ++it)
+	if (_entries[it.value()].order < t->min_order)
+	    t->min_order = _entries[it.value()].order;
+}
+
+void
+IPTupleFilter::remove_entry(uint32_t rule, const Key &value, const Key &mask)
+{
+    Tuple *t = _tuple_map.get(mask);
+    uint32_t *head = t ? t->table.get_pointer(value) : 0;
+    if (!head)
+	return;
+    uint32_t *prev = head;
+    while (*prev != NONE && _entries[*prev].rule != rule)
+	prev = &_entries[*prev].next;
+    if (*prev == NONE)
+	return;
+
+    uint32_t ei = *prev;
+    Entry &e = _entries[ei];
+    *prev = e.next;
+    uint32_t order = e.order;
+    e.rule = NONE;
+    e.next = _free_entry;
+    _free_entry = ei;
+    if (*head == NONE)
+	t->table.erase(value);
+    --_nentries;
+
+    if (--t->nentries == 0) {
+	_tuple_map.erase(mask);
+	for (Tuple **tp = _tuples.begin(); tp != _tuples.end(); ++tp)
+	    if (*tp == t) {
+		_tuples.erase(tp);
+		break;
+	    }
+	delete t;
+    } else if (order == t->min_order)
+	update_min_order(t);
+}
+
+int
+IPTupleFilter::tuple_compar(const void *a, const void *b, void *)
+{
+    uint32_t ao = (*static_cast<Tuple * const *>(a))->min_order;
+    uint32_t bo = (*static_cast<Tuple * const *>(b))->min_order;
+    return ao < bo ? -1 : (ao > bo ? 1 : 0);
+}
+
+void
+IPTupleFilter::sort_tuples()
+{
+    click_qsort(_tuples.begin(), _tuples.size(), sizeof(Tuple *), tuple_compar);
+}
+
+void
+IPTupleFilter::renumber()
+{
+    for (int i = 0; i < _order.size(); ++i)
+	_rules[_order[i]].order = (i + 1) * ORDER_GAP;
+    for (Entry *e = _entries.begin(); e != _entries.end(); ++e)
+	if (e->rule != NONE)
+	    e->order = _rules[e->rule].order;
+    for (Tuple **tp = _tuples.begin(); tp != _tuples.end(); ++tp)
+	update_min_order(*tp);
+}
+
+int
+IPTupleFilter::add_rule(const String &text, int pos, ErrorHandler *errh)
+{
+    Rule r;
+    if (parse_rule(text, r, errh) < 0)
+	return -1;
+
+    // Choose an order between the neighboring rules', renumbering all the
+    // rules if there is no room.
+    for (int tries = 0; ; ++tries) {
+	uint32_t lo = pos ? _rules[_order[pos - 1]].order : 0;
+	uint32_t hi = pos < _order.size() ? _rules[_order[pos]].order : NONE;
+	if (pos == _order.size() && hi - lo > ORDER_GAP)
+	    r.order = lo + ORDER_GAP;
+	else if (hi - lo >= 2)
+	    r.order = lo + (hi - lo) / 2;
+	else if (tries == 0) {
+	    renumber();
+	    continue;
+	} else
+	    return errh->error("too many rules");
+	break;
+    }
+
+    r.live = true;
+    uint32_t id;
+    if (_free_rules.size()) {
+	id = _free_rules.back();
+	_free_rules.pop_back();
+	_rules[id] = r;
+    } else {
+	id = _rules.size();
+	_rules.push_back(r);
+    }
+    _order.insert(_order.begin() + pos, id);
+
+    Vector<Key> values, masks;
+    expand(r, values, masks);
+    for (int i = 0; i < values.size(); ++i)
+	insert_entry(id, values[i], masks[i]);
+    return 0;
+}
+
+void
+IPTupleFilter::remove_rule(int pos)
+{
+    uint32_t id = _order[pos];
+    Rule &r = _rules[id];
+    Vector<Key> values, masks;
+    expand(r, values, masks);
+    for (int i = 0; i < values.size(); ++i)
+	remove_entry(id, values[i], masks[i]);
+    _order.erase(_order.begin() + pos);
+    r.live = false;
+    r.text = String();
+    _free_rules.push_back(id);
+}
+
+void
+IPTupleFilter::clear()
+{
+    for (Tuple **tp = _tuples.begin(); tp != _tuples.end(); ++tp)
+	delete *tp;
+    _tuples.clear();
+    _tuple_map.clear();
+    _rules.clear();
+    _order.clear();
+    _free_rules.clear();
+    _entries.clear();
+    _free_entry = NONE;
+    _nentries = 0;
+}
+
+int
+IPTupleFilter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    clear();
+    for (int i = 0; i < conf.size(); ++i) {
+	PrefixErrorHandler perrh(errh, "rule " + String(i) + ": ");
+	if (add_rule(conf[i], _order.size(), &perrh) < 0)
+	    return -1;
+    }
+    sort_tuples();
+    return 0;
+}
+
+void
+IPTupleFilter::cleanup(CleanupStage)
+{
+    clear();
+}
+
+inline int
+IPTupleFilter::lookup(const Packet *p) const
+{
+    const click_ip *iph = p->ip_header();
+    Key k;
+    k.src = iph->ip_src.s_addr;
+    k.dst = iph->ip_dst.s_addr;
+    k.proto = iph->ip_p;
+    bool ports = has_ports(k.proto) && IP_FIRSTFRAG(iph)
+	&& p->transport_length() >= 4;
+    if (ports) {
+	const uint16_t *th = reinterpret_cast<const uint16_t *>(p->transport_header());
+	k.sport = ntohs(th[0]);
+	k.dport = ntohs(th[1]);
+    } else
+	k.sport = k.dport = 0;
+
+    uint32_t best = NONE;
+    int action = -1;
+    for (Tuple * const *tp = _tuples.begin(); tp != _tuples.end(); ++tp) {
+	const Tuple *t = *tp;
+	if (t->min_order >= best)
+	    break;
+	if (t->ports && !ports)
+	    continue;
+	Key mk;
+	mk.src = k.src & t->mask.src;
+	mk.dst = k.dst & t->mask.dst;
+	mk.sport = k.sport & t->mask.sport;
+	mk.dport = k.dport & t->mask.dport;
+	mk.proto = k.proto & t->mask.proto;
+	const uint32_t *ei = t->table.get_pointer(mk);
+	for (uint32_t i = ei ? *ei : NONE; i != NONE; i = _entries[i].next) {
+	    const Entry &e = _entries[i];
+	    if (e.order >= best)
+		break;
+	    if (!e.ports
+		|| (ports && k.sport >= e.sport[0] && k.sport <= e.sport[1]
+		    && k.dport >= e.dport[0] && k.dport <= e.dport[1])) {
+		best = e.order, action = e.action;
+		break;
+	    }
+	}
+    }
+    return action;
+}
+
+void
+IPTupleFilter::push(int, Packet *p)
+{
+    checked_output_push(lookup(p), p);
+}
+
+String
+IPTupleFilter::read_handler(Element *e, void *user_data)
+{
+    IPTupleFilter *tf = static_cast<IPTupleFilter *>(e);
+    StringAccum sa;
+    if ((intptr_t) user_data == h_rules) {
+	for (int i = 0; i < tf->_order.size(); ++i)
+	    sa << i << '\t' << tf->_rules[tf->_order[i]].text << '\n';
+    } else {
+	sa << "rules " << tf->_order.size() << '\n'
+	   << "entries " << tf->_nentries << '\n'
+	   << "tuples " << tf->_tuples.size() << '\n';
+    }
+    return sa.take_string();
+}
+
+int
+IPTupleFilter::write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh)
+{
+    IPTupleFilter *tf = static_cast<IPTupleFilter *>(e);
+    String s = cp_uncomment(str);
+    int pos;
+    switch ((intptr_t) user_data) {
+    case h_add:
+    case h_insert:
+	pos = tf->_order.size();
+	if ((intptr_t) user_data == h_insert
+	    && (!IntArg().parse(cp_shift_spacevec(s), pos)
+		|| pos < 0 || pos > tf->_order.size()))
+	    return errh->error("bad rule number");
+	if (tf->add_rule(s, pos, errh) < 0)
+	    return -1;
+	tf->sort_tuples();
+	return 0;
+    case h_remove:
+	if (!IntArg().parse(s, pos) || pos < 0 || pos >= tf->_order.size())
+	    return errh->error("bad rule number");
+	tf->remove_rule(pos);
+	tf->sort_tuples();
+	return 0;
+    case h_clear:
+	tf->clear();
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+IPTupleFilter::add_handlers()
+{
+    add_read_handler("rules", read_handler, h_rules);
+    add_read_handler("stats", read_handler, h_stats);
+    add_write_handler("add", write_handler, h_add);
+    add_write_handler("insert", write_handler, h_insert);
+    add_write_handler("remove", write_handler, h_remove);
+    add_write_handler("clear", write_handler, h_clear);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPTupleFilter)
@@ -0,0 +1,219 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPTUPLEFILTER_HH
+#define CLICK_IPTUPLEFILTER_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IPTupleFilter(ACTION_1 PATTERN_1, ..., ACTION_N PATTERN_N)
+
+=s ip
+
+filters IP packets by 5-tuple rules, scaling to large rulesets
+
+=d
+
+IPTupleFilter is a packet filter for large access control lists.  Its rules
+use IPFilter's syntax and first-match semantics, but are limited to the IP
+5-tuple: each PATTERN is a conjunction of source and destination address
+prefixes, an IP protocol, and source and destination port ranges.
+IPTupleFilter sets up rulesets of tens of thousands of rules in well under a
+second and changes them rule by rule through handlers, where IPFilter would
+compile a single decision tree whose size and compile time grow quickly with
+the number of rules, especially rules with port ranges.
+
+Each ACTION is an output port number; 'C<allow>', which is equivalent to
+'C<0>'; or 'C<drop>' or 'C<deny>', which drop the packet.  Packets that match
+no rule are dropped.  Input packets must have their IP header annotation
+set; CheckIPHeader and MarkIPHeader do this.
+
+Each PATTERN is 'C<all>' (or 'C<->'), or primitives joined by 'C<&&>' or
+'C<and>':
+
+=over 8
+
+=item 'C<src> [C<host>|C<net>] ADDR', 'C<dst> [C<host>|C<net>] ADDR'
+
+ADDR is an IP address, an address prefix like 10.0.0.0/8, or a name
+registered with AddressInfo.
+
+=item 'C<tcp>', 'C<udp>', 'C<icmp>', 'C<ip proto> PROTO'
+
+PROTO is a protocol number or name.
+
+=item 'C<src port> PORTS', 'C<dst port> PORTS'
+
+PORTS is a port number or name, a range 'LOW-HIGH', or a comparison such as
+'C<< > 1023 >>' or 'C<< <= 1023 >>'.  A pattern with ports and no protocol
+matches TCP and UDP, as in IPFilter.  Port patterns never match non-first
+fragments.
+
+=back
+
+Anything else, including 'C<||>', 'C<not>' and TCP flags, is an error; use
+IPFilter or IPClassifier for such rules.
+
+IPTupleFilter classifies with tuple space search.  Each rule becomes an
+entry (two for port rules without a protocol) that matches particular values
+under a particular combination of address prefix lengths, protocol, and
+exact or wildcard ports, a I<tuple>.  Each tuple has a hash table of its
+entries; port ranges other than single ports are checked against the
+entries found there.  A packet is classified by masking its 5-tuple with
+each tuple's masks and looking it up in that tuple's table, visiting tuples
+in order of their highest priority rule and stopping once no remaining tuple
+can hold a better match.  Lookup time thus grows with the number of distinct
+tuples, usually a few dozen to a few hundred, not the number of rules.
+
+Rule changes made through handlers take effect immediately, but are not
+synchronized with packets being classified on other threads.
+
+=h rules read-only
+
+Returns the rules, one per line, each preceded by its number.
+
+=h stats read-only
+
+Returns the number of rules, entries, and tuples.
+
+=h add write-only
+
+Takes a rule, 'ACTION PATTERN', and adds it after all other rules.
+
+=h insert write-only
+
+Takes a rule number followed by a rule, and inserts the rule before the
+rule with that number, so that the new rule has that number.
+
+=h remove write-only
+
+Takes a rule number and removes that rule.
+
+=h clear write-only
+
+Removes all rules.
+
+=e
+
+  IPTupleFilter(allow src 10.0.0.0/8 && tcp && dst port 80,
+		1 dst net 192.168.0.0/16 && udp && dst port 5000-5999,
+		deny src port < 1024,
+		allow all);
+
+The conf/make-acl-bench.pl script generates ClassBench-style rulesets and
+traffic for measuring IPTupleFilter against IPFilter.
+
+=a
+
+IPFilter, IPClassifier, CheckIPHeader, AddressInfo */
+
+class IPTupleFilter : public Element { public:
+
+    IPTupleFilter() CLICK_COLD;
+    ~IPTupleFilter() CLICK_COLD;
+
+    const char *class_name() const	{ return "IPTupleFilter"; }
+    const char *port_count() const	{ return "1/-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+
+  private:
+
+    // A packet's 5-tuple, or a masked one.  Addresses are in network byte
+    // order, ports in host byte order.
+    struct Key {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t sport;
+	uint16_t dport;
+	uint32_t proto;
+
+	hashcode_t hashcode() const {
+	    uint32_t h = src * 0x9E3779B1U;
+	    h = (h ^ dst) * 0x85EBCA6BU;
+	    h = (h ^ ((sport << 16) | dport)) * 0xC2B2AE35U;
+	    h ^= proto;
+	    return h ^ (h >> 15);
+	}
+	bool operator==(const Key &x) const {
+	    return src == x.src && dst == x.dst && sport == x.sport
+		&& dport == x.dport && proto == x.proto;
+	}
+    };
+
+    struct Rule {
+	String text;
+	int action;
+	uint32_t order;		// smaller matches first
+	Key value;
+	Key mask;
+	uint16_t sport[2];	// inclusive port ranges
+	uint16_t dport[2];
+	bool ports;
+	bool live;
+    };
+
+    // Entries with the same masked key are chained in order.  Port ranges
+    // that are not exact ports are checked here, not in the key.
+    struct Entry {
+	uint32_t order;
+	int action;
+	uint32_t rule;
+	uint32_t next;
+	bool ports;
+	uint16_t sport[2];
+	uint16_t dport[2];
+    };
+
+    enum { NONE = 0xFFFFFFFFU, ORDER_GAP = 1U << 10 };
+
+    // Entries with one combination of prefix lengths, by masked key.
+    struct Tuple {
+	Key mask;
+	bool ports;
+	uint32_t min_order;
+	uint32_t nentries;
+	HashTable<Key, uint32_t> table;
+	Tuple()
+	    : table(NONE) {
+	}
+    };
+
+    Vector<Rule> _rules;		// by rule ID
+    Vector<uint32_t> _order;		// rule IDs, first match first
+    Vector<uint32_t> _free_rules;
+    Vector<Entry> _entries;
+    uint32_t _free_entry;
+    uint32_t _nentries;
+    Vector<Tuple *> _tuples;		// sorted by min_order
+    HashTable<Key, Tuple *> _tuple_map;	// by mask
+
+    int parse_rule(const String &, Rule &, ErrorHandler *) const;
+    void expand(const Rule &, Vector<Key> &values, Vector<Key> &masks) const;
+    int add_rule(const String &, int pos, ErrorHandler *);
+    void remove_rule(int pos);
+    void update_min_order(Tuple *);
+    void insert_entry(uint32_t rule, const Key &value, const Key &mask);
+    void remove_entry(uint32_t rule, const Key &value, const Key &mask);
+    void renumber();
+    void sort_tuples();
+    static int tuple_compar(const void *, const void *, void *);
+    void clear();
+    inline int lookup(const Packet *) const;
+
+    enum { h_rules, h_stats, h_add, h_insert, h_remove, h_clear };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
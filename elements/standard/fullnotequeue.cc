@@ -70,9 +70,10 @@ FullNoteQueue::pull(int)
     // Code taken from SimpleQueue::deq.
     Storage::index_type h = head(), t = tail(), nh = next_i(h);
 
-    if (h != t)
+    if (h != t) {
+	prefetch_next(nh, t);
 	return pull_success(h, nh);
-    else
+    } else
 	return pull_failure();
 }
 
@@ -0,0 +1,670 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * htbshaper.{cc,hh} -- hierarchical token bucket shaper
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "htbshaper.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+#include <click/nameinfo.hh>
+CLICK_DECLS
+
+// Token counts are kept in nanoseconds of transmission time, and may go as
+// far negative as one MBUFFER.
+static const int64_t NSEC_PER_SEC = 1000000000;
+static const int64_t MBUFFER = 60 * NSEC_PER_SEC;
+static const int64_t RATE_INTERVAL = NSEC_PER_SEC;
+
+static inline int64_t
+tx_time(uint32_t len, uint32_t rate)
+{
+    return (int64_t) len * NSEC_PER_SEC / rate;
+}
+
+static inline int64_t
+elapsed(const Timestamp &now, const Timestamp &then)
+{
+    int64_t diff = (now - then).nsecval();
+    return diff < MBUFFER ? diff : MBUFFER;
+}
+
+HTBShaper::HTBShaper()
+    : _default(-1), _backlog(0), _drops(0), _timer(this)
+{
+}
+
+void *
+HTBShaper::cast(const char *n)
+{
+    if (strcmp(n, "HTBShaper") == 0)
+	return (HTBShaper *)this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return &_notifier;
+    else
+	return Element::cast(n);
+}
+
+int
+HTBShaper::parse_class(const String &spec, Vector<uint32_t> &parents, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(spec, words);
+    if (words.size() < 3 || (words.size() & 1) == 0)
+	return errh->error("CLASS %<%s%>: expected %<ID PARENT RATE [KEYWORD VALUE]...%>", spec.c_str());
+
+    uint32_t low = 0, high = 0, parent = 0;
+    int dash = words[0].find_left('-');
+    if (!IntArg().parse(dash < 0 ? words[0] : words[0].substring(0, dash), low)
+	|| !IntArg().parse(dash < 0 ? words[0] : words[0].substring(dash + 1), high)
+	|| high < low)
+	return errh->error("CLASS %<%s%>: bad ID", spec.c_str());
+    if (words[1] != "-" && !IntArg().parse(words[1], parent))
+	return errh->error("CLASS %<%s%>: bad PARENT", spec.c_str());
+    if (words[1] != "-" && parent >= low && parent <= high)
+	return errh->error("CLASS %<%s%>: class is its own parent", spec.c_str());
+
+    Class c = Class();
+    c.parent = (words[1] == "-" ? -1 : 0);
+    c.capacity = 1000;
+    if (!BandwidthArg().parse(words[2], c.rate) || c.rate == 0)
+	return errh->error("CLASS %<%s%>: bad RATE", spec.c_str());
+    c.ceil = c.rate;
+    uint32_t burst = 0, cburst = 0;
+    c.quantum = c.rate / 10;
+    for (int i = 3; i < words.size(); i += 2) {
+	bool ok;
+	if (words[i] == "CEIL")
+	    ok = BandwidthArg().parse(words[i + 1], c.ceil) && c.ceil >= c.rate;
+	else if (words[i] == "BURST")
+	    ok = IntArg().parse(words[i + 1], burst);
+	else if (words[i] == "CBURST")
+	    ok = IntArg().parse(words[i + 1], cburst);
+	else if (words[i] == "QUANTUM")
+	    ok = IntArg().parse(words[i + 1], c.quantum) && c.quantum > 0;
+	else if (words[i] == "CAPACITY")
+	    ok = IntArg().parse(words[i + 1], c.capacity);
+	else
+	    return errh->error("CLASS %<%s%>: unknown keyword %<%s%>", spec.c_str(), words[i].c_str());
+	if (!ok)
+	    return errh->error("CLASS %<%s%>: bad %s", spec.c_str(), words[i].c_str());
+    }
+    if (!burst)
+	burst = (c.rate / 50 > 1600 ? c.rate / 50 : 1600);
+    if (!cburst)
+	cburst = (c.ceil / 50 > 1600 ? c.ceil / 50 : 1600);
+    if (c.quantum < 1500)
+	c.quantum = 1500;
+    else if (c.quantum > 60000)
+	c.quantum = 60000;
+    if (c.parent < 0) {
+	c.ceil = c.rate;
+	cburst = burst;
+    }
+    c.buffer = c.tokens = tx_time(burst, c.rate);
+    c.cbuffer = c.ctokens = tx_time(cburst, c.ceil);
+    c.deficit = c.quantum;
+
+    for (uint64_t id = low; id <= high; ++id) {
+	if (_class_map.find((uint32_t) id) != _class_map.end())
+	    return errh->error("CLASS %<%s%>: class %u redefined", spec.c_str(), (uint32_t) id);
+	c.id = id;
+	_class_map[c.id] = _classes.size();
+	_classes.push_back(c);
+	parents.push_back(parent);
+    }
+    return 0;
+}
+
+int
+HTBShaper::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _notifier.initialize(Notifier::EMPTY_NOTIFIER, router());
+
+    Vector<String> specs;
+    int anno = PAINT_ANNO_OFFSET + (PAINT_ANNO_SIZE << 16);
+    uint32_t default_id;
+    bool default_set;
+    if (Args(conf, this, errh)
+	.read_all("CLASS", AnyArg(), specs)
+	.read("ANNO", AnnoArg(0), anno)
+	.read("DEFAULT", default_id).read_status(default_set)
+	.complete() < 0)
+	return -1;
+
+    _anno = ANNOTATIONINFO_OFFSET(anno);
+    _anno_size = ANNOTATIONINFO_SIZE(anno) ? ANNOTATIONINFO_SIZE(anno) : 4;
+    if ((_anno_size != 1 && _anno_size != 2 && _anno_size != 4)
+	|| _anno % _anno_size != 0 || _anno + _anno_size > Packet::anno_size)
+	return errh->error("bad ANNO");
+
+    _classes.clear();
+    _class_map.clear();
+    Vector<uint32_t> parents;
+    for (String *it = specs.begin(); it != specs.end(); ++it)
+	if (parse_class(*it, parents, errh) < 0)
+	    return -1;
+    if (!_classes.size())
+	return errh->error("no classes defined");
+
+    // link parents, then compute levels: leaves are level 0, and each inner
+    // class is one level above its highest child
+    for (int i = 0; i < _classes.size(); ++i)
+	if (_classes[i].parent >= 0) {
+	    int p = find_class(parents[i]);
+	    if (p < 0)
+		return errh->error("class %u: parent %u not defined", _classes[i].id, parents[i]);
+	    _classes[i].parent = p;
+	    _classes[p].nchildren++;
+	}
+    int nlevels = 1;
+    for (int i = 0; i < _classes.size(); ++i)
+	if (!_classes[i].nchildren) {
+	    int depth = 0;
+	    for (int c = i; c >= 0; c = _classes[c].parent, ++depth) {
+		if (depth > _classes.size())
+		    return errh->error("class %u: parent loop", _classes[i].id);
+		if (_classes[c].level < depth)
+		    _classes[c].level = depth;
+	    }
+	    if (nlevels < depth)
+		nlevels = depth;
+	}
+    for (int i = 0; i < _classes.size(); ++i)
+	if (_classes[i].parent >= 0 && _classes[i].nchildren && !_classes[i].level)
+	    return errh->error("class %u: parent loop", _classes[i].id);
+    _rows.assign(nlevels, -1);
+
+    _default = -1;
+    if (default_set) {
+	_default = find_class(default_id);
+	if (_default < 0 || _classes[_default].nchildren)
+	    return errh->error("DEFAULT must name a leaf class");
+    }
+    return 0;
+}
+
+int
+HTBShaper::initialize(ErrorHandler *)
+{
+    Timestamp now = Timestamp::now_steady();
+    for (Class *c = _classes.begin(); c != _classes.end(); ++c) {
+	c->t_c = c->rate_start = now;
+	c->mode = mode_can;
+	c->row_link.prev = c->row_link.next = -1;
+	c->feed_link.prev = c->feed_link.next = -1;
+	c->feed = c->wait_pos = -1;
+    }
+    _timer.initialize(this);
+    _notifier.sleep();
+    return 0;
+}
+
+void
+HTBShaper::cleanup(CleanupStage)
+{
+    for (Class *c = _classes.begin(); c != _classes.end(); ++c)
+	while (Packet *p = c->head) {
+	    c->head = p->next();
+	    p->kill();
+	}
+}
+
+inline int
+HTBShaper::find_class(uint32_t id) const
+{
+    HashTable<uint32_t, int>::const_iterator it = _class_map.find(id);
+    return it != _class_map.end() ? it.value() : -1;
+}
+
+template <HTBShaper::Link HTBShaper::Class::*L> inline void
+HTBShaper::list_insert(int &list, int c)
+{
+    Link &l = _classes[c].*L;
+    if (list < 0) {
+	l.prev = l.next = c;
+	list = c;
+    } else {
+	// insert just before the current element, at the end of the round
+	Link &cur = _classes[list].*L;
+	l.prev = cur.prev;
+	l.next = list;
+	(_classes[cur.prev].*L).next = c;
+	cur.prev = c;
+    }
+}
+
+template <HTBShaper::Link HTBShaper::Class::*L> inline void
+HTBShaper::list_remove(int &list, int c)
+{
+    Link &l = _classes[c].*L;
+    if (l.next == c)
+	list = -1;
+    else {
+	(_classes[l.prev].*L).next = l.next;
+	(_classes[l.next].*L).prev = l.prev;
+	if (list == c)
+	    list = l.next;
+    }
+    l.prev = l.next = -1;
+}
+
+inline bool
+HTBShaper::wanting(const Class &c) const
+{
+    return c.nchildren ? c.feed >= 0 : c.qlen != 0;
+}
+
+/* Links class c, which has just started wanting to send, according to its
+ * mode. */
+void
+HTBShaper::activate(int c)
+{
+    Class &cl = _classes[c];
+    if (cl.mode == mode_can)
+	list_insert<&Class::row_link>(_rows[cl.level], c);
+    if (cl.mode != mode_cant)
+	feed_join(c);
+}
+
+/* Unlinks class c, which has just stopped wanting to send. */
+void
+HTBShaper::deactivate(int c)
+{
+    Class &cl = _classes[c];
+    if (cl.mode == mode_can)
+	list_remove<&Class::row_link>(_rows[cl.level], c);
+    if (cl.mode != mode_cant)
+	feed_leave(c);
+}
+
+/* Adds c to its parent's feed.  The parent may start wanting to send in
+ * turn. */
+void
+HTBShaper::feed_join(int c)
+{
+    int p = _classes[c].parent;
+    if (p < 0)
+	return;
+    bool was_wanting = _classes[p].feed >= 0;
+    list_insert<&Class::feed_link>(_classes[p].feed, c);
+    if (!was_wanting)
+	activate(p);
+}
+
+void
+HTBShaper::feed_leave(int c)
+{
+    int p = _classes[c].parent;
+    if (p < 0)
+	return;
+    list_remove<&Class::feed_link>(_classes[p].feed, c);
+    if (_classes[p].feed < 0)
+	deactivate(p);
+}
+
+/* Returns c's mode at now.  If the mode is not mode_can, sets delay to the
+ * time until it improves. */
+int
+HTBShaper::class_mode(const Class &c, const Timestamp &now, int64_t &delay) const
+{
+    int64_t diff = elapsed(now, c.t_c);
+    int64_t toks = c.ctokens + diff;
+    if (toks < 0) {
+	delay = -toks;
+	return mode_cant;
+    }
+    toks = c.tokens + diff;
+    if (toks >= 0)
+	return mode_can;
+    delay = -toks;
+    // a root class has nobody to borrow from
+    return c.parent >= 0 ? mode_may : mode_cant;
+}
+
+void
+HTBShaper::change_mode(int c, int mode)
+{
+    Class &cl = _classes[c];
+    int old = cl.mode;
+    if (old == mode)
+	return;
+    cl.mode = mode;
+    if (!wanting(cl))
+	return;
+    if (old == mode_can)
+	list_remove<&Class::row_link>(_rows[cl.level], c);
+    else if (mode == mode_can)
+	list_insert<&Class::row_link>(_rows[cl.level], c);
+    if (old == mode_cant)
+	feed_join(c);
+    else if (mode == mode_cant)
+	feed_leave(c);
+}
+
+void
+HTBShaper::wait_sift_up(int pos)
+{
+    int c = _wait[pos];
+    while (pos > 0) {
+	int parent = (pos - 1) / 2;
+	if (!(_classes[c].event < _classes[_wait[parent]].event))
+	    break;
+	_wait[pos] = _wait[parent];
+	_classes[_wait[pos]].wait_pos = pos;
+	pos = parent;
+    }
+    _wait[pos] = c;
+    _classes[c].wait_pos = pos;
+}
+
+void
+HTBShaper::wait_sift_down(int pos)
+{
+    int c = _wait[pos], n = _wait.size();
+    while (1) {
+	int child = 2 * pos + 1;
+	if (child >= n)
+	    break;
+	if (child + 1 < n && _classes[_wait[child + 1]].event < _classes[_wait[child]].event)
+	    ++child;
+	if (!(_classes[_wait[child]].event < _classes[c].event))
+	    break;
+	_wait[pos] = _wait[child];
+	_classes[_wait[pos]].wait_pos = pos;
+	pos = child;
+    }
+    _wait[pos] = c;
+    _classes[c].wait_pos = pos;
+}
+
+void
+HTBShaper::wait_set(int c, const Timestamp &when)
+{
+    Class &cl = _classes[c];
+    if (cl.wait_pos < 0) {
+	cl.event = when;
+	cl.wait_pos = _wait.size();
+	_wait.push_back(c);
+	wait_sift_up(cl.wait_pos);
+    } else if (when < cl.event) {
+	cl.event = when;
+	wait_sift_up(cl.wait_pos);
+    } else {
+	cl.event = when;
+	wait_sift_down(cl.wait_pos);
+    }
+}
+
+void
+HTBShaper::wait_remove(int c)
+{
+    int pos = _classes[c].wait_pos;
+    _classes[c].wait_pos = -1;
+    int last = _wait.back();
+    _wait.pop_back();
+    if (last != c) {
+	_wait[pos] = last;
+	_classes[last].wait_pos = pos;
+	wait_sift_up(pos);
+	wait_sift_down(_classes[last].wait_pos);
+    }
+}
+
+void
+HTBShaper::do_events(const Timestamp &now)
+{
+    while (_wait.size() && _classes[_wait[0]].event <= now) {
+	int c = _wait[0];
+	wait_remove(c);
+	int64_t delay = 0;
+	int mode = class_mode(_classes[c], now, delay);
+	change_mode(c, mode);
+	if (mode != mode_can)
+	    wait_set(c, now + Timestamp::make_nsec(delay));
+    }
+}
+
+/* Ends cl's measurement interval if it has lasted long enough, setting
+ * measured_rate to the interval's byte rate. */
+void
+HTBShaper::measure(Class &cl, const Timestamp &now)
+{
+    int64_t diff = (now - cl.rate_start).nsecval();
+    if (diff < RATE_INTERVAL)
+	return;
+    uint64_t r = int_divide((cl.bytes - cl.rate_bytes) * 1000000, (uint64_t) (diff / 1000));
+    cl.measured_rate = (r < 0xFFFFFFFFU ? r : 0xFFFFFFFFU);
+    cl.rate_start = now;
+    cl.rate_bytes = cl.bytes;
+}
+
+/* Charges a len-byte packet to leaf c and its ancestors.  Classes at or
+ * above the lender's level spend rate tokens; every class spends ceil
+ * tokens. */
+void
+HTBShaper::charge(int c, int level, uint32_t len, const Timestamp &now)
+{
+    for (; c >= 0; c = _classes[c].parent) {
+	Class &cl = _classes[c];
+	int64_t diff = elapsed(now, cl.t_c);
+	int64_t toks = cl.tokens + diff;
+	if (toks > cl.buffer)
+	    toks = cl.buffer;
+	if (cl.level >= level) {
+	    toks -= tx_time(len, cl.rate);
+	    if (toks <= -MBUFFER)
+		toks = 1 - MBUFFER;
+	}
+	cl.tokens = toks;
+	toks = cl.ctokens + diff;
+	if (toks > cl.cbuffer)
+	    toks = cl.cbuffer;
+	toks -= tx_time(len, cl.ceil);
+	if (toks <= -MBUFFER)
+	    toks = 1 - MBUFFER;
+	cl.ctokens = toks;
+	cl.t_c = now;
+	measure(cl, now);
+	cl.packets++;
+	cl.bytes += len;
+
+	int64_t delay = 0;
+	int mode = class_mode(cl, now, delay);
+	change_mode(c, mode);
+	if (mode != mode_can)
+	    wait_set(c, now + Timestamp::make_nsec(delay));
+	else if (cl.wait_pos >= 0)
+	    wait_remove(c);
+    }
+}
+
+Packet *
+HTBShaper::dequeue(int level, const Timestamp &now)
+{
+    // descend from the lender through borrowing classes to a leaf
+    int c = _rows[level];
+    while (_classes[c].nchildren)
+	c = _classes[c].feed;
+
+    Class &leaf = _classes[c];
+    Packet *p = leaf.head;
+    leaf.head = p->next();
+    if (!leaf.head)
+	leaf.tail = 0;
+    p->set_next(0);
+    leaf.qlen--;
+    _backlog--;
+
+    // deficit round robin: move on once the leaf spends its quantum
+    leaf.deficit -= p->length();
+    if (leaf.deficit <= 0) {
+	leaf.deficit += leaf.quantum;
+	for (int k = c; _classes[k].level < level; k = _classes[k].parent)
+	    _classes[_classes[k].parent].feed = _classes[k].feed_link.next;
+	_rows[level] = _classes[_rows[level]].row_link.next;
+    }
+
+    if (!leaf.qlen)
+	deactivate(c);
+    charge(c, level, p->length(), now);
+    return p;
+}
+
+void
+HTBShaper::push(int, Packet *p)
+{
+    uint32_t id;
+    if (_anno_size == 1)
+	id = p->anno_u8(_anno);
+    else if (_anno_size == 2)
+	id = p->anno_u16(_anno);
+    else
+	id = p->anno_u32(_anno);
+    int c = find_class(id);
+    if (c < 0 || _classes[c].nchildren)
+	c = _default;
+    if (c < 0) {
+	_drops++;
+	p->kill();
+	return;
+    }
+
+    Class &cl = _classes[c];
+    if (cl.qlen >= cl.capacity) {
+	cl.drops++;
+	_drops++;
+	p->kill();
+	return;
+    }
+    if (cl.tail)
+	cl.tail->set_next(p);
+    else
+	cl.head = p;
+    cl.tail = p;
+    p->set_next(0);
+    _backlog++;
+    if (++cl.qlen == 1) {
+	activate(c);
+	_notifier.wake();
+    }
+}
+
+Packet *
+HTBShaper::pull(int)
+{
+    Timestamp now = Timestamp::now_steady();
+    do_events(now);
+    for (int level = 0; level < _rows.size(); ++level)
+	if (_rows[level] >= 0)
+	    return dequeue(level, now);
+
+    // Nothing may be sent now.  Sleep until the next class changes mode,
+    // unless that is very soon.
+    if (_backlog && _wait.size()) {
+	Timestamp expiry = _classes[_wait[0]].event - Timer::adjustment();
+	if (expiry > now) {
+	    _timer.schedule_at_steady(expiry);
+	    _notifier.sleep();
+	}
+    } else
+	_notifier.sleep();
+    return 0;
+}
+
+void
+HTBShaper::run_timer(Timer *)
+{
+    _notifier.wake();
+}
+
+uint32_t
+HTBShaper::backlog(int c) const
+{
+    if (!_classes[c].nchildren)
+	return _classes[c].qlen;
+    uint32_t n = 0;
+    for (int i = 0; i < _classes.size(); ++i)
+	if (_classes[i].parent == c)
+	    n += backlog(i);
+    return n;
+}
+
+enum { h_backlog, h_drops, h_rate, h_config_rate, h_classes };
+
+int
+HTBShaper::read_param_handler(int, String &s, Element *e, const Handler *h, ErrorHandler *errh)
+{
+    HTBShaper *htb = static_cast<HTBShaper *>(e);
+    intptr_t what = reinterpret_cast<intptr_t>(h->read_user_data());
+    uint32_t id;
+    int c = -1;
+    if (s || what == h_rate || what == h_config_rate) {
+	if (!IntArg().parse(s, id) || (c = htb->find_class(id)) < 0)
+	    return errh->error("expected class ID");
+    }
+    Class *cl = (c >= 0 ? &htb->_classes[c] : 0);
+    switch (what) {
+    case h_backlog:
+	s = String(cl ? htb->backlog(c) : htb->_backlog);
+	break;
+    case h_drops:
+	s = String(cl ? cl->drops : htb->_drops);
+	break;
+    case h_rate:
+	htb->measure(*cl, Timestamp::now_steady());
+	s = BandwidthArg::unparse(cl->measured_rate);
+	break;
+    case h_config_rate:
+	s = BandwidthArg::unparse(cl->rate) + " " + BandwidthArg::unparse(cl->ceil);
+	break;
+    }
+    return 0;
+}
+
+String
+HTBShaper::read_handler(Element *e, void *)
+{
+    HTBShaper *htb = static_cast<HTBShaper *>(e);
+    static const char * const modes[] = { "cant", "borrow", "can" };
+    StringAccum sa;
+    for (int i = 0; i < htb->_classes.size(); ++i) {
+	const Class &cl = htb->_classes[i];
+	sa << cl.id << ' ';
+	if (cl.parent >= 0)
+	    sa << htb->_classes[cl.parent].id;
+	else
+	    sa << '-';
+	sa << ' ' << BandwidthArg::unparse(cl.rate)
+	   << ' ' << BandwidthArg::unparse(cl.ceil)
+	   << ' ' << modes[cl.mode]
+	   << ' ' << htb->backlog(i)
+	   << ' ' << cl.packets << ' ' << cl.bytes << ' ' << cl.drops << '\n';
+    }
+    return sa.take_string();
+}
+
+void
+HTBShaper::add_handlers()
+{
+    set_handler("backlog", Handler::f_read | Handler::f_read_param, read_param_handler, h_backlog);
+    set_handler("drops", Handler::f_read | Handler::f_read_param, read_param_handler, h_drops);
+    set_handler("rate", Handler::f_read | Handler::f_read_param, read_param_handler, h_rate);
+    set_handler("config_rate", Handler::f_read | Handler::f_read_param, read_param_handler, h_config_rate);
+    add_read_handler("classes", read_handler, h_classes, Handler::f_expensive);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(HTBShaper)
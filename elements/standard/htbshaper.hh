@@ -0,0 +1,229 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HTBSHAPER_HH
+#define CLICK_HTBSHAPER_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/notifier.hh>
+#include <click/hashtable.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HTBShaper(CLASS I<spec>, ..., [I<keywords>])
+
+=s shaping
+
+hierarchical token bucket shaper
+
+=d
+
+HTBShaper is a queue that shapes traffic through a tree of classes, using
+the hierarchical token bucket (HTB) algorithm.  Packets pushed on its input
+are classified by an annotation into leaf classes, each with its own queue.
+Pulling from its output returns the next packet that the class tree allows
+to be sent, or null if none may be sent yet.
+
+Each class has an assured RATE and a CEIL rate.  A class whose traffic is
+under RATE may always send.  A class over RATE but under CEIL may borrow
+unused bandwidth from its nearest ancestor that is itself under RATE.  A
+class over CEIL may not send.  Every packet counts against the CEIL of all
+its ancestors.  Borrowers share their lender's spare bandwidth by deficit
+round robin, in units of QUANTUM bytes.
+
+A single HTBShaper can hold many thousands of classes.  It keeps a calendar
+of the times at which classes become eligible, and uses a timer to wake up
+its downstream pullers when the next class becomes eligible.  Dequeuing takes
+time logarithmic in the number of classes.
+
+Each CLASS argument is a space-separated specification:
+
+   ID PARENT RATE [CEIL ceil] [BURST bytes] [CBURST bytes]
+	[QUANTUM bytes] [CAPACITY packets]
+
+ID is an unsigned integer or a range "LOW-HIGH", which defines one class per
+ID in the range with the same parameters.  PARENT is the ID of the parent
+class, or "-" for a root class.  RATE and CEIL are bandwidths; CEIL defaults
+to RATE, and is ignored for root classes, which have nothing to borrow from.
+BURST and CBURST are the rate and ceil token bucket sizes, and default to 20
+milliseconds' worth of tokens, but at least 1600 bytes.  QUANTUM defaults to
+one tenth of RATE per second, between 1500 and 60000 bytes.  CAPACITY is the
+queue capacity of a leaf class, and defaults to 1000 packets.
+
+Only leaf classes, which have no children, hold packets.  Packets whose
+annotation does not name a leaf class are put in the DEFAULT class, or
+dropped if there is no DEFAULT.  Packets that arrive at a full class queue are
+dropped.
+
+Keyword arguments are:
+
+=over 8
+
+=item CLASS
+
+Class specification, as described above.  May be given many times.
+
+=item ANNO
+
+Annotation name.  The annotation that holds each packet's class ID.  It may
+be 1, 2, or 4 bytes long.  Default is PAINT.
+
+=item DEFAULT
+
+Unsigned integer.  The leaf class used for unclassified packets.
+
+=back
+
+=h backlog read-only
+
+With a class ID parameter, returns the number of packets queued in that
+class and its descendants.  Without a parameter, returns the total number of
+queued packets.
+
+=h drops read-only
+
+With a class ID parameter, returns the number of packets dropped because that
+class's queue was full.  Without a parameter, returns the total number of
+dropped packets, including unclassified packets.
+
+=h rate read-only
+
+Takes a class ID parameter.  Returns the rate at which that class sent
+during its last complete measurement interval.  Intervals last at least one
+second and end when the class sends a packet or the handler is read.
+
+=h config_rate read-only
+
+Takes a class ID parameter.  Returns that class's RATE and CEIL.
+
+=h classes read-only
+
+Returns one line per class: ID, parent ID (or "-"), RATE, CEIL, current mode
+("can", "borrow", or "cant"), backlog, packets sent, bytes sent, and drops.
+
+=n
+
+HTBShaper is not thread safe: push to it and pull from it on a single
+thread.
+
+=e
+
+Shape each of 1000 subscribers, painted 0 through 999 in their AGGREGATE
+annotations, to 2Mbps, borrowing up to 10Mbps from a 100Mbps link:
+
+  ... -> htb :: HTBShaper(ANNO AGGREGATE,
+		CLASS 1000 - 100Mbps,
+		CLASS 0-999 1000 2Mbps CEIL 10Mbps)
+      -> ToDevice(eth0);
+
+=a BandwidthShaper, BandwidthRatedUnqueue, DRRSched, Queue */
+
+class HTBShaper : public Element { public:
+
+    HTBShaper() CLICK_COLD;
+
+    const char *class_name() const	{ return "HTBShaper"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH_TO_PULL; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    Packet *pull(int);
+    void run_timer(Timer *);
+
+  private:
+
+    enum { mode_cant = 0, mode_may = 1, mode_can = 2 };
+
+    // Classes are stored in a Vector and refer to each other by index.
+    // Round-robin lists are circular and doubly linked; a list is named by
+    // its current element's index.  A wanting class whose mode is mode_can
+    // is in the row for its level.  A wanting class whose mode is not
+    // mode_cant is in its parent's feed, so it keeps its round-robin
+    // position as it moves between mode_can and mode_may.  A leaf wants to
+    // send when its queue is nonempty; an inner class wants to send when
+    // its feed is nonempty.
+    struct Link {
+	int prev;
+	int next;
+    };
+    struct Class {
+	uint32_t id;
+	int parent;
+	int level;
+	int nchildren;
+	uint32_t rate;
+	uint32_t ceil;
+	int64_t buffer;		// nanoseconds
+	int64_t cbuffer;
+	int64_t tokens;
+	int64_t ctokens;
+	Timestamp t_c;
+	int mode;
+	Link row_link;
+	Link feed_link;
+	int feed;
+	int wait_pos;
+	Timestamp event;
+	Packet *head;
+	Packet *tail;
+	uint32_t qlen;
+	uint32_t capacity;
+	int32_t deficit;
+	uint32_t quantum;
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t drops;
+	Timestamp rate_start;	// current measurement interval
+	uint64_t rate_bytes;	// bytes before rate_start
+	uint32_t measured_rate;	// bytes/s in the last interval
+    };
+
+    Vector<Class> _classes;
+    HashTable<uint32_t, int> _class_map;
+    Vector<int> _rows;
+    Vector<int> _wait;
+    int _anno;
+    int _anno_size;
+    int _default;
+    uint32_t _backlog;
+    uint64_t _drops;
+    Timer _timer;
+    ActiveNotifier _notifier;
+
+    int parse_class(const String &, Vector<uint32_t> &, ErrorHandler *);
+    inline int find_class(uint32_t id) const;
+
+    template <Link Class::*L> inline void list_insert(int &list, int c);
+    template <Link Class::*L> inline void list_remove(int &list, int c);
+    inline bool wanting(const Class &c) const;
+    void activate(int c);
+    void deactivate(int c);
+    void feed_join(int c);
+    void feed_leave(int c);
+    int class_mode(const Class &, const Timestamp &now, int64_t &delay) const;
+    void change_mode(int c, int mode);
+
+    void wait_set(int c, const Timestamp &when);
+    void wait_remove(int c);
+    void wait_sift_up(int pos);
+    void wait_sift_down(int pos);
+    void do_events(const Timestamp &now);
+
+    static void measure(Class &, const Timestamp &now);
+    void charge(int c, int level, uint32_t len, const Timestamp &now);
+    Packet *dequeue(int level, const Timestamp &now);
+
+    uint32_t backlog(int c) const;
+    static int read_param_handler(int, String &, Element *, const Handler *, ErrorHandler *) CLICK_COLD;
+    static String read_handler(Element *, void *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
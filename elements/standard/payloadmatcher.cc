@@ -0,0 +1,1027 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * payloadmatcher.{cc,hh} -- multi-pattern payload classifier
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "payloadmatcher.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/confparse.hh>
+#include <click/integers.hh>
+#include <click/atomic.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+#if CLICK_USERLEVEL
+# include <click/userutils.hh>
+#endif
+#if defined(__SSE2__) && !CLICK_LINUXMODULE && !CLICK_BSDMODULE
+# include <emmintrin.h>
+# define PAYLOADMATCHER_SSE2 1
+#endif
+CLICK_DECLS
+
+namespace {
+
+// A set of bytes: one position in a pattern.
+struct ByteSet {
+    uint32_t w[8];
+
+    ByteSet() {
+	memset(w, 0, sizeof(w));
+    }
+    void add(int c) {
+	w[c >> 5] |= 1U << (c & 31);
+    }
+    void add_range(int lo, int hi) {
+	for (int c = lo; c <= hi; ++c)
+	    add(c);
+    }
+    bool contains(int c) const {
+	return w[c >> 5] & (1U << (c & 31));
+    }
+    void invert() {
+	for (int i = 0; i < 8; ++i)
+	    w[i] = ~w[i];
+    }
+    void merge(const ByteSet &x) {
+	for (int i = 0; i < 8; ++i)
+	    w[i] |= x.w[i];
+    }
+    void fold_case() {
+	for (int c = 'a'; c <= 'z'; ++c)
+	    if (contains(c) || contains(c - 'a' + 'A')) {
+		add(c);
+		add(c - 'a' + 'A');
+	    }
+    }
+};
+
+enum { max_expansions = 4096 };
+
+// Patterns are stored as strings of ByteSets, one per position.
+inline void
+append(StringAccum &sa, const ByteSet &bs)
+{
+    sa.append(reinterpret_cast<const char *>(bs.w), sizeof(bs.w));
+}
+
+inline const ByteSet &
+position(const String &alt, int i)
+{
+    return reinterpret_cast<const ByteSet *>(alt.data())[i];
+}
+
+inline int
+npositions(const String &alt)
+{
+    return alt.length() / sizeof(ByteSet);
+}
+
+int
+hexval(int c)
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+	return (c | 0x20) - 'a' + 10;
+    else
+	return -1;
+}
+
+// Parse the escape sequence at s[0] == '\\' into a byte set.
+const char *
+parse_escape(const char *s, const char *end, ByteSet &bs, ErrorHandler *errh)
+{
+    if (++s == end) {
+	errh->error("pattern ends in backslash");
+	return 0;
+    }
+    int c = (unsigned char) *s++;
+    switch (c) {
+    case 'd': case 'D':
+	bs.add_range('0', '9');
+	break;
+    case 'w': case 'W':
+	bs.add_range('0', '9');
+	bs.add_range('A', 'Z');
+	bs.add_range('a', 'z');
+	bs.add('_');
+	break;
+    case 's': case 'S':
+	bs.add(' ');
+	bs.add_range('\t', '\r');
+	break;
+    case 'n': bs.add('\n'); return s;
+    case 'r': bs.add('\r'); return s;
+    case 't': bs.add('\t'); return s;
+    case 'f': bs.add('\f'); return s;
+    case 'v': bs.add('\v'); return s;
+    case '0': bs.add(0); return s;
+    case 'x': {
+	int h1, h2;
+	if (end - s < 2 || (h1 = hexval(s[0])) < 0 || (h2 = hexval(s[1])) < 0) {
+	    errh->error("bad %<\\x%> escape");
+	    return 0;
+	}
+	bs.add(h1 * 16 + h2);
+	return s + 2;
+    }
+    default:
+	if (isalnum(c)) {
+	    errh->error("unknown escape %<\\%c%>", c);
+	    return 0;
+	}
+	bs.add(c);
+	return s;
+    }
+    if (c == 'D' || c == 'W' || c == 'S')
+	bs.invert();
+    return s;
+}
+
+// Parse a bracket class; s[0] == '['.
+const char *
+parse_class(const char *s, const char *end, ByteSet &bs, ErrorHandler *errh)
+{
+    bool negate = false;
+    if (++s != end && *s == '^')
+	negate = true, ++s;
+    bool first = true;
+    while (s != end && (*s != ']' || first)) {
+	first = false;
+	ByteSet item;
+	int lo = -1;
+	if (*s == '\\') {
+	    if (!(s = parse_escape(s, end, item, errh)))
+		return 0;
+	    for (int c = 0; c < 256 && lo < 0; ++c)
+		if (item.contains(c))
+		    lo = c;
+	    // only single-byte escapes can start a range
+	    ByteSet single;
+	    single.add(lo);
+	    if (memcmp(single.w, item.w, sizeof(item.w)) != 0)
+		lo = -1;
+	} else {
+	    lo = (unsigned char) *s++;
+	    item.add(lo);
+	}
+	if (lo >= 0 && end - s >= 2 && s[0] == '-' && s[1] != ']') {
+	    ByteSet hiset;
+	    int hi;
+	    if (s[1] == '\\') {
+		if (!(s = parse_escape(s + 1, end, hiset, errh)))
+		    return 0;
+		for (hi = 255; hi >= 0 && !hiset.contains(hi); --hi)
+		    /* nada */;
+	    } else {
+		hi = (unsigned char) s[1];
+		s += 2;
+	    }
+	    if (hi < lo) {
+		errh->error("bad range in character class");
+		return 0;
+	    }
+	    item.add_range(lo, hi);
+	}
+	bs.merge(item);
+    }
+    if (s == end) {
+	errh->error("unterminated character class");
+	return 0;
+    }
+    if (negate)
+	bs.invert();
+    return s + 1;
+}
+
+struct Item {
+    ByteSet bs;
+    int min;
+    int max;
+};
+
+// Expand one branch of a regular expression into alternatives.
+int
+parse_branch(const char *s, const char *end, bool nocase,
+	     Vector<String> &alts, ErrorHandler *errh)
+{
+    Vector<Item> items;
+    uint32_t nexpansions = 1;
+    while (s != end) {
+	Item it;
+	it.min = it.max = 1;
+	if (*s == '\\') {
+	    if (!(s = parse_escape(s, end, it.bs, errh)))
+		return -1;
+	} else if (*s == '[') {
+	    if (!(s = parse_class(s, end, it.bs, errh)))
+		return -1;
+	} else if (*s == '.') {
+	    it.bs.invert();
+	    ++s;
+	} else if (*s == '*' || *s == '+')
+	    return errh->error("unbounded repetition %<%c%> not supported", *s);
+	else if (*s == '(' || *s == ')' || *s == '^' || *s == '$')
+	    return errh->error("%<%c%> not supported", *s);
+	else if (*s == '?' || *s == '{')
+	    return errh->error("repetition of nothing");
+	else
+	    it.bs.add((unsigned char) *s++);
+
+	if (s != end && (*s == '*' || *s == '+'))
+	    return errh->error("unbounded repetition %<%c%> not supported", *s);
+	else if (s != end && *s == '?') {
+	    it.min = 0;
+	    ++s;
+	} else if (s != end && *s == '{') {
+	    const char *close = (const char *) memchr(s, '}', end - s);
+	    const char *comma = close ? (const char *) memchr(s, ',', close - s) : 0;
+	    if (!close
+		|| !IntArg().parse(String(s + 1, comma ? comma : close), it.min)
+		|| !IntArg().parse(String(comma ? comma + 1 : s + 1, close), it.max)
+		|| it.min < 0 || it.max < it.min || it.max > 255)
+		return errh->error("bad repetition count");
+	    s = close + 1;
+	}
+	if (s != end && (*s == '*' || *s == '+' || *s == '?' || *s == '{'))
+	    return errh->error("nested repetition not supported");
+	if (nocase)
+	    it.bs.fold_case();
+	nexpansions *= it.max - it.min + 1;
+	if (nexpansions > max_expansions)
+	    return errh->error("pattern has too many alternatives");
+	items.push_back(it);
+    }
+
+    // Enumerate every combination of repetition counts.
+    Vector<int> count(items.size(), 0);
+    for (int i = 0; i < items.size(); ++i)
+	count[i] = items[i].min;
+    while (1) {
+	StringAccum sa;
+	for (int i = 0; i < items.size(); ++i)
+	    for (int j = 0; j < count[i]; ++j)
+		append(sa, items[i].bs);
+	if (!sa.length())
+	    return errh->error("pattern can match the empty string");
+	alts.push_back(sa.take_string());
+	int i = items.size() - 1;
+	while (i >= 0 && count[i] == items[i].max) {
+	    count[i] = items[i].min;
+	    --i;
+	}
+	if (i < 0)
+	    return 0;
+	++count[i];
+    }
+}
+
+}
+
+static int
+parse_rule(const String &text, PayloadMatcher::Rule &rule, ErrorHandler *errh)
+{
+    String str = cp_uncomment(text);
+    const char *s = str.begin(), *end = str.end();
+    rule.text = str;
+    rule.output = 0;
+    rule.alternatives.clear();
+
+    const char *pend;
+    bool regex;
+    if (s != end && *s == '\"') {
+	pend = cp_skip_double_quote(s, end);
+	if (pend[-1] != '\"' || pend == s + 1)
+	    return errh->error("unterminated string");
+	regex = false;
+    } else if (s != end && *s == '/') {
+	for (pend = s + 1; pend != end && *pend != '/'; ++pend)
+	    if (*pend == '\\' && pend + 1 != end)
+		++pend;
+	    else if (*pend == '[') {
+		// skip the class, which may contain '/'
+		const char *x = pend + 1;
+		if (x != end && *x == '^')
+		    ++x;
+		if (x != end && *x == ']')
+		    ++x;
+		while (x != end && *x != ']')
+		    x += (*x == '\\' && x + 1 != end ? 2 : 1);
+		pend = (x == end ? x - 1 : x);
+	    }
+	if (pend == end)
+	    return errh->error("unterminated regular expression");
+	++pend;
+	regex = true;
+    } else
+	return errh->error("expected %<\"STRING\"%> or %</REGEX/%>");
+
+    bool nocase = false;
+    const char *fend = pend;
+    for (; fend != end && isalpha((unsigned char) *fend); ++fend)
+	if (*fend == 'i')
+	    nocase = true;
+	else
+	    return errh->error("unknown pattern flag %<%c%>", *fend);
+
+    String rest = cp_uncomment(str.substring(fend, end));
+    if (rest && !IntArg().parse(rest, rule.output))
+	return errh->error("expected output port after pattern");
+
+    if (regex) {
+	// split on top-level '|'
+	const char *b = s + 1, *e = pend - 1;
+	const char *x = b;
+	int depth = 0;
+	while (1) {
+	    if (x == e || (*x == '|' && !depth)) {
+		if (parse_branch(b, x, nocase, rule.alternatives, errh) < 0)
+		    return -1;
+		if (x == e)
+		    break;
+		b = ++x;
+	    } else if (*x == '\\' && x + 1 != e)
+		x += 2;
+	    else {
+		if (*x == '[' && !depth)
+		    depth = 1;
+		else if (*x == ']' && depth && x[-1] != '[' && !(x[-1] == '^' && x[-2] == '['))
+		    depth = 0;
+		++x;
+	    }
+	}
+	if (rule.alternatives.size() > max_expansions)
+	    return errh->error("pattern has too many alternatives");
+    } else {
+	String lit = cp_unquote(str.substring(s, pend));
+	StringAccum sa;
+	for (int i = 0; i < lit.length(); ++i) {
+	    ByteSet bs;
+	    bs.add((unsigned char) lit[i]);
+	    if (nocase)
+		bs.fold_case();
+	    append(sa, bs);
+	}
+	rule.alternatives.push_back(sa.take_string());
+    }
+    return 0;
+}
+
+
+// THE AUTOMATON
+
+struct PayloadMatcher::Automaton {
+    enum { match_bit = 0x80000000U };
+
+    uint32_t nclasses;
+    uint32_t nstates;
+    uint8_t byte_class[256];
+    // delta[s * nclasses + class] is the next state times nclasses, plus
+    // match_bit if that state ends a pattern
+    Vector<uint32_t> delta;
+    Vector<uint32_t> match_begin;	// per state: first rule number in matches
+    Vector<uint32_t> matches;	// rule numbers, ascending per state
+
+    int nstart;			// # bytes that leave the start state, or -1
+    unsigned char start[4];
+
+    Vector<String> texts;
+    Vector<int> outputs;
+    Vector<uint32_t> counts;
+
+    Automaton()
+	: nclasses(1), nstates(1), nstart(0) {
+	memset(byte_class, 0, sizeof(byte_class));
+    }
+
+    // Returns the first position at or after s where a match might start.
+    inline const unsigned char *skip(const unsigned char *s,
+				     const unsigned char *end) const;
+};
+
+inline const unsigned char *
+PayloadMatcher::Automaton::skip(const unsigned char *s,
+				const unsigned char *end) const
+{
+    if (nstart == 0)
+	return end;
+#if PAYLOADMATCHER_SSE2
+    if (end - s >= 16) {
+	__m128i b0 = _mm_set1_epi8(start[0]);
+	__m128i b1 = _mm_set1_epi8(start[nstart > 1 ? 1 : 0]);
+	__m128i b2 = _mm_set1_epi8(start[nstart > 2 ? 2 : 0]);
+	__m128i b3 = _mm_set1_epi8(start[nstart > 3 ? 3 : 0]);
+	for (; end - s >= 16; s += 16) {
+	    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+	    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, b0),
+						  _mm_cmpeq_epi8(v, b1)),
+				     _mm_or_si128(_mm_cmpeq_epi8(v, b2),
+						  _mm_cmpeq_epi8(v, b3)));
+	    if (int mask = _mm_movemask_epi8(m))
+		return s + ffs_lsb((unsigned) mask) - 1;
+	}
+    }
+#endif
+    if (nstart == 1) {
+	const void *x = memchr(s, start[0], end - s);
+	return x ? reinterpret_cast<const unsigned char *>(x) : end;
+    }
+    for (; s != end; ++s)
+	for (int i = 0; i < nstart; ++i)
+	    if (*s == start[i])
+		return s;
+    return end;
+}
+
+
+// BUILDING AUTOMATA
+//
+// Builds proceed in steps so that a background task can build a new
+// automaton without holding up the driver.
+
+struct PayloadMatcher::Build {
+    enum { p_classes, p_trie, p_links, p_finish, p_done };
+    enum { step_work = 1 << 16 };
+
+    Vector<Rule> rules;
+    Automaton *a;
+    uint32_t max_states;
+    int phase;
+    int pos;
+    String error;
+
+    Vector<uint32_t> own_head;	// trie: first rule ending at state
+    Vector<uint32_t> own_next;	// linked rule list; 0 is the end
+    Vector<uint32_t> own_rule;
+    Vector<uint32_t> fail;
+    Vector<uint32_t> queue;
+    Vector<uint32_t> match_count;
+
+    Build(Vector<Rule> &rules_, uint32_t max_states_)
+	: a(new Automaton), max_states(max_states_), phase(p_classes), pos(0) {
+	rules.swap(rules_);
+	for (int i = 0; i < rules.size(); ++i) {
+	    a->texts.push_back(rules[i].text);
+	    a->outputs.push_back(rules[i].output);
+	}
+	a->counts.assign(rules.size(), 0);
+    }
+    ~Build() {
+	delete a;
+    }
+
+    // Returns 1 when the automaton is done, 0 if there is more to do, and
+    // -1 on error.
+    int step();
+
+  private:
+
+    void refine(const ByteSet &bs);
+    bool insert(int rule, const String &alt);
+    void link(uint32_t r);
+    void finish(uint32_t s);
+    uint32_t new_state();
+
+};
+
+void
+PayloadMatcher::Build::refine(const ByteSet &bs)
+{
+    int16_t remap[256][2];
+    memset(remap, -1, sizeof(remap));
+    int n = 0;
+    for (int c = 0; c < 256; ++c) {
+	int16_t &x = remap[a->byte_class[c]][bs.contains(c)];
+	if (x < 0)
+	    x = n++;
+	a->byte_class[c] = x;
+    }
+    a->nclasses = n;
+}
+
+uint32_t
+PayloadMatcher::Build::new_state()
+{
+    uint32_t s = a->nstates++;
+    if (a->nstates * a->nclasses > (uint32_t) a->delta.capacity())
+	a->delta.reserve(2 * a->nstates * a->nclasses);
+    a->delta.resize(a->nstates * a->nclasses, 0);
+    own_head.push_back(0);
+    return s;
+}
+
+bool
+PayloadMatcher::Build::insert(int rule, const String &alt)
+{
+    uint32_t nc = a->nclasses;
+    Vector<uint32_t> frontier, next;
+    frontier.push_back(0);
+    for (int i = 0; i < npositions(alt); ++i) {
+	const ByteSet &bs = position(alt, i);
+	bool seen[256];
+	memset(seen, 0, sizeof(seen));
+	next.clear();
+	for (int c = 0; c < 256; ++c) {
+	    int cls = a->byte_class[c];
+	    if (!bs.contains(c) || seen[cls])
+		continue;
+	    seen[cls] = true;
+	    for (uint32_t *fp = frontier.begin(); fp != frontier.end(); ++fp) {
+		uint32_t child = a->delta[*fp * nc + cls];
+		if (!child) {
+		    if (a->nstates >= max_states) {
+			error = "too many states";
+			return false;
+		    }
+		    child = new_state();
+		    a->delta[*fp * nc + cls] = child;
+		}
+		next.push_back(child);
+	    }
+	}
+	if (next.size() > max_expansions) {
+	    error = "rule " + String(rule) + " has too many alternatives";
+	    return false;
+	}
+	frontier.swap(next);
+    }
+    for (uint32_t *fp = frontier.begin(); fp != frontier.end(); ++fp) {
+	own_next.push_back(own_head[*fp]);
+	own_rule.push_back(rule);
+	own_head[*fp] = own_next.size() - 1;
+    }
+    return true;
+}
+
+// Compute the failure link and match list for each child of state r, and
+// fill in r's missing transitions from its failure state.  States are
+// linked in breadth-first order, so shallower states are always complete.
+void
+PayloadMatcher::Build::link(uint32_t r)
+{
+    uint32_t nc = a->nclasses;
+    uint32_t *row = &a->delta[r * nc];
+    const uint32_t *frow = &a->delta[fail[r] * nc];
+    for (uint32_t c = 0; c < nc; ++c)
+	if (uint32_t u = row[c]) {
+	    fail[u] = r ? frow[c] : 0;
+	    queue.push_back(u);
+
+	    // matches: own rules, then the failure state's
+	    a->match_begin[u] = a->matches.size();
+	    for (uint32_t x = own_head[u]; x; x = own_next[x])
+		a->matches.push_back(own_rule[x]);
+	    const uint32_t *fm = a->matches.begin() + a->match_begin[fail[u]];
+	    for (uint32_t i = 0; i < match_count[fail[u]]; ++i)
+		a->matches.push_back(fm[i]);
+	    uint32_t *mb = a->matches.begin() + a->match_begin[u];
+	    match_count[u] = a->matches.end() - mb;
+	    click_qsort(mb, match_count[u]);
+	} else if (r != 0)
+	    row[c] = frow[c];
+}
+
+void
+PayloadMatcher::Build::finish(uint32_t s)
+{
+    uint32_t nc = a->nclasses;
+    uint32_t *row = &a->delta[s * nc];
+    for (uint32_t c = 0; c < nc; ++c)
+	row[c] = row[c] * nc | (match_count[row[c]] ? (uint32_t) Automaton::match_bit : 0);
+}
+
+int
+PayloadMatcher::Build::step()
+{
+    int work = 0;
+    while (work < step_work && phase != p_done) {
+	switch (phase) {
+	case p_classes:
+	    // Split bytes into classes that no pattern distinguishes.
+	    if (pos == rules.size()) {
+		phase = p_trie;
+		pos = 0;
+		a->delta.assign(a->nclasses, 0);
+		own_head.assign(1, 0);
+		own_next.assign(1, 0);
+		own_rule.assign(1, 0);
+		break;
+	    }
+	    for (int j = 0; j < rules[pos].alternatives.size(); ++j) {
+		const String &alt = rules[pos].alternatives[j];
+		for (int i = 0; i < npositions(alt); ++i)
+		    refine(position(alt, i));
+		work += npositions(alt) * 32;
+	    }
+	    ++pos;
+	    break;
+
+	case p_trie:
+	    if (pos == rules.size()) {
+		if ((uint64_t) a->nstates * a->nclasses > Automaton::match_bit) {
+		    error = "too many states";
+		    return -1;
+		}
+		phase = p_links;
+		pos = 0;
+		fail.assign(a->nstates, 0);
+		match_count.assign(a->nstates, 0);
+		a->match_begin.assign(a->nstates, 0);
+		queue.clear();
+		queue.push_back(0);
+		break;
+	    }
+	    for (int j = 0; j < rules[pos].alternatives.size(); ++j) {
+		if (!insert(pos, rules[pos].alternatives[j]))
+		    return -1;
+		work += npositions(rules[pos].alternatives[j]) * 4;
+	    }
+	    ++pos;
+	    break;
+
+	case p_links:
+	    if (pos == queue.size()) {
+		phase = p_finish;
+		pos = 0;
+		break;
+	    }
+	    link(queue[pos]);
+	    ++pos;
+	    work += a->nclasses;
+	    break;
+
+	case p_finish:
+	    if (pos == (int) a->nstates) {
+		a->nstart = 0;
+		for (int c = 0; c < 256; ++c)
+		    if (a->delta[a->byte_class[c]] != 0) {
+			if (a->nstart == 4) {
+			    a->nstart = -1;
+			    break;
+			}
+			a->start[a->nstart++] = c;
+		    }
+		phase = p_done;
+		break;
+	    }
+	    finish(pos);
+	    ++pos;
+	    work += a->nclasses;
+	    break;
+	}
+    }
+    return phase == p_done;
+}
+
+
+// THE ELEMENT
+
+PayloadMatcher::PayloadMatcher()
+    : _automaton(0), _hazards(0), _nhazards(0), _build(0), _task(this),
+      _generation(0), _offset(0), _maxlen(0), _max_states(1 << 20),
+      _anno(-1), _payload(false)
+{
+}
+
+PayloadMatcher::~PayloadMatcher()
+{
+}
+
+int
+PayloadMatcher::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String filename;
+    uint32_t offset = 0, maxlen = 0, max_states = 1 << 20;
+    bool payload = false;
+    int anno = -1;
+    if (Args(this, errh).bind(conf)
+	.read("FILE", FilenameArg(), filename)
+	.read("OFFSET", offset)
+	.read("PAYLOAD", payload)
+	.read("MAXLEN", maxlen)
+	.read("ANNO", AnnoArg(4), anno)
+	.read("MAX_STATES", max_states)
+	.consume() < 0)
+	return -1;
+
+    Vector<Rule> rules;
+    for (int i = 0; i < conf.size(); ++i) {
+	ContextErrorHandler cerrh(errh, "rule %d:", rules.size());
+	rules.push_back(Rule());
+	if (parse_rule(conf[i], rules.back(), &cerrh) < 0)
+	    return -1;
+    }
+    if (filename) {
+#if CLICK_USERLEVEL
+	String text = file_string(filename, errh);
+	if (!text && errh->nerrors())
+	    return -1;
+	const char *s = text.begin(), *end = text.end();
+	for (int line = 1; s != end; ++line) {
+	    const char *nl = (const char *) memchr(s, '\n', end - s);
+	    String str = cp_uncomment(text.substring(s, nl ? nl : end));
+	    s = nl ? nl + 1 : end;
+	    if (!str || str[0] == '#')
+		continue;
+	    LandmarkErrorHandler lerrh(errh, filename + ":" + String(line));
+	    rules.push_back(Rule());
+	    if (parse_rule(str, rules.back(), &lerrh) < 0)
+		return -1;
+	}
+#else
+	return errh->error("FILE not supported");
+#endif
+    }
+    for (int i = 0; i < rules.size(); ++i)
+	if (rules[i].output < 0 || rules[i].output >= noutputs() - 1)
+	    return errh->error("rule %d: output %d out of range", i, rules[i].output);
+
+    _offset = offset;
+    _maxlen = maxlen;
+    _max_states = max_states;
+    _payload = payload;
+    _anno = anno;
+    _rules.swap(rules);
+    return 0;
+}
+
+int
+PayloadMatcher::initialize(ErrorHandler *errh)
+{
+    _nhazards = click_max_cpu_ids();
+    _hazards = new Hazard[_nhazards];
+    for (unsigned i = 0; i < _nhazards; ++i)
+	_hazards[i].a = 0;
+    _task.initialize(this, false);
+
+    Build b(_rules, _max_states);
+    int r;
+    while ((r = b.step()) == 0)
+	/* nada */;
+    if (r < 0)
+	return errh->error("%s", b.error.c_str());
+    install(b.a);
+    b.a = 0;
+    return 0;
+}
+
+int
+PayloadMatcher::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (configure(conf, errh) < 0)
+	return -1;
+    delete _build;
+    _build = new Build(_rules, _max_states);
+    _error = String();
+    _task.reschedule();
+    return 0;
+}
+
+void
+PayloadMatcher::cleanup(CleanupStage)
+{
+    delete _build;
+    _build = 0;
+    delete _automaton;
+    _automaton = 0;
+    for (Automaton **ap = _retired.begin(); ap != _retired.end(); ++ap)
+	delete *ap;
+    _retired.clear();
+    delete[] _hazards;
+    _hazards = 0;
+}
+
+void
+PayloadMatcher::install(Automaton *a)
+{
+    if (_automaton)
+	_retired.push_back(_automaton);
+    click_write_fence();
+    _automaton = a;
+    ++_generation;
+}
+
+// Delete retired automata that no thread is using.  Returns true if none
+// remain.
+bool
+PayloadMatcher::reclaim()
+{
+    click_fence();
+    for (int i = 0; i < _retired.size(); ) {
+	bool busy = false;
+	for (unsigned j = 0; j < _nhazards && !busy; ++j)
+	    busy = (_hazards[j].a == _retired[i]);
+	if (busy)
+	    ++i;
+	else {
+	    delete _retired[i];
+	    _retired[i] = _retired.back();
+	    _retired.pop_back();
+	}
+    }
+    return _retired.empty();
+}
+
+bool
+PayloadMatcher::run_task(Task *)
+{
+    bool work = false;
+    if (_build) {
+	int r = _build->step();
+	if (r > 0) {
+	    install(_build->a);
+	    _build->a = 0;
+	} else if (r < 0) {
+	    _error = _build->error;
+	    click_chatter("%{element}: %s, keeping old rules", this, _error.c_str());
+	}
+	if (r != 0) {
+	    delete _build;
+	    _build = 0;
+	}
+	work = true;
+    }
+    if (!reclaim() || _build)
+	_task.fast_reschedule();
+    return work;
+}
+
+inline PayloadMatcher::Automaton *
+PayloadMatcher::acquire()
+{
+#if HAVE_MULTITHREAD
+    // Publish the automaton we're about to use, then make sure it wasn't
+    // retired in the meantime.
+    Hazard &h = _hazards[click_current_cpu_id()];
+    Automaton *a;
+    do {
+	a = _automaton;
+	h.a = a;
+	click_fence();
+    } while (a != _automaton);
+    return a;
+#else
+    return _automaton;
+#endif
+}
+
+inline void
+PayloadMatcher::release()
+{
+#if HAVE_MULTITHREAD
+    click_fence();
+    _hazards[click_current_cpu_id()].a = 0;
+#endif
+}
+
+uint32_t
+PayloadMatcher::match(const Automaton *a, const unsigned char *s,
+		      const unsigned char *end) const
+{
+    const uint32_t *delta = a->delta.begin();
+    const uint8_t *byte_class = a->byte_class;
+    uint32_t state = 0;
+    uint32_t best = (uint32_t) -1;
+    while (s != end) {
+	if (state == 0 && a->nstart >= 0
+	    && (s = a->skip(s, end)) == end)
+	    break;
+	uint32_t e = delta[state + byte_class[*s]];
+	++s;
+	state = e & ~(uint32_t) Automaton::match_bit;
+	if (e & Automaton::match_bit) {
+	    uint32_t r = a->matches[a->match_begin[state / a->nclasses]];
+	    if (r < best && (best = r) == 0)
+		break;
+	}
+    }
+    return best;
+}
+
+void
+PayloadMatcher::push(int, Packet *p)
+{
+    const unsigned char *s = p->data(), *end = p->end_data();
+    if (_payload && p->has_network_header()) {
+	const click_ip *iph = p->ip_header();
+	s = p->transport_header();
+	if (IP_FIRSTFRAG(iph)) {
+	    if (iph->ip_p == IP_PROTO_TCP && s + sizeof(click_tcp) <= end)
+		s += reinterpret_cast<const click_tcp *>(s)->th_off << 2;
+	    else if (iph->ip_p == IP_PROTO_UDP)
+		s += sizeof(click_udp);
+	}
+    }
+    s += _offset;
+    if (_maxlen && end - s > (ptrdiff_t) _maxlen)
+	end = s + _maxlen;
+
+    int port = noutputs() - 1;
+    if (s < end) {
+	Automaton *a = acquire();
+	uint32_t r = match(a, s, end);
+	if (r != (uint32_t) -1) {
+	    port = a->outputs[r];
+	    atomic_uint32_t::inc(a->counts[r]);
+	    if (_anno >= 0)
+		p->set_anno_u32(_anno, r);
+	}
+	release();
+    }
+    output(port).push(p);
+}
+
+String
+PayloadMatcher::read_handler(Element *e, void *user_data)
+{
+    PayloadMatcher *pm = static_cast<PayloadMatcher *>(e);
+    Automaton *a = pm->_automaton;
+    StringAccum sa;
+    switch ((intptr_t) user_data) {
+    case h_rules:
+	for (int i = 0; i < a->texts.size(); ++i)
+	    sa << a->texts[i] << '\n';
+	break;
+    case h_building:
+	sa << (pm->_build != 0);
+	break;
+    case h_error:
+	sa << pm->_error;
+	break;
+    case h_generation:
+	sa << pm->_generation;
+	break;
+    case h_nrules:
+	sa << a->texts.size();
+	break;
+    case h_states:
+	sa << a->nstates;
+	break;
+    case h_classes:
+	sa << a->nclasses;
+	break;
+    case h_counts:
+	for (int i = 0; i < a->counts.size(); ++i)
+	    if (a->counts[i])
+		sa << i << ' ' << a->counts[i] << '\n';
+	break;
+    }
+    return sa.take_string();
+}
+
+int
+PayloadMatcher::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    PayloadMatcher *pm = static_cast<PayloadMatcher *>(e);
+    Vector<Rule> rules;
+    const char *s = str.begin(), *end = str.end();
+    while (s != end) {
+	const char *nl = (const char *) memchr(s, '\n', end - s);
+	String line = cp_uncomment(str.substring(s, nl ? nl : end));
+	s = nl ? nl + 1 : end;
+	if (!line || line[0] == '#')
+	    continue;
+	ContextErrorHandler cerrh(errh, "rule %d:", rules.size());
+	rules.push_back(Rule());
+	if (parse_rule(line, rules.back(), &cerrh) < 0)
+	    return -1;
+	if (rules.back().output < 0 || rules.back().output >= pm->noutputs() - 1)
+	    return cerrh.error("output %d out of range", rules.back().output);
+    }
+    delete pm->_build;
+    pm->_build = new Build(rules, pm->_max_states);
+    pm->_error = String();
+    pm->_task.reschedule();
+    return 0;
+}
+
+void
+PayloadMatcher::add_handlers()
+{
+    add_read_handler("rules", read_handler, h_rules);
+    add_write_handler("rules", write_handler, h_rules);
+    add_read_handler("building", read_handler, h_building);
+    add_read_handler("error", read_handler, h_error);
+    add_read_handler("generation", read_handler, h_generation);
+    add_read_handler("nrules", read_handler, h_nrules);
+    add_read_handler("states", read_handler, h_states);
+    add_read_handler("classes", read_handler, h_classes);
+    add_read_handler("counts", read_handler, h_counts);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(PayloadMatcher)
@@ -0,0 +1,208 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PAYLOADMATCHER_HH
+#define CLICK_PAYLOADMATCHER_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+PayloadMatcher(RULE, ..., [I<keywords> FILE, OFFSET, PAYLOAD, MAXLEN, ANNO, MAX_STATES])
+
+=s classification
+
+classifies packets by strings found anywhere in their payloads
+
+=d
+
+Searches each packet's data for a set of patterns, and emits the packet on
+the output of the first matching rule: the lowest-numbered rule whose
+pattern appears anywhere in the scanned data.  Packets that match no rule
+are emitted on the last output.  Unlike Classifier, patterns need not be at
+fixed offsets, so PayloadMatcher can find HTTP Host headers, signatures, and
+the like.
+
+All the patterns are compiled into a single deterministic Aho-Corasick
+automaton, so each packet is scanned once, in time proportional to its
+length, however many rules there are.  Bytes that no pattern distinguishes
+share a transition column, which keeps the automaton compact.  When few
+bytes can start a match, the scan skips ahead to the next such byte, using
+SSE2 where available.
+
+Each RULE is a PATTERN followed by an optional OUTPUT port number, which
+defaults to 0.  Rules are numbered from 0 in the order given, arguments
+first, then FILE.  OUTPUT must be less than the number of the last output.
+
+A PATTERN is either a double-quoted string, which matches literally and
+may contain the usual backslash escapes such as "\r\n" and "\xFF", or a
+simple regular expression between slashes, such as C</Host: [a-z]+\.com/i>.
+Regular expressions support literal characters, backslash escapes
+(including C<\d>, C<\w>, C<\s>, and C<\xHH>), C<.> for any byte, bracket
+classes such as C<[^0-9a-f]>, the C<?> and C<{M}> and C<{M,N}> bounded
+repetitions, and top-level C<|> alternation.  Unbounded repetition (C<*> and
+C<+>) is not supported.  A trailing C<i> flag makes the pattern
+case-insensitive.  A pattern may expand to at most 4096 alternatives.
+Since commas separate configuration arguments, rules whose patterns contain
+commas, such as C</a{2,3}/>, should be given in FILE or through the
+C<rules> handler.
+
+Keyword arguments are:
+
+=over 8
+
+=item FILE
+
+Filename.  Read more rules from FILE, one per line.  Blank lines and lines
+starting with C<#> are ignored.  User-level only.
+
+=item OFFSET
+
+Unsigned integer.  Start scanning OFFSET bytes into the packet.  Default
+is 0.
+
+=item PAYLOAD
+
+Boolean.  If true, start scanning at the transport payload of IP packets:
+after the TCP header for TCP, after the UDP header for UDP, and after the IP
+header otherwise.  Requires the IP header annotation.  OFFSET is relative
+to the payload.  Default is false.
+
+=item MAXLEN
+
+Unsigned integer.  Scan at most MAXLEN bytes.  0 means no limit, the
+default.
+
+=item ANNO
+
+Annotation name.  If set, store the number of the first matching rule in
+this 4-byte annotation.
+
+=item MAX_STATES
+
+Unsigned integer.  Refuse rule sets whose automaton has more than
+MAX_STATES states.  Default is 1048576.
+
+=back
+
+=h rules read/write
+
+Returns the current rules, one per line.  Writing replaces the rules.  The
+new rules are parsed immediately, and syntax errors are reported to the
+writer; the new automaton is then built by a background task, in small
+steps, while packets continue to be matched against the old one.  It is
+swapped in as soon as it is complete.  Writing again during a build
+abandons that build.
+
+=h building read-only
+
+Returns true while a new automaton is being built.
+
+=h error read-only
+
+Returns the error from the last failed build, or an empty string.
+
+=h generation read-only
+
+Returns the number of automata that have been installed.
+
+=h nrules read-only
+
+Returns the number of rules.
+
+=h states read-only
+
+Returns the number of automaton states.
+
+=h classes read-only
+
+Returns the number of byte classes.
+
+=h counts read-only
+
+Returns one line per rule that has matched: the rule number and the number
+of packets it classified.  Counts restart when a new automaton is
+installed.
+
+=e
+
+  FromDevice(eth0)
+    -> Strip(14) -> CheckIPHeader
+    -> pm :: PayloadMatcher("Host: evil.example" 0,
+                            /User-Agent: curl|User-Agent: wget/i 0,
+                            /\x90\x90\x90\x90/ 1)
+    -> Discard;
+  pm[1] -> Print(shellcode) -> Discard;
+  pm[2] -> ToDevice(eth1);
+
+=a
+
+Classifier, IPClassifier */
+
+class PayloadMatcher : public Element { public:
+
+    PayloadMatcher() CLICK_COLD;
+    ~PayloadMatcher() CLICK_COLD;
+
+    const char *class_name() const	{ return "PayloadMatcher"; }
+    const char *port_count() const	{ return "1/2-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    bool can_live_reconfigure() const	{ return true; }
+    int live_reconfigure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    bool run_task(Task *);
+
+    struct Rule {
+	String text;
+	int output;
+	Vector<String> alternatives;	// each one byte set per position
+    };
+
+  private:
+
+    struct Automaton;
+    struct Build;
+    struct Hazard {
+	Automaton * volatile a;
+	char padding[CLICK_CACHE_LINE_SIZE - sizeof(Automaton *)];
+    };
+
+    Automaton * volatile _automaton;
+    Hazard *_hazards;
+    unsigned _nhazards;
+    Vector<Automaton *> _retired;
+    Build *_build;
+    Task _task;
+    uint32_t _generation;
+    String _error;
+
+    Vector<Rule> _rules;		// from configure, until initialize
+    uint32_t _offset;
+    uint32_t _maxlen;
+    uint32_t _max_states;
+    int _anno;
+    bool _payload;
+
+    void install(Automaton *a);
+    bool reclaim();
+
+    inline Automaton *acquire();
+    inline void release();
+    uint32_t match(const Automaton *a, const unsigned char *s, const unsigned char *end) const;
+
+    enum { h_rules, h_building, h_error, h_generation, h_nrules, h_states,
+	   h_classes, h_counts };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -103,6 +103,8 @@ class SimpleQueue : public Element, public Storage { public:
     volatile int _drops;
     int _highwater_length;
 
+    inline void prefetch_next(Storage::index_type nh, Storage::index_type t) const;
+
     friend class MixedQueue;
     friend class TokenQueue;
     friend class InOrderQueue;
@@ -114,6 +116,21 @@ class SimpleQueue : public Element, public Storage { public:
 };
 
 
+/* Warm the cache for the packets that will be dequeued next: data for the
+   packet at nh, metadata for the one after.  Dequeuing a packet already
+   prefetched its metadata, so the data prefetch does not stall.  Only slots
+   in [nh, t) hold packets. */
+inline void
+SimpleQueue::prefetch_next(Storage::index_type nh, Storage::index_type t) const
+{
+    if (nh != t) {
+	_q[nh]->prefetch_data();
+	Storage::index_type nnh = next_i(nh);
+	if (nnh != t)
+	    _q[nnh]->prefetch();
+    }
+}
+
 inline bool
 SimpleQueue::enq(Packet *p)
 {
@@ -155,8 +172,10 @@ SimpleQueue::deq()
     Storage::index_type h = head(), t = tail();
     if (h != t) {
 	Packet *p = _q[h];
-	set_head(next_i(h));
+	Storage::index_type nh = next_i(h);
+	set_head(nh);
 	assert(p);
+	prefetch_next(nh, t);
 	return p;
     } else
 	return 0;
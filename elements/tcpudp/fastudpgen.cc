@@ -0,0 +1,543 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * fastudpgen.{cc,hh} -- many-flow UDP traffic generator with precise pacing
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fastudpgen.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/etheraddress.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <click/router.hh>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+FastUDPGen::FastUDPGen()
+    : _data(0), _tsc(false), _hz(1000000000), _khz(1000000),
+      _task(this), _timer(&_task)
+{
+}
+
+int
+FastUDPGen::parse_range(const String &str, Range &r, bool ip, ErrorHandler *errh)
+{
+    const char *dash = find(str, '-');
+    String lows = str.substring(str.begin(), dash);
+    String highs = (dash == str.end() ? lows : str.substring(dash + 1, str.end()));
+    uint32_t low, high;
+    if (ip) {
+	IPAddress a, b;
+	if (!IPAddressArg().parse(lows, a) || !IPAddressArg().parse(highs, b))
+	    return errh->error("expected IP address or range");
+	low = ntohl(a.addr());
+	high = ntohl(b.addr());
+    } else if (!IntArg().parse(lows, low) || !IntArg().parse(highs, high)
+	       || high > 0xFFFF)
+	return errh->error("expected port or range");
+    if (high < low)
+	return errh->error("empty range");
+    r.low = low;
+    r.n = high - low + 1;
+    if (r.n == 0)		// the whole IPv4 address space
+	return errh->error("range too large");
+    r.cur = 0;
+    return 0;
+}
+
+int
+FastUDPGen::parse_lengths(const String &str, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(str, words);
+    _lengths.clear();
+    _weights.clear();
+    for (String *it = words.begin(); it != words.end(); ++it) {
+	const char *colon = find(*it, ':');
+	uint32_t len, weight = 1;
+	if (!IntArg().parse(it->substring(it->begin(), colon), len)
+	    || (colon != it->end()
+		&& !IntArg().parse(it->substring(colon + 1, it->end()), weight)))
+	    return errh->error("LENGTH syntax error at %<%s%>", it->c_str());
+	if (len < sizeof(click_ether) + sizeof(click_ip) + sizeof(click_udp)
+	    || len > 0xFFFF)
+	    return errh->error("LENGTH %u out of range", len);
+	if (weight == 0 || weight > 0xFFFF)
+	    return errh->error("LENGTH weight %u out of range", weight);
+	_lengths.push_back(len);
+	_weights.push_back(weight);
+    }
+    if (!_lengths.size())
+	return errh->error("LENGTH is empty");
+    return 0;
+}
+
+int
+FastUDPGen::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String src = "0.0.0.0", dst = "0.0.0.0", sport = "1234", dport = "1234";
+    String length = "60";
+    bool imix = false;
+    uint32_t rate = 0;
+    memset(&_ethh, 0, sizeof(_ethh));
+    _ntemplates = 1024;
+    _seed = 1;
+    _random = false;
+    _burst = 32;
+    _limit = -1;
+    _stop = false;
+    _active = true;
+    _checksum = true;
+    _timestamp = false;
+    if (Args(conf, this, errh)
+	.read("SRCETH", EtherAddressArg(), _ethh.ether_shost)
+	.read("DSTETH", EtherAddressArg(), _ethh.ether_dhost)
+	.read("SRCIP", AnyArg(), src)
+	.read("DSTIP", AnyArg(), dst)
+	.read("SPORT", AnyArg(), sport)
+	.read("DPORT", AnyArg(), dport)
+	.read("LENGTH", AnyArg(), length)
+	.read("IMIX", imix)
+	.read("TEMPLATES", _ntemplates)
+	.read("RANDOM", _random)
+	.read("SEED", _seed)
+	.read("RATE", rate)
+	.read("BURST", _burst)
+	.read("LIMIT", _limit)
+	.read("STOP", _stop)
+	.read("ACTIVE", _active)
+	.read("CHECKSUM", _checksum)
+	.read("TIMESTAMP", _timestamp)
+	.complete() < 0)
+	return -1;
+    if (imix)
+	length = "60:7 590:4 1514:1";
+    if (parse_range(src, _src, true, errh) < 0
+	|| parse_range(dst, _dst, true, errh) < 0
+	|| parse_range(sport, _sport, false, errh) < 0
+	|| parse_range(dport, _dport, false, errh) < 0
+	|| parse_lengths(length, errh) < 0)
+	return -1;
+    if (_ntemplates == 0 || _ntemplates > 0x100000)
+	return errh->error("TEMPLATES out of range");
+    uint32_t max_length = 0;
+    for (int j = 0; j < _lengths.size(); ++j)
+	max_length = (_lengths[j] > max_length ? _lengths[j] : max_length);
+    if ((uint64_t) _ntemplates * ((max_length + 7) & ~7) > MAX_TEMPLATE_BYTES)
+	return errh->error("TEMPLATES %u too large for LENGTH %u", _ntemplates, max_length);
+    if (_burst == 0)
+	return errh->error("BURST must be positive");
+    _ethh.ether_type = htons(ETHERTYPE_IP);
+    _rate = rate;
+    return 0;
+}
+
+inline uint32_t
+FastUDPGen::next_random()
+{
+    uint32_t x = _random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return _random_state = x;
+}
+
+/* Builds the template ring.  Template i gets the length at position
+ * i * total weight / TEMPLATES of the cumulative weight distribution, so
+ * the ring matches the distribution as closely as TEMPLATES allows; the
+ * ring is then shuffled so that sizes interleave.  Flow fields are left
+ * zero, and the stored checksums are complemented, ready for incremental
+ * updates. */
+int
+FastUDPGen::build_templates(ErrorHandler *errh)
+{
+    uint32_t total = 0;
+    for (int j = 0; j < _weights.size(); ++j)
+	total += _weights[j];
+
+    _templates.resize(_ntemplates);
+    size_t offset = 0;
+    for (uint32_t i = 0; i < _ntemplates; ++i) {
+	uint32_t target = int_divide((uint64_t) i * total, _ntemplates);
+	int j = 0;
+	for (uint32_t cum = _weights[0]; cum <= target; cum += _weights[++j])
+	    /* nada */;
+	_templates[i].length = _lengths[j];
+    }
+    for (uint32_t i = _ntemplates - 1; i > 0; --i) {
+	uint32_t j = next_random() % (i + 1);
+	click_swap(_templates[i].length, _templates[j].length);
+    }
+    for (uint32_t i = 0; i < _ntemplates; ++i) {
+	_templates[i].offset = offset;
+	offset += (_templates[i].length + 7) & ~7;
+    }
+
+    if (!(_data = new unsigned char[offset]))
+	return errh->error("out of memory");
+    memset(_data, 0, offset);
+    for (uint32_t i = 0; i < _ntemplates; ++i) {
+	Template &t = _templates[i];
+	unsigned char *d = _data + t.offset;
+	memcpy(d, &_ethh, sizeof(_ethh));
+	click_ip *ip = reinterpret_cast<click_ip *>(d + sizeof(click_ether));
+	click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
+	uint32_t ulen = t.length - sizeof(click_ether) - sizeof(click_ip);
+
+	ip->ip_v = 4;
+	ip->ip_hl = sizeof(click_ip) >> 2;
+	ip->ip_len = htons(t.length - sizeof(click_ether));
+	ip->ip_ttl = 64;
+	ip->ip_p = IP_PROTO_UDP;
+	t.ip_sum = ~click_in_cksum((unsigned char *) ip, sizeof(click_ip));
+
+	udp->uh_ulen = htons(ulen);
+	unsigned csum = click_in_cksum((unsigned char *) udp, ulen);
+	t.udp_sum = ~click_in_cksum_pseudohdr(csum, ip, ulen);
+    }
+    return 0;
+}
+
+/* Returns the current time in ticks. */
+inline uint64_t
+FastUDPGen::ticks() const
+{
+    if (_tsc)
+	return click_get_cycles();
+    else
+	return Timestamp::now_steady().nsecval();
+}
+
+uint64_t
+FastUDPGen::ticks_to_nsec(uint64_t t) const
+{
+    if (!_tsc)
+	return t;
+    uint64_t q = int_divide(t, _khz);
+    return q * 1000000 + int_divide((t - q * _khz) * 1000000, _khz);
+}
+
+/* Measures the cycle counter's rate against the steady clock.  The cycle
+ * counter is assumed to run at a constant rate, as on modern x86 CPUs. */
+void
+FastUDPGen::calibrate()
+{
+    _tsc = false;
+    _hz = 1000000000;
+    _khz = 1000000;
+#if TIMESTAMP_WARPABLE
+    if (Timestamp::warp_class() != Timestamp::warp_none)
+	return;
+#endif
+    click_cycles_t c0 = click_get_cycles(), c1;
+    if (!c0 || sizeof(click_cycles_t) < 8)
+	return;
+    Timestamp t0 = Timestamp::now_steady(), t1;
+    do {
+	t1 = Timestamp::now_steady();
+	c1 = click_get_cycles();
+    } while (t1 - t0 < Timestamp::make_msec(10));
+    uint64_t nsec = (t1 - t0).nsecval();
+    _hz = ((uint64_t) (c1 - c0) * 1000000000) / nsec;
+    _khz = _hz / 1000;
+    _tsc = (_khz != 0);
+}
+
+void
+FastUDPGen::set_rate(uint32_t rate)
+{
+    _rate = rate;
+    if (rate) {
+	_gap = int_divide(_hz, rate);
+	_gap_frac = int_divide((_hz - _gap * rate) << 16, rate);
+    } else
+	_gap = _gap_frac = 0;
+}
+
+void
+FastUDPGen::reset()
+{
+    _count = 0;
+    _first = _last = 0;
+    _last_lateness = 0;
+    _jitter = 0;
+    _next = ticks();
+    _next_frac = 0;
+}
+
+int
+FastUDPGen::initialize(ErrorHandler *errh)
+{
+    _random_state = _seed ? _seed : 1;
+    if (build_templates(errh) < 0)
+	return -1;
+    _tpos = 0;
+    calibrate();
+    set_rate(_rate);
+    reset();
+    _task.initialize(this, _active);
+    _timer.initialize(this);
+    _nonfull_signal = Notifier::downstream_full_signal(this, 0, &_task);
+    return 0;
+}
+
+void
+FastUDPGen::cleanup(CleanupStage)
+{
+    delete[] _data;
+    _data = 0;
+}
+
+inline void
+FastUDPGen::next_flow()
+{
+    if (_random) {
+	_src.cur = next_random() % _src.n;
+	_dst.cur = next_random() % _dst.n;
+	_sport.cur = next_random() % _sport.n;
+	_dport.cur = next_random() % _dport.n;
+    } else if (++_src.cur == _src.n) {
+	_src.cur = 0;
+	if (++_dst.cur == _dst.n) {
+	    _dst.cur = 0;
+	    if (++_sport.cur == _sport.n) {
+		_sport.cur = 0;
+		if (++_dport.cur == _dport.n)
+		    _dport.cur = 0;
+	    }
+	}
+    }
+}
+
+/* Copies the next template and patches in the flow fields and IP ID.
+ * The checksums are one's-complement sums over 16-bit words, so summing
+ * the new fields as they lie in memory, into the template's complemented
+ * checksum, gives the complemented new checksum whatever the host byte
+ * order (RFC 1624). */
+inline Packet *
+FastUDPGen::make_packet()
+{
+    const Template &t = _templates[_tpos];
+    if (++_tpos == _ntemplates)
+	_tpos = 0;
+    WritablePacket *q = Packet::make(_data + t.offset, t.length);
+    if (!q)
+	return 0;
+    click_ip *ip = reinterpret_cast<click_ip *>(q->data() + sizeof(click_ether));
+    click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
+
+    uint32_t src = htonl(_src.low + _src.cur);
+    uint32_t dst = htonl(_dst.low + _dst.cur);
+    uint16_t id = htons((uint16_t) _count);
+    ip->ip_src.s_addr = src;
+    ip->ip_dst.s_addr = dst;
+    ip->ip_id = id;
+    uint32_t addrs = (src & 0xFFFF) + (src >> 16) + (dst & 0xFFFF) + (dst >> 16);
+    uint32_t sum = t.ip_sum + addrs + id;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    ip->ip_sum = ~(sum + (sum >> 16));
+
+    uint16_t sport = htons(_sport.low + _sport.cur);
+    uint16_t dport = htons(_dport.low + _dport.cur);
+    udp->uh_sport = sport;
+    udp->uh_dport = dport;
+    if (_checksum) {
+	sum = t.udp_sum + addrs + sport + dport;
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = ~(sum + (sum >> 16)) & 0xFFFF;
+	udp->uh_sum = (sum ? sum : 0xFFFF);
+    }
+
+    q->set_ip_header(ip, sizeof(click_ip));
+    q->set_dst_ip_anno(IPAddress(dst));
+    if (_timestamp)
+	q->timestamp_anno().assign_now();
+    next_flow();
+    return q;
+}
+
+/* Arranges for the task to run at the next deadline: by busy-waiting if
+ * it is close, or by a timer otherwise. */
+void
+FastUDPGen::schedule_wait(uint64_t now)
+{
+    Timestamp wait = Timestamp::make_nsec(ticks_to_nsec(_next - now));
+    Timestamp adj = Timer::adjustment();
+    if (wait > adj)
+	_timer.schedule_at_steady(Timestamp::now_steady() + wait - adj);
+    else
+	_task.fast_reschedule();
+}
+
+bool
+FastUDPGen::run_task(Task *)
+{
+    if (!_active || !_nonfull_signal)
+	return false;
+    if (_limit >= 0 && _count >= (uint64_t) _limit) {
+	if (_stop)
+	    router()->please_stop_driver();
+	return false;
+    }
+
+    uint32_t n = _burst;
+    if (_limit >= 0 && _count + n > (uint64_t) _limit)
+	n = _limit - _count;
+
+    uint32_t sent = 0;
+    uint64_t now = ticks();
+    if (_rate) {
+	if (now < _next) {
+	    schedule_wait(now);
+	    return false;
+	}
+	// skip ahead rather than catch up with a long burst
+	uint64_t max_lag = _burst * _gap;
+	if (now - _next > max_lag) {
+	    _next = now - max_lag;
+	    _next_frac = 0;
+	}
+	while (sent < n) {
+	    if (sent)
+		now = ticks();
+	    if (now < _next)
+		break;
+	    // RFC 3550 jitter of departure times against deadlines
+	    int64_t lateness = now - _next;
+	    int64_t d = lateness - _last_lateness;
+	    if (d < 0)
+		d = -d;
+	    if (_count + sent)
+		_jitter += d - ((_jitter + 8) >> 4);
+	    _last_lateness = lateness;
+	    _next_frac += _gap_frac;
+	    _next += _gap + (_next_frac >> 16);
+	    _next_frac &= 0xFFFF;
+
+	    if (Packet *p = make_packet()) {
+		if (!_count && !sent)
+		    _first = now;
+		++sent;
+		++_count;
+		output(0).push(p);
+	    } else
+		break;
+	}
+    } else {
+	for (; sent < n; ++sent) {
+	    Packet *p = make_packet();
+	    if (!p)
+		break;
+	    ++_count;
+	    output(0).push(p);
+	}
+	if (sent && _count == sent)
+	    _first = now;
+	now = ticks();
+    }
+    if (sent)
+	_last = now;
+
+    if (_limit >= 0 && _count >= (uint64_t) _limit)
+	_task.fast_reschedule();	// stop the driver next time if asked
+    else if (_rate && sent < n)
+	schedule_wait(now);
+    else
+	_task.fast_reschedule();
+    return sent > 0;
+}
+
+void
+FastUDPGen::run_timer(Timer *)
+{
+    _task.reschedule();
+}
+
+String
+FastUDPGen::read_handler(Element *e, void *user_data)
+{
+    FastUDPGen *g = static_cast<FastUDPGen *>(e);
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_count:
+	return String(g->_count);
+    case h_rate:
+	return String(g->_rate);
+    case h_achieved_rate: {
+	uint64_t nsec = g->ticks_to_nsec(g->_last - g->_first);
+	if (g->_count < 2 || nsec == 0)
+	    return String(0);
+	return String(((g->_count - 1) * 1000000000 + nsec / 2) / nsec);
+    }
+    case h_jitter:
+	return String((g->ticks_to_nsec(g->_jitter) + 8) >> 4);
+    case h_active:
+	return BoolArg::unparse(g->_active);
+    case h_limit:
+	return String(g->_limit);
+    default:
+	return String();
+    }
+}
+
+int
+FastUDPGen::write_handler(const String &s, Element *e, void *user_data, ErrorHandler *errh)
+{
+    FastUDPGen *g = static_cast<FastUDPGen *>(e);
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_rate: {
+	uint32_t rate;
+	if (!IntArg().parse(s, rate))
+	    return errh->error("syntax error");
+	g->set_rate(rate);
+	g->_next = g->ticks();
+	g->_next_frac = 0;
+	break;
+    }
+    case h_active:
+	if (!BoolArg().parse(s, g->_active))
+	    return errh->error("syntax error");
+	break;
+    case h_limit:
+	if (!IntArg().parse(s, g->_limit))
+	    return errh->error("syntax error");
+	break;
+    case h_reset:
+	g->reset();
+	break;
+    }
+    if (g->_active)
+	g->_task.reschedule();
+    return 0;
+}
+
+void
+FastUDPGen::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("rate", read_handler, h_rate);
+    add_write_handler("rate", write_handler, h_rate);
+    add_read_handler("achieved_rate", read_handler, h_achieved_rate);
+    add_read_handler("jitter", read_handler, h_jitter);
+    add_read_handler("active", read_handler, h_active, Handler::f_checkbox);
+    add_write_handler("active", write_handler, h_active);
+    add_read_handler("limit", read_handler, h_limit);
+    add_write_handler("limit", write_handler, h_limit);
+    add_write_handler("reset", write_handler, h_reset, Handler::f_button);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(FastUDPGen)
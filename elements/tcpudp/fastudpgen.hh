@@ -0,0 +1,261 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FASTUDPGEN_HH
+#define CLICK_FASTUDPGEN_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+#include <click/notifier.hh>
+#include <click/ipaddress.hh>
+#include <clicknet/ether.h>
+CLICK_DECLS
+
+/*
+=c
+
+FastUDPGen([I<keywords> SRCIP, DSTIP, SPORT, DPORT, LENGTH, IMIX, RATE, ...])
+
+=s udp
+
+generates many-flow UDP traffic at a precise rate
+
+=d
+
+FastUDPGen is a benchmark tool that pushes UDP/IP/Ethernet packets from many
+flows, with a mix of packet sizes, at a precisely paced rate.
+
+At initialization, FastUDPGen builds a ring of TEMPLATES packet templates
+whose lengths follow the LENGTH distribution, shuffled.  Each template's IP
+and UDP checksums are computed once.  The Nth packet sent is a copy of
+template N modulo TEMPLATES, with the flow's addresses and ports and an IP ID
+patched in; the checksums are updated incrementally rather than recomputed.
+
+The flows are all combinations of the SRCIP, DSTIP, SPORT, and DPORT ranges.
+FastUDPGen cycles through the flows in order, or picks one at random for each
+packet if RANDOM is true.
+
+Packets are paced against deadlines kept in CPU cycle counts (the TSC), which
+FastUDPGen calibrates against the system clock at initialization.  Each time
+its task runs, FastUDPGen sends up to BURST packets whose deadlines have
+passed.  If the next deadline is close, the task busy-waits; otherwise a timer
+reschedules it just before the deadline.  If FastUDPGen falls more than BURST
+packets behind, it skips ahead rather than sending a long catch-up burst.
+When the cycle counter is unavailable, or time is warped (as with
+C<click --simtime>), the system clock is used instead.
+
+Keyword arguments are:
+
+=over 8
+
+=item SRCETH, DSTETH
+
+Ethernet addresses.  Default is 00:00:00:00:00:00.
+
+=item SRCIP, DSTIP
+
+IP address, or range of IP addresses "LOW-HIGH".  Default is 0.0.0.0.
+
+=item SPORT, DPORT
+
+Port number, or range of port numbers "LOW-HIGH".  Default is 1234.
+
+=item LENGTH
+
+Space-separated list of "LEN[:WEIGHT]" entries.  Each LEN is a frame length
+including the Ethernet header, at least 42; each WEIGHT is a positive integer,
+and defaults to 1.  The templates' lengths follow these proportions.  Default
+is 60.
+
+=item IMIX
+
+Boolean.  If true, use the simple IMIX distribution: 7 parts 60-byte frames,
+4 parts 590-byte frames, and 1 part 1514-byte frames (64, 594, and 1518 bytes
+on the wire).  Overrides LENGTH.  Default is false.
+
+=item TEMPLATES
+
+Unsigned integer.  Number of packet templates.  Their total size, at up to
+the largest LENGTH each, may not exceed 256MB.  Default is 1024.
+
+=item RANDOM
+
+Boolean.  If true, choose a random flow for each packet.  Default is false.
+
+=item SEED
+
+Unsigned integer.  Seed for shuffling templates and for RANDOM.  Default is 1.
+
+=item RATE
+
+Unsigned integer.  Packets per second.  Zero means send as fast as possible.
+Default is 0.
+
+=item BURST
+
+Unsigned integer.  Maximum number of packets per task run.  Default is 32.
+
+=item LIMIT
+
+Integer.  Stop after sending LIMIT packets; negative means never stop.
+Default is -1.
+
+=item STOP
+
+Boolean.  If true, stop the driver after sending LIMIT packets.  Default is
+false.
+
+=item ACTIVE
+
+Boolean.  If false, send nothing.  Default is true.
+
+=item CHECKSUM
+
+Boolean.  If true, set UDP checksums.  Default is true.
+
+=item TIMESTAMP
+
+Boolean.  If true, set each packet's timestamp annotation.  Default is false.
+
+=back
+
+FastUDPGen respects downstream full notifiers.
+
+=h count read-only
+
+Number of packets sent.
+
+=h rate read/write
+
+The RATE parameter.
+
+=h achieved_rate read-only
+
+Packets per second actually sent, measured from the first to the most recent
+packet since the last reset.
+
+=h jitter read-only
+
+Inter-departure jitter, in nanoseconds: a running average, as in RFC 3550, of
+the difference between each packet's actual and scheduled gap from the
+previous packet.  Only meaningful when RATE is set.
+
+=h active read/write
+
+The ACTIVE parameter.
+
+=h limit read/write
+
+The LIMIT parameter.
+
+=h reset write-only
+
+Reset the packet count and statistics, and restart.
+
+=e
+
+Send 1 Mpps of simple IMIX traffic from 65536 flows:
+
+  FastUDPGen(SRCIP 10.0.0.0-10.0.0.255, DSTIP 10.1.0.1,
+	     SPORT 1000-1255, DPORT 53, IMIX true, RATE 1000000)
+     -> ToDevice(eth0);
+
+=a
+
+FastUDPFlows, FastUDPSource, RatedSource, InfiniteSource */
+
+class FastUDPGen : public Element { public:
+
+    FastUDPGen() CLICK_COLD;
+
+    const char *class_name() const	{ return "FastUDPGen"; }
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    bool run_task(Task *);
+    void run_timer(Timer *);
+
+  private:
+
+    enum { MAX_TEMPLATE_BYTES = 1 << 28 };
+
+    struct Template {
+	size_t offset;		// into _data
+	uint32_t length;
+	uint16_t ip_sum;	// complemented checksums with zero flow
+	uint16_t udp_sum;	// fields
+    };
+
+    struct Range {
+	uint32_t low;		// host byte order
+	uint32_t n;
+	uint32_t cur;
+    };
+
+    Vector<Template> _templates;
+    unsigned char *_data;
+    click_ether _ethh;
+    Range _src;
+    Range _dst;
+    Range _sport;
+    Range _dport;
+    Vector<uint32_t> _lengths;
+    Vector<uint32_t> _weights;
+    uint32_t _ntemplates;
+    uint32_t _tpos;
+    uint32_t _seed;
+    uint32_t _random_state;
+    bool _random;
+    bool _checksum;
+    bool _timestamp;
+    bool _active;
+    bool _stop;
+
+    // Pacing.  Deadlines are in ticks: CPU cycles if _tsc, otherwise
+    // nanoseconds of steady time.
+    bool _tsc;
+    uint64_t _hz;
+    uint32_t _khz;
+    uint32_t _rate;
+    uint64_t _gap;		// ticks per packet
+    uint32_t _gap_frac;		// and 16 fractional bits
+    uint64_t _next;		// next deadline
+    uint32_t _next_frac;
+    uint32_t _burst;
+
+    uint64_t _count;
+    int64_t _limit;
+    uint64_t _first;
+    uint64_t _last;
+    int64_t _last_lateness;
+    uint64_t _jitter;		// ticks, 4 fractional bits
+
+    Task _task;
+    Timer _timer;
+    NotifierSignal _nonfull_signal;
+
+    static int parse_range(const String &, Range &, bool ip, ErrorHandler *);
+    int parse_lengths(const String &, ErrorHandler *);
+    inline uint64_t ticks() const;
+    uint64_t ticks_to_nsec(uint64_t t) const;
+    void calibrate();
+    void set_rate(uint32_t rate);
+    void reset();
+    int build_templates(ErrorHandler *);
+    inline uint32_t next_random();
+    inline void next_flow();
+    inline Packet *make_packet();
+    void schedule_wait(uint64_t now);
+
+    enum { h_count, h_rate, h_achieved_rate, h_jitter, h_active, h_limit,
+	   h_reset };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
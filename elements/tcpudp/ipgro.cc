@@ -0,0 +1,332 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipgro.{cc,hh} -- coalesce TCP and UDP segments into super-packets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipgro.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/packet_anno.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+IPGRO::IPGRO()
+    : _flows(0), _nflows(0), _task(this), _timer(this),
+      _count(0), _super_packets(0), _merged(0)
+{
+}
+
+IPGRO::~IPGRO()
+{
+}
+
+int
+IPGRO::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _max_size = 65535;
+    _max_flows = 8;
+    _timeout = Timestamp();
+    _tcp = _udp = true;
+    if (Args(conf, this, errh)
+	.read("MAX_SIZE", _max_size)
+	.read("MAX_FLOWS", _max_flows)
+	.read("TIMEOUT", _timeout)
+	.read("TCP", _tcp)
+	.read("UDP", _udp)
+	.complete() < 0)
+	return -1;
+    if (_max_size > 65535)
+	return errh->error("MAX_SIZE too large");
+    if (_max_flows == 0)
+	return errh->error("MAX_FLOWS must be positive");
+    return 0;
+}
+
+int
+IPGRO::initialize(ErrorHandler *errh)
+{
+    if (!(_flows = new Flow[_max_flows]))
+	return errh->error("out of memory");
+    ScheduleInfo::initialize_task(this, &_task, false, errh);
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+IPGRO::cleanup(CleanupStage)
+{
+    for (uint32_t i = 0; i < _nflows; ++i)
+	_flows[i].p->kill();
+    _nflows = 0;
+    delete[] _flows;
+    _flows = 0;
+}
+
+// Returns the transport payload length of p if it could be merged with other
+// segments, or -1 if it can't.
+static int
+segment_length(const Packet *p, bool tcp, bool udp)
+{
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_v != 4 || iph->ip_hl != 5 || IP_ISFRAG(iph)
+	|| p->network_header() < p->data()
+	|| GSO_SIZE_ANNO(p))
+	return -1;
+    int ip_len = ntohs(iph->ip_len);
+    if (ip_len > p->end_data() - p->network_header())
+	return -1;
+    if (iph->ip_p == IP_PROTO_TCP && tcp) {
+	if (ip_len < (int) (sizeof(click_ip) + sizeof(click_tcp)))
+	    return -1;
+	const click_tcp *th = p->tcp_header();
+	int hlen = sizeof(click_ip) + (th->th_off << 2);
+	if (th->th_off < 5 || ip_len <= hlen
+	    || (th->th_flags & (TH_SYN | TH_RST | TH_URG))
+	    || !(th->th_flags & TH_ACK))
+	    return -1;
+	return ip_len - hlen;
+    } else if (iph->ip_p == IP_PROTO_UDP && udp) {
+	const click_udp *uh = p->udp_header();
+	int hlen = sizeof(click_ip) + sizeof(click_udp);
+	if (ip_len <= hlen || ntohs(uh->uh_ulen) != ip_len - sizeof(click_ip))
+	    return -1;
+	return ip_len - hlen;
+    } else
+	return -1;
+}
+
+int
+IPGRO::find_flow(const Packet *p) const
+{
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_v != 4 || IP_ISFRAG(iph)
+	|| (iph->ip_p != IP_PROTO_TCP && iph->ip_p != IP_PROTO_UDP)
+	|| p->transport_length() < 4)
+	return -1;
+    uint32_t ports = *reinterpret_cast<const uint32_t *>(p->transport_header());
+    for (uint32_t i = 0; i < _nflows; ++i) {
+	const Flow &f = _flows[i];
+	if (f.ports == ports && f.saddr == iph->ip_src.s_addr
+	    && f.daddr == iph->ip_dst.s_addr && f.proto == iph->ip_p)
+	    return i;
+    }
+    return -1;
+}
+
+bool
+IPGRO::append(uint32_t i, Packet *p)
+{
+    Flow &f = _flows[i];
+    Packet *h = f.p;
+    const click_ip *iph = p->ip_header();
+    const click_ip *hiph = h->ip_header();
+    if (iph->ip_tos != hiph->ip_tos || iph->ip_ttl != hiph->ip_ttl)
+	return false;
+
+    int hlen, plen;
+    uint8_t flags = 0;
+    if (f.proto == IP_PROTO_TCP) {
+	const click_tcp *th = p->tcp_header();
+	const click_tcp *hth = h->tcp_header();
+	hlen = th->th_off << 2;
+	// The data offset, flags other than PSH and FIN, window and options
+	// must all match the first segment.
+	if (ntohl(th->th_seq) != f.next_seq
+	    || th->th_ack != hth->th_ack
+	    || th->th_off != hth->th_off
+	    || ((th->th_flags ^ hth->th_flags) & ~(TH_PUSH | TH_FIN))
+	    || (th->th_flags & TH_CWR)
+	    || th->th_win != hth->th_win
+	    || memcmp(th + 1, hth + 1, hlen - sizeof(click_tcp)) != 0)
+	    return false;
+	flags = th->th_flags & (TH_PUSH | TH_FIN);
+    } else
+	hlen = sizeof(click_udp);
+    plen = ntohs(iph->ip_len) - sizeof(click_ip) - hlen;
+    int h_len = ntohs(hiph->ip_len);
+    if (plen > f.mss || h_len + plen > (int) _max_size)
+	return false;
+
+    // The first merge copies the held packet into a buffer large enough for
+    // MAX_SIZE, dropping any link-level padding.  A shared packet is copied
+    // too: uniqueify() would free it on failure, but it must stay held.
+    WritablePacket *q;
+    int ip_end = h->network_header_offset() + h_len;
+    if (!h->shared() && h->length() == (uint32_t) ip_end
+	&& h->tailroom() >= (uint32_t) plen)
+	q = h->uniqueify();
+    else if ((q = Packet::make(h->headroom(), h->data(), ip_end, _max_size - h_len))) {
+	q->copy_annotations(h);
+	if (h->has_mac_header() && h->mac_header() >= h->data())
+	    q->set_mac_header(q->data() + h->mac_header_offset());
+	q->set_network_header(q->data() + h->network_header_offset(), sizeof(click_ip));
+	h->kill();
+    }
+    if (!q)
+	return false;
+    q = q->put(plen);
+    memcpy(q->end_data() - plen, p->transport_header() + hlen, plen);
+    q->ip_header()->ip_len = htons(h_len + plen);
+    if (flags)
+	q->tcp_header()->th_flags |= flags;
+    SET_EXTRA_PACKETS_ANNO(q, EXTRA_PACKETS_ANNO(q) + 1 + EXTRA_PACKETS_ANNO(p));
+    f.p = q;
+    f.next_seq += plen;
+    ++f.nsegs;
+    ++_merged;
+    p->kill();
+
+    if (flags || plen < f.mss || h_len + plen + f.mss > (int) _max_size)
+	flush(i);
+    return true;
+}
+
+void
+IPGRO::hold(Packet *p)
+{
+    const click_ip *iph = p->ip_header();
+    int plen = ntohs(iph->ip_len) - sizeof(click_ip);
+    uint32_t seq = 0;
+    if (iph->ip_p == IP_PROTO_TCP) {
+	const click_tcp *th = p->tcp_header();
+	if (th->th_flags & (TH_PUSH | TH_FIN)) {
+	    output(0).push(p);
+	    return;
+	}
+	plen -= th->th_off << 2;
+	seq = ntohl(th->th_seq);
+    } else
+	plen -= sizeof(click_udp);
+    if (_nflows == _max_flows)
+	flush(0);
+    Flow &f = _flows[_nflows++];
+    f.p = p;
+    f.saddr = iph->ip_src.s_addr;
+    f.daddr = iph->ip_dst.s_addr;
+    f.ports = *reinterpret_cast<const uint32_t *>(p->transport_header());
+    f.proto = iph->ip_p;
+    f.mss = plen;
+    f.next_seq = seq + plen;
+    f.nsegs = 1;
+    schedule_flush();
+}
+
+void
+IPGRO::flush(uint32_t i)
+{
+    Flow f = _flows[i];
+    --_nflows;
+    memmove(&_flows[i], &_flows[i + 1], (_nflows - i) * sizeof(Flow));
+
+    if (f.nsegs > 1) {
+	WritablePacket *q = static_cast<WritablePacket *>(f.p);
+	click_ip *iph = q->ip_header();
+	iph->ip_sum = 0;
+	iph->ip_sum = click_in_cksum((const unsigned char *) iph, sizeof(click_ip));
+	int tlen = ntohs(iph->ip_len) - sizeof(click_ip);
+	if (f.proto == IP_PROTO_TCP) {
+	    click_tcp *th = q->tcp_header();
+	    th->th_sum = 0;
+	    unsigned csum = click_in_cksum((const unsigned char *) th, tlen);
+	    th->th_sum = click_in_cksum_pseudohdr(csum, iph, tlen);
+	} else {
+	    click_udp *uh = q->udp_header();
+	    uh->uh_ulen = htons(tlen);
+	    if (uh->uh_sum) {
+		uh->uh_sum = 0;
+		unsigned csum = click_in_cksum((const unsigned char *) uh, tlen);
+		csum = click_in_cksum_pseudohdr(csum, iph, tlen);
+		uh->uh_sum = csum ? csum : 0xFFFF;
+	    }
+	}
+	SET_GSO_SIZE_ANNO(q, f.mss);
+	++_super_packets;
+    }
+    output(0).push(f.p);
+}
+
+void
+IPGRO::flush_all()
+{
+    while (_nflows)
+	flush(0);
+}
+
+void
+IPGRO::schedule_flush()
+{
+    if (!_timeout)
+	_task.reschedule();
+    else if (!_timer.scheduled())
+	_timer.schedule_after(_timeout);
+}
+
+void
+IPGRO::push(int, Packet *p)
+{
+    ++_count;
+    if (!p->has_network_header()) {
+	output(0).push(p);
+	return;
+    }
+    int len = segment_length(p, _tcp, _udp);
+    int i = find_flow(p);
+    if (i >= 0) {
+	if (len > 0 && append(i, p))
+	    return;
+	flush(i);
+    }
+    if (len > 0)
+	hold(p);
+    else
+	output(0).push(p);
+}
+
+bool
+IPGRO::run_task(Task *)
+{
+    if (!_nflows)
+	return false;
+    flush_all();
+    return true;
+}
+
+void
+IPGRO::run_timer(Timer *)
+{
+    flush_all();
+}
+
+int
+IPGRO::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<IPGRO *>(e)->flush_all();
+    return 0;
+}
+
+void
+IPGRO::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_data_handlers("super_packets", Handler::OP_READ, &_super_packets);
+    add_data_handlers("merged", Handler::OP_READ, &_merged);
+    add_write_handler("flush", write_handler, 0);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPGRO)
@@ -0,0 +1,179 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPGRO_HH
+#define CLICK_IPGRO_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IPGRO([I<keywords> MAX_SIZE, MAX_FLOWS, TIMEOUT, TCP, UDP])
+
+=s tcp
+
+coalesces TCP and UDP segments into super-packets
+
+=d
+
+IPGRO performs generic receive offload in software.  It expects IPv4 packets
+with their IP header annotations set (by CheckIPHeader, for example), and
+merges runs of consecutive segments of the same TCP or UDP flow into one
+large super-packet.  Elements downstream then do their per-packet work,
+such as a lookup, a rewrite, or a count, once for the whole run.  IPGSO cuts
+super-packets back into segments.
+
+A TCP segment extends the super-packet held for its flow if it starts at the
+sequence number where the held data ends, carries at most as much payload as
+the held packet's first segment, and matches the first segment's
+acknowledgement number, window, TCP options, IP TOS and TTL.  Its payload is
+appended to the held packet.  A UDP datagram extends the held packet for its
+flow under the same size, TOS and TTL rules; its payload is appended as
+another segment.  Any data before the network header, such as an Ethernet
+header, is kept from the first segment.
+
+A held packet is emitted when a segment of its flow cannot extend it, when a
+segment shorter than the first arrives (it is appended first), when a TCP
+segment with PSH or FIN arrives (its flags are merged into the held header),
+or when another segment would make it longer than MAX_SIZE.  If more than
+MAX_FLOWS flows are held, the oldest is emitted.  Finally, all held packets
+are emitted when IPGRO's task next runs: that is, once the element pushing
+packets into IPGRO (a FromDevice, for example) finishes its current burst.
+If TIMEOUT is set, held packets instead wait up to TIMEOUT for more
+segments.
+
+An emitted super-packet has correct IP and TCP or UDP lengths and checksums,
+and the sequence number and IP ID of its first segment.  Its GSO_SIZE
+annotation is set to the payload length of its first segment, and its
+EXTRA_PACKETS annotation counts the segments merged into it, so Counter-like
+elements that honor that annotation still see the original packet count.
+Packets that hold a single segment leave IPGRO unchanged.
+
+Non-IPv4 packets, fragments, packets with IP options, other protocols, pure
+TCP acknowledgements, SYN, RST and URG segments, and packets whose GSO_SIZE
+annotation is already set are never merged; they are emitted at once, after
+any held packet of the same flow.  IPGRO does not verify checksums; place
+CheckTCPHeader or CheckUDPHeader before it if needed.
+
+IPGRO is not MT-safe: its input and its task should run on the same thread.
+
+Keyword arguments are:
+
+=over 8
+
+=item MAX_SIZE
+
+Unsigned integer.  Maximum IP length of a super-packet, up to 65535.  Default
+is 65535.
+
+=item MAX_FLOWS
+
+Unsigned integer.  Maximum number of flows with held packets.  Default is 8.
+
+=item TIMEOUT
+
+Time.  If nonzero, hold packets for up to this long.  Default is 0, which
+emits held packets at the end of each burst.
+
+=item TCP
+
+Boolean.  Merge TCP segments.  Default is true.
+
+=item UDP
+
+Boolean.  Merge UDP datagrams.  Default is true.
+
+=back
+
+=h count read-only
+
+Returns the number of packets received.
+
+=h super_packets read-only
+
+Returns the number of super-packets emitted that merged more than one
+segment.
+
+=h merged read-only
+
+Returns the number of segments that were merged into an earlier one.
+
+=h flush write-only
+
+Emits all held packets.
+
+=e
+
+  FromDevice(eth0, BURST 32)
+    -> Strip(14) -> CheckIPHeader
+    -> IPGRO
+    -> rw :: IPRewriter(...)
+    -> IPGSO
+    -> ...
+
+=a
+
+IPGSO, TCPFragmenter, KernelTun */
+
+class IPGRO : public Element { public:
+
+    IPGRO() CLICK_COLD;
+    ~IPGRO() CLICK_COLD;
+
+    const char *class_name() const	{ return "IPGRO"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    bool run_task(Task *);
+    void run_timer(Timer *);
+
+  private:
+
+    // A flow with a held packet.  mss is the payload length of its first
+    // segment; next_seq is where its TCP data ends.
+    struct Flow {
+	Packet *p;
+	uint32_t saddr;
+	uint32_t daddr;
+	uint32_t ports;
+	uint8_t proto;
+	uint16_t mss;
+	uint32_t next_seq;
+	uint32_t nsegs;
+    };
+
+    Flow *_flows;
+    uint32_t _nflows;
+    uint32_t _max_flows;
+    uint32_t _max_size;
+    Timestamp _timeout;
+    bool _tcp;
+    bool _udp;
+
+    Task _task;
+    Timer _timer;
+
+    click_uint_large_t _count;
+    click_uint_large_t _super_packets;
+    click_uint_large_t _merged;
+
+    int find_flow(const Packet *) const;
+    bool append(uint32_t, Packet *);
+    void hold(Packet *);
+    void flush(uint32_t);
+    void flush_all();
+    void schedule_flush();
+
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
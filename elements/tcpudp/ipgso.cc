@@ -0,0 +1,146 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipgso.{cc,hh} -- cut TCP and UDP super-packets into segments
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipgso.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+IPGSO::IPGSO()
+    : _mtu(0)
+{
+    _count = 0;
+    _segmented = 0;
+    _segments = 0;
+}
+
+IPGSO::~IPGSO()
+{
+}
+
+int
+IPGSO::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh).read_p("MTU", _mtu).complete();
+}
+
+// Returns the segment size for p, or 0 if it should pass unchanged.  Sets hl
+// and thl to its IP and transport header lengths and plen to its payload
+// length.
+int
+IPGSO::segment_size(const Packet *p, int &hl, int &thl, int &plen) const
+{
+    int mss = GSO_SIZE_ANNO(p);
+    if (!p->has_network_header() || p->network_header() < p->data()
+	|| (!mss && !_mtu))
+	return 0;
+    const click_ip *iph = p->ip_header();
+    int ip_len = ntohs(iph->ip_len);
+    hl = iph->ip_hl << 2;
+    if (iph->ip_v != 4 || IP_ISFRAG(iph)
+	|| ip_len > p->end_data() - p->network_header())
+	return 0;
+    if (iph->ip_p == IP_PROTO_TCP && ip_len >= hl + (int) sizeof(click_tcp)) {
+	thl = p->tcp_header()->th_off << 2;
+	if (_mtu && (ip_len > _mtu || mss > _mtu - hl - thl))
+	    mss = _mtu - hl - thl;
+    } else if (iph->ip_p == IP_PROTO_UDP && mss
+	       && ip_len >= hl + (int) sizeof(click_udp))
+	thl = sizeof(click_udp);
+    else
+	return 0;
+    plen = ip_len - hl - thl;
+    return mss > 0 && plen > mss ? mss : 0;
+}
+
+void
+IPGSO::push(int, Packet *p)
+{
+    _count++;
+    int hl, thl, plen;
+    int mss = segment_size(p, hl, thl, plen);
+    if (!mss) {
+	SET_GSO_SIZE_ANNO(p, 0);
+	output(0).push(p);
+	return;
+    }
+
+    // Each segment copies the headers, from the packet data through the
+    // transport header, then its share of the payload.
+    _segmented++;
+    int hdr = p->network_header_offset() + hl + thl;
+    uint16_t ip_id = ntohs(p->ip_header()->ip_id);
+    for (int off = 0; off < plen; off += mss, ++ip_id) {
+	int n = plen - off < mss ? plen - off : mss;
+	WritablePacket *q = Packet::make(p->headroom(), p->data(), hdr + n, 0);
+	if (!q)
+	    break;
+	memcpy(q->data() + hdr, p->data() + hdr + off, n);
+	q->copy_annotations(p);
+	SET_GSO_SIZE_ANNO(q, 0);
+	SET_EXTRA_PACKETS_ANNO(q, 0);
+	if (p->has_mac_header() && p->mac_header() >= p->data())
+	    q->set_mac_header(q->data() + p->mac_header_offset());
+	q->set_network_header(q->data() + p->network_header_offset(), hl);
+
+	click_ip *qip = q->ip_header();
+	qip->ip_len = htons(hl + thl + n);
+	qip->ip_id = htons(ip_id);
+	qip->ip_sum = 0;
+	qip->ip_sum = click_in_cksum((const unsigned char *) qip, hl);
+	int tlen = thl + n;
+	if (qip->ip_p == IP_PROTO_TCP) {
+	    click_tcp *th = q->tcp_header();
+	    th->th_seq = htonl(ntohl(th->th_seq) + off);
+	    if (off)
+		th->th_flags &= ~TH_CWR;
+	    if (off + n < plen)
+		th->th_flags &= ~(TH_PUSH | TH_FIN);
+	    th->th_sum = 0;
+	    unsigned csum = click_in_cksum((const unsigned char *) th, tlen);
+	    th->th_sum = click_in_cksum_pseudohdr(csum, qip, tlen);
+	} else {
+	    click_udp *uh = q->udp_header();
+	    uh->uh_ulen = htons(tlen);
+	    if (uh->uh_sum) {
+		uh->uh_sum = 0;
+		unsigned csum = click_in_cksum((const unsigned char *) uh, tlen);
+		csum = click_in_cksum_pseudohdr(csum, qip, tlen);
+		uh->uh_sum = csum ? csum : 0xFFFF;
+	    }
+	}
+	_segments++;
+	output(0).push(q);
+    }
+    p->kill();
+}
+
+void
+IPGSO::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_data_handlers("segmented", Handler::OP_READ, &_segmented);
+    add_data_handlers("segments", Handler::OP_READ, &_segments);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPGSO)
+ELEMENT_MT_SAFE(IPGSO)
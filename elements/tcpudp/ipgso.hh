@@ -0,0 +1,83 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPGSO_HH
+#define CLICK_IPGSO_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IPGSO([MTU])
+
+=s tcp
+
+cuts TCP and UDP super-packets into segments
+
+=d
+
+IPGSO performs generic segmentation offload in software.  It expects IPv4
+packets with their IP header annotations set, and cuts each TCP or UDP
+packet whose GSO_SIZE annotation is nonzero into segments carrying at most
+GSO_SIZE bytes of transport payload.  Super-packets come from IPGRO, or from
+KernelTun and Socket when the kernel hands them over.
+
+Every segment is a copy of the super-packet's headers, including any data
+before the network header, with the IP length, IP ID, and checksums fixed.
+TCP segments get successive sequence numbers; only the first keeps CWR, and
+only the last keeps PSH and FIN.  UDP segments each get their own UDP length
+and checksum; a zero UDP checksum stays zero.  IP IDs increase by one per
+segment.  Segments have their GSO_SIZE and EXTRA_PACKETS annotations cleared
+and copy all other annotations from the super-packet.
+
+If MTU is nonzero, IPGSO also cuts TCP packets whose IP length exceeds MTU,
+as TCPFragmenter does, and uses a smaller segment size if GSO_SIZE would
+produce segments longer than MTU.  UDP packets are only cut by GSO_SIZE,
+since that changes their datagram boundaries.
+
+Other packets, and packets with at most one segment's worth of payload, pass
+through with their GSO_SIZE annotation cleared.
+
+=h count read-only
+
+Returns the number of packets received.
+
+=h segmented read-only
+
+Returns the number of packets that were cut into segments.
+
+=h segments read-only
+
+Returns the number of segments emitted.
+
+=a
+
+IPGRO, TCPFragmenter, IPFragmenter */
+
+class IPGSO : public Element { public:
+
+    IPGSO() CLICK_COLD;
+    ~IPGSO() CLICK_COLD;
+
+    const char *class_name() const	{ return "IPGSO"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+
+  private:
+
+    uint16_t _mtu;
+
+    atomic_uint32_t _count;
+    atomic_uint32_t _segmented;
+    atomic_uint32_t _segments;
+
+    int segment_size(const Packet *, int &, int &, int &) const;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -165,26 +165,20 @@ IPRewriter::push(int port, Packet *p_in)
     output(m->output()).push(p);
 }
 
-String
-IPRewriter::udp_mappings_handler(Element *e, void *)
+int
+IPRewriter::udp_mappings_handler(Element *e, void *, StringAccum &sa, uint64_t &cursor)
 {
     IPRewriter *rw = (IPRewriter *)e;
-    click_jiffies_t now = click_jiffies();
-    StringAccum sa;
-    for (Map::iterator iter = rw->_udp_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
-    return sa.take_string();
+    return unparse_mappings_chunk<UDPFlow>(rw->_udp_map, sa, cursor);
 }
 
 void
 IPRewriter::add_handlers()
 {
-    add_read_handler("tcp_table", tcp_mappings_handler);
-    add_read_handler("udp_table", udp_mappings_handler);
-    add_read_handler("tcp_mappings", tcp_mappings_handler, 0, Handler::h_deprecated);
-    add_read_handler("udp_mappings", udp_mappings_handler, 0, Handler::h_deprecated);
+    add_read_stream_handler("tcp_table", tcp_mappings_handler);
+    add_read_stream_handler("udp_table", udp_mappings_handler);
+    add_read_stream_handler("tcp_mappings", tcp_mappings_handler, 0, Handler::h_deprecated);
+    add_read_stream_handler("udp_mappings", udp_mappings_handler, 0, Handler::h_deprecated);
     set_handler("tcp_lookup", Handler::OP_READ | Handler::READ_PARAM, tcp_lookup_handler, 0);
     add_rewriter_handlers(true);
 }
@@ -269,7 +269,7 @@ class IPRewriter : public TCPRewriter { public:
 	IPRewriter *x = static_cast<IPRewriter *>(rwinput->reply_element);
 	return x->_udp_map;
     }
-    static String udp_mappings_handler(Element *e, void *user_data);
+    static int udp_mappings_handler(Element *, void *, StringAccum &, uint64_t &);
 
 };
 
@@ -0,0 +1,676 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tcpreassembler.{cc,hh} -- reassembles TCP byte streams
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tcpreassembler.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+TCPReassembler::TCPReassembler()
+    : _states(0), _nstates(0)
+{
+}
+
+TCPReassembler::~TCPReassembler()
+{
+}
+
+int
+TCPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _capacity = 1 << 20;
+    _memory = 64 << 20;
+    _timeout = 120;
+    _chunk = 0;
+    if (Args(conf, this, errh)
+	.read("CAPACITY", _capacity)
+	.read("MEMORY", _memory)
+	.read("TIMEOUT", SecondsArg(), _timeout)
+	.read("CHUNK", _chunk)
+	.complete() < 0)
+	return -1;
+    if (_capacity == 0)
+	return errh->error("CAPACITY must be positive");
+    if (_timeout > 0x7FFFFFFF)
+	_timeout = 0x7FFFFFFF;
+    return 0;
+}
+
+int
+TCPReassembler::initialize(ErrorHandler *errh)
+{
+    _nstates = click_max_cpu_ids();
+    if (!(_states = new State[_nstates]))
+	return errh->error("out of memory");
+    memset(_states, 0, sizeof(State) * _nstates);
+    int nthreads = master()->nthreads();
+    if (nthreads <= 0)
+	nthreads = 1;
+    _thread_capacity = _capacity / nthreads ? _capacity / nthreads : 1;
+    _thread_memory = _memory / nthreads;
+    _hash_seed = click_random();
+    return 0;
+}
+
+void
+TCPReassembler::cleanup(CleanupStage)
+{
+    for (unsigned i = 0; i < _nstates; i++) {
+	State &st = _states[i];
+	for (uint32_t si = st.lru_head; si; si = st.streams[si].lru_next)
+	    while (Packet *q = st.streams[si].queue) {
+		st.streams[si].queue = q->next();
+		q->kill();
+	    }
+	delete[] st.slots;
+	delete[] st.streams;
+    }
+    delete[] _states;
+    _states = 0;
+}
+
+
+// TABLES AND LISTS
+
+/* Returns the slot holding the given stream, or the empty slot where it
+ * belongs. */
+uint32_t
+TCPReassembler::find_slot(State &st, uint32_t saddr, uint32_t daddr,
+			  uint32_t ports, uint32_t hash)
+{
+    uint32_t i = hash & st.mask;
+    while (uint32_t si = st.slots[i]) {
+	const Stream &s = st.streams[si];
+	if (s.hash == hash && s.saddr == saddr && s.daddr == daddr
+	    && (s.sport | ((uint32_t) s.dport << 16)) == ports)
+	    break;
+	i = (i + 1) & st.mask;
+    }
+    return i;
+}
+
+bool
+TCPReassembler::grow_table(State &st)
+{
+    uint32_t nslots = st.slots ? (st.mask + 1) * 2 : (uint32_t) INITIAL_STREAMS * 2;
+    uint32_t *slots = new uint32_t[nslots];
+    if (!slots)
+	return false;
+    memset(slots, 0, sizeof(uint32_t) * nslots);
+    for (uint32_t b = 0; st.slots && b <= st.mask; b++)
+	if (uint32_t si = st.slots[b]) {
+	    uint32_t i = st.streams[si].hash & (nslots - 1);
+	    while (slots[i])
+		i = (i + 1) & (nslots - 1);
+	    slots[i] = si;
+	}
+    delete[] st.slots;
+    st.slots = slots;
+    st.mask = nslots - 1;
+    return true;
+}
+
+bool
+TCPReassembler::grow_streams(State &st)
+{
+    uint32_t n = st.nstreams ? st.nstreams * 2 : (uint32_t) INITIAL_STREAMS;
+    if (n > _thread_capacity + 1)
+	n = _thread_capacity + 1;
+    if (n <= st.nstreams)
+	return false;
+    Stream *streams = new Stream[n];
+    if (!streams)
+	return false;
+    if (st.nstreams)
+	memcpy(streams, st.streams, sizeof(Stream) * st.nstreams);
+    // chain the new streams onto the free list; index 0 is never used
+    for (uint32_t si = n - 1; si >= st.nstreams && si > 0; --si) {
+	streams[si].lru_next = st.free;
+	st.free = si;
+    }
+    delete[] st.streams;
+    st.streams = streams;
+    st.nstreams = n;
+    return true;
+}
+
+inline void
+TCPReassembler::list_append(Stream *streams, uint32_t &head, uint32_t &tail,
+			    uint32_t si, uint32_t Stream::*prev,
+			    uint32_t Stream::*next)
+{
+    streams[si].*prev = tail;
+    streams[si].*next = 0;
+    if (tail)
+	streams[tail].*next = si;
+    else
+	head = si;
+    tail = si;
+}
+
+inline void
+TCPReassembler::list_unlink(Stream *streams, uint32_t &head, uint32_t &tail,
+			    uint32_t si, uint32_t Stream::*prev,
+			    uint32_t Stream::*next)
+{
+    uint32_t p = streams[si].*prev, n = streams[si].*next;
+    if (p)
+	streams[p].*next = n;
+    else
+	head = n;
+    if (n)
+	streams[n].*prev = p;
+    else
+	tail = p;
+}
+
+uint32_t
+TCPReassembler::new_stream(State &st, const click_ip *iph,
+			   const click_tcp *tcph, uint32_t hash, Emit &e)
+{
+    if (st.count >= _thread_capacity) {
+	++st.stat_evicted;
+	evict(st, st.lru_head, e);
+    }
+    if (!st.free && !grow_streams(st))
+	return 0;
+    if ((st.count + 1) * 2 > st.mask + 1 && !grow_table(st))
+	return 0;
+
+    uint32_t ports = tcph->th_sport | ((uint32_t) tcph->th_dport << 16);
+    uint32_t slot = find_slot(st, iph->ip_src.s_addr, iph->ip_dst.s_addr, ports, hash);
+    uint32_t si = st.free;
+    Stream &s = st.streams[si];
+    st.free = s.lru_next;
+    s.saddr = iph->ip_src.s_addr;
+    s.daddr = iph->ip_dst.s_addr;
+    s.sport = tcph->th_sport;
+    s.dport = tcph->th_dport;
+    s.hash = hash;
+    s.queue = 0;
+    s.queue_mem = 0;
+    s.state = s_open;
+    st.slots[slot] = si;
+    ++st.count;
+    list_append(st.streams, st.lru_head, st.lru_tail, si,
+		&Stream::lru_prev, &Stream::lru_next);
+    return si;
+}
+
+/* Forgets stream si, whose queue must be empty.  Later members of its probe
+ * sequence are shifted back so that lookups never need tombstones. */
+void
+TCPReassembler::remove_stream(State &st, uint32_t si)
+{
+    Stream &s = st.streams[si];
+    uint32_t i = find_slot(st, s.saddr, s.daddr, s.sport | ((uint32_t) s.dport << 16), s.hash);
+    assert(st.slots[i] == si && !s.queue);
+    uint32_t j = i;
+    while (1) {
+	j = (j + 1) & st.mask;
+	if (!st.slots[j])
+	    break;
+	uint32_t home = st.streams[st.slots[j]].hash & st.mask;
+	// move j to i unless its home lies cyclically in (i, j]
+	if ((j > i && (home <= i || home > j))
+	    || (j < i && home <= i && home > j)) {
+	    st.slots[i] = st.slots[j];
+	    i = j;
+	}
+    }
+    st.slots[i] = 0;
+    --st.count;
+
+    list_unlink(st.streams, st.lru_head, st.lru_tail, si,
+		&Stream::lru_prev, &Stream::lru_next);
+    s.state = 0;
+    s.lru_next = st.free;
+    st.free = si;
+}
+
+
+// SEGMENTS
+
+/* Finds p's TCP segment: the sequence number of its first data byte, its
+ * data length, and its flags.  Returns false if p is not a usable TCP
+ * segment. */
+inline bool
+TCPReassembler::segment(Packet *p, tcp_seq_t &seq, uint32_t &len, int &flags)
+{
+    seq = len = flags = 0;
+    if (!p->has_network_header())
+	return false;
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_p != IP_PROTO_TCP || !IP_FIRSTFRAG(iph)
+	|| (iph->ip_off & htons(IP_MF)))
+	return false;
+    if (p->transport_header() + sizeof(click_tcp) > p->end_data())
+	return false;
+    const click_tcp *tcph = p->tcp_header();
+    const unsigned char *data = p->transport_header() + (tcph->th_off << 2);
+    const unsigned char *end = p->network_header() + ntohs(iph->ip_len);
+    if (end > p->end_data())
+	end = p->end_data();
+    if (data > end)
+	return false;
+    flags = tcph->th_flags;
+    seq = ntohl(tcph->th_seq) + (flags & TH_SYN ? 1 : 0);
+    len = end - data;
+    return true;
+}
+
+/* Emits the part of p beyond s.next_seq, or sends p to output 1 if it
+ * contains nothing new.  Requires seq <= s.next_seq. */
+void
+TCPReassembler::deliver(State &st, Stream &s, Packet *p, tcp_seq_t seq,
+			uint32_t len, int flags, Emit &e)
+{
+    uint32_t skip = s.next_seq - seq;
+    bool fin = (flags & TH_FIN) && s.state == s_open;
+    if (skip > len || (skip == len && !fin)) {
+	if (len)
+	    ++st.stat_retransmits;
+	e.append(p, 1);
+	return;
+    }
+    if (skip)
+	++st.stat_overlaps;
+
+    // zero-copy trim to the new data; the headers stay in the headroom
+    const unsigned char *data = p->transport_header() + (p->tcp_header()->th_off << 2);
+    p->pull(data + skip - p->data());
+    p->take(p->length() - (len - skip));
+    st.stat_bytes += len - skip;
+    s.next_seq = seq + len;
+    if (fin) {
+	++s.next_seq;
+	s.state = s_closed;
+	++st.stat_closed;
+    }
+    e.append(p, 0);
+}
+
+/* Emits held segments that are now in order.  If the stream has closed,
+ * drops the rest. */
+void
+TCPReassembler::drain(State &st, uint32_t si, Emit &e)
+{
+    Stream &s = st.streams[si];
+    while (Packet *q = s.queue) {
+	tcp_seq_t seq;
+	uint32_t len;
+	int flags;
+	segment(q, seq, len, flags);
+	if (s.state == s_open && SEQ_GT(seq, s.next_seq))
+	    return;
+	s.queue = q->next();
+	s.queue_mem -= q->buffer_length();
+	st.mem_used -= q->buffer_length();
+	if (!s.queue)
+	    list_unlink(st.streams, st.q_head, st.q_tail, si,
+			&Stream::q_prev, &Stream::q_next);
+	if (s.state == s_open)
+	    deliver(st, s, q, seq, len, flags, e);
+	else
+	    e.append(q, 1);
+    }
+}
+
+void
+TCPReassembler::drop_queue(State &st, uint32_t si, Emit &e)
+{
+    Stream &s = st.streams[si];
+    if (!s.queue)
+	return;
+    while (Packet *q = s.queue) {
+	s.queue = q->next();
+	e.append(q, 1);
+    }
+    st.mem_used -= s.queue_mem;
+    s.queue_mem = 0;
+    list_unlink(st.streams, st.q_head, st.q_tail, si,
+		&Stream::q_prev, &Stream::q_next);
+}
+
+/* Holds p, which starts after s.next_seq, in sequence order.  Then, if
+ * the thread is over its memory limit, flushes the least recently active
+ * queues. */
+void
+TCPReassembler::hold(State &st, uint32_t si, Packet *p, tcp_seq_t seq,
+		     uint32_t len, int flags, Emit &e)
+{
+    Stream &s = st.streams[si];
+    Packet *prev = 0, *x = s.queue;
+    for (; x; prev = x, x = x->next()) {
+	tcp_seq_t xseq;
+	uint32_t xlen;
+	int xflags;
+	segment(x, xseq, xlen, xflags);
+	if (SEQ_GT(xseq, seq))
+	    break;
+	// drop p if x already covers it
+	if (SEQ_GEQ(xseq + xlen, seq + len)
+	    && ((xflags & TH_FIN) || !(flags & TH_FIN))) {
+	    ++st.stat_retransmits;
+	    e.append(p, 1);
+	    return;
+	}
+    }
+
+    p->set_next(x);
+    if (prev)
+	prev->set_next(p);
+    else
+	s.queue = p;
+    s.queue_mem += p->buffer_length();
+    st.mem_used += p->buffer_length();
+    ++st.stat_held;
+    if (s.queue != p || x)
+	list_unlink(st.streams, st.q_head, st.q_tail, si,
+		    &Stream::q_prev, &Stream::q_next);
+    list_append(st.streams, st.q_head, st.q_tail, si,
+		&Stream::q_prev, &Stream::q_next);
+
+    while (st.mem_used > _thread_memory && st.q_head)
+	flush_queue(st, st.q_head, e);
+}
+
+/* Emits all of a stream's held segments, skipping over gaps. */
+void
+TCPReassembler::flush_queue(State &st, uint32_t si, Emit &e)
+{
+    Stream &s = st.streams[si];
+    while (s.queue) {
+	tcp_seq_t seq;
+	uint32_t len;
+	int flags;
+	segment(s.queue, seq, len, flags);
+	if (s.state == s_open && SEQ_GT(seq, s.next_seq)) {
+	    ++st.stat_gaps;
+	    s.next_seq = seq;
+	}
+	drain(st, si, e);
+    }
+}
+
+void
+TCPReassembler::evict(State &st, uint32_t si, Emit &e)
+{
+    flush_queue(st, si, e);
+    remove_stream(st, si);
+}
+
+/* The LRU list is in order of last activity, so idle streams are at its
+ * head. */
+void
+TCPReassembler::reap(State &st, int32_t now, Emit &e)
+{
+    int32_t kill_time = now - (int32_t) _timeout;
+    while (st.lru_head && st.streams[st.lru_head].last_sec < kill_time) {
+	++st.stat_timeouts;
+	evict(st, st.lru_head, e);
+    }
+}
+
+
+// OUTPUT
+
+/* Returns the sequence number of p's first data byte.  Emitted packets'
+ * data pointers have been advanced past their headers and any data already
+ * delivered. */
+static inline tcp_seq_t
+data_seq(const Packet *p)
+{
+    const click_tcp *tcph = p->tcp_header();
+    return ntohl(tcph->th_seq) + (tcph->th_flags & TH_SYN ? 1 : 0)
+	+ (p->data() - (p->transport_header() + (tcph->th_off << 2)));
+}
+
+/* Copies the data of the packets from first to last, totaling len bytes,
+ * into one packet with a copy of first's headers.  The packets' data must
+ * be contiguous in sequence space. */
+WritablePacket *
+TCPReassembler::merge(Packet *first, Packet *last, uint32_t len)
+{
+    const click_ip *iph = first->ip_header();
+    const click_tcp *tcph = first->tcp_header();
+    uint32_t iphl = first->transport_header() - first->network_header();
+    uint32_t hl = iphl + (tcph->th_off << 2);
+    WritablePacket *q = Packet::make(Packet::default_headroom + hl, 0, len, 0);
+    if (!q)
+	return 0;
+    unsigned char *data = q->data();
+    for (Packet *p = first; ; p = p->next()) {
+	memcpy(data, p->data(), p->length());
+	data += p->length();
+	if (p == last)
+	    break;
+    }
+
+    // headers: the first segment's, starting at the chunk's first byte
+    tcp_seq_t seq = data_seq(first);
+    memcpy(q->data() - hl, iph, hl);
+    q->set_network_header(q->data() - hl, iphl);
+    click_ip *qiph = q->ip_header();
+    click_tcp *qtcph = q->tcp_header();
+    qiph->ip_len = htons(hl + len);
+    qtcph->th_seq = htonl(seq);
+    qtcph->th_flags &= ~(TH_SYN | TH_FIN | TH_RST);
+    q->copy_annotations(first);
+    return q;
+}
+
+void
+TCPReassembler::emit(Emit &e)
+{
+    Packet *p = e.head[0];
+    while (p) {
+	Packet *next = p->next();
+	// coalesce runs of contiguous data segments from one stream; flushes
+	// skip over holes, so neighboring packets need not be contiguous
+	if (_chunk && next && p->length()
+	    && !(p->tcp_header()->th_flags & (TH_FIN | TH_RST))) {
+	    Packet *last = p;
+	    uint32_t len = p->length();
+	    while (Packet *x = last->next()) {
+		const click_ip *xiph = x->ip_header(), *iph = p->ip_header();
+		if (len + x->length() > _chunk
+		    || (x->tcp_header()->th_flags & (TH_FIN | TH_RST))
+		    || xiph->ip_src.s_addr != iph->ip_src.s_addr
+		    || xiph->ip_dst.s_addr != iph->ip_dst.s_addr
+		    || x->tcp_header()->th_sport != p->tcp_header()->th_sport
+		    || x->tcp_header()->th_dport != p->tcp_header()->th_dport
+		    || data_seq(x) != data_seq(last) + last->length())
+		    break;
+		len += x->length();
+		last = x;
+	    }
+	    if (last != p)
+		if (WritablePacket *q = merge(p, last, len)) {
+		    next = last->next();
+		    for (Packet *x = p; x != next; ) {
+			Packet *y = x->next();
+			x->kill();
+			x = y;
+		    }
+		    output(0).push(q);
+		    p = next;
+		    continue;
+		}
+	}
+	p->set_next(0);
+	output(0).push(p);
+	p = next;
+    }
+
+    for (p = e.head[1]; p; ) {
+	Packet *next = p->next();
+	p->set_next(0);
+	checked_output_push(1, p);
+	p = next;
+    }
+}
+
+void
+TCPReassembler::push(int, Packet *p)
+{
+    State &st = state();
+    Emit e;
+    tcp_seq_t seq;
+    uint32_t len;
+    int flags;
+    if (!segment(p, seq, len, flags)) {
+	checked_output_push(1, p);
+	return;
+    }
+    ++st.stat_segments;
+
+    int32_t now = p->timestamp_anno() ? p->timestamp_anno().sec() : Timestamp::recent().sec();
+    if (st.lru_head)
+	reap(st, now, e);
+
+    const click_ip *iph = p->ip_header();
+    const click_tcp *tcph = p->tcp_header();
+    uint32_t ports = tcph->th_sport | ((uint32_t) tcph->th_dport << 16);
+    uint32_t hash = hash_key(iph->ip_src.s_addr, iph->ip_dst.s_addr, ports, _hash_seed);
+    uint32_t si = 0;
+    if (st.slots)
+	si = st.slots[find_slot(st, iph->ip_src.s_addr, iph->ip_dst.s_addr, ports, hash)];
+
+    if (!si) {
+	// start a stream only at a segment that could carry data
+	if ((flags & TH_RST) || (!len && !(flags & (TH_SYN | TH_FIN)))
+	    || !(si = new_stream(st, iph, tcph, hash, e))) {
+	    e.append(p, 1);
+	    goto done;
+	}
+	st.streams[si].next_seq = seq;
+    } else {
+	// a SYN reopens a closed stream
+	if (st.streams[si].state == s_closed) {
+	    if (!(flags & TH_SYN)) {
+		e.append(p, 1);
+		goto done;
+	    }
+	    st.streams[si].state = s_open;
+	    st.streams[si].next_seq = seq;
+	}
+	list_unlink(st.streams, st.lru_head, st.lru_tail, si,
+		    &Stream::lru_prev, &Stream::lru_next);
+	list_append(st.streams, st.lru_head, st.lru_tail, si,
+		    &Stream::lru_prev, &Stream::lru_next);
+    }
+
+    {
+	Stream &s = st.streams[si];
+	s.last_sec = now;
+
+	if (flags & TH_RST) {
+	    tcp_seq_t rseq = ntohl(tcph->th_seq);
+	    if (SEQ_GEQ(rseq, s.next_seq)) {
+		drop_queue(st, si, e);
+		p->pull(p->transport_header() + (tcph->th_off << 2) - p->data());
+		p->take(p->length());
+		s.state = s_closed;
+		++st.stat_closed;
+		e.append(p, 0);
+	    } else
+		e.append(p, 1);
+	} else if (SEQ_GT(seq, s.next_seq)) {
+	    if (len || (flags & TH_FIN))
+		hold(st, si, p, seq, len, flags, e);
+	    else
+		e.append(p, 1);
+	} else {
+	    deliver(st, s, p, seq, len, flags, e);
+	    if (s.queue)
+		drain(st, si, e);
+	}
+    }
+
+  done:
+    emit(e);
+}
+
+
+// HANDLERS
+
+String
+TCPReassembler::read_handler(Element *e, void *user_data)
+{
+    TCPReassembler *r = static_cast<TCPReassembler *>(e);
+    uint64_t v[9];
+    memset(v, 0, sizeof(v));
+    uint32_t count = 0, mem_used = 0;
+    for (unsigned i = 0; i < r->_nstates; i++) {
+	const State &st = r->_states[i];
+	count += st.count;
+	mem_used += st.mem_used;
+	v[0] += st.stat_segments;
+	v[1] += st.stat_bytes;
+	v[2] += st.stat_held;
+	v[3] += st.stat_retransmits;
+	v[4] += st.stat_overlaps;
+	v[5] += st.stat_gaps;
+	v[6] += st.stat_closed;
+	v[7] += st.stat_evicted;
+	v[8] += st.stat_timeouts;
+    }
+    switch ((intptr_t) user_data) {
+    case h_count:
+	return String(count);
+    case h_mem_used:
+	return String(mem_used);
+    default: {
+	static const char * const names[] = {
+	    "segments", "bytes", "held", "retransmits", "overlaps", "gaps",
+	    "closed", "evicted", "timeouts"
+	};
+	StringAccum sa;
+	for (int i = 0; i < 9; i++)
+	    sa << names[i] << ' ' << v[i] << '\n';
+	return sa.take_string();
+    }
+    }
+}
+
+int
+TCPReassembler::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    TCPReassembler *r = static_cast<TCPReassembler *>(e);
+    for (unsigned i = 0; i < r->_nstates; i++) {
+	State &st = r->_states[i];
+	Emit em;
+	while (st.lru_head)
+	    r->evict(st, st.lru_head, em);
+	r->emit(em);
+    }
+    return 0;
+}
+
+void
+TCPReassembler::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("mem_used", read_handler, h_mem_used);
+    add_read_handler("stats", read_handler, h_stats);
+    add_write_handler("flush", write_handler, h_flush);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TCPReassembler)
@@ -0,0 +1,271 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TCPREASSEMBLER_HH
+#define CLICK_TCPREASSEMBLER_HH
+#include <click/element.hh>
+#include <click/glue.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+CLICK_DECLS
+
+/*
+=c
+
+TCPReassembler([I<keywords> CAPACITY, MEMORY, TIMEOUT, CHUNK])
+
+=s tcp
+
+reassembles TCP byte streams
+
+=d
+
+Expects TCP/IP packets with their IP header annotations set (by CheckIPHeader,
+for example) on its input, and emits each TCP stream's data in sequence order
+on output 0.  Every packet emitted on output 0 holds exactly the next new bytes
+of its stream: the packet's data is pulled forward past the IP and TCP headers
+and any bytes already delivered, so overlapping and retransmitted data is
+never seen twice.  The headers themselves stay in the packet and remain
+available through the network and transport header annotations.  The
+sequence number of a packet's first data byte is the header's sequence
+number, plus 1 for a SYN, plus the distance from the end of the TCP header to
+the packet data.
+
+Each direction of a connection is a separate stream.  Streams normally begin
+at a SYN; a stream picked up in the middle starts at the first segment seen.
+Segments that arrive ahead of the stream are held, without copying, until the
+gap before them is filled.  A segment with FIN is emitted on output 0 once all
+data before it has been emitted, and closes the stream.  An RST at or
+beyond the next expected sequence number is emitted on output 0 with no
+data, and closes the stream at once; any held segments are dropped.
+Analyzers can thus recognize the end of a stream by the FIN or RST flag in
+its last packet.  A closed stream stays in the table, ignoring late
+retransmissions, until it times out or a new SYN reopens it.
+
+Packets that contribute nothing to a stream, including pure
+acknowledgements, retransmissions, segments for closed streams, dropped held
+segments, fragments, and non-TCP packets, are emitted on output 1 if it
+exists, and dropped otherwise.
+
+Streams are kept in per-thread hash tables, so both directions of a
+connection need not arrive on the same thread, but all the packets of one
+direction must.  Each stream takes about 64 bytes.  Idle streams time out
+after TIMEOUT seconds, measured by packet timestamps.  When a thread's table
+reaches its share of CAPACITY, its least recently used stream is evicted.
+When held segments exceed a thread's share of MEMORY, TCPReassembler flushes
+the held segments of the least recently active streams: it skips over their
+gaps and emits them in sequence order.  Evicted and timed-out streams are
+flushed the same way.  Analyzers can detect the skipped bytes from the
+sequence numbers.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned integer.  Maximum number of streams.  Default is 1048576.
+
+=item MEMORY
+
+Unsigned integer.  Maximum number of bytes of out-of-order segments held,
+counting their whole packet buffers.  Default is 64 MB.
+
+=item TIMEOUT
+
+Time in seconds.  Streams idle for this long are flushed and forgotten.
+Default is 120.
+
+=item CHUNK
+
+Unsigned integer.  If nonzero, data that becomes deliverable at once, such as
+a run of held segments released by the segment that fills their gap, is
+copied into packets of up to CHUNK bytes rather than emitted segment by
+segment.  Each such packet carries a copy of the first segment's headers,
+with the IP length and TCP sequence number adjusted but checksums unchanged.
+Default is 0, which never copies.
+
+=back
+
+=h count read-only
+
+Returns the number of streams.
+
+=h mem_used read-only
+
+Returns the number of bytes held in out-of-order segments.
+
+=h stats read-only
+
+Returns statistics: segments seen, data bytes emitted, segments held out of
+order, retransmitted segments, partly overlapping segments, gaps skipped,
+streams closed, streams evicted, and streams timed out.
+
+=h flush write-only
+
+Flushes and forgets every stream.
+
+=e
+
+  FromDump(tap.pcap, STOP true)
+    -> Strip(14) -> CheckIPHeader -> IPClassifier(tcp)
+    -> TCPReassembler(CAPACITY 4000000, MEMORY 512000000)
+    -> PayloadMatcher(/HTTP\/1\.[01] 200/) -> ...;
+
+=a
+
+IPReassembler, TCPBuffer, PayloadMatcher */
+
+class TCPReassembler : public Element { public:
+
+    TCPReassembler() CLICK_COLD;
+    ~TCPReassembler() CLICK_COLD;
+
+    const char *class_name() const	{ return "TCPReassembler"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+
+  private:
+
+    enum { INITIAL_STREAMS = 64 };
+    enum { s_open = 1, s_closed = 2 };
+
+    // One direction of a connection.  Streams live in a per-thread array and
+    // refer to each other by index; index 0 is never used.  Out-of-order
+    // segments are kept in sequence order on a list linked through their
+    // next() annotations; a stream is on its thread's queue list exactly
+    // when that list is nonempty.
+    struct Stream {
+	uint32_t saddr;
+	uint32_t daddr;
+	uint16_t sport;
+	uint16_t dport;
+	uint32_t hash;
+	tcp_seq_t next_seq;
+	int32_t last_sec;
+	uint32_t lru_prev;
+	uint32_t lru_next;
+	uint32_t q_prev;
+	uint32_t q_next;
+	Packet *queue;
+	uint32_t queue_mem;
+	uint8_t state;
+    };
+
+    // Reassembly state for one thread.  All streams are on the LRU list,
+    // least recently used first.  Streams with out-of-order segments are
+    // also on the queue list, in order of last activity.
+    struct State {
+	uint32_t *slots;
+	uint32_t mask;
+	Stream *streams;
+	uint32_t nstreams;
+	uint32_t free;
+	uint32_t count;
+	uint32_t lru_head;
+	uint32_t lru_tail;
+	uint32_t q_head;
+	uint32_t q_tail;
+	uint32_t mem_used;
+	uint64_t stat_segments;
+	uint64_t stat_bytes;
+	uint64_t stat_held;
+	uint64_t stat_retransmits;
+	uint64_t stat_overlaps;
+	uint64_t stat_gaps;
+	uint64_t stat_closed;
+	uint64_t stat_evicted;
+	uint64_t stat_timeouts;
+    };
+
+    // Packets to emit on each output, in order.
+    struct Emit {
+	Packet *head[2];
+	Packet *tail[2];
+	Emit() {
+	    head[0] = head[1] = tail[0] = tail[1] = 0;
+	}
+	inline void append(Packet *p, int port);
+    };
+
+    State *_states;
+    unsigned _nstates;
+    uint32_t _hash_seed;
+
+    uint32_t _capacity;
+    uint32_t _memory;
+    uint32_t _thread_capacity;
+    uint32_t _thread_memory;
+    uint32_t _timeout;
+    uint32_t _chunk;
+
+    inline State &state();
+    static inline uint32_t hash_key(uint32_t, uint32_t, uint32_t, uint32_t);
+    static inline bool segment(Packet *, tcp_seq_t &, uint32_t &, int &);
+
+    static uint32_t find_slot(State &, uint32_t, uint32_t, uint32_t, uint32_t);
+    static bool grow_table(State &);
+    bool grow_streams(State &);
+    uint32_t new_stream(State &, const click_ip *, const click_tcp *, uint32_t,
+			Emit &);
+    static void remove_stream(State &, uint32_t);
+    static inline void list_append(Stream *, uint32_t &, uint32_t &,
+				   uint32_t, uint32_t Stream::*, uint32_t Stream::*);
+    static inline void list_unlink(Stream *, uint32_t &, uint32_t &,
+				   uint32_t, uint32_t Stream::*, uint32_t Stream::*);
+
+    static void deliver(State &, Stream &, Packet *, tcp_seq_t, uint32_t, int, Emit &);
+    static void drain(State &, uint32_t, Emit &);
+    void hold(State &, uint32_t, Packet *, tcp_seq_t, uint32_t, int, Emit &);
+    static void drop_queue(State &, uint32_t, Emit &);
+    void flush_queue(State &, uint32_t, Emit &);
+    void evict(State &, uint32_t, Emit &);
+    void reap(State &, int32_t, Emit &);
+    void emit(Emit &);
+    WritablePacket *merge(Packet *, Packet *, uint32_t);
+
+    enum { h_count, h_mem_used, h_stats, h_flush };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+
+inline TCPReassembler::State &
+TCPReassembler::state()
+{
+    return _states[click_current_cpu_id() % _nstates];
+}
+
+inline uint32_t
+TCPReassembler::hash_key(uint32_t saddr, uint32_t daddr, uint32_t ports,
+			 uint32_t seed)
+{
+    uint32_t x = seed ^ saddr;
+    x = (x * 0x9E3779B1U) ^ daddr;
+    x = (x * 0x9E3779B1U) ^ ports;
+    x ^= x >> 16;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35U;
+    return x ^ (x >> 16);
+}
+
+inline void
+TCPReassembler::Emit::append(Packet *p, int port)
+{
+    p->set_next(0);
+    if (tail[port])
+	tail[port]->set_next(p);
+    else
+	head[port] = p;
+    tail[port] = p;
+}
+
+CLICK_ENDDECLS
+#endif
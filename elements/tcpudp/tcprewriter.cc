@@ -343,18 +343,11 @@ TCPRewriter::push(int port, Packet *p_in)
 }
 
 
-String
-TCPRewriter::tcp_mappings_handler(Element *e, void *)
+int
+TCPRewriter::tcp_mappings_handler(Element *e, void *, StringAccum &sa, uint64_t &cursor)
 {
     TCPRewriter *rw = (TCPRewriter *)e;
-    click_jiffies_t now = click_jiffies();
-    StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
-    return sa.take_string();
+    return unparse_mappings_chunk<TCPFlow>(rw->_map, sa, cursor);
 }
 
 int
@@ -393,8 +386,8 @@ TCPRewriter::tcp_lookup_handler(int, String &str, Element *e, const Handler *, E
 void
 TCPRewriter::add_handlers()
 {
-    add_read_handler("table", tcp_mappings_handler, 0);
-    add_read_handler("mappings", tcp_mappings_handler, 0, Handler::h_deprecated);
+    add_read_stream_handler("table", tcp_mappings_handler, 0);
+    add_read_stream_handler("mappings", tcp_mappings_handler, 0, Handler::h_deprecated);
     set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, tcp_lookup_handler, 0);
     add_rewriter_handlers(true);
 }
@@ -189,7 +189,7 @@ class TCPRewriter : public IPRewriterBase { public:
 	    return _timeouts[0];
     }
 
-    static String tcp_mappings_handler(Element *, void *);
+    static int tcp_mappings_handler(Element *, void *, StringAccum &, uint64_t &);
     static int tcp_lookup_handler(int, String &str, Element *e, const Handler *h, ErrorHandler *errh);
 
 };
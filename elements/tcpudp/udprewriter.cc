@@ -177,24 +177,18 @@ UDPRewriter::push(int port, Packet *p_in)
 }
 
 
-String
-UDPRewriter::dump_mappings_handler(Element *e, void *)
+int
+UDPRewriter::dump_mappings_handler(Element *e, void *, StringAccum &sa, uint64_t &cursor)
 {
     UDPRewriter *rw = (UDPRewriter *)e;
-    click_jiffies_t now = click_jiffies();
-    StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
-    return sa.take_string();
+    return unparse_mappings_chunk<UDPFlow>(rw->_map, sa, cursor);
 }
 
 void
 UDPRewriter::add_handlers()
 {
-    add_read_handler("table", dump_mappings_handler);
-    add_read_handler("mappings", dump_mappings_handler, 0, Handler::h_deprecated);
+    add_read_stream_handler("table", dump_mappings_handler);
+    add_read_stream_handler("mappings", dump_mappings_handler, 0, Handler::h_deprecated);
     add_rewriter_handlers(true);
 }
 
@@ -211,7 +211,7 @@ class UDPRewriter : public IPRewriterBase { public:
 	    return _timeouts[0];
     }
 
-    static String dump_mappings_handler(Element *, void *);
+    static int dump_mappings_handler(Element *, void *, StringAccum &, uint64_t &);
 
     friend class IPRewriter;
 
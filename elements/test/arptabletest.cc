@@ -0,0 +1,219 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * arptabletest.{cc,hh} -- stress test and benchmark for ARPTable lookups
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "arptabletest.hh"
+#include "elements/ethernet/arptable.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/args.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+ARPTableTest::ARPTableTest()
+    : _arpt(0), _tasks(0), _ntasks(0), _stats(0),
+      _update_task(update_task_callback, this), _generations(0),
+      _n(1024), _batch(1024), _limit(1000000), _updates(0),
+      _update(true), _stop(false)
+{
+    _running = 0;
+}
+
+int
+ARPTableTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read_mp("TABLE", ElementCastArg("ARPTable"), _arpt)
+	.read("N", _n)
+	.read("BATCH", _batch)
+	.read("LIMIT", _limit)
+	.read("UPDATE", _update)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _n > 0xFFFFFF)
+	return errh->error("N out of range");
+    if (_batch == 0)
+	return errh->error("BATCH must be positive");
+    return 0;
+}
+
+inline IPAddress
+ARPTableTest::entry_ip(unsigned i) const
+{
+    return IPAddress(htonl(0x0A000000U + i));
+}
+
+// The generation's low bit selects whether the address bytes are stored
+// plain or complemented, so a reader that mixes bytes from two updates sees
+// an address that fails check_eth().
+EtherAddress
+ARPTableTest::entry_eth(IPAddress ip, uint32_t generation)
+{
+    unsigned char data[6];
+    const unsigned char *ipd = ip.data();
+    data[0] = 0x02;
+    data[1] = generation;
+    for (int i = 0; i < 4; ++i)
+	data[i + 2] = (generation & 1 ? ~ipd[i] : ipd[i]);
+    return EtherAddress(data);
+}
+
+bool
+ARPTableTest::check_eth(IPAddress ip, const EtherAddress &eth)
+{
+    const unsigned char *d = eth.data();
+    if (d[0] != 0x02)
+	return false;
+    return entry_eth(ip, d[1]) == eth;
+}
+
+int
+ARPTableTest::initialize(ErrorHandler *)
+{
+    _generations = new uint32_t[_n];
+    for (unsigned i = 0; i < _n; ++i) {
+	_generations[i] = 0;
+	_arpt->insert(entry_ip(i), entry_eth(entry_ip(i), 0));
+    }
+
+    _ntasks = master()->nthreads();
+    _stats = new att_stat[_ntasks];
+    _tasks = reinterpret_cast<Task *>(new char[sizeof(Task) * _ntasks]);
+    for (int i = 0; i < _ntasks; ++i) {
+	_stats[i].seed = click_random() | 1;
+	new(reinterpret_cast<char *>(&_tasks[i])) Task(this);
+	_tasks[i].initialize(this, false);
+	_tasks[i].move_thread(i);
+	_tasks[i].reschedule();
+    }
+    _running = _ntasks;
+    if (_update)
+	_update_task.initialize(this, true);
+    return 0;
+}
+
+void
+ARPTableTest::cleanup(CleanupStage)
+{
+    if (_tasks) {
+	for (int i = 0; i < _ntasks; ++i)
+	    _tasks[i].~Task();
+	delete[] reinterpret_cast<char *>(_tasks);
+	_tasks = 0;
+    }
+    delete[] _stats;
+    delete[] _generations;
+}
+
+bool
+ARPTableTest::run_task(Task *t)
+{
+    att_stat &st = _stats[t - _tasks];
+    uint32_t seed = st.seed;
+    uint64_t misses = 0, errors = 0;
+    EtherAddress eth;
+
+    click_cycles_t c0 = click_get_cycles();
+    for (unsigned i = 0; i < _batch; ++i) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	IPAddress ip = entry_ip(seed % _n);
+	if (_arpt->lookup(ip, &eth, 0) < 0)
+	    ++misses;
+	else if (!check_eth(ip, eth))
+	    ++errors;
+    }
+    st.cycles += click_get_cycles() - c0;
+
+    st.seed = seed;
+    st.lookups += _batch;
+    st.misses += misses;
+    st.errors += errors;
+    if (errors)
+	click_chatter("%p{element}: %llu inconsistent lookups", this,
+		      (unsigned long long) errors);
+
+    if (!_limit || st.lookups < _limit)
+	t->fast_reschedule();
+    else if (_running.dec_and_test() && _stop)
+	router()->please_stop_driver();
+    return true;
+}
+
+bool
+ARPTableTest::update_task_callback(Task *t, void *user_data)
+{
+    ARPTableTest *att = static_cast<ARPTableTest *>(user_data);
+    unsigned n = att->_batch / 16 + 1;
+    for (unsigned i = 0; i < n; ++i) {
+	unsigned which = click_random() % att->_n;
+	IPAddress ip = att->entry_ip(which);
+	att->_arpt->insert(ip, entry_eth(ip, ++att->_generations[which]));
+    }
+    att->_updates += n;
+    if (att->_running.value())
+	t->fast_reschedule();
+    return true;
+}
+
+String
+ARPTableTest::read_handler(Element *e, void *user_data)
+{
+    ARPTableTest *att = static_cast<ARPTableTest *>(e);
+    uint64_t lookups = 0, misses = 0, errors = 0;
+    for (int i = 0; i < att->_ntasks; ++i) {
+	lookups += att->_stats[i].lookups;
+	misses += att->_stats[i].misses;
+	errors += att->_stats[i].errors;
+    }
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_errors:
+	return String(errors);
+    case h_misses:
+	return String(misses);
+    case h_lookups:
+	return String(lookups);
+    case h_updates:
+	return String(att->_updates);
+    case h_stats: {
+	StringAccum sa;
+	for (int i = 0; i < att->_ntasks; ++i) {
+	    const att_stat &st = att->_stats[i];
+	    sa << i << ' ' << st.lookups << ' '
+	       << (st.lookups ? st.cycles / st.lookups : 0) << '\n';
+	}
+	return sa.take_string();
+    }
+    default:
+	return String();
+    }
+}
+
+void
+ARPTableTest::add_handlers()
+{
+    add_read_handler("errors", read_handler, h_errors);
+    add_read_handler("misses", read_handler, h_misses);
+    add_read_handler("lookups", read_handler, h_lookups);
+    add_read_handler("updates", read_handler, h_updates);
+    add_read_handler("stats", read_handler, h_stats);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(ARPTable)
+EXPORT_ELEMENT(ARPTableTest)
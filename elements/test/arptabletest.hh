@@ -0,0 +1,128 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ARPTABLETEST_HH
+#define CLICK_ARPTABLETEST_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/ipaddress.hh>
+#include <click/etheraddress.hh>
+CLICK_DECLS
+class ARPTable;
+
+/*
+=c
+
+ARPTableTest(TABLE, [I<keywords>])
+
+=s test
+
+runs ARPTable concurrent lookup stress test
+
+=d
+
+ARPTableTest is a stress test and benchmark for ARPTable lookups.  At
+initialization it fills TABLE with N entries.  It then runs one resolver task
+per Click thread; each task repeatedly looks up random entries from TABLE.  A
+separate updater task continually rewrites those entries with new Ethernet
+addresses.  Every Ethernet address encodes its IP address and a generation
+number, so resolvers can detect torn or mismatched reads.
+
+ARPTableTest does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Unsigned integer.  Number of table entries.  Default is 1024.
+
+=item BATCH
+
+Unsigned integer.  Number of lookups per resolver task run.  Default is 1024.
+
+=item LIMIT
+
+Unsigned integer.  Each resolver task stops after this many lookups.  Zero
+means run forever.  Default is 1000000.
+
+=item UPDATE
+
+Boolean.  If true, run the updater task.  Default is true.
+
+=item STOP
+
+Boolean.  If true, stop the driver once every resolver task has reached
+LIMIT.  Default is false.
+
+=back
+
+=h errors r
+
+Number of lookups that returned a wrong or inconsistent Ethernet address.
+
+=h misses r
+
+Number of lookups that failed.
+
+=h lookups r
+
+Total number of lookups.
+
+=h updates r
+
+Number of entries rewritten by the updater task.
+
+=h stats r
+
+One line per thread: thread number, lookups, and average cycles per lookup.
+
+*/
+
+class ARPTableTest : public Element { public:
+    ARPTableTest() CLICK_COLD;
+
+    const char* class_name() const		{ return "ARPTableTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage stage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    bool run_task(Task *t);
+
+  private:
+    struct att_stat {
+        uint64_t lookups;
+        uint64_t misses;
+        uint64_t errors;
+        uint64_t cycles;
+        uint32_t seed;
+        uint32_t padding[7];
+        att_stat() : lookups(0), misses(0), errors(0), cycles(0), seed(0) {}
+    };
+
+    ARPTable *_arpt;
+    Task *_tasks;
+    int _ntasks;
+    att_stat *_stats;
+    Task _update_task;
+    uint32_t *_generations;
+    unsigned _n;
+    unsigned _batch;
+    uint64_t _limit;
+    uint64_t _updates;
+    atomic_uint32_t _running;
+    bool _update;
+    bool _stop;
+
+    inline IPAddress entry_ip(unsigned i) const;
+    static EtherAddress entry_eth(IPAddress ip, uint32_t generation);
+    static bool check_eth(IPAddress ip, const EtherAddress &eth);
+    static bool update_task_callback(Task *, void *);
+
+    enum { h_errors, h_misses, h_lookups, h_updates, h_stats };
+    static String read_handler(Element *, void *) CLICK_COLD;
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,296 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * flathashtabletest.{cc,hh} -- regression test element for FlatHashTable
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flathashtabletest.hh"
+#include <click/flathashtable.hh>
+#include <click/hashtable.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+FlatHashTableTest::FlatHashTableTest()
+    : _benchmark(false), _n(1000000)
+{
+}
+
+int
+FlatHashTableTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh)
+	.read("BENCHMARK", _benchmark)
+	.read("N", _n)
+	.complete();
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+namespace {
+// A borrowed string, for heterogeneous lookups in String-keyed tables.
+struct StrSpan {
+    const char *s;
+    int len;
+    StrSpan(const char *s_)
+	: s(s_), len(strlen(s_)) {
+    }
+    hashcode_t hashcode() const {
+	return len ? String::hashcode(s, s + len) : 0;
+    }
+};
+
+inline bool operator==(const String &a, const StrSpan &b) {
+    return a.equals(b.s, b.len);
+}
+}
+
+static int
+check_strings(ErrorHandler *errh)
+{
+    FlatHashTable<String, int> h;
+    CHECK(h.empty());
+    CHECK(h.capacity() == 0);
+    CHECK(!h.find("Foo"));
+    CHECK(h.get("Foo") == 0);
+
+    h["Foo"] = 1;
+    CHECK(h.set("bar", 2));
+    CHECK(!h.set("bar", 3));
+    h.find_insert("facker", 4);
+    h.find_insert("facker", 5);
+    CHECK(h.size() == 3);
+    CHECK(h["Foo"] == 1);
+    CHECK(h["bar"] == 3);
+    CHECK(h.get("facker") == 4);
+    CHECK(h.count(String("facker")) == 1);
+    CHECK(h.count(String("Facker")) == 0);
+    CHECK(h.find("Crud") == h.end());
+    CHECK(h.get_pointer("Crud") == 0);
+    *h.get_pointer("Foo") = 6;
+    CHECK(h["Foo"] == 6);
+
+    // heterogeneous lookup
+    CHECK(h.find_as(StrSpan("bar")).value() == 3);
+    CHECK(!h.find_as(StrSpan("barn")));
+    CHECK(h.erase_as(StrSpan("bar")) == 1);
+    CHECK(h.erase_as(StrSpan("bar")) == 0);
+    CHECK(h.size() == 2);
+
+    // copy, assignment, swap
+    FlatHashTable<String, int> hh(h);
+    CHECK(hh.size() == 2 && hh["Foo"] == 6 && hh["facker"] == 4);
+    hh["Crap"] = 7;
+    CHECK(h.size() == 2 && !h.find("Crap"));
+    h = hh;
+    CHECK(h.size() == 3 && h["Crap"] == 7);
+    FlatHashTable<String, int> h3(-1);
+    CHECK(h3["Nothing"] == -1);
+    h3.swap(h);
+    CHECK(h3.size() == 3 && h.size() == 1 && h.default_value() == -1);
+
+    // erase while iterating
+    int n = 0;
+    for (FlatHashTable<String, int>::iterator it = h3.begin(); it; )
+	if (it.key() == "Foo")
+	    it = h3.erase(it);
+	else {
+	    it.value() += 10;
+	    ++it, ++n;
+	}
+    CHECK(n == 2);
+    CHECK(h3.size() == 2 && !h3.find("Foo"));
+    CHECK(h3["Crap"] == 17 && h3["facker"] == 14);
+
+    size_t cap = h3.capacity();
+    h3.clear();
+    CHECK(h3.empty() && h3.capacity() == cap && h3.begin() == h3.end());
+    return 0;
+}
+
+static int
+check_against_hashtable(ErrorHandler *errh)
+{
+    // Random operations, compared with HashTable.  Keys come from a small
+    // range so that erasures and reinsertions collide.
+    FlatHashTable<int, int> f;
+    HashTable<int, int> h;
+    bool saw_rehash = false;
+    for (int i = 0; i < 200000; ++i) {
+	int k = click_random() % 50000, op = click_random() % 8;
+	if (op < 5) {
+	    CHECK(f.set(k, i) == h.set(k, i));
+	    saw_rehash = saw_rehash || f.rehashing();
+	} else if (op < 7) {
+	    CHECK(f.erase(k) == h.erase(k));
+	} else {
+	    CHECK(f.get(k) == h.get(k));
+	}
+	CHECK(f.size() == h.size());
+    }
+    CHECK(saw_rehash);
+
+    int n = 0;
+    for (FlatHashTable<int, int>::const_iterator it = f.begin(); it; ++it, ++n)
+	CHECK(h.get(it.key()) == it.value());
+    CHECK(n == (int) h.size());
+    for (HashTable<int, int>::iterator it = h.begin(); it; ++it)
+	CHECK(f.get(it.key()) == it.value());
+    return 0;
+}
+
+static int
+check_incremental(ErrorHandler *errh)
+{
+    // Growth moves elements one group per insertion.  Everything stays
+    // findable and iterable while both tables are live.
+    FlatHashTable<int, int> f;
+    int k = 0;
+    while (!f.rehashing() || f.capacity() < 4096)
+	f[k] = k, ++k;
+    size_t cap = f.capacity();
+    CHECK(f.size() == (size_t) k);
+    for (int i = 0; i < k; ++i)
+	CHECK(f.get(i) == i);
+    int n = 0;
+    for (FlatHashTable<int, int>::iterator it = f.begin(); it; ++it, ++n)
+	CHECK(it.key() == it.value());
+    CHECK(n == k);
+    int gone = k - 1;
+    CHECK(f.erase(0) == 1 && f.erase(gone) == 1);
+    CHECK(!f.find(0) && !f.find(gone));
+    int steps = 0;
+    for (; f.rehashing(); ++steps)
+	f[k] = k, ++k;
+    CHECK(steps > 1 && steps <= (int) (cap / 2 / 16));
+    CHECK(f.capacity() == cap);
+    for (int i = 1; i < k; ++i)
+	CHECK(i == gone || f.get(i) == i);
+
+    // Churn leaves tombstones; the table rehashes in place rather than
+    // growing without bound.
+    FlatHashTable<int, int> c;
+    for (int i = 0; i < 500000; ++i) {
+	c[i] = i;
+	if (i >= 1000) {
+	    CHECK(c.erase(i - 1000) == 1);
+	}
+    }
+    CHECK(c.size() == 1000 && c.capacity() <= 4096);
+
+    // After reserve(), insertions never allocate or rehash.
+    FlatHashTable<int, int> r;
+    r.reserve(10000);
+    cap = r.capacity();
+    for (int i = 0; i < 10000; ++i) {
+	r[i] = i;
+	CHECK(!r.rehashing());
+    }
+    CHECK(r.capacity() == cap);
+    r.rehash(0);
+    CHECK(r.size() == 10000 && r.get(9999) == 9999);
+
+    // A reservation that cannot be met leaves the table alone.
+    cap = r.capacity();
+    CHECK(!r.reserve((size_t) -1 / 2));
+    CHECK(!r.rehash((size_t) -1 / 2));
+    CHECK(r.capacity() == cap && r.size() == 10000 && r.get(9999) == 9999);
+    return 0;
+}
+
+int
+FlatHashTableTest::initialize(ErrorHandler *errh)
+{
+    if (check_strings(errh) < 0
+	|| check_against_hashtable(errh) < 0
+	|| check_incremental(errh) < 0)
+	return -1;
+#if CLICK_USERLEVEL
+    if (_benchmark)
+	benchmark(errh);
+#endif
+    errh->message("All tests pass!");
+    return 0;
+}
+
+#if CLICK_USERLEVEL
+// Inserts keys in order, then looks up and erases them in the shuffled
+// order given by lookups, so that neither table benefits from allocating
+// elements in insertion order.
+template <typename M, typename K>
+static void
+time_map(const char *name, const Vector<K> &keys, const Vector<K> &lookups,
+	 const Vector<K> &misses, ErrorHandler *errh)
+{
+    M m;
+    Timestamp t[5];
+    click_cycles_t max_insert = 0;
+    unsigned sum = 0;
+    int n = keys.size();
+
+    t[0] = Timestamp::now_steady();
+    for (int i = 0; i < n; ++i) {
+	click_cycles_t c0 = click_get_cycles();
+	m.set(keys[i], i);
+	click_cycles_t c1 = click_get_cycles() - c0;
+	if (c1 > max_insert)
+	    max_insert = c1;
+    }
+    t[1] = Timestamp::now_steady();
+    for (int i = 0; i < n; ++i)
+	sum += m.get(lookups[i]);
+    t[2] = Timestamp::now_steady();
+    for (int i = 0; i < n; ++i)
+	sum += m.get(misses[i]);
+    t[3] = Timestamp::now_steady();
+    for (int i = 0; i < n; ++i)
+	m.erase(lookups[i]);
+    t[4] = Timestamp::now_steady();
+
+    double ns[4];
+    for (int i = 0; i < 4; ++i)
+	ns[i] = (t[i + 1] - t[i]).doubleval() * 1e9 / n;
+    errh->message("Time: %s: insert %.1f, hit %.1f, miss %.1f, erase %.1f ns/op; max insert %llu cycles (%u)",
+		  name, ns[0], ns[1], ns[2], ns[3],
+		  (unsigned long long) max_insert, sum);
+}
+
+void
+FlatHashTableTest::benchmark(ErrorHandler *errh)
+{
+    Vector<int> ikeys, ilookups, imisses;
+    Vector<String> skeys, slookups, smisses;
+    for (uint32_t i = 0; i < _n; ++i) {
+	// Distinct, scattered keys; misses are disjoint from hits.
+	ikeys.push_back((int) (i * 0x9E3779B1U));
+	imisses.push_back((int) ((i + _n) * 0x9E3779B1U));
+	skeys.push_back("key" + String(ikeys.back()));
+	smisses.push_back("key" + String(imisses.back()));
+    }
+    ilookups = ikeys;
+    slookups = skeys;
+    for (int i = _n - 1; i > 0; --i) {
+	int j = click_random(0, i);
+	click_swap(ilookups[i], ilookups[j]);
+	click_swap(slookups[i], slookups[j]);
+    }
+    time_map<HashTable<int, int> >("HashTable<int, int>", ikeys, ilookups, imisses, errh);
+    time_map<FlatHashTable<int, int> >("FlatHashTable<int, int>", ikeys, ilookups, imisses, errh);
+    time_map<HashTable<String, int> >("HashTable<String, int>", skeys, slookups, smisses, errh);
+    time_map<FlatHashTable<String, int> >("FlatHashTable<String, int>", skeys, slookups, smisses, errh);
+}
+#endif
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(FlatHashTableTest)
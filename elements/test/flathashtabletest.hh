@@ -0,0 +1,59 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLATHASHTABLETEST_HH
+#define CLICK_FLATHASHTABLETEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FlatHashTableTest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for FlatHashTable<K, V>
+
+=d
+
+FlatHashTableTest runs FlatHashTable regression tests at initialization time.
+It does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Boolean.  User-level only.  If true, also time insertions, successful and
+unsuccessful lookups, and erasures of N integer keys and N string keys in
+FlatHashTable and HashTable, and report the nanoseconds per operation.
+Default is false.
+
+=item N
+
+Unsigned integer.  Number of keys in the benchmark.  Default is 1000000.
+
+=back
+
+=a HashTableTest */
+
+class FlatHashTableTest : public Element { public:
+
+    FlatHashTableTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "FlatHashTableTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+
+  private:
+
+    bool _benchmark;
+    uint32_t _n;
+
+    void benchmark(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,89 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hdrhistogramtest.{cc,hh} -- regression test element for HdrHistogram
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hdrhistogramtest.hh"
+#include <click/hdrhistogram.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+HdrHistogramTest::HdrHistogramTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+int
+HdrHistogramTest::initialize(ErrorHandler *errh)
+{
+    // buckets are contiguous, and every value maps into its bucket
+    CHECK(HdrHistogram::lowest_equivalent(0) == 0);
+    for (int i = 0; i < HdrHistogram::nbuckets; ++i) {
+	uint64_t lo = HdrHistogram::lowest_equivalent(i),
+	    hi = HdrHistogram::highest_equivalent(i);
+	CHECK(lo <= hi);
+	CHECK(HdrHistogram::index_of(lo) == i);
+	CHECK(HdrHistogram::index_of(hi) == i);
+	CHECK(hi - lo <= lo / 64);
+	if (i + 1 < HdrHistogram::nbuckets)
+	    CHECK(HdrHistogram::lowest_equivalent(i + 1) == hi + 1);
+    }
+    CHECK(HdrHistogram::highest_equivalent(HdrHistogram::nbuckets - 1)
+	  == ((uint64_t) 1 << HdrHistogram::max_value_bits) - 1);
+    CHECK(HdrHistogram::index_of(~(uint64_t) 0) == HdrHistogram::nbuckets - 1);
+
+    HdrHistogram *h = new HdrHistogram;
+    CHECK(h->count() == 0 && h->min() == 0 && h->max() == 0);
+    CHECK(h->value_at_percentile(500000) == 0);
+
+    // small values are exact
+    for (uint64_t v = 1; v <= 100; ++v)
+	h->add(v);
+    CHECK(h->count() == 100 && h->sum() == 5050);
+    CHECK(h->min() == 1 && h->max() == 100 && h->mean() == 50);
+    CHECK(h->value_at_percentile(0) == 1);
+    CHECK(h->value_at_percentile(500000) == 50);
+    CHECK(h->value_at_percentile(990000) == 99);
+    CHECK(h->value_at_percentile(999000) == 100);
+    CHECK(h->value_at_percentile(1000000) == 100);
+
+    // large values are within the bucket error, and capped by max
+    h->clear();
+    h->add(1000000, 99);
+    h->add(20000000);
+    uint64_t p50 = h->value_at_percentile(500000);
+    CHECK(p50 >= 1000000 && p50 <= 1000000 + 1000000 / 64);
+    CHECK(h->value_at_percentile(990000) == p50);
+    CHECK(h->value_at_percentile(995000) == 20000000);
+    CHECK(h->max() == 20000000);
+
+    // merging adds counts and combines extremes
+    HdrHistogram *h2 = new HdrHistogram;
+    h2->add(5);
+    h2->add(30000000);
+    h->merge(*h2);
+    CHECK(h->count() == 102);
+    CHECK(h->min() == 5 && h->max() == 30000000);
+    CHECK(h->value_at_percentile(0) == 5);
+    CHECK(h->sum() == 99000000 + 20000000 + 5 + 30000000);
+    delete h2;
+    delete h;
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+EXPORT_ELEMENT(HdrHistogramTest)
+CLICK_ENDDECLS
@@ -0,0 +1,34 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HDRHISTOGRAMTEST_HH
+#define CLICK_HDRHISTOGRAMTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HdrHistogramTest()
+
+=s test
+
+runs regression tests for HdrHistogram
+
+=d
+
+HdrHistogramTest runs HdrHistogram regression tests at initialization time.
+It does not route packets.
+
+*/
+
+class HdrHistogramTest : public Element { public:
+
+    HdrHistogramTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "HdrHistogramTest"; }
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
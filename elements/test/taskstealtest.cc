@@ -0,0 +1,174 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * taskstealtest.{cc,hh} -- stress test for work stealing
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "taskstealtest.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/args.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+TaskStealTest::TaskStealTest()
+    : _generator(generator_callback, this), _workers(0), _stats(0),
+      _nworkers(8), _npinned(2), _limit(100000), _burst(256), _batch(16),
+      _spin(200), _stop(false), _generated(0), _sink(0)
+{
+    _done = 0;
+    _errors = 0;
+}
+
+int
+TaskStealTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _nworkers)
+	.read("PINNED", _npinned)
+	.read("LIMIT", _limit)
+	.read("BURST", _burst)
+	.read("BATCH", _batch)
+	.read("SPIN", _spin)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (_nworkers == 0 || _burst == 0 || _batch == 0)
+	return errh->error("N, BURST, and BATCH must be positive");
+    if (_npinned > _nworkers)
+	return errh->error("PINNED must be no greater than N");
+    return 0;
+}
+
+int
+TaskStealTest::initialize(ErrorHandler *)
+{
+    _workers = new Worker[_nworkers];
+    for (unsigned i = 0; i < _nworkers; ++i) {
+	Worker &w = _workers[i];
+	w.owner = this;
+	w.pending = 0;
+	w.running = 0;
+	w.task.set_stealable(i >= _npinned);
+	w.task.initialize(this, false);
+	w.home = w.task.home_thread_id();
+    }
+    _stats = new tst_stat[master()->nthreads()];
+    _generator.initialize(this, true);
+    return 0;
+}
+
+void
+TaskStealTest::cleanup(CleanupStage)
+{
+    delete[] _workers;
+    delete[] _stats;
+    _workers = 0;
+    _stats = 0;
+}
+
+bool
+TaskStealTest::generator_callback(Task *t, void *user_data)
+{
+    TaskStealTest *e = static_cast<TaskStealTest *>(user_data);
+    if (e->_generated < e->_limit) {
+	Worker &w = e->_workers[click_random() % e->_nworkers];
+	uint32_t n = 1 + click_random() % e->_burst;
+	if (n > e->_limit - e->_generated)
+	    n = e->_limit - e->_generated;
+	e->_generated += n;
+	w.pending += n;
+	w.task.reschedule();
+	t->fast_reschedule();
+	return true;
+    }
+
+    uint32_t done = e->_done.value();
+    if (done > e->_limit) {
+	click_chatter("%{element}: processed %u units, expected %u", e, done, e->_limit);
+	++e->_errors;
+    } else if (done < e->_limit) {
+	t->fast_reschedule();
+	return false;
+    }
+    if (e->_stop)
+	e->router()->please_stop_driver();
+    return false;
+}
+
+bool
+TaskStealTest::worker_callback(Task *, void *user_data)
+{
+    Worker *w = static_cast<Worker *>(user_data);
+    return w->owner->run_worker(w);
+}
+
+bool
+TaskStealTest::run_worker(Worker *w)
+{
+    if (w->running.compare_swap(0, 1) != 0) {
+	click_chatter("%{element}: worker running on two threads", this);
+	++_errors;
+	return false;
+    }
+    int tid = w->task.thread()->thread_id();
+    if (!w->task.stealable() && tid != w->home) {
+	click_chatter("%{element}: pinned worker ran on thread %d", this, tid);
+	++_errors;
+    }
+
+    uint32_t n = w->pending.value();
+    if (n > _batch)
+	n = _batch;
+    for (uint32_t i = 0; i < n * _spin; ++i)
+	_sink = _sink + i;
+    w->pending -= n;
+    _done += n;
+    ++_stats[tid].runs;
+
+    w->running = 0;
+    if (w->pending.value())
+	w->task.fast_reschedule();
+    return n != 0;
+}
+
+String
+TaskStealTest::read_handler(Element *e, void *user_data)
+{
+    TaskStealTest *t = static_cast<TaskStealTest *>(e);
+    switch ((intptr_t) user_data) {
+    case h_done:
+	return String(t->_done.value());
+    case h_errors:
+	return String(t->_errors.value());
+    default: {
+	StringAccum sa;
+	for (int i = 0; i < t->master()->nthreads(); ++i)
+	    sa << (i ? " " : "") << t->_stats[i].runs;
+	return sa.take_string();
+    }
+    }
+}
+
+void
+TaskStealTest::add_handlers()
+{
+    add_read_handler("done", read_handler, h_done);
+    add_read_handler("errors", read_handler, h_errors);
+    add_read_handler("runs", read_handler, h_runs);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(multithread)
+EXPORT_ELEMENT(TaskStealTest)
@@ -0,0 +1,138 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TASKSTEALTEST_HH
+#define CLICK_TASKSTEALTEST_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TaskStealTest([I<keywords>])
+
+=s test
+
+runs work stealing stress test
+
+=d
+
+TaskStealTest is a stress test for work stealing (see StealingThreadSched).
+It creates N worker tasks on its home thread, PINNED of which are not
+stealable, and a generator task that hands bursts of 1 to BURST work units
+to random workers until LIMIT units have been handed out.  Each worker
+processes at most BATCH units per run, spinning SPIN iterations per unit.
+When all the work is done, TaskStealTest stops the driver if STOP is true.
+
+TaskStealTest checks that no worker ever runs on two threads at once, that
+pinned workers never leave the home thread, and that every unit handed out
+is processed exactly once.  Violations are counted in the C<errors>
+handler.
+
+TaskStealTest does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Unsigned integer.  Number of worker tasks.  Default is 8.
+
+=item PINNED
+
+Unsigned integer.  Number of workers that may not be stolen.  Default is 2.
+
+=item LIMIT
+
+Unsigned integer.  Total number of work units.  Default is 100000.
+
+=item BURST
+
+Unsigned integer.  Maximum units per burst.  Default is 256.
+
+=item BATCH
+
+Unsigned integer.  Maximum units a worker processes per run.  Default is 16.
+
+=item SPIN
+
+Unsigned integer.  Spin iterations per unit.  Default is 200.
+
+=item STOP
+
+Boolean.  Stop the driver when all the work is done.  Default is false.
+
+=back
+
+=h done read-only
+
+Returns the number of units processed.
+
+=h errors read-only
+
+Returns the number of correctness violations found.
+
+=h runs read-only
+
+Space-separated array of counters: how many times a worker ran on each
+thread.
+
+=a
+
+StealingThreadSched, TaskThreadTest
+*/
+
+class TaskStealTest : public Element { public:
+
+    TaskStealTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "TaskStealTest"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    struct Worker {
+	TaskStealTest *owner;
+	Task task;
+	atomic_uint32_t pending;
+	atomic_uint32_t running;
+	int home;
+	Worker() : task(worker_callback, this) { }
+    };
+    struct tst_stat {
+	uint64_t runs;
+	uint64_t padding[7];
+	tst_stat() : runs(0) { }
+    };
+
+    Task _generator;
+    Worker *_workers;
+    tst_stat *_stats;
+    unsigned _nworkers;
+    unsigned _npinned;
+    uint32_t _limit;
+    uint32_t _burst;
+    uint32_t _batch;
+    uint32_t _spin;
+    bool _stop;
+    uint32_t _generated;
+    atomic_uint32_t _done;
+    atomic_uint32_t _errors;
+    volatile uint32_t _sink;
+
+    static bool generator_callback(Task *, void *);
+    static bool worker_callback(Task *, void *);
+    bool run_worker(Worker *w);
+
+    enum { h_done, h_errors, h_runs };
+    static String read_handler(Element *, void *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
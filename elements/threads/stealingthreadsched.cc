@@ -0,0 +1,135 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * stealingthreadsched.{cc,hh} -- enable work stealing between threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "stealingthreadsched.hh"
+#include <click/task.hh>
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+StealingThreadSched::StealingThreadSched()
+    : _next_thread_sched(0), _active(true)
+{
+}
+
+int
+StealingThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(this, errh).bind(conf)
+	.read("ACTIVE", _active)
+	.consume() < 0)
+	return -1;
+
+    _stealable.assign(router()->nelements(), false);
+    for (int i = 0; i < conf.size(); i++) {
+	String ename;
+	if (Args(this, errh).push_back_words(conf[i])
+	    .read_mp("ELEMENT", ename)
+	    .complete() < 0)
+	    return -1;
+	bool found = false;
+	if (Element *e = router()->find(ename, this))
+	    _stealable[e->eindex()] = found = true;
+	else if (ename) {
+	    String prefix = router()->ename_context(eindex()) + ename + "/";
+	    for (int j = 0; j != router()->nelements(); ++j)
+		if (router()->ename(j).starts_with(prefix))
+		    _stealable[j] = found = true;
+	}
+	if (!found)
+	    return errh->error("%<%s%> does not name an element", ename.c_str());
+    }
+
+    _next_thread_sched = router()->thread_sched();
+    router()->set_thread_sched(this);
+    return 0;
+}
+
+int
+StealingThreadSched::initialize(ErrorHandler *)
+{
+    master()->set_work_stealing(_active);
+    return 0;
+}
+
+int
+StealingThreadSched::initial_home_thread_id(const Element *e)
+{
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_home_thread_id(e);
+    else
+	return THREAD_UNKNOWN;
+}
+
+bool
+StealingThreadSched::initial_task_stealable(const Element *e)
+{
+    int eidx = e->eindex();
+    if (eidx >= 0 && eidx < _stealable.size() && _stealable[eidx])
+	return true;
+    return _next_thread_sched && _next_thread_sched->initial_task_stealable(e);
+}
+
+String
+StealingThreadSched::read_handler(Element *e, void *user_data)
+{
+    Master *m = e->master();
+    uint64_t steals = 0, returns = 0;
+    StringAccum sa;
+    for (int tid = 0; tid < m->nthreads(); ++tid) {
+	RouterThread *t = m->thread(tid);
+	steals += t->steals();
+	returns += t->steal_returns();
+	sa << tid << ' ' << t->steals() << ' ' << t->steal_returns() << '\n';
+    }
+    switch ((intptr_t) user_data) {
+    case h_active:
+	return String(m->work_stealing());
+    case h_steals:
+	return String(steals);
+    case h_returns:
+	return String(returns);
+    default:
+	return sa.take_string();
+    }
+}
+
+int
+StealingThreadSched::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    StealingThreadSched *ss = static_cast<StealingThreadSched *>(e);
+    if (!BoolArg().parse(str, ss->_active))
+	return errh->error("syntax error");
+    ss->master()->set_work_stealing(ss->_active);
+    return 0;
+}
+
+void
+StealingThreadSched::add_handlers()
+{
+    add_read_handler("active", read_handler, h_active);
+    add_write_handler("active", write_handler, h_active);
+    add_read_handler("steals", read_handler, h_steals);
+    add_read_handler("returns", read_handler, h_returns);
+    add_read_handler("thread_steals", read_handler, h_thread_steals);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(multithread)
+EXPORT_ELEMENT(StealingThreadSched)
@@ -0,0 +1,98 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_STEALINGTHREADSCHED_HH
+#define CLICK_STEALINGTHREADSCHED_HH
+#include <click/element.hh>
+#include <click/standard/threadsched.hh>
+CLICK_DECLS
+
+/*
+=c
+
+StealingThreadSched([ELEMENT, ..., I<keyword> ACTIVE])
+
+=s threads
+
+enables work stealing between threads
+
+=d
+
+Turns on work stealing.  When a thread has no tasks to run, it asks for
+work; the next busy thread to notice, meaning one with at least two
+scheduled tasks, hands it one of its stealable tasks.  A stolen task returns
+to its home thread as soon as it runs without doing any work or unschedules
+itself, so tasks keep their StaticThreadSched placement except during
+bursts.  Compared with BalancedThreadSched, which moves tasks once a
+second, stealing reacts within one scheduling round.
+
+The tasks of each ELEMENT are stealable.  ELEMENT may also name a compound
+element, making all the tasks inside it stealable.  Only list elements
+whose tasks are safe to run on any thread, such as Unqueue or ToDevice
+elements that pull from a ThreadSafeQueue.  Elements may also mark their
+tasks stealable themselves.
+
+Keyword arguments are:
+
+=over 8
+
+=item ACTIVE
+
+Boolean.  If false, do not steal work until the C<active> handler is set to
+true.  Default is true.
+
+=back
+
+=h active read/write
+
+Returns or sets whether work stealing is on.  Work stealing is a property of
+the driver, so this affects every router it runs.
+
+=h steals read-only
+
+Returns the number of tasks stolen since the driver started.
+
+=h returns read-only
+
+Returns the number of stolen tasks sent back to their home threads.
+
+=h thread_steals read-only
+
+Returns one line per thread: the thread ID, the number of tasks the thread
+stole, and the number of stolen tasks it sent home.
+
+=e
+
+  FromDevice(eth0) -> q :: ThreadSafeQueue -> uq :: Unqueue -> ...;
+  StaticThreadSched(uq 1);
+  StealingThreadSched(uq);
+
+=a
+
+StaticThreadSched, BalancedThreadSched, ThreadSafeQueue */
+
+class StealingThreadSched : public Element, public ThreadSched { public:
+
+    StealingThreadSched() CLICK_COLD;
+
+    const char *class_name() const	{ return "StealingThreadSched"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    int initial_home_thread_id(const Element *e);
+    bool initial_task_stealable(const Element *e);
+
+  private:
+
+    Vector<bool> _stealable;
+    ThreadSched *_next_thread_sched;
+    bool _active;
+
+    enum { h_active, h_steals, h_returns, h_thread_steals };
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -33,7 +33,7 @@
 #include <fcntl.h>
 CLICK_DECLS
 
-const char ControlSocket::protocol_version[] = "1.3";
+const char ControlSocket::protocol_version[] = "1.4";
 
 class ControlSocketErrorHandler : public ErrorHandler { public:
 
@@ -302,6 +302,13 @@ ControlSocket::take_state(Element *e, ErrorHandler *errh)
     cs->_socket_fd = -1;
     _conns.swap(cs->_conns);
 
+    // streams refer to the old router's handlers, so end them here
+    for (connection **it = _conns.begin(); it != _conns.end(); ++it)
+	if (*it && (*it)->stream_h) {
+	    (*it)->stream_h = 0;
+	    (*it)->message(CSERR_UNSPECIFIED, "Read handler '" + (*it)->stream_name + "' interrupted by hotswap");
+	}
+
     if (_socket_fd >= 0)
 	add_select(_socket_fd, SELECT_READ);
     for (connection **it = _conns.begin(); it != _conns.end(); ++it) {
@@ -534,6 +541,52 @@ ControlSocket::read_command(connection &conn, const String &handlername, String
   return 0;
 }
 
+int
+ControlSocket::read_stream_command(connection &conn, const String &handlername)
+{
+  Element *e;
+  const Handler* h = parse_handler(conn, handlername, &e);
+  if (!h)
+    return ANY_ERR;
+  else if (!h->read_visible())
+    return conn.message(CSERR_PERMISSION, "Handler '" + handlername + "' write-only");
+
+  conn.stream_h = h;
+  conn.stream_e = e;
+  conn.stream_name = handlername;
+  conn.stream_cursor = 0;
+  return stream_chunk(conn, true);
+}
+
+int
+ControlSocket::stream_chunk(connection &conn, bool first)
+{
+  // collect errors from proxy
+  ControlSocketErrorHandler errh;
+  _proxied_handler = conn.stream_h->name();
+  _proxied_errh = &errh;
+  _stream_sa.clear();
+  int r = conn.stream_h->call_read_chunk(conn.stream_e, _stream_sa, conn.stream_cursor, &errh);
+  _proxied_errh = 0;
+
+  if (r < 0 || errh.nerrors() > 0) {
+    conn.stream_h = 0;
+    return conn.transfer_messages(CSERR_UNSPECIFIED, "Read handler '" + conn.stream_name + "' error", &errh);
+  }
+
+  if (first)
+    conn.message(CSERR_OK, "Read handler '" + conn.stream_name + "' OK");
+  if (_stream_sa.length()) {
+    conn.out_text << "DATA " << _stream_sa.length() << '\r' << '\n';
+    conn.out_text.append(_stream_sa.data(), _stream_sa.length());
+  }
+  if (r == 0) {
+    conn.out_text << "DATA 0" << '\r' << '\n';
+    conn.stream_h = 0;
+  }
+  return 0;
+}
+
 int
 ControlSocket::write_command(connection &conn, const String &handlername, String data)
 {
@@ -754,6 +807,11 @@ ControlSocket::parse_command(connection &conn, const String &line)
       else
 	  return write_command(conn, words[1], data);
 
+  } else if (command == "READSTREAM") {
+      if (words.size() != 2)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      return read_stream_command(conn, words[1]);
+
   } else if (command == "CHECKREAD" || command == "CHECKWRITE") {
       if (words.size() != 2)
 	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
@@ -784,6 +842,7 @@ ControlSocket::parse_command(connection &conn, const String &line)
     conn.message(CSERR_OK, "READ handler [arg...]   call read handler, return DATA", true);
     conn.message(CSERR_OK, "READDATA handler len    call read handler with len data bytes, return DATA", true);
     conn.message(CSERR_OK, "READUNTIL handler term  call read handler, take data until term, return DATA", true);
+    conn.message(CSERR_OK, "READSTREAM handler      call read handler, return DATA chunks ending with DATA 0", true);
     conn.message(CSERR_OK, "WRITE handler [arg...]  call write handler", true);
     conn.message(CSERR_OK, "WRITEDATA handler len   call write handler, pass len data bytes", true);
     conn.message(CSERR_OK, "WRITEUNTIL handler term call write handler, take data until term", true);
@@ -856,8 +915,9 @@ ControlSocket::selected(int fd, int)
 
     // parse commands
     // 16.Jun.2004: process only one command each time through
+    // Commands wait while a READSTREAM is in progress.
     bool blocked = false;
-    if (conn->in_text.length()) {
+    if (conn->in_text.length() && !conn->stream_h) {
 	const char *in_text = conn->in_text.begin() + conn->inpos;
 	const char *in_end = conn->in_text.end();
 	const char *line_end = in_text;
@@ -889,13 +949,19 @@ ControlSocket::selected(int fd, int)
 	    blocked = true;
     }
 
+    // produce the next chunk of a stream once the previous one is written,
+    // so memory use stays bounded and the router runs between chunks
+    else if (conn->stream_h && !conn->out_text.length())
+	stream_chunk(*conn, false);
+
     // write data until blocked
     // The 2nd argument causes write events to remain selected when commands
     // remain to be processed (whether or not CS has data to write).
-    conn->flush_write(this, conn->in_text.length() && !blocked);
+    conn->flush_write(this, (conn->in_text.length() && !blocked) || conn->stream_h);
 
     // maybe close out
-    if ((conn->in_closed && !conn->in_text.length() && !conn->out_text.length())
+    if ((conn->in_closed && !conn->in_text.length() && !conn->out_text.length()
+	 && !conn->stream_h)
 	|| conn->out_closed) {
 	remove_select(conn->fd, SELECT_READ | SELECT_WRITE);
 	close(conn->fd);
@@ -39,8 +39,8 @@ The server will accept lines terminated by CR, LF, or CRLF. Its response
 lines are always terminated by CRLF.
 
 When a connection is opened, the server responds by stating its protocol
-version number with a line like "Click::ControlSocket/1.3". The current
-version number is 1.3. Changes in minor version number will only add commands
+version number with a line like "Click::ControlSocket/1.4". The current
+version number is 1.4. Changes in minor version number will only add commands
 and functionality to this specification, not change existing functionality.
 
 ControlSocket supports hot-swapping, meaning you can change configurations
@@ -136,6 +136,20 @@ for a terminator, ControlSocket removes trailing spaces from both
 I<terminator> and the input lines. Introduced in version 1.3 of the
 ControlSocket protocol.
 
+=item READSTREAM I<handler>
+
+Call a read I<handler> and return its results in chunks.  The server responds
+with a message line, then with any number of "DATA I<n>" lines, each followed
+by I<n> bytes of the value, and finally with "DATA 0".  Handlers that produce
+their values incrementally, such as the C<table> handlers of the IP rewriter
+elements, are called once per chunk, and the next chunk is only produced
+after the previous one has been written to the socket.  This keeps memory use
+bounded for very large values and lets the router run between chunks; the
+value may thus reflect changes made while it was being read.  If the handler
+fails after the first chunk, the stream ends with an error message line
+instead of "DATA 0".  No other command is processed until the stream ends.
+Introduced in version 1.4 of the ControlSocket protocol.
+
 =item WRITE I<handler> I<params...>
 
 Call a write I<handler>, passing the I<params>, if any, as arguments.
@@ -275,9 +289,14 @@ class ControlSocket : public Element { public:
 	int outpos;
 	bool in_closed;
 	bool out_closed;
+	const Handler *stream_h;
+	Element *stream_e;
+	String stream_name;
+	uint64_t stream_cursor;
 	connection(int fd_)
 	    : fd(fd_), inpos(0), outpos(0),
-	      in_closed(false), out_closed(false) {
+	      in_closed(false), out_closed(false),
+	      stream_h(0), stream_e(0), stream_cursor(0) {
 	}
 	int message(int code, const String &msg, bool continuation = false);
 	int transfer_messages(int default_code, const String &msg, ControlSocketErrorHandler *);
@@ -290,6 +309,7 @@ class ControlSocket : public Element { public:
 
     String _proxied_handler;
     ErrorHandler *_proxied_errh;
+    StringAccum _stream_sa;
 
     int _retries;
     Timer *_retry_timer;
@@ -306,6 +326,8 @@ class ControlSocket : public Element { public:
     String proxied_handler_name(const String &) const;
     const Handler* parse_handler(connection &conn, const String &, Element **);
     int read_command(connection &conn, const String &, String);
+    int read_stream_command(connection &conn, const String &);
+    int stream_chunk(connection &conn, bool first);
     int write_command(connection &conn, const String &, String);
     int check_command(connection &conn, const String &, bool write);
     int llrpc_command(connection &conn, const String &, String);
@@ -27,6 +27,12 @@
 #include <click/glue.hh>
 #include <clicknet/ether.h>
 #include <click/standard/scheduleinfo.hh>
+#include <click/packet_anno.hh>
+#include <click/master.hh>
+#include <clicknet/ip.h>
+#include <clicknet/ip6.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -55,6 +61,30 @@
 #if HAVE_NET_IF_TAP_H
 # include <net/if_tap.h>
 #endif
+#if KERNELTUN_LINUX && defined(IFF_VNET_HDR)
+# define KERNELTUN_VNET 1
+// <linux/virtio_net.h> is not C++-safe (it has a member named "class"), so
+// declare the fixed-layout header prepended by IFF_VNET_HDR here.
+struct virtio_net_hdr {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+};
+# define VIRTIO_NET_HDR_F_NEEDS_CSUM	1
+# define VIRTIO_NET_HDR_GSO_NONE	0
+# define VIRTIO_NET_HDR_GSO_TCPV4	1
+# define VIRTIO_NET_HDR_GSO_UDP_L4	5
+# define VIRTIO_NET_HDR_GSO_TCPV6	4
+# define VIRTIO_NET_HDR_GSO_ECN		0x80
+// newer than some installed headers
+# ifndef TUN_F_USO4
+#  define TUN_F_USO4 0x20
+#  define TUN_F_USO6 0x40
+# endif
+#endif
 
 #if defined(__NetBSD__)
 # include <sys/param.h>
@@ -70,12 +100,14 @@ CLICK_DECLS
 KernelTun::KernelTun()
     : _fd(-1), _tap(false), _task(this), _ignore_q_errs(false),
       _printed_write_err(false), _printed_read_err(false),
-      _selected_calls(0), _packets(0)
+      _n_queues(1), _thread_offset(0), _vnet_hdr(false)
 {
 }
 
 KernelTun::~KernelTun()
 {
+    for (int i = 0; i < _rxqs.size(); ++i)
+	delete _rxqs[i];
 }
 
 void *
@@ -96,6 +128,7 @@ KernelTun::configure(Vector<String> &conf, ErrorHandler *errh)
     _headroom += (4 - _headroom % 4) % 4; // default 4/0 alignment
     _mtu_out = DEFAULT_MTU;
     _burst = 1;
+    String n_queues = "1";
     if (Args(conf, this, errh)
 	.read_mp("ADDR", IPPrefixArg(), _near, _mask)
 	.read_p("GATEWAY", _gw)
@@ -108,10 +141,26 @@ KernelTun::configure(Vector<String> &conf, ErrorHandler *errh)
 #if KERNELTUN_LINUX
 	.read("DEV_NAME", Args::deprecated, _dev_name)
 	.read("DEVNAME", _dev_name)
+	.read("N_QUEUES", WordArg(), n_queues)
+	.read("THREAD_OFFSET", _thread_offset)
+	.read("VNET_HDR", _vnet_hdr)
 #endif
 	.complete() < 0)
 	return -1;
 
+    if (n_queues == "all")
+	_n_queues = master()->nthreads();
+    else if (!IntArg().parse(n_queues, _n_queues) || _n_queues < 1)
+	return errh->error("N_QUEUES should be a positive integer or \"all\"");
+#if !defined(IFF_MULTI_QUEUE)
+    if (_n_queues > 1)
+	return errh->error("N_QUEUES not supported on this system");
+#endif
+#if !KERNELTUN_VNET
+    if (_vnet_hdr)
+	return errh->error("VNET_HDR not supported on this system");
+#endif
+
     if (_gw && !_gw.matches_prefix(_near, _mask))
 	return errh->error("bad GATEWAY");
     if (_burst < 1)
@@ -128,27 +177,61 @@ KernelTun::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 KernelTun::try_linux_universal()
 {
-    int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
-    if (fd < 0)
-	return -errno;
-
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    ifr.ifr_flags = (_tap ? IFF_TAP : IFF_TUN);
-    if (_dev_name)
-	// Setting ifr_name allows us to select an arbitrary interface name.
-	strncpy(ifr.ifr_name, _dev_name.c_str(), sizeof(ifr.ifr_name));
-    int err = ioctl(fd, TUNSETIFF, (void *)&ifr);
-    if (err < 0) {
-	close(fd);
-	return -errno;
+    Vector<int> fds;
+    String dev_name = _dev_name;
+    for (unsigned i = 0; i < _n_queues; ++i) {
+	int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (fd >= 0) {
+	    fds.push_back(fd);
+	    struct ifreq ifr;
+	    memset(&ifr, 0, sizeof(ifr));
+	    ifr.ifr_flags = (_tap ? IFF_TAP : IFF_TUN);
+#ifdef IFF_MULTI_QUEUE
+	    if (_n_queues > 1)
+		ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#endif
+#if KERNELTUN_VNET
+	    if (_vnet_hdr)
+		ifr.ifr_flags |= IFF_VNET_HDR;
+#endif
+	    if (dev_name)
+		// Setting ifr_name allows us to select an arbitrary interface
+		// name.  Later queues attach to the first queue's interface.
+		strncpy(ifr.ifr_name, dev_name.c_str(), sizeof(ifr.ifr_name));
+	    if (ioctl(fd, TUNSETIFF, (void *)&ifr) >= 0) {
+		dev_name = ifr.ifr_name;
+		continue;
+	    }
+	}
+	int err = errno;
+	for (int j = 0; j < fds.size(); ++j)
+	    close(fds[j]);
+	return -err;
     }
 
-    _dev_name = ifr.ifr_name;
-    _fd = fd;
+    _dev_name = dev_name;
+    _fd = fds[0];
+    for (int i = 0; i < fds.size(); ++i)
+	_rxqs.push_back(new RXQueue(this, fds[i]));
     _type = LINUX_UNIVERSAL;
     return 0;
 }
+
+int
+KernelTun::set_offloads(ErrorHandler *errh)
+{
+#if KERNELTUN_VNET
+    // We can take partial checksums and TCP super-packets, and UDP
+    // super-packets if the kernel knows about them.
+    unsigned offloads = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+    if (ioctl(_fd, TUNSETOFFLOAD, offloads | TUN_F_USO4 | TUN_F_USO6) != 0
+	&& ioctl(_fd, TUNSETOFFLOAD, offloads) != 0)
+	return errh->error("TUNSETOFFLOAD failed: %s", strerror(errno));
+#else
+    (void) errh;
+#endif
+    return 0;
+}
 #endif
 
 int
@@ -161,6 +244,7 @@ KernelTun::try_tun(const String &dev_name, ErrorHandler *)
 
     _dev_name = dev_name;
     _fd = fd;
+    _rxqs.push_back(new RXQueue(this, fd));
     return 0;
 }
 
@@ -420,6 +504,13 @@ KernelTun::setup_tun(ErrorHandler *errh)
     }
 #endif
 
+#if KERNELTUN_LINUX
+    if ((_n_queues > 1 || _vnet_hdr) && _type != LINUX_UNIVERSAL)
+	return errh->error("N_QUEUES and VNET_HDR require the Linux Universal TUN/TAP driver");
+    if (_vnet_hdr && set_offloads(errh) < 0)
+	return -1;
+#endif
+
     // set addresses and MTU
     if (updown(_near, _mask, errh) < 0)
 	return -1;
@@ -455,6 +546,12 @@ KernelTun::setup_tun(ErrorHandler *errh)
     else /* _type == LINUX_ETHERTAP */
 	_mtu_in = _mtu_out + 16;
 
+#if KERNELTUN_VNET
+    // room for the virtio-net header and for super-packets
+    if (_vnet_hdr)
+	_mtu_in = 4 + sizeof(struct virtio_net_hdr) + (_tap ? 14 : 0) + 0xFFFF;
+#endif
+
     return 0;
 }
 
@@ -470,40 +567,95 @@ KernelTun::initialize(ErrorHandler *errh)
 	_signal = Notifier::upstream_empty_signal(this, 0, &_task);
     }
     if (_adjust_headroom) {
+	// align the IP header after any link prefix
+	int prefix = 4;
+#if KERNELTUN_VNET
+	if (_vnet_hdr)
+	    prefix += sizeof(struct virtio_net_hdr);
+#endif
 	if (_tap && _type == LINUX_UNIVERSAL)
-	    _headroom += (4 - (_headroom + 2) % 4) % 4; // default 4/2 alignment
+	    _headroom += (4 - (_headroom + prefix + 14) % 4) % 4; // default 4/2 alignment
+	else if (_type == LINUX_UNIVERSAL)
+	    _headroom += (4 - (_headroom + prefix) % 4) % 4; // default 4/0 alignment
 	else
 	    _headroom += (4 - _headroom % 4) % 4; // default 4/0 alignment
     }
-    add_select(_fd, SELECT_READ);
+
+    // Each queue is read by its own task; the queue's thread selects on
+    // its descriptor while the task is idle.
+    int nthreads = master()->nthreads();
+    if (_rxqs.size() > nthreads)
+	errh->warning("%d queues share %d threads", _rxqs.size(), nthreads);
+    for (int i = 0; i < _rxqs.size(); ++i) {
+	RXQueue *q = _rxqs[i];
+	int thread_id = (_thread_offset + i) % nthreads;
+	q->task.initialize(this, false);
+	q->task.move_thread(thread_id);
+	q->select_thread = master()->thread(thread_id);
+	q->select_thread->select_set().add_select(q->fd, this, SELECT_READ);
+    }
     return 0;
 }
 
 void
 KernelTun::cleanup(CleanupStage)
 {
+    for (int i = 0; i < _rxqs.size(); ++i) {
+	RXQueue *q = _rxqs[i];
+	if (q->select_thread)
+	    q->select_thread->select_set().remove_select(q->fd, this, SELECT_READ);
+	if (q->fd != _fd)
+	    close(q->fd);
+    }
     if (_fd >= 0) {
 	if (_type != LINUX_UNIVERSAL && _type != NETBSD_TAP)
 	    updown(0, ~0, ErrorHandler::default_handler());
 	close(_fd);
-	remove_select(_fd, SELECT_READ);
     }
 }
 
 void
 KernelTun::selected(int fd, int)
+{
+    for (int i = 0; i < _rxqs.size(); ++i) {
+	RXQueue *q = _rxqs[i];
+	if (q->fd == fd && q->select_thread) {
+	    ++q->selected_calls;
+	    // stop selecting until the task has drained the queue
+	    q->select_thread->select_set().remove_select(fd, this, SELECT_READ);
+	    q->select_thread = 0;
+	    q->task.reschedule();
+	    return;
+	}
+    }
+}
+
+bool
+KernelTun::rx_task(Task *, void *user_data)
+{
+    RXQueue *q = static_cast<RXQueue *>(user_data);
+    return q->kt->rx_burst(*q);
+}
+
+bool
+KernelTun::rx_burst(RXQueue &q)
 {
     Timestamp now = Timestamp::now();
-    if (fd != _fd)
-	return;
-    ++_selected_calls;
-    unsigned n = _burst;
-    while (n > 0 && one_selected(now))
-	--n;
+    unsigned n = 0;
+    while (n < _burst && one_selected(q, now))
+	++n;
+    if (n == _burst)
+	// probably more to read
+	q.task.fast_reschedule();
+    else {
+	q.select_thread = q.task.thread();
+	q.select_thread->select_set().add_select(q.fd, this, SELECT_READ);
+    }
+    return n > 0;
 }
 
 bool
-KernelTun::one_selected(const Timestamp &now)
+KernelTun::one_selected(RXQueue &q, const Timestamp &now)
 {
     WritablePacket *p = Packet::make(_headroom, 0, _mtu_in, 0);
     if (!p) {
@@ -511,25 +663,32 @@ KernelTun::one_selected(const Timestamp &now)
 	return false;
     }
 
-    int cc = read(_fd, p->data(), _mtu_in);
+    int cc = read(q.fd, p->data(), _mtu_in);
     if (cc > 0) {
-	++_packets;
+	++q.packets;
 	p->take(_mtu_in - cc);
 	bool ok = false;
 
 	if (_tap) {
-	    if (_type == LINUX_UNIVERSAL)
-		// 2-byte padding, 2-byte Ethernet type, then Ethernet header
+	    if (_type == LINUX_UNIVERSAL) {
+		// 2-byte padding, 2-byte Ethernet type, [virtio-net header,]
+		// then Ethernet header
 		p->pull(4);
-	    else if (_type == LINUX_ETHERTAP)
-		// 2-byte padding, then Ethernet header
-		p->pull(2);
-	    ok = true;
+		ok = !_vnet_hdr || vnet_receive(p);
+	    } else {
+		if (_type == LINUX_ETHERTAP)
+		    // 2-byte padding, then Ethernet header
+		    p->pull(2);
+		ok = true;
+	    }
 	} else if (_type == LINUX_UNIVERSAL) {
-	    // 2-byte padding followed by an Ethernet type
+	    // 2-byte padding followed by an Ethernet type[, then the
+	    // virtio-net header]
 	    uint16_t etype = *(uint16_t *)(p->data() + 2);
 	    p->pull(4);
-	    if (etype != htons(ETHERTYPE_IP) && etype != htons(ETHERTYPE_IP6))
+	    if (_vnet_hdr && !vnet_receive(p))
+		/* bad virtio-net header */;
+	    else if (etype != htons(ETHERTYPE_IP) && etype != htons(ETHERTYPE_IP6))
 		checked_output_push(1, p->clone());
 	    else
 		ok = fake_pcap_force_ip(p, FAKE_DLT_RAW);
@@ -616,19 +775,44 @@ KernelTun::push(int, Packet *p)
 	check_length = p->length();
     }
 
-    // check MTU
-    if (check_length > _mtu_out) {
+    // remember link information before the packet changes
+    int ip_v = (iph ? iph->ip_v : 0);
+    uint16_t tap_ethertype = (_tap ? ((const click_ether *) p->data())->ether_type : 0);
+
+    WritablePacket *q;
+#if KERNELTUN_VNET
+    struct virtio_net_hdr vh;
+    if (_vnet_hdr && !vnet_transmit(p, _tap ? sizeof(click_ether) : 0, vh)) {
+	click_chatter("%s(%s): out of memory", class_name(), _dev_name.c_str());
+	return;
+    }
+#endif
+
+    // check MTU; the kernel segments super-packets
+    if (check_length > _mtu_out
+#if KERNELTUN_VNET
+	&& !(_vnet_hdr && vh.gso_type != VIRTIO_NET_HDR_GSO_NONE)
+#endif
+	) {
 	click_chatter("%s(%s): packet larger than MTU (%d)", class_name(), _dev_name.c_str(), _mtu_out);
 	goto kill;
     }
 
-    WritablePacket *q;
-    if (_tap) {
+#if KERNELTUN_VNET
+    if (_vnet_hdr) {
+	if ((q = p->push(sizeof(vh))))
+	    memcpy(q->data(), &vh, sizeof(vh));
+	p = q;
+    }
+#endif
+    if (!p)
+	/* out of memory */;
+    else if (_tap) {
 	if (_type == LINUX_UNIVERSAL) {
-	    // 2-byte padding, 2-byte Ethernet type, then Ethernet header
-	    uint16_t ethertype = ((const click_ether *) p->data())->ether_type;
+	    // 2-byte padding, 2-byte Ethernet type, [virtio-net header,]
+	    // then Ethernet header
 	    if ((q = p->push(4)))
-		((uint16_t *) q->data())[1] = ethertype;
+		((uint16_t *) q->data())[1] = tap_ethertype;
 	    p = q;
 	} else if (_type == LINUX_ETHERTAP) {
 	    // 2-byte padding, then Ethernet header
@@ -637,18 +821,19 @@ KernelTun::push(int, Packet *p)
 	    /* existing packet is OK */;
 	}
     } else if (_type == LINUX_UNIVERSAL) {
-	// 2-byte padding followed by an Ethernet type
-	uint32_t ethertype = (iph->ip_v == 4 ? htonl(ETHERTYPE_IP) : htonl(ETHERTYPE_IP6));
+	// 2-byte padding followed by an Ethernet type[, then the virtio-net
+	// header]
+	uint32_t ethertype = (ip_v == 4 ? htonl(ETHERTYPE_IP) : htonl(ETHERTYPE_IP6));
 	if ((q = p->push(4)))
 	    *(uint32_t *)(q->data()) = ethertype;
 	p = q;
     } else if (_type == BSD_TUN) {
-	uint32_t af = (iph->ip_v == 4 ? htonl(AF_INET) : htonl(AF_INET6));
+	uint32_t af = (ip_v == 4 ? htonl(AF_INET) : htonl(AF_INET6));
 	if ((q = p->push(4)))
 	    *(uint32_t *)(q->data()) = af;
 	p = q;
     } else if (_type == LINUX_ETHERTAP) {
-	uint16_t ethertype = (iph->ip_v == 4 ? htons(ETHERTYPE_IP) : htons(ETHERTYPE_IP6));
+	uint16_t ethertype = (ip_v == 4 ? htons(ETHERTYPE_IP) : htons(ETHERTYPE_IP6));
 	if ((q = p->push(16))) {
 	    /* ethertap driver is very picky about what address we use
 	     * here. e.g. if we have the wrong address, linux might ignore
@@ -663,7 +848,9 @@ KernelTun::push(int, Packet *p)
     }
 
     if (p) {
-	int w = write(_fd, p->data(), p->length());
+	// with several queues, write to the one belonging to this CPU
+	int fd = _rxqs.size() > 1 ? _rxqs[click_current_cpu_id() % _rxqs.size()]->fd : _fd;
+	int w = write(fd, p->data(), p->length());
 	if (w != (int) p->length() && (errno != ENOBUFS || !_ignore_q_errs || !_printed_write_err)) {
 	    _printed_write_err = true;
 	    click_chatter("%s(%s): write failed: %s", class_name(), _dev_name.c_str(), strerror(errno));
@@ -673,14 +860,141 @@ KernelTun::push(int, Packet *p)
 	click_chatter("%s(%s): out of memory", class_name(), _dev_name.c_str());
 }
 
+#if KERNELTUN_VNET
+/* Parses and removes the virtio-net header at the front of p.  Partial
+ * checksums are completed, so that the packet is valid as it stands, and
+ * super-packets get their segment size in the GSO_SIZE annotation. */
+bool
+KernelTun::vnet_receive(WritablePacket *p)
+{
+    struct virtio_net_hdr vh;
+    if (p->length() < sizeof(vh))
+	return false;
+    memcpy(&vh, p->data(), sizeof(vh));
+    p->pull(sizeof(vh));
+
+    if (vh.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+	// the checksum field holds the pseudo-header sum
+	unsigned start = vh.csum_start, offset = start + vh.csum_offset;
+	if (offset + 2 > p->length())
+	    return false;
+	uint16_t csum = click_in_cksum(p->data() + start, p->length() - start);
+	if (csum == 0 && vh.csum_offset == offsetof(click_udp, uh_sum))
+	    csum = 0xFFFF;
+	memcpy(p->data() + offset, &csum, 2);
+    }
+    // the annotation bytes are shared, so always set them
+    if ((vh.gso_type & ~VIRTIO_NET_HDR_GSO_ECN) != VIRTIO_NET_HDR_GSO_NONE)
+	SET_GSO_SIZE_ANNO(p, vh.gso_size);
+    else
+	SET_GSO_SIZE_ANNO(p, 0);
+    return true;
+}
+
+/* Fills in the virtio-net header for p, whose IP header starts at
+ * l3_offset.  A super-packet, a TCP or UDP packet with a GSO_SIZE
+ * annotation and more than one segment's worth of payload, is handed to the
+ * kernel with a partial checksum and segmentation instructions.  The
+ * annotation shares bytes with others, so it is ignored unless a segment
+ * with its headers fits in the MTU; such packets get GSO_NONE and are
+ * subject to the usual MTU check.  Returns false on allocation failure, in
+ * which case p is gone. */
+bool
+KernelTun::vnet_transmit(Packet *&p, int l3_offset, struct virtio_net_hdr &vh)
+{
+    memset(&vh, 0, sizeof(vh));
+    unsigned gso_size = GSO_SIZE_ANNO(p);
+    if (!gso_size)
+	return true;
+
+    // find the transport header
+    const unsigned char *l3 = p->data() + l3_offset;
+    unsigned l3_len = p->length() - l3_offset, l4_offset, addr_offset, addr_len;
+    int ip_v = (l3_len ? l3[0] >> 4 : 0), proto;
+    if (ip_v == 4 && l3_len >= sizeof(click_ip)) {
+	const click_ip *iph = reinterpret_cast<const click_ip *>(l3);
+	proto = iph->ip_p;
+	l4_offset = l3_offset + (iph->ip_hl << 2);
+	addr_offset = l3_offset + offsetof(click_ip, ip_src);
+	addr_len = 4;
+    } else if (ip_v == 6 && l3_len >= sizeof(click_ip6)) {
+	const click_ip6 *ip6h = reinterpret_cast<const click_ip6 *>(l3);
+	proto = ip6h->ip6_nxt;
+	l4_offset = l3_offset + sizeof(click_ip6);
+	addr_offset = l3_offset + offsetof(click_ip6, ip6_src);
+	addr_len = 16;
+    } else
+	return true;
+
+    unsigned hdr_len, gso_type, csum_offset;
+    if (proto == IP_PROTO_TCP && l4_offset + sizeof(click_tcp) <= p->length()) {
+	hdr_len = l4_offset + (p->data()[l4_offset + 12] >> 4) * 4;
+	gso_type = (ip_v == 4 ? VIRTIO_NET_HDR_GSO_TCPV4 : VIRTIO_NET_HDR_GSO_TCPV6);
+	csum_offset = offsetof(click_tcp, th_sum);
+    } else if (proto == IP_PROTO_UDP && l4_offset + sizeof(click_udp) <= p->length()) {
+	hdr_len = l4_offset + sizeof(click_udp);
+	gso_type = VIRTIO_NET_HDR_GSO_UDP_L4;
+	csum_offset = offsetof(click_udp, uh_sum);
+    } else
+	return true;
+
+    if (hdr_len > p->length()
+	|| hdr_len - l3_offset + gso_size > (unsigned) _mtu_out
+	|| p->length() - hdr_len <= gso_size)
+	// bogus annotation, or fits in one segment
+	return true;
+
+    WritablePacket *q = p->uniqueify();
+    if (!(p = q))
+	return false;
+    vh.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    vh.gso_type = gso_type;
+    vh.csum_offset = csum_offset;
+    vh.hdr_len = hdr_len;
+    vh.gso_size = gso_size;
+    vh.csum_start = l4_offset;
+
+    // replace the checksum with the pseudo-header sum; source and
+    // destination addresses are adjacent in both IPv4 and IPv6 headers
+    uint32_t sum = htons(proto) + htons(q->length() - l4_offset);
+    const uint16_t *addrs = reinterpret_cast<const uint16_t *>(q->data() + addr_offset);
+    for (unsigned i = 0; i < addr_len; ++i)
+	sum += addrs[i];
+    while (sum >> 16)
+	sum = (sum & 0xFFFF) + (sum >> 16);
+    uint16_t csum = sum;
+    memcpy(q->data() + l4_offset + vh.csum_offset, &csum, 2);
+    return true;
+}
+#else
+bool
+KernelTun::vnet_receive(WritablePacket *)
+{
+    return false;
+}
+#endif
+
+String
+KernelTun::read_handler(Element *e, void *user_data)
+{
+    KernelTun *kt = static_cast<KernelTun *>(e);
+    click_uint_large_t n = 0;
+    for (int i = 0; i < kt->_rxqs.size(); ++i)
+	if ((intptr_t) user_data == h_packets)
+	    n += kt->_rxqs[i]->packets;
+	else
+	    n += kt->_rxqs[i]->selected_calls;
+    return String(n);
+}
+
 void
 KernelTun::add_handlers()
 {
     if (input_is_pull(0))
 	add_task_handlers(&_task);
     add_data_handlers("dev_name", Handler::OP_READ, &_dev_name);
-    add_data_handlers("selected_calls", Handler::OP_READ, &_selected_calls);
-    add_data_handlers("packets", Handler::OP_READ, &_packets);
+    add_read_handler("selected_calls", read_handler, h_selected_calls);
+    add_read_handler("packets", read_handler, h_packets);
 }
 
 CLICK_ENDDECLS
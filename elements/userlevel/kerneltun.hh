@@ -5,12 +5,13 @@
 #include <click/etheraddress.hh>
 #include <click/task.hh>
 #include <click/notifier.hh>
+struct virtio_net_hdr;
 CLICK_DECLS
 
 /*
 =c
 
-KernelTun(ADDR/MASK [, GATEWAY, I<keywords> HEADROOM, ETHER, MTU, IGNORE_QUEUE_OVERFLOWS])
+KernelTun(ADDR/MASK [, GATEWAY, I<keywords> HEADROOM, ETHER, MTU, IGNORE_QUEUE_OVERFLOWS, N_QUEUES, VNET_HDR])
 
 =s comm
 
@@ -42,7 +43,8 @@ Keyword arguments are:
 
 =item BURST
 
-Integer. The maximum number of packets to emit per scheduling. Default is 1.
+Integer. The maximum number of packets to read and emit per task run.
+Default is 1.
 
 =item HEADROOM
 
@@ -73,6 +75,34 @@ String. If specified, try to alloc a tun device with name DEVNAME.
 Otherwise, we'll just take the first virtual device we find. This option
 only works with the Linux Universal TUN/TAP driver.
 
+=item N_QUEUES
+
+Integer, or C<all>.  Number of device queues to open.  With more than one,
+the device is created with IFF_MULTI_QUEUE, and the kernel spreads packets
+across the queues by flow.  Each queue has its own file descriptor and its
+own reading task; the task for the I<i>th queue runs on Click thread
+(THREAD_OFFSET + I<i>) modulo the number of threads.  C<all> means one
+queue per Click thread.  Packets sent to KernelTun are written to a queue
+chosen by the sending CPU.  Requires the Linux Universal TUN/TAP driver.
+Default is 1.
+
+=item THREAD_OFFSET
+
+Integer.  See N_QUEUES.  Default is 0.
+
+=item VNET_HDR
+
+Boolean.  If true, exchange packets with the kernel using virtio-net
+headers (IFF_VNET_HDR) and enable checksum and segmentation offloads.  The
+kernel may then pass up TCP and UDP super-packets of up to 64KB with
+partial checksums.  KernelTun completes their checksums and sets their
+GSO_SIZE annotation to the segment size (zero for other packets).  In the
+other direction, TCP and UDP packets with a nonzero GSO_SIZE annotation may
+exceed MTU; they are handed to the kernel as a single buffer to be
+segmented.  The annotation is ignored if one segment plus headers would not
+fit in MTU.  Requires the Linux Universal
+TUN/TAP driver.  Default is false.
+
 =back
 
 =n
@@ -100,6 +130,22 @@ and C<ping> should print Click's responses.
 This element differs from KernelTap in that it produces and expects IP
 packets, not IP-in-Ethernet packets.
 
+With N_QUEUES greater than 1, KernelTun pushes packets from several threads
+at once, so downstream elements must be thread safe.
+
+=h dev_name read-only
+
+Returns the name of the device.
+
+=h packets read-only
+
+Returns the number of packets read from the device, summed over all queues.
+
+=h selected_calls read-only
+
+Returns the number of times the device became readable, summed over all
+queues.
+
 =a
 
 FromDevice.u, ToDevice.u, KernelTap, ifconfig(8) */
@@ -133,7 +179,7 @@ class KernelTun : public Element { public:
     enum Type { LINUX_UNIVERSAL, LINUX_ETHERTAP, BSD_TUN, BSD_TAP, OSX_TUN,
 		NETBSD_TUN, NETBSD_TAP };
 
-    int _fd;
+    int _fd;			// first queue's descriptor
     int _mtu_in;
     int _mtu_out;
     Type _type;
@@ -153,17 +199,40 @@ class KernelTun : public Element { public:
     bool _printed_read_err;
     bool _adjust_headroom;
 
-    click_uint_large_t _selected_calls;
-    click_uint_large_t _packets;
+    struct RXQueue {
+	RXQueue(KernelTun *e, int f)
+	    : task(rx_task, this), kt(e), fd(f), select_thread(0),
+	      selected_calls(0), packets(0) {
+	}
+	Task task;
+	KernelTun *kt;
+	int fd;
+	RouterThread *select_thread;	// thread selecting on fd, if any
+	click_uint_large_t selected_calls;
+	click_uint_large_t packets;
+    };
+
+    Vector<RXQueue *> _rxqs;
+    unsigned _n_queues;
+    unsigned _thread_offset;
+    bool _vnet_hdr;
 
 #if HAVE_LINUX_IF_TUN_H
     int try_linux_universal();
+    int set_offloads(ErrorHandler *);
 #endif
     int try_tun(const String &, ErrorHandler *);
     int alloc_tun(ErrorHandler *);
     int setup_tun(ErrorHandler *);
     int updown(IPAddress, IPAddress, ErrorHandler *);
-    bool one_selected(const Timestamp &now);
+    static bool rx_task(Task *, void *);
+    bool rx_burst(RXQueue &);
+    bool one_selected(RXQueue &, const Timestamp &now);
+    bool vnet_receive(WritablePacket *);
+    bool vnet_transmit(Packet *&, int l3_offset, struct virtio_net_hdr &);
+
+    enum { h_packets, h_selected_calls };
+    static String read_handler(Element *, void *) CLICK_COLD;
 
     friend class KernelTap;
 
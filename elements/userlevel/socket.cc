@@ -31,6 +31,9 @@
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 #include <fcntl.h>
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+# include <netinet/udp.h>
+#endif
 #include "socket.hh"
 
 #ifdef HAVE_PROPER
@@ -39,13 +42,25 @@
 
 CLICK_DECLS
 
+// most segments the kernel accepts in one UDP_SEGMENT send
+#define SOCKET_GSO_MAX_SEGMENTS	64
+// largest UDP payload in one IPv4 datagram
+#define SOCKET_GSO_MAX_BYTES	65507
+
 Socket::Socket()
   : _task(this),
     _fd(-1), _active(-1), _rq(0), _wq(0),
     _local_port(0), _local_pathname(""),
     _timestamp(true), _sndbuf(-1), _rcvbuf(-1),
     _snaplen(2048), _headroom(Packet::default_headroom), _nodelay(1),
-    _verbose(false), _client(false), _proper(false), _allow(0), _deny(0)
+    _verbose(false), _client(false), _proper(false), _allow(0), _deny(0),
+    _burst(1), _gro(false), _gso(false)
+#if HAVE_RECVMMSG
+    , _rmsg(0), _riov(0), _rfrom(0), _rcmsg(0), _rqv(0)
+#endif
+#if HAVE_SENDMMSG
+    , _wmsg(0), _wiov(0), _wto(0), _wcmsg(0), _wqv(0), _nwqv(0)
+#endif
 {
 }
 
@@ -76,9 +91,15 @@ Socket::configure(Vector<String> &conf, ErrorHandler *errh)
       .read("PROPER", _proper)
       .read("ALLOW", allow)
       .read("DENY", deny)
+      .read("BURST", _burst)
+      .read("GRO", _gro)
+      .read("GSO", _gso)
       .consume() < 0)
     return -1;
 
+  if (_burst < 1)
+    return errh->error("BURST must be at least 1");
+
   if (allow && !(_allow = (IPRouteTable *)allow->cast("IPRouteTable")))
     return errh->error("%s is not an IPRouteTable", allow->name().c_str());
 
@@ -119,6 +140,9 @@ Socket::configure(Vector<String> &conf, ErrorHandler *errh)
   else
     return errh->error("unknown socket type `%s'", socktype.c_str());
 
+  if ((_gro || _gso) && _protocol != IPPROTO_UDP)
+    return errh->error("GRO and GSO require a UDP socket");
+
   return 0;
 }
 
@@ -189,6 +213,9 @@ Socket::initialize(ErrorHandler *errh)
     if (setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &_rcvbuf, sizeof(_rcvbuf)) < 0)
       return initialize_socket_error(errh, "setsockopt(SO_RCVBUF)");
 
+  if (_socktype == SOCK_DGRAM && initialize_batch(errh) < 0)
+    return -1;
+
   // if a server, then the first arguments should be interpreted as
   // the address/port/file to bind() to, not to connect() to
   if (!_client) {
@@ -253,6 +280,65 @@ Socket::initialize(ErrorHandler *errh)
   return 0;
 }
 
+int
+Socket::initialize_batch(ErrorHandler *errh)
+{
+  bool pull_input = ninputs() && input_is_pull(0);
+  _gro = _gro && noutputs();
+  _gso = _gso && pull_input;
+
+  // probe for kernel support
+#if HAVE_RECVMMSG && defined(UDP_GRO)
+  int one = 1;
+  if (_gro && setsockopt(_fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+    errh->warning("setsockopt(UDP_GRO): %s, GRO disabled", strerror(errno));
+    _gro = false;
+  }
+#else
+  if (_gro) {
+    errh->warning("GRO not supported on this platform");
+    _gro = false;
+  }
+#endif
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+  int zero = 0;
+  if (_gso && setsockopt(_fd, IPPROTO_UDP, UDP_SEGMENT, &zero, sizeof(zero)) < 0) {
+    errh->warning("setsockopt(UDP_SEGMENT): %s, GSO disabled", strerror(errno));
+    _gso = false;
+  }
+#else
+  if (_gso) {
+    errh->warning("GSO not supported on this platform");
+    _gso = false;
+  }
+#endif
+
+#if HAVE_RECVMMSG
+  if (noutputs() && (_burst > 1 || _gro)) {
+    _rmsg = new struct mmsghdr[_burst];
+    _riov = new struct iovec[_burst];
+    _rfrom = new struct sockaddr_storage[_burst];
+    _rcmsg = new char[_burst * CMSG_SPACE(sizeof(int))];
+    _rqv = new WritablePacket *[_burst];
+    if (!_rmsg || !_riov || !_rfrom || !_rcmsg || !_rqv)
+      return errh->error("out of memory");
+    memset(_rqv, 0, sizeof(WritablePacket *) * _burst);
+  }
+#endif
+#if HAVE_SENDMMSG
+  if (pull_input && _burst > 1) {
+    _wmsg = new struct mmsghdr[_burst];
+    _wiov = new struct iovec[_burst];
+    _wto = new struct sockaddr_storage[_burst];
+    _wcmsg = new char[_burst * CMSG_SPACE(sizeof(uint16_t))];
+    _wqv = new Packet *[_burst];
+    if (!_wmsg || !_wiov || !_wto || !_wcmsg || !_wqv)
+      return errh->error("out of memory");
+  }
+#endif
+  return 0;
+}
+
 void
 Socket::cleanup(CleanupStage)
 {
@@ -264,6 +350,28 @@ Socket::cleanup(CleanupStage)
     _rq->kill();
   if (_wq)
     _wq->kill();
+#if HAVE_RECVMMSG
+  for (unsigned i = 0; _rqv && i < _burst; i++)
+    if (_rqv[i])
+      _rqv[i]->kill();
+  delete[] _rmsg;
+  delete[] _riov;
+  delete[] _rfrom;
+  delete[] _rcmsg;
+  delete[] _rqv;
+  _rqv = 0;
+#endif
+#if HAVE_SENDMMSG
+  for (unsigned i = 0; i < _nwqv; i++)
+    _wqv[i]->kill();
+  _nwqv = 0;
+  delete[] _wmsg;
+  delete[] _wiov;
+  delete[] _wto;
+  delete[] _wcmsg;
+  delete[] _wqv;
+  _wqv = 0;
+#endif
   if (_fd >= 0) {
     // shut down the listening socket in case we forked
 #ifdef SHUT_RDWR
@@ -347,18 +455,31 @@ Socket::selected(int fd, int)
     }
 
     // read data from socket
-    if (!_rq)
-      _rq = Packet::make(_headroom, 0, _snaplen, 0);
-    if (_rq) {
+#if HAVE_RECVMMSG
+    if (_rmsg) {
+      if (receive_batch() < 0) {
+	if (_verbose)
+	  click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+	close_active();
+	return;
+      }
+    } else
+#endif
+    for (unsigned i = 0; i < _burst; i++) {
+      if (!_rq)
+	_rq = Packet::make(_headroom, 0, _snaplen, 0);
+      if (!_rq)
+	break;
       if (_socktype == SOCK_STREAM)
 	len = read(_active, _rq->data(), _rq->length());
-      else if (_client)
-	len = recv(_active, _rq->data(), _rq->length(), MSG_TRUNC);
       else {
-	// datagram server, find out who we are talking to
+	// datagram socket, find out who we are talking to
+	from_len = sizeof(from);
 	len = recvfrom(_active, _rq->data(), _rq->length(), MSG_TRUNC, (struct sockaddr *)&from, &from_len);
 
-	if (_family == AF_INET && !allowed(IPAddress(from.in.sin_addr))) {
+	if (_client)
+	  /* nothing */;
+	else if (_family == AF_INET && !allowed(IPAddress(from.in.sin_addr))) {
 	  if (_verbose)
 	    click_chatter("%s: dropped datagram from %s:%d", declaration().c_str(),
 			  IPAddress(from.in.sin_addr).unparse().c_str(), ntohs(from.in.sin_port));
@@ -372,21 +493,9 @@ Socket::selected(int fd, int)
 
       // this segment OK
       if (len > 0) {
-	if (len > _snaplen) {
-	  // truncate packet to max length (should never happen)
-	  assert(_rq->length() == (uint32_t)_snaplen);
-	  SET_EXTRA_LENGTH_ANNO(_rq, len - _snaplen);
-	} else {
-	  // trim packet to actual length
-	  _rq->take(_snaplen - len);
-	}
-
-	// set timestamp
-	if (_timestamp)
-	  _rq->timestamp_anno().assign_now();
-
-	// push packet
-	output(0).push(_rq);
+	push_received(_rq, len, _snaplen,
+		      _socktype == SOCK_DGRAM ? (struct sockaddr *)&from : 0,
+		      _timestamp ? Timestamp::now() : Timestamp());
 	_rq = 0;
       }
 
@@ -397,6 +506,9 @@ Socket::selected(int fd, int)
 	close_active();
 	return;
       }
+
+      else
+	break;
     }
   }
 
@@ -404,6 +516,105 @@ Socket::selected(int fd, int)
     run_task(0);
 }
 
+void
+Socket::push_received(WritablePacket *p, int len, int buflen,
+		      const struct sockaddr *from, const Timestamp &now)
+{
+  if (len > _snaplen) {
+    // truncate packet to max length
+    p->take(buflen - _snaplen);
+    SET_EXTRA_LENGTH_ANNO(p, len - _snaplen);
+  } else
+    // trim packet to actual length
+    p->take(buflen - len);
+
+  // set timestamp
+  if (_timestamp)
+    p->timestamp_anno() = now;
+
+  // remember the sender
+  if (from && from->sa_family == AF_INET)
+    p->set_dst_ip_anno(((const struct sockaddr_in *)from)->sin_addr);
+
+  output(0).push(p);
+}
+
+#if HAVE_RECVMMSG
+int
+Socket::receive_batch()
+{
+  // With GRO, one buffer may hold many datagrams from the same sender.
+  int buflen = _gro ? 65535 : _snaplen;
+  unsigned n;
+  for (n = 0; n < _burst; n++) {
+    if (!_rqv[n] && !(_rqv[n] = Packet::make(_headroom, 0, buflen, 0)))
+      break;
+    _riov[n].iov_base = _rqv[n]->data();
+    _riov[n].iov_len = buflen;
+    struct msghdr &m = _rmsg[n].msg_hdr;
+    m.msg_name = &_rfrom[n];
+    m.msg_namelen = sizeof(_rfrom[n]);
+    m.msg_iov = &_riov[n];
+    m.msg_iovlen = 1;
+    m.msg_control = _gro ? _rcmsg + n * CMSG_SPACE(sizeof(int)) : 0;
+    m.msg_controllen = _gro ? CMSG_SPACE(sizeof(int)) : 0;
+    m.msg_flags = 0;
+  }
+  if (n == 0)
+    return 0;
+
+  int r = recvmmsg(_active, _rmsg, n, MSG_TRUNC, 0);
+  if (r < 0)
+    return errno == EAGAIN || errno == EINTR ? 0 : -1;
+
+  Timestamp now = _timestamp ? Timestamp::now() : Timestamp();
+  for (int i = 0; i < r; i++) {
+    struct msghdr &m = _rmsg[i].msg_hdr;
+    const struct sockaddr *from = (const struct sockaddr *)&_rfrom[i];
+    int len = _rmsg[i].msg_len;
+
+    if (_client)
+      /* nothing */;
+    else if (_family == AF_INET && !allowed(IPAddress(((const struct sockaddr_in *)from)->sin_addr))) {
+      if (_verbose)
+	click_chatter("%s: dropped datagram from %s", declaration().c_str(),
+		      IPAddress(((const struct sockaddr_in *)from)->sin_addr).unparse().c_str());
+      continue;
+    } else {
+      memcpy(&_remote, from, m.msg_namelen);
+      _remote_len = m.msg_namelen;
+    }
+
+    int seglen = 0;
+#ifdef UDP_GRO
+    if (_gro)
+      for (struct cmsghdr *c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c))
+	if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO
+	    && c->cmsg_len >= CMSG_LEN(sizeof(int))) {
+	  // the kernel reports the segment size as an int
+	  int gso_size;
+	  memcpy(&gso_size, CMSG_DATA(c), sizeof(gso_size));
+	  seglen = gso_size;
+	}
+#endif
+
+    if (seglen > 0 && len > seglen) {
+      // split a coalesced buffer; keep the buffer for the next call
+      for (int off = 0; off < len; off += seglen) {
+	int l = len - off < seglen ? len - off : seglen;
+	int caplen = l < _snaplen ? l : _snaplen;
+	if (WritablePacket *q = Packet::make(_headroom, _rqv[i]->data() + off, caplen, 0))
+	  push_received(q, l, caplen, from, now);
+      }
+    } else {
+      push_received(_rqv[i], len, buflen, from, now);
+      _rqv[i] = 0;
+    }
+  }
+  return r;
+}
+#endif
+
 int
 Socket::write_packet(Packet *p)
 {
@@ -481,10 +692,130 @@ Socket::push(int, Packet *p)
     p->kill();
 }
 
+#if HAVE_SENDMMSG
+bool
+Socket::run_task_batch()
+{
+  if (_active < 0)
+    return false;
+
+  // fill the burst, keeping packets left over from a short send
+  bool any = false;
+  while (_nwqv < _burst)
+    if (Packet *p = input(0).pull()) {
+      _wqv[_nwqv++] = p;
+      any = true;
+    } else
+      break;
+  if (!_nwqv) {
+    remove_select(_active, SELECT_WRITE);
+    return any;
+  }
+
+  // one message per packet, or per run of packets with GSO
+  bool use_anno = !IPAddress(_remote_ip) && _client && _family == AF_INET;
+  unsigned nmsg = 0;
+  for (unsigned k = 0, j; k < _nwqv; k = j, nmsg++) {
+    Packet *p = _wqv[k];
+    struct msghdr &m = _wmsg[nmsg].msg_hdr;
+    if (use_anno) {
+      // send to the packet's IP destination annotation
+      memcpy(&_wto[nmsg], &_remote, _remote_len);
+      ((struct sockaddr_in *)&_wto[nmsg])->sin_addr = p->dst_ip_anno();
+      m.msg_name = &_wto[nmsg];
+    } else
+      m.msg_name = &_remote;
+    m.msg_namelen = _remote_len;
+
+    uint32_t seglen = p->length(), total = seglen;
+    _wiov[k].iov_base = const_cast<unsigned char *>(p->data());
+    _wiov[k].iov_len = seglen;
+    for (j = k + 1; _gso && j < _nwqv && j - k < SOCKET_GSO_MAX_SEGMENTS; j++) {
+      Packet *q = _wqv[j];
+      if (_wqv[j - 1]->length() != seglen || q->length() > seglen
+	  || !q->length() || total + q->length() > SOCKET_GSO_MAX_BYTES
+	  || (use_anno && q->dst_ip_anno() != p->dst_ip_anno()))
+	break;
+      _wiov[j].iov_base = const_cast<unsigned char *>(q->data());
+      _wiov[j].iov_len = q->length();
+      total += q->length();
+    }
+    m.msg_iov = &_wiov[k];
+    m.msg_iovlen = j - k;
+    m.msg_flags = 0;
+
+#ifdef UDP_SEGMENT
+    if (j - k > 1) {
+      m.msg_control = _wcmsg + nmsg * CMSG_SPACE(sizeof(uint16_t));
+      m.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+      struct cmsghdr *c = CMSG_FIRSTHDR(&m);
+      c->cmsg_level = IPPROTO_UDP;
+      c->cmsg_type = UDP_SEGMENT;
+      c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t gso_size = seglen;
+      memcpy(CMSG_DATA(c), &gso_size, sizeof(gso_size));
+    } else
+#endif
+    {
+      m.msg_control = 0;
+      m.msg_controllen = 0;
+    }
+  }
+
+  int r = sendmmsg(_active, _wmsg, nmsg, 0);
+  if (r < 0) {
+    if (errno == EINTR) {
+      _task.reschedule();
+      return any;
+    } else if (errno == ENOBUFS || errno == EAGAIN) {
+      // wait until the socket is writable
+      add_select(_active, SELECT_WRITE);
+      return any;
+    } else if (errno == EIO && _gso) {
+      // the device cannot segment; fall back to one packet per message
+      click_chatter("%s: %s, GSO disabled", declaration().c_str(), strerror(errno));
+      _gso = false;
+      _task.reschedule();
+      return any;
+    }
+    if (_verbose)
+      click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+    close_active();
+    for (unsigned i = 0; i < _nwqv; i++)
+      _wqv[i]->kill();
+    _nwqv = 0;
+    return any;
+  }
+
+  // free the packets that were sent
+  unsigned sent = 0;
+  for (int i = 0; i < r; i++)
+    sent += _wmsg[i].msg_hdr.msg_iovlen;
+  for (unsigned i = 0; i < sent; i++)
+    _wqv[i]->kill();
+  memmove(_wqv, _wqv + sent, (_nwqv - sent) * sizeof(Packet *));
+  _nwqv -= sent;
+
+  if (_nwqv)
+    // short send: wait until the socket is writable
+    add_select(_active, SELECT_WRITE);
+  else if (_signal)
+    // more pending
+    _task.reschedule();
+  else
+    remove_select(_active, SELECT_WRITE);
+  return true;
+}
+#endif
+
 bool
 Socket::run_task(Task *)
 {
   assert(ninputs() && input_is_pull(0));
+#if HAVE_SENDMMSG
+  if (_wmsg)
+    return run_task_batch();
+#endif
   bool any = false;
 
   if (_active >= 0) {
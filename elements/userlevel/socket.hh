@@ -141,8 +141,35 @@ Boolean. PlanetLab specific. If true and Click has been configured
 
 Integer. Per-packet headroom. Defaults to 28.
 
+=item BURST
+
+Unsigned integer. Maximum number of packets to receive, or to send from a
+"pull" input, per socket operation. On datagram sockets where the system
+provides recvmmsg() and sendmmsg(), a burst is received or sent with a
+single system call. Default is 1.
+
+=item GRO
+
+Boolean. Applies to UDP sockets only. If set, ask the kernel to coalesce
+received datagrams from the same sender into larger buffers (UDP_GRO),
+which Socket splits back into separate packets. Ignored, with a warning,
+if the kernel does not support it. Default is false.
+
+=item GSO
+
+Boolean. Applies to UDP sockets with "pull" inputs only. If set, hand the
+kernel each run of equal-length packets for the same destination within a
+burst (up to 64 packets) as one buffer to be segmented (UDP_SEGMENT); the
+last packet in a run may be shorter. Ignored, with a warning, if the kernel
+does not support it. Default is false.
+
 =back
 
+Packets received on AF_INET datagram sockets have their destination IP
+annotation set to the sender's address. A client UDP Socket with a zero IP
+address, which sends to the destination IP annotation, will therefore
+return them to their sender's host.
+
 =e
 
   // A server socket
@@ -160,6 +187,12 @@ Integer. Per-packet headroom. Defaults to 28.
   // A bi-directional client socket bound to a particular local port
   ... -> Socket(TCP, 1.2.3.4, 80, 0.0.0.0, 54321) -> ...
 
+  // A batched UDP server socket
+  Socket(UDP, 0.0.0.0, 4789, BURST 32, GRO true) -> ...
+
+  // A batched UDP client socket
+  ... -> Queue -> Socket(UDP, 1.2.3.4, 4789, BURST 32, GSO true)
+
   // A localhost server socket
   allow :: RadixIPLookup(127.0.0.1 0);
   deny :: RadixIPLookup(0.0.0.0/0	0);
@@ -235,7 +268,34 @@ private:
   IPRouteTable *_allow;		// lookup table of good hosts
   IPRouteTable *_deny;		// lookup table of bad hosts
 
+  unsigned _burst;		// packets per socket operation
+  bool _gro;			// receive coalesced UDP datagrams
+  bool _gso;			// send runs of UDP datagrams as one buffer
+
+#if HAVE_RECVMMSG
+  // batched receive state, one slot per burst entry
+  struct mmsghdr *_rmsg;
+  struct iovec *_riov;
+  struct sockaddr_storage *_rfrom;
+  char *_rcmsg;
+  WritablePacket **_rqv;
+#endif
+#if HAVE_SENDMMSG
+  // batched send state; _wqv holds pulled packets not yet sent
+  struct mmsghdr *_wmsg;
+  struct iovec *_wiov;
+  struct sockaddr_storage *_wto;
+  char *_wcmsg;
+  Packet **_wqv;
+  unsigned _nwqv;
+#endif
+
   int initialize_socket_error(ErrorHandler *, const char *);
+  int initialize_batch(ErrorHandler *) CLICK_COLD;
+  void push_received(WritablePacket *, int len, int buflen,
+		     const struct sockaddr *from, const Timestamp &now);
+  int receive_batch();
+  bool run_task_batch();
 
 };
 
@@ -23,11 +23,14 @@
 #include <click/glue.hh>
 #include <elements/wifi/path.hh>
 #include <click/straccum.hh>
+#include <click/heap.hh>
 CLICK_DECLS
 
 LinkTable::LinkTable()
-  : _timer(this)
+  : _full_runs(0), _incremental_runs(0), _incremental_hosts(0),
+    _incremental(true), _timer(this)
 {
+  _routes_valid[0] = _routes_valid[1] = false;
 }
 
 
@@ -40,6 +43,7 @@ LinkTable::~LinkTable()
 int
 LinkTable::initialize (ErrorHandler *)
 {
+  rebuild_graph();
   _timer.initialize(this);
   _timer.schedule_now();
   return 0;
@@ -69,6 +73,7 @@ LinkTable::configure (Vector<String> &conf, ErrorHandler *errh)
   ret = Args(conf, this, errh)
       .read("IP", _ip)
       .read("STALE", stale_period)
+      .read("INCREMENTAL", _incremental)
       .complete();
 
   if (!_ip)
@@ -88,6 +93,7 @@ LinkTable::take_state(Element *e, ErrorHandler *) {
 
   _hosts = q->_hosts;
   _links = q->_links;
+  rebuild_graph();
   dijkstra(true);
   dijkstra(false);
 }
@@ -137,7 +143,7 @@ LinkTable::clear()
 {
   _hosts.clear();
   _links.clear();
-
+  rebuild_graph();
 }
 bool
 LinkTable::update_link(IPAddress from, IPAddress to,
@@ -151,27 +157,21 @@ LinkTable::update_link(IPAddress from, IPAddress to,
   }
 
   /* make sure both the hosts exist */
-  HostInfo *nfrom = _hosts.findp(from);
-  if (!nfrom) {
-    HostInfo foo = HostInfo(from);
-    _hosts.insert(from, foo);
-    nfrom = _hosts.findp(from);
-  }
-  HostInfo *nto = _hosts.findp(to);
-  if (!nto) {
-    _hosts.insert(to, HostInfo(to));
-    nto = _hosts.findp(to);
-  }
-
-  assert(nfrom);
-  assert(nto);
+  int nfrom = host_index(from);
+  int nto = host_index(to);
 
   IPPair p = IPPair(from, to);
   LinkInfo *lnfo = _links.findp(p);
+  uint32_t old_metric = INFINITE_METRIC;
   if (!lnfo) {
     _links.insert(p, LinkInfo(from, to, seq, age, metric));
   } else {
+    old_metric = lnfo->_metric;
     lnfo->update(seq, age, metric);
+    metric = lnfo->_metric;
+  }
+  if (metric != old_metric) {
+    link_changed(nfrom, nto, old_metric, metric);
   }
   return true;
 }
@@ -459,11 +459,13 @@ void
 LinkTable::clear_stale() {
 
   LTable links;
+  bool removed = false;
   for (LTIter iter = _links.begin(); iter.live(); iter++) {
     LinkInfo nfo = iter.value();
     if ((unsigned) _stale_timeout.sec() >= nfo.age()) {
       links.insert(IPPair(nfo._from, nfo._to), nfo);
     } else {
+      removed = true;
       if (0) {
 	click_chatter("%p{element} :: %s removing link %s -> %s metric %d seq %d age %d\n",
 		      this,
@@ -483,6 +485,9 @@ LinkTable::clear_stale() {
     _links.insert(IPPair(nfo._from, nfo._to), nfo);
   }
 
+  if (removed) {
+    rebuild_graph();
+  }
 }
 
 Vector<IPAddress>
@@ -511,116 +516,266 @@ LinkTable::get_neighbors(IPAddress ip)
 
   return neighbors;
 }
-void
-LinkTable::dijkstra(bool from_me)
+/* Assigns ip a graph index, adding a host for it if necessary. */
+int
+LinkTable::host_index(IPAddress ip)
 {
-  Timestamp start = Timestamp::now();
-  IPAddress src = _ip;
-
-  typedef HashMap<IPAddress, bool> IPMap;
-  IPMap ip_addrs;
-
-  for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    ip_addrs.insert(iter.value()._ip, true);
+  HostInfo *nfo = _hosts.findp(ip);
+  if (!nfo) {
+    _hosts.insert(ip, HostInfo(ip));
+    nfo = _hosts.findp(ip);
+  }
+  if (nfo->_index < 0) {
+    nfo->_index = _index_ip.size();
+    _index_ip.push_back(ip);
+    _out.push_back(Vector<GraphLink>());
+    _in.push_back(Vector<GraphLink>());
+    for (int t = 0; t < 2; t++) {
+      _dist[t].push_back(INFINITE_METRIC);
+      _prev[t].push_back(-1);
+    }
+    if (ip == _ip) {
+      _routes_valid[0] = _routes_valid[1] = false;
+    }
   }
+  return nfo->_index;
+}
 
-  for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-    /* clear them all initially */
-    HostInfo *n = _hosts.findp(i.key());
-    n->clear(from_me);
+void
+LinkTable::rebuild_graph()
+{
+  _index_ip.clear();
+  for (HTable::iterator iter = _hosts.begin(); iter.live(); iter++) {
+    iter.value()._index = _index_ip.size();
+    _index_ip.push_back(iter.key());
+  }
+  int n = _index_ip.size();
+  _out.clear();
+  _out.resize(n);
+  _in.clear();
+  _in.resize(n);
+  for (LTIter iter = _links.begin(); iter.live(); iter++) {
+    const LinkInfo &nfo = iter.value();
+    HostInfo *from = _hosts.findp(nfo._from);
+    HostInfo *to = _hosts.findp(nfo._to);
+    if (from && to && nfo._metric) {
+      _out[from->_index].push_back(GraphLink(to->_index, nfo._metric));
+      _in[to->_index].push_back(GraphLink(from->_index, nfo._metric));
+    }
   }
-  HostInfo *root_info = _hosts.findp(src);
-
-
-  assert(root_info);
+  for (int t = 0; t < 2; t++) {
+    _dist[t].assign(n, INFINITE_METRIC);
+    _prev[t].assign(n, -1);
+    _routes_valid[t] = false;
+  }
+}
 
-  if (from_me) {
-    root_info->_prev_from_me = root_info->_ip;
-    root_info->_metric_from_me = 0;
+/* Sets the metric of the graph link from -> to, and returns its old
+ * metric, or INFINITE_METRIC if it is new. */
+uint32_t
+LinkTable::set_graph_link(int from, int to, uint32_t metric)
+{
+  uint32_t old_metric = INFINITE_METRIC;
+  GraphLink *l = _out[from].begin();
+  for (; l != _out[from].end() && l->_host != to; l++)
+    ;
+  if (l != _out[from].end()) {
+    old_metric = l->_metric;
+    l->_metric = metric;
   } else {
-    root_info->_prev_to_me = root_info->_ip;
-    root_info->_metric_to_me = 0;
+    _out[from].push_back(GraphLink(to, metric));
   }
+  for (l = _in[to].begin(); l != _in[to].end() && l->_host != from; l++)
+    ;
+  if (l != _in[to].end()) {
+    l->_metric = metric;
+  } else {
+    _in[to].push_back(GraphLink(from, metric));
+  }
+  return old_metric;
+}
 
-  IPAddress current_min_ip = root_info->_ip;
-
-  while (current_min_ip) {
-    HostInfo *current_min = _hosts.findp(current_min_ip);
-    assert(current_min);
-    if (from_me) {
-      current_min->_marked_from_me = true;
+void
+LinkTable::link_changed(int from, int to, uint32_t old_metric, uint32_t metric)
+{
+  set_graph_link(from, to, metric);
+  for (int t = 0; t < 2; t++) {
+    if (!_routes_valid[t]) {
+      continue;
+    }
+    if (_incremental) {
+      update_routes(t, from, to, old_metric, metric);
     } else {
-      current_min->_marked_to_me = true;
+      _routes_valid[t] = false;
     }
+  }
+}
 
-
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *neighbor = _hosts.findp(i.key());
-      assert(neighbor);
-      bool marked = neighbor->_marked_to_me;
-      if (from_me) {
-	marked = neighbor->_marked_from_me;
+/* Runs dijkstra's algorithm from the hosts on the heap.  The tree from me
+ * follows links forwards and the tree to me follows them backwards.
+ * Returns the number of hosts whose metric improved; if touched is
+ * nonnull, also appends them to it. */
+int
+LinkTable::relax(bool from_me, Vector<HeapEntry> &heap, Vector<int> *touched)
+{
+  Vector<uint32_t> &dist = _dist[from_me];
+  Vector<int> &prev = _prev[from_me];
+  Vector<Vector<GraphLink> > &adj = from_me ? _out : _in;
+  int nrelaxed = 0;
+
+  while (heap.size()) {
+    HeapEntry e = heap[0];
+    pop_heap(heap.begin(), heap.end(), heap_less);
+    heap.pop_back();
+    if (e._metric != dist[e._host]) {
+      continue;			/* superseded by a later push */
+    }
+    const Vector<GraphLink> &links = adj[e._host];
+    for (const GraphLink *l = links.begin(); l != links.end(); l++) {
+      uint32_t metric = e._metric + l->_metric;
+      if (metric >= e._metric && metric < dist[l->_host]) {
+	dist[l->_host] = metric;
+	prev[l->_host] = e._host;
+	heap.push_back(HeapEntry(metric, l->_host));
+	push_heap(heap.begin(), heap.end(), heap_less);
+	nrelaxed++;
+	if (touched) {
+	  touched->push_back(l->_host);
+	}
       }
+    }
+  }
+  return nrelaxed;
+}
 
-      if (marked) {
-	continue;
-      }
+/* Copies host i's route in one tree into its HostInfo. */
+void
+LinkTable::export_route(bool from_me, int i)
+{
+  HostInfo *nfo = _hosts.findp(_index_ip[i]);
+  uint32_t d = _dist[from_me][i];
+  int p = _prev[from_me][i];
+  uint32_t metric = (d == INFINITE_METRIC) ? 0 : d;
+  IPAddress prev = (p >= 0) ? _index_ip[p] : IPAddress();
+  if (from_me) {
+    nfo->_metric_from_me = metric;
+    nfo->_prev_from_me = prev;
+    nfo->_marked_from_me = (p >= 0);
+  } else {
+    nfo->_metric_to_me = metric;
+    nfo->_prev_to_me = prev;
+    nfo->_marked_to_me = (p >= 0);
+  }
+}
 
-      IPPair pair = IPPair(neighbor->_ip, current_min_ip);
-      if (from_me) {
-	pair = IPPair(current_min_ip, neighbor->_ip);
-      }
-      LinkInfo *lnfo = _links.findp(pair);
-      if (!lnfo || !lnfo->_metric) {
-	continue;
-      }
-      uint32_t neighbor_metric = neighbor->_metric_to_me;
-      uint32_t current_metric = current_min->_metric_to_me;
+void
+LinkTable::compute_routes(bool from_me)
+{
+  Timestamp start = Timestamp::now();
+  int n = _index_ip.size();
+  _dist[from_me].assign(n, INFINITE_METRIC);
+  _prev[from_me].assign(n, -1);
 
-      if (from_me) {
-	neighbor_metric = neighbor->_metric_from_me;
-	current_metric = current_min->_metric_from_me;
-      }
+  Vector<HeapEntry> heap;
+  HostInfo *root_info = _hosts.findp(_ip);
+  if (root_info && root_info->_index >= 0) {
+    int root = root_info->_index;
+    _dist[from_me][root] = 0;
+    _prev[from_me][root] = root;
+    heap.push_back(HeapEntry(0, root));
+  }
+  relax(from_me, heap, 0);
 
+  for (int i = 0; i < n; i++) {
+    export_route(from_me, i);
+  }
+  _routes_valid[from_me] = true;
 
-      uint32_t adjusted_metric = current_metric + lnfo->_metric;
-      if (!neighbor_metric ||
-	  adjusted_metric < neighbor_metric) {
-	if (from_me) {
-	  neighbor->_metric_from_me = adjusted_metric;
-	  neighbor->_prev_from_me = current_min_ip;
-	} else {
-	  neighbor->_metric_to_me = adjusted_metric;
-	  neighbor->_prev_to_me = current_min_ip;
-	}
+  dijkstra_time = Timestamp::now() - start;
+  _full_runs++;
+  _full_time += dijkstra_time;
+}
 
+/* Repairs one tree after the metric of link from -> to changed.  A better
+ * link can only shorten paths through it, so dijkstra's algorithm restarts
+ * from the far end of the link.  A worse link matters only if it is in the
+ * tree; then every host below it loses its route, takes the best route
+ * through a host outside that subtree, and dijkstra's algorithm runs over
+ * the subtree alone. */
+void
+LinkTable::update_routes(bool from_me, int from, int to,
+			 uint32_t old_metric, uint32_t metric)
+{
+  Timestamp start = Timestamp::now();
+  Vector<uint32_t> &dist = _dist[from_me];
+  Vector<int> &prev = _prev[from_me];
+  Vector<Vector<GraphLink> > &adj = from_me ? _out : _in;
+  Vector<Vector<GraphLink> > &radj = from_me ? _in : _out;
+  int parent = from_me ? from : to;
+  int child = from_me ? to : from;
+  Vector<HeapEntry> heap;
+  Vector<int> touched;
+
+  if (metric < old_metric) {
+    uint32_t m = dist[parent] + metric;
+    if (dist[parent] != INFINITE_METRIC && m >= metric && m < dist[child]) {
+      dist[child] = m;
+      prev[child] = parent;
+      heap.push_back(HeapEntry(m, child));
+      touched.push_back(child);
+    }
+  } else if (prev[child] == parent && child != parent) {
+    /* collect the subtree below the link; tree links are graph links */
+    touched.push_back(child);
+    for (int i = 0; i < touched.size(); i++) {
+      int u = touched[i];
+      const Vector<GraphLink> &links = adj[u];
+      for (const GraphLink *l = links.begin(); l != links.end(); l++) {
+	if (prev[l->_host] == u && l->_host != u) {
+	  touched.push_back(l->_host);
+	}
       }
     }
-
-    current_min_ip = IPAddress();
-    uint32_t  min_metric = ~0;
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *nfo = _hosts.findp(i.key());
-      uint32_t metric = nfo->_metric_to_me;
-      bool marked = nfo->_marked_to_me;
-      if (from_me) {
-	metric = nfo->_metric_from_me;
-	marked = nfo->_marked_from_me;
+    for (int i = 0; i < touched.size(); i++) {
+      dist[touched[i]] = INFINITE_METRIC;
+      prev[touched[i]] = -1;
+    }
+    for (int i = 0; i < touched.size(); i++) {
+      int v = touched[i];
+      const Vector<GraphLink> &links = radj[v];
+      for (const GraphLink *l = links.begin(); l != links.end(); l++) {
+	uint32_t d = dist[l->_host], m = d + l->_metric;
+	if (d != INFINITE_METRIC && m >= d && m < dist[v]) {
+	  dist[v] = m;
+	  prev[v] = l->_host;
+	}
       }
-      if (!marked && metric &&
-	  metric < min_metric) {
-        current_min_ip = nfo->_ip;
-        min_metric = metric;
+      if (dist[v] != INFINITE_METRIC) {
+	heap.push_back(HeapEntry(dist[v], v));
+	push_heap(heap.begin(), heap.end(), heap_less);
       }
     }
+  }
 
-
+  if (touched.size()) {
+    relax(from_me, heap, &touched);
+    for (int i = 0; i < touched.size(); i++) {
+      export_route(from_me, touched[i]);
+    }
   }
+  _incremental_runs++;
+  _incremental_hosts += touched.size();
+  _incremental_time += Timestamp::now() - start;
+}
 
-  dijkstra_time = Timestamp::now() - start;
-  //StringAccum sa;
-  //sa << "dijstra took " << finish - start;
-  //click_chatter("%s: %s\n", name().c_str(), sa.take_string().c_str());
+/* Brings the tree up to date.  With incremental updates, the tree is
+ * normally current already. */
+void
+LinkTable::dijkstra(bool from_me)
+{
+  if (!_routes_valid[from_me]) {
+    compute_routes(from_me);
+  }
 }
 
 
@@ -635,7 +790,8 @@ enum {H_BLACKLIST,
       H_HOSTS,
       H_CLEAR,
       H_DIJKSTRA,
-      H_DIJKSTRA_TIME};
+      H_DIJKSTRA_TIME,
+      H_DIJKSTRA_STATS};
 
 static String
 LinkTable_read_param(Element *e, void *thunk)
@@ -663,6 +819,14 @@ LinkTable_read_param(Element *e, void *thunk)
       sa << td->dijkstra_time << "\n";
       return sa.take_string();
     }
+    case H_DIJKSTRA_STATS: {
+      StringAccum sa;
+      sa << "full " << td->_full_runs << " " << td->_full_time << "\n";
+      sa << "incremental " << td->_incremental_runs << " "
+	 << td->_incremental_time << "\n";
+      sa << "incremental_hosts " << td->_incremental_hosts << "\n";
+      return sa.take_string();
+    }
     default:
       return String();
     }
@@ -693,7 +857,7 @@ LinkTable_write_param(const String &in_s, Element *e, void *vparam,
     break;
   }
   case H_CLEAR: f->clear(); break;
-  case H_DIJKSTRA: f->dijkstra(true); f->dijkstra(false); break;
+  case H_DIJKSTRA: f->compute_routes(true); f->compute_routes(false); break;
   }
   return 0;
 }
@@ -709,6 +873,7 @@ LinkTable::add_handlers() {
   add_read_handler("hosts", LinkTable_read_param, H_HOSTS);
   add_read_handler("blacklist", LinkTable_read_param, H_BLACKLIST);
   add_read_handler("dijkstra_time", LinkTable_read_param, H_DIJKSTRA_TIME);
+  add_read_handler("dijkstra_stats", LinkTable_read_param, H_DIJKSTRA_STATS);
 
   add_write_handler("clear", LinkTable_write_param, H_CLEAR);
   add_write_handler("blacklist_clear", LinkTable_write_param, H_BLACKLIST_CLEAR);
@@ -6,17 +6,34 @@
 #include <click/element.hh>
 #include <click/bighashmap.hh>
 #include <click/hashmap.hh>
+#include <click/vector.hh>
 #include "path.hh"
 CLICK_DECLS
 
 /*
  * =c
- * LinkTable(IP Address, [STALE timeout])
+ * LinkTable(IP Address, [STALE timeout, INCREMENTAL bool])
  * =s Wifi
  * Keeps a Link state database and calculates Weighted Shortest Path
  * for other elements
  * =d
- * Runs dijkstra's algorithm occasionally.
+ * Keeps shortest path trees to and from this node, computed with
+ * dijkstra's algorithm over a binary heap.  If INCREMENTAL is true, the
+ * default, a link metric change only re-relaxes the part of each tree it
+ * affects, so the trees are always current and dijkstra() has nothing to
+ * do.  Otherwise, any change invalidates the trees and the next call to
+ * dijkstra() recomputes them.  Stale link removal always recomputes.
+ *
+ * =h dijkstra write-only
+ * Recomputes both trees from scratch.
+ *
+ * =h dijkstra_time read-only
+ * Time taken by the last full computation.
+ *
+ * =h dijkstra_stats read-only
+ * Number and total time of full computations and of incremental updates,
+ * and the number of hosts incremental updates re-relaxed.
+ *
  * =a ARPTable
  *
  */
@@ -94,6 +111,7 @@ public:
   unsigned get_route_metric(const Vector<IPAddress> &route);
   Vector<IPAddress> get_neighbors(IPAddress ip);
   void dijkstra(bool);
+  void compute_routes(bool);
   void clear_stale();
   Vector<IPAddress> best_route(IPAddress dst, bool from_me);
 
@@ -126,6 +144,11 @@ public:
   IPTable _blacklist;
 
   Timestamp dijkstra_time;
+  uint32_t _full_runs;
+  Timestamp _full_time;
+  uint32_t _incremental_runs;
+  Timestamp _incremental_time;
+  uint64_t _incremental_hosts;
 protected:
   class LinkInfo {
   public:
@@ -188,8 +211,11 @@ protected:
     bool _marked_from_me;
     bool _marked_to_me;
 
+    int _index;
+
     HostInfo(IPAddress p = IPAddress()) {
       _ip = p;
+      _index = -1;
       _metric_from_me = 0;
       _metric_to_me = 0;
       _prev_from_me = IPAddress();
@@ -205,7 +231,8 @@ protected:
       _prev_from_me(p._prev_from_me),
       _prev_to_me(p._prev_to_me),
       _marked_from_me(p._marked_from_me),
-      _marked_to_me(p._marked_to_me)
+      _marked_to_me(p._marked_to_me),
+      _index(p._index)
     { }
 
     void clear(bool from_me) {
@@ -232,6 +259,48 @@ protected:
   HTable _hosts;
   LTable _links;
 
+  /* Route computation works on an index-based copy of the graph.  Each
+   * HostInfo records its index; _out[i] and _in[i] are host i's outgoing
+   * and incoming links.  The tree to me (t = 0) or from me (t = 1) is kept
+   * in _dist[t] and _prev[t] and copied into the HostInfo fields. */
+  class GraphLink {
+  public:
+    int _host;
+    uint32_t _metric;
+    GraphLink(int host = -1, uint32_t metric = 0)
+      : _host(host), _metric(metric) { }
+  };
+
+  class HeapEntry {
+  public:
+    uint32_t _metric;
+    int _host;
+    HeapEntry(uint32_t metric = 0, int host = -1)
+      : _metric(metric), _host(host) { }
+  };
+  static bool heap_less(const HeapEntry &a, const HeapEntry &b) {
+    return a._metric < b._metric;
+  }
+
+  enum { INFINITE_METRIC = 0xFFFFFFFFU };
+
+  Vector<IPAddress> _index_ip;
+  Vector<Vector<GraphLink> > _out;
+  Vector<Vector<GraphLink> > _in;
+  Vector<uint32_t> _dist[2];
+  Vector<int> _prev[2];
+  bool _routes_valid[2];
+  bool _incremental;
+
+  int host_index(IPAddress ip);
+  void rebuild_graph();
+  uint32_t set_graph_link(int from, int to, uint32_t metric);
+  void link_changed(int from, int to, uint32_t old_metric, uint32_t metric);
+  int relax(bool from_me, Vector<HeapEntry> &heap, Vector<int> *touched);
+  void update_routes(bool from_me, int from, int to,
+		     uint32_t old_metric, uint32_t metric);
+  void export_route(bool from_me, int i);
+
 
   IPAddress _ip;
   Timestamp _stale_timeout;
@@ -17,7 +17,8 @@ void click_static_initialize();
 void click_static_cleanup();
 
 Lexer *click_lexer();
-Router *click_read_router(String filename, bool is_expr, ErrorHandler * = 0, bool initialize = true, Master * = 0);
+Router *click_read_router(String filename, bool is_expr, ErrorHandler * = 0, bool initialize = true, Master * = 0,
+                          const String &compiled_filename = String(), bool *compiled_hit = 0);
 
 String click_compile_archive_file(const Vector<ArchiveElement> &ar,
                 const ArchiveElement *ae,
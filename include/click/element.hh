@@ -161,6 +161,9 @@ class Element { public:
     void add_read_handler(const String &name, ReadHandlerCallback read_callback, const void *user_data = 0, uint32_t flags = 0);
     void add_read_handler(const String &name, ReadHandlerCallback read_callback, int user_data, uint32_t flags = 0);
     void add_read_handler(const char *name, ReadHandlerCallback read_callback, int user_data = 0, uint32_t flags = 0);
+    void add_read_stream_handler(const String &name, ReadStreamHandlerCallback read_callback, const void *user_data = 0, uint32_t flags = 0);
+    void add_read_stream_handler(const String &name, ReadStreamHandlerCallback read_callback, int user_data, uint32_t flags = 0);
+    void add_read_stream_handler(const char *name, ReadStreamHandlerCallback read_callback, int user_data = 0, uint32_t flags = 0);
     void add_write_handler(const String &name, WriteHandlerCallback write_callback, const void *user_data = 0, uint32_t flags = 0);
     void add_write_handler(const String &name, WriteHandlerCallback write_callback, int user_data, uint32_t flags = 0);
     void add_write_handler(const char *name, WriteHandlerCallback write_callback, int user_data = 0, uint32_t flags = 0);
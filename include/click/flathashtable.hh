@@ -0,0 +1,981 @@
+#ifndef CLICK_FLATHASHTABLE_HH
+#define CLICK_FLATHASHTABLE_HH
+/*
+ * flathashtable.hh -- open-addressing hash table template
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software")
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <click/glue.hh>
+#include <click/pair.hh>
+#include <click/algorithm.hh>
+#include <click/integers.hh>
+#if defined(__SSE2__) && !CLICK_LINUXMODULE && !CLICK_BSDMODULE
+# define CLICK_FLATHASHTABLE_SSE2 1
+# include <emmintrin.h>
+#endif
+CLICK_DECLS
+
+/** @file <click/flathashtable.hh>
+ * @brief Click's open-addressing hash table template.
+ */
+
+template <typename K, typename V> class FlatHashTable;
+template <typename K, typename V> class FlatHashTable_iterator;
+template <typename K, typename V> class FlatHashTable_const_iterator;
+
+/** @cond never */
+// Groups of 16 control bytes, one per slot.  A full slot's control byte has
+// the high bit set and holds 7 bits of its key's hash.  Empty slots are 0,
+// so a table can start from zeroed memory.  Each match function returns a
+// bitmask of matching slots in the group.
+struct FlatHashTableGroup {
+    enum { width = 16 };
+    enum { ctrl_empty = 0, ctrl_deleted = 1, ctrl_full = 0x80 };
+
+    static inline bool full(unsigned char c) {
+	return c >= ctrl_full;
+    }
+#if CLICK_FLATHASHTABLE_SSE2
+    static inline unsigned match(const unsigned char *g, unsigned char c) {
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8((char) c)));
+    }
+    static inline unsigned match_full(const unsigned char *g) {
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g));
+	return _mm_movemask_epi8(x);
+    }
+#else
+    static inline unsigned match(const unsigned char *g, unsigned char c) {
+	unsigned m = 0;
+	for (int i = 0; i < width; ++i)
+	    m |= (unsigned) (g[i] == c) << i;
+	return m;
+    }
+    static inline unsigned match_full(const unsigned char *g) {
+	unsigned m = 0;
+	for (int i = 0; i < width; ++i)
+	    m |= (unsigned) (g[i] >> 7) << i;
+	return m;
+    }
+#endif
+    static inline unsigned match_empty(const unsigned char *g) {
+	return match(g, ctrl_empty);
+    }
+    static inline unsigned match_free(const unsigned char *g) {
+	return ~match_full(g) & ((1U << width) - 1);
+    }
+};
+/** @endcond never */
+
+/** @class FlatHashTable
+  @brief Open-addressing hash table template.
+
+  FlatHashTable<K, V> maps keys K to values V, like HashTable<K, V>, but
+  stores its elements inline in one flat array instead of chaining them from
+  buckets.  A parallel array holds one control byte per slot with 7 bits of
+  the slot's hash.  Lookups probe 16-slot groups, comparing all 16 control
+  bytes at once (with SSE2 where available), and compare keys only for
+  control-byte matches.  Most lookups touch one control group and one slot.
+
+  Growth is incremental.  When the table fills, FlatHashTable allocates a
+  table twice as large and moves elements into it one group at a time,
+  piggybacked on later insertions; lookups and erasures consult both tables
+  until the move completes.  No single operation rehashes the whole table,
+  so latency stays bounded even for tables with millions of elements.  Use
+  reserve() to size a table ahead of time and avoid growth altogether.
+
+  find_as() and erase_as() support heterogeneous lookup: they accept any key
+  type Q for which hashcode(Q) equals the hashcode() of an equal K and for
+  which K == Q is defined.  For example, a FlatHashTable<String, V> can be
+  searched with a type that references characters in a packet without
+  allocating a String.
+
+  Iteration order is undefined.  Inserting an element invalidates existing
+  iterators; erasing does not, except for iterators to the erased element.
+
+  FlatHashTable allocates its slots in large contiguous blocks, so it is best
+  suited to user-level code.  HashTable remains the right choice for kernel
+  modules.
+*/
+template <typename K, typename V>
+class FlatHashTable {
+
+    typedef FlatHashTableGroup group;
+
+  public:
+
+    /** @brief Key type. */
+    typedef K key_type;
+
+    /** @brief Const reference to key type. */
+    typedef const K &key_const_reference;
+
+    /** @brief Value type. */
+    typedef V mapped_type;
+
+    /** @brief Pair of key type and value type. */
+    typedef Pair<const K, V> value_type;
+
+    /** @brief Type of sizes. */
+    typedef size_t size_type;
+
+    typedef FlatHashTable_const_iterator<K, V> const_iterator;
+    typedef FlatHashTable_iterator<K, V> iterator;
+
+
+    /** @brief Construct an empty hash table with normal default value. */
+    FlatHashTable()
+	: _default_value() {
+	initialize();
+    }
+
+    /** @brief Construct an empty hash table with default value @a d. */
+    explicit FlatHashTable(const mapped_type &d)
+	: _default_value(d) {
+	initialize();
+    }
+
+    /** @brief Construct a hash table as a copy of @a x. */
+    FlatHashTable(const FlatHashTable<K, V> &x)
+	: _default_value(x._default_value) {
+	initialize();
+	copy_elements(x);
+    }
+
+#if HAVE_CXX_RVALUE_REFERENCES
+    /** @overload */
+    FlatHashTable(FlatHashTable<K, V> &&x)
+	: _default_value() {
+	initialize();
+	x.swap(*this);
+    }
+#endif
+
+    /** @brief Destroy this hash table, freeing its memory. */
+    ~FlatHashTable() {
+	free_table(_old);
+	free_table(_t);
+    }
+
+
+    /** @brief Return the number of elements in the hash table. */
+    inline size_type size() const {
+	return _t.size + _old.size;
+    }
+
+    /** @brief Return true iff size() == 0. */
+    inline bool empty() const {
+	return size() == 0;
+    }
+
+    /** @brief Return the number of slots in the hash table.
+     *
+     * During an incremental rehash, this is the size of the new table. */
+    inline size_type capacity() const {
+	return _t.ngroups * group::width;
+    }
+
+    /** @brief Return true iff an incremental rehash is in progress. */
+    inline bool rehashing() const {
+	return _old.ngroups != 0;
+    }
+
+    /** @brief Return the hash table's default value.
+     *
+     * The default value is returned by get() and operator[]() when a key
+     * does not exist. */
+    inline const mapped_type &default_value() const {
+	return _default_value;
+    }
+
+
+    /** @brief Return an iterator for the first element in the table.
+     *
+     * @note FlatHashTable iterators return elements in undefined order. */
+    inline iterator begin();
+    /** @overload */
+    inline const_iterator begin() const;
+
+    /** @brief Return an iterator for the end of the table.
+     * @invariant end().live() == false */
+    inline iterator end() {
+	return iterator(this, 0, 0);
+    }
+    /** @overload */
+    inline const_iterator end() const {
+	return const_iterator(this, 0, 0);
+    }
+
+
+    /** @brief Return 1 if an element with key @a key exists, 0 otherwise. */
+    inline size_type count(key_const_reference key) const {
+	return find_as(key).live();
+    }
+
+    /** @brief Return an iterator for the element with key @a key, if any.
+     *
+     * Returns end() if no such element exists. */
+    inline const_iterator find(key_const_reference key) const {
+	return find_as(key);
+    }
+    /** @overload */
+    inline iterator find(key_const_reference key) {
+	return find_as(key);
+    }
+
+    /** @brief Return an iterator for the element equal to @a key, if any.
+     *
+     * Q may differ from key_type.  hashcode(@a key) must equal the
+     * hashcode() of any equal key_type object, and key_type == Q must be
+     * defined.  Returns end() if no such element exists. */
+    template <typename Q>
+    inline const_iterator find_as(const Q &key) const;
+    /** @overload */
+    template <typename Q>
+    inline iterator find_as(const Q &key);
+
+    /** @brief Return the value for @a key.
+     *
+     * If no element for @a key currently exists (find(@a key) == end()),
+     * returns default_value(). */
+    const mapped_type &get(key_const_reference key) const {
+	if (const_iterator i = find(key))
+	    return i.value();
+	else
+	    return _default_value;
+    }
+
+    /** @brief Return a pointer to the value for @a key.
+     *
+     * If no element for @a key currently exists (find(@a key) == end()),
+     * returns null. */
+    mapped_type *get_pointer(key_const_reference key) {
+	if (iterator i = find(key))
+	    return &i.value();
+	else
+	    return 0;
+    }
+    /** @overload */
+    const mapped_type *get_pointer(key_const_reference key) const {
+	if (const_iterator i = find(key))
+	    return &i.value();
+	else
+	    return 0;
+    }
+
+    /** @brief Return the value for @a key.
+     *
+     * If no element for @a key currently exists (find(@a key) == end()),
+     * returns default_value(). */
+    const mapped_type &operator[](key_const_reference key) const {
+	return get(key);
+    }
+
+    /** @brief Return a reference to the value for @a key.
+     *
+     * The caller can assign the reference to change the value.  If no element
+     * for @a key currently exists (find(@a key) == end()), adds a new element
+     * with default_value() and returns a reference to that value.
+     *
+     * @note Inserting an element into a FlatHashTable invalidates all
+     * existing iterators. */
+    inline mapped_type &operator[](key_const_reference key) {
+	return find_insert(key).value();
+    }
+
+
+    /** @brief Ensure an element with key @a key and return its iterator.
+     *
+     * If an element with @a key already exists in the table, then find(@a
+     * key) and find_insert(@a key) are equivalent.  Otherwise, find_insert
+     * adds a new element with key @a key and value default_value() to the
+     * table and returns its iterator.
+     *
+     * @note Inserting an element into a FlatHashTable invalidates all
+     * existing iterators. */
+    inline iterator find_insert(key_const_reference key) {
+	return find_insert(key, _default_value);
+    }
+
+    /** @brief Ensure an element for key @a key and return its iterator.
+     *
+     * If an element with @a key already exists in the table, then find(@a
+     * key) and find_insert(@a key, @a value) are equivalent.  Otherwise,
+     * adds a new element with key @a key and value @a value to the table and
+     * returns its iterator.  Returns end() if the table must grow but
+     * memory cannot be allocated.
+     *
+     * @note Inserting an element into a FlatHashTable invalidates all
+     * existing iterators. */
+    iterator find_insert(key_const_reference key, const mapped_type &value);
+
+    /** @brief Set the mapping for @a key to @a value.
+     *
+     * If an element for @a key already exists in the table, then its value is
+     * assigned to @a value and the function returns false.  Otherwise, a new
+     * element mapping @a key to @a value is added and the function returns
+     * true.  Returns false, adding nothing, if the table must grow but
+     * memory cannot be allocated.
+     *
+     * @note Inserting an element into a FlatHashTable invalidates all
+     * existing iterators. */
+    bool set(key_const_reference key, const mapped_type &value);
+
+    /** @brief Remove the element indicated by @a it.
+     * @return A valid iterator pointing at the next element remaining, or
+     * end() if no such element exists. */
+    iterator erase(const iterator &it);
+
+    /** @brief Remove any element with @a key.
+     *
+     * Returns the number of elements removed, which is always 0 or 1. */
+    size_type erase(key_const_reference key) {
+	return erase_as(key);
+    }
+
+    /** @brief Remove any element equal to @a key.
+     *
+     * Q may differ from key_type, as for find_as().  Returns the number of
+     * elements removed, which is always 0 or 1. */
+    template <typename Q>
+    size_type erase_as(const Q &key);
+
+    /** @brief Remove all elements.
+     * @post size() == 0
+     *
+     * The table keeps its current capacity. */
+    void clear();
+
+
+    /** @brief Swap the contents of this hash table and @a x. */
+    void swap(FlatHashTable<K, V> &x);
+
+
+    /** @brief Ensure the table can hold @a n elements without growing.
+     *
+     * Completes any incremental rehash, then, if necessary, rehashes the
+     * table at once into a table large enough for @a n elements.  Call
+     * reserve() during initialization so that later insertions never
+     * allocate.  Returns false, leaving the table's elements and capacity
+     * unchanged, if memory cannot be allocated. */
+    bool reserve(size_type n);
+
+    /** @brief Rehash the table at once into at least @a n slots.
+     *
+     * All existing iterators are invalidated.  The table is never shrunk
+     * below what its current elements need.  Returns false, leaving the
+     * table's elements and capacity unchanged, if memory cannot be
+     * allocated. */
+    bool rehash(size_type n);
+
+    /** @brief Complete any incremental rehash now.
+     *
+     * All existing iterators are invalidated. */
+    void finish_rehash();
+
+
+    /** @brief Assign this hash table's contents to a copy of @a x. */
+    FlatHashTable<K, V> &operator=(const FlatHashTable<K, V> &x);
+
+#if HAVE_CXX_RVALUE_REFERENCES
+    /** @overload */
+    FlatHashTable<K, V> &operator=(FlatHashTable<K, V> &&x) {
+	x.swap(*this);
+	return *this;
+    }
+#endif
+
+  private:
+
+    struct table {
+	value_type *slots;
+	unsigned char *ctrl;
+	size_type ngroups;	// power of 2, or 0 if unallocated
+	size_type size;
+	size_type tombstones;
+	size_type growth_left;	// free slots before the table must grow
+    };
+
+    static const size_type npos = (size_type) -1;
+
+    table _t;			// current table
+    table _old;			// table being drained, if rehashing()
+    size_type _migrate;		// next group of _old to move
+    V _default_value;
+
+    static inline size_t mix(hashcode_t h) {
+	// Click hashcodes are often weak (an integer's hashcode is itself),
+	// and the table uses both low bits (control byte) and high bits
+	// (group index), so spread the entropy first.
+#if HAVE_INT64_TYPES
+	uint64_t x = (uint64_t) h * 0x9E3779B97F4A7C15ULL;
+	return (size_t) (x ^ (x >> 32));
+#else
+	uint32_t x = (uint32_t) h * 0x9E3779B9U;
+	return x ^ (x >> 16);
+#endif
+    }
+    template <typename Q>
+    static inline size_t hash(const Q &key) {
+	return mix(hashcode(key));
+    }
+
+    inline void initialize() {
+	memset(&_t, 0, sizeof(table));
+	memset(&_old, 0, sizeof(table));
+	_migrate = 0;
+    }
+
+    template <typename Q>
+    static inline size_type find_in(const table &t, const Q &key, size_t x);
+    static inline size_type insert_in(table &t, const value_type &v, size_t x);
+    static inline void erase_in(table &t, size_type i);
+    static bool allocate_table(table &t, size_type ngroups);
+    static void free_table(table &t);
+
+    bool grow();
+    bool start_rehash(size_type ngroups);
+    void migrate_group();
+    void copy_elements(const FlatHashTable<K, V> &x);
+
+    friend class FlatHashTable_const_iterator<K, V>;
+    friend class FlatHashTable_iterator<K, V>;
+
+};
+
+/** @class FlatHashTable_const_iterator
+ * @brief The const_iterator type for FlatHashTable. */
+template <typename K, typename V>
+class FlatHashTable_const_iterator { public:
+
+    typedef typename FlatHashTable<K, V>::value_type value_type;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashTable_const_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    const value_type *get() const {
+	return _t ? &_t->slots[_i] : 0;
+    }
+
+    /** @brief Return a pointer to the element.
+     * @pre *this != end() */
+    const value_type *operator->() const {
+	return &_t->slots[_i];
+    }
+
+    /** @brief Return a reference to the element.
+     * @pre *this != end() */
+    const value_type &operator*() const {
+	return _t->slots[_i];
+    }
+
+    /** @brief Return a reference to the element's key.
+     * @pre *this != end() */
+    const K &key() const {
+	return _t->slots[_i].first;
+    }
+
+    /** @brief Return a reference to the element's value.
+     * @pre *this != end() */
+    const V &value() const {
+	return _t->slots[_i].second;
+    }
+
+    /** @brief Return true iff *this != end(). */
+    bool live() const {
+	return _t != 0;
+    }
+
+    typedef bool (FlatHashTable_const_iterator::*unspecified_bool_type)() const;
+    /** @brief Return true iff *this != end(). */
+    inline operator unspecified_bool_type() const {
+	return _t ? &FlatHashTable_const_iterator::live : 0;
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++(int) {
+	advance();
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++() {
+	advance();
+    }
+
+  private:
+
+    typedef typename FlatHashTable<K, V>::table table;
+
+    const FlatHashTable<K, V> *_h;
+    const table *_t;
+    typename FlatHashTable<K, V>::size_type _i;
+
+    inline FlatHashTable_const_iterator(const FlatHashTable<K, V> *h,
+					const table *t,
+					typename FlatHashTable<K, V>::size_type i)
+	: _h(h), _t(t), _i(i) {
+    }
+
+    void advance();
+
+    friend class FlatHashTable<K, V>;
+    friend class FlatHashTable_iterator<K, V>;
+    template <typename KK, typename VV>
+    friend bool operator==(const FlatHashTable_const_iterator<KK, VV> &,
+			   const FlatHashTable_const_iterator<KK, VV> &);
+
+};
+
+/** @class FlatHashTable_iterator
+ * @brief The iterator type for FlatHashTable. */
+template <typename K, typename V>
+class FlatHashTable_iterator : public FlatHashTable_const_iterator<K, V> { public:
+
+    typedef FlatHashTable_const_iterator<K, V> inherited;
+    typedef typename inherited::value_type value_type;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashTable_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    value_type *get() const {
+	return const_cast<value_type *>(inherited::get());
+    }
+
+    /** @brief Return a pointer to the element.
+     * @pre *this != end() */
+    inline value_type *operator->() const {
+	return const_cast<value_type *>(inherited::operator->());
+    }
+
+    /** @brief Return a reference to the element.
+     * @pre *this != end() */
+    inline value_type &operator*() const {
+	return const_cast<value_type &>(inherited::operator*());
+    }
+
+    /** @brief Return a mutable reference to the element's value.
+     * @pre *this != end() */
+    V &value() const {
+	return const_cast<V &>(inherited::value());
+    }
+
+  private:
+
+    inline FlatHashTable_iterator(const FlatHashTable<K, V> *h,
+				  const typename inherited::table *t,
+				  typename FlatHashTable<K, V>::size_type i)
+	: inherited(h, t, i) {
+    }
+
+    friend class FlatHashTable<K, V>;
+
+};
+
+template <typename K, typename V>
+void FlatHashTable_const_iterator<K, V>::advance()
+{
+    typedef FlatHashTableGroup group;
+    while (_t) {
+	typename FlatHashTable<K, V>::size_type n = _t->ngroups * group::width;
+	for (++_i; _i < n; ++_i)
+	    if (group::full(_t->ctrl[_i]))
+		return;
+	if (_t == &_h->_old) {
+	    _t = &_h->_t;
+	    _i = (typename FlatHashTable<K, V>::size_type) -1;
+	} else
+	    _t = 0;
+    }
+}
+
+template <typename K, typename V>
+inline bool operator==(const FlatHashTable_const_iterator<K, V> &a,
+		       const FlatHashTable_const_iterator<K, V> &b)
+{
+    return a._t == b._t && (!a._t || a._i == b._i);
+}
+
+template <typename K, typename V>
+inline bool operator!=(const FlatHashTable_const_iterator<K, V> &a,
+		       const FlatHashTable_const_iterator<K, V> &b)
+{
+    return !(a == b);
+}
+
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::const_iterator
+FlatHashTable<K, V>::begin() const
+{
+    const_iterator it(this, _old.ngroups ? &_old : &_t, npos);
+    it.advance();
+    return it;
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::begin()
+{
+    iterator it(this, _old.ngroups ? &_old : &_t, npos);
+    it.advance();
+    return it;
+}
+
+template <typename K, typename V> template <typename Q>
+inline typename FlatHashTable<K, V>::size_type
+FlatHashTable<K, V>::find_in(const table &t, const Q &key, size_t x)
+{
+    if (!t.ngroups)
+	return npos;
+    size_type mask = t.ngroups - 1, g = (x >> 7) & mask;
+    unsigned char h2 = group::ctrl_full | (x & 0x7F);
+    // Triangular probing visits every group when ngroups is a power of 2.
+    for (size_type step = 1; ; ++step) {
+	const unsigned char *c = t.ctrl + g * group::width;
+	for (unsigned m = group::match(c, h2); m; m &= m - 1) {
+	    size_type i = g * group::width + ffs_lsb(m) - 1;
+	    if (t.slots[i].first == key)
+		return i;
+	}
+	if (group::match_empty(c))
+	    return npos;
+	g = (g + step) & mask;
+    }
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::size_type
+FlatHashTable<K, V>::insert_in(table &t, const value_type &v, size_t x)
+{
+    size_type mask = t.ngroups - 1, g = (x >> 7) & mask;
+    for (size_type step = 1; ; ++step) {
+	const unsigned char *c = t.ctrl + g * group::width;
+	if (unsigned m = group::match_free(c)) {
+	    size_type i = g * group::width + ffs_lsb(m) - 1;
+	    if (t.ctrl[i] == group::ctrl_deleted)
+		--t.tombstones;
+	    else
+		--t.growth_left;
+	    new((void *) &t.slots[i]) value_type(v);
+	    t.ctrl[i] = group::ctrl_full | (x & 0x7F);
+	    ++t.size;
+	    return i;
+	}
+	g = (g + step) & mask;
+    }
+}
+
+template <typename K, typename V>
+inline void
+FlatHashTable<K, V>::erase_in(table &t, size_type i)
+{
+    t.slots[i].~value_type();
+    --t.size;
+    // Probes stop at the first group with an empty slot, so if this group
+    // already has one, no probe passes through it and the slot can become
+    // empty rather than a tombstone.
+    if (group::match_empty(t.ctrl + (i & ~(size_type) (group::width - 1)))) {
+	t.ctrl[i] = group::ctrl_empty;
+	++t.growth_left;
+    } else {
+	t.ctrl[i] = group::ctrl_deleted;
+	++t.tombstones;
+    }
+}
+
+template <typename K, typename V> template <typename Q>
+inline typename FlatHashTable<K, V>::const_iterator
+FlatHashTable<K, V>::find_as(const Q &key) const
+{
+    size_t x = hash(key);
+    size_type i = find_in(_t, key, x);
+    if (i != npos)
+	return const_iterator(this, &_t, i);
+    if (_old.ngroups && (i = find_in(_old, key, x)) != npos)
+	return const_iterator(this, &_old, i);
+    return end();
+}
+
+template <typename K, typename V> template <typename Q>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::find_as(const Q &key)
+{
+    size_t x = hash(key);
+    size_type i = find_in(_t, key, x);
+    if (i != npos)
+	return iterator(this, &_t, i);
+    if (_old.ngroups && (i = find_in(_old, key, x)) != npos)
+	return iterator(this, &_old, i);
+    return end();
+}
+
+template <typename K, typename V>
+typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::find_insert(key_const_reference key, const mapped_type &value)
+{
+    size_t x = hash(key);
+    size_type i = find_in(_t, key, x);
+    if (i != npos)
+	return iterator(this, &_t, i);
+    if (_old.ngroups && (i = find_in(_old, key, x)) != npos)
+	return iterator(this, &_old, i);
+    if (!_t.growth_left && !grow())
+	return end();
+    i = insert_in(_t, value_type(key, value), x);
+    // Moving old elements only inserts into _t, so slot i stays put.
+    if (_old.ngroups)
+	migrate_group();
+    return iterator(this, &_t, i);
+}
+
+template <typename K, typename V>
+bool
+FlatHashTable<K, V>::set(key_const_reference key, const mapped_type &value)
+{
+    size_type old_size = size();
+    iterator it = find_insert(key, value);
+    if (!it)
+	return false;
+    else if (size() == old_size) {
+	it.value() = value;
+	return false;
+    } else
+	return true;
+}
+
+template <typename K, typename V>
+typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::erase(const iterator &it)
+{
+    iterator next(it);
+    next.advance();
+    erase_in(const_cast<table &>(*it._t), it._i);
+    return next;
+}
+
+template <typename K, typename V> template <typename Q>
+typename FlatHashTable<K, V>::size_type
+FlatHashTable<K, V>::erase_as(const Q &key)
+{
+    if (iterator it = find_as(key)) {
+	erase_in(const_cast<table &>(*it._t), it._i);
+	return 1;
+    } else
+	return 0;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::clear()
+{
+    free_table(_old);
+    size_type n = _t.ngroups * group::width;
+    for (size_type i = 0; i < n; ++i)
+	if (group::full(_t.ctrl[i]))
+	    _t.slots[i].~value_type();
+    if (n)
+	memset(_t.ctrl, group::ctrl_empty, n);
+    _t.size = _t.tombstones = 0;
+    _t.growth_left = n - n / 8;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::swap(FlatHashTable<K, V> &x)
+{
+    click_swap(_t, x._t);
+    click_swap(_old, x._old);
+    click_swap(_migrate, x._migrate);
+    click_swap(_default_value, x._default_value);
+}
+
+template <typename K, typename V>
+bool
+FlatHashTable<K, V>::allocate_table(table &t, size_type ngroups)
+{
+    size_type n = ngroups * group::width;
+    if (n / group::width != ngroups
+	|| n > ((size_type) -1) / (sizeof(value_type) + 1))
+	return false;
+    size_type sz = n * sizeof(value_type) + n;
+#if CLICK_USERLEVEL
+    // Large calloc()s come from fresh zero pages, so a big table costs
+    // little until it is used.
+    char *mem = reinterpret_cast<char *>(calloc(sz, 1));
+    if (!mem)
+	return false;
+#else
+    char *mem = new char[sz];
+    if (!mem)
+	return false;
+    memset(mem + n * sizeof(value_type), group::ctrl_empty, n);
+#endif
+    t.slots = reinterpret_cast<value_type *>(mem);
+    t.ctrl = reinterpret_cast<unsigned char *>(mem + n * sizeof(value_type));
+    t.ngroups = ngroups;
+    t.size = t.tombstones = 0;
+    t.growth_left = n - n / 8;
+    return true;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::free_table(table &t)
+{
+    if (!t.ngroups)
+	return;
+    size_type n = t.ngroups * group::width;
+    for (size_type i = 0; t.size && i < n; ++i)
+	if (group::full(t.ctrl[i])) {
+	    t.slots[i].~value_type();
+	    --t.size;
+	}
+#if CLICK_USERLEVEL
+    free(t.slots);
+#else
+    delete[] reinterpret_cast<char *>(t.slots);
+#endif
+    memset(&t, 0, sizeof(table));
+}
+
+template <typename K, typename V>
+bool
+FlatHashTable<K, V>::start_rehash(size_type ngroups)
+{
+    table t;
+    if (!allocate_table(t, ngroups))
+	return false;
+    _old = _t;
+    _t = t;
+    _migrate = 0;
+    if (!_old.size)
+	free_table(_old);
+    return true;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::migrate_group()
+{
+    // Move one group's elements into _t, leaving tombstones so that probes
+    // for elements still in _old keep working.  A rehash starts only when
+    // _t has at least twice _old's element count in free slots, and each
+    // insertion moves a group, so _t never fills before _old drains.
+    unsigned char *c = _old.ctrl + _migrate * group::width;
+    for (unsigned m = group::match_full(c); m; m &= m - 1) {
+	size_type i = _migrate * group::width + ffs_lsb(m) - 1;
+	value_type &v = _old.slots[i];
+	insert_in(_t, v, hash(v.first));
+	v.~value_type();
+	c[i - _migrate * group::width] = group::ctrl_deleted;
+	--_old.size;
+    }
+    if (++_migrate == _old.ngroups || !_old.size)
+	free_table(_old);
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::finish_rehash()
+{
+    while (_old.ngroups)
+	migrate_group();
+}
+
+template <typename K, typename V>
+bool
+FlatHashTable<K, V>::grow()
+{
+    finish_rehash();
+    size_type ngroups = _t.ngroups ? _t.ngroups : 1;
+    // A table full mostly of tombstones is rehashed at the same size.
+    if (_t.size > ngroups * group::width * 7 / 16)
+	ngroups *= 2;
+    return start_rehash(ngroups);
+}
+
+template <typename K, typename V>
+bool
+FlatHashTable<K, V>::rehash(size_type n)
+{
+    if (n > npos / (4 * group::width))
+	return false;
+    finish_rehash();
+    size_type ngroups = 1;
+    while (ngroups * group::width < n
+	   || ngroups * group::width * 7 / 8 < _t.size)
+	ngroups *= 2;
+    if (!start_rehash(ngroups))
+	return false;
+    finish_rehash();
+    return true;
+}
+
+template <typename K, typename V>
+bool
+FlatHashTable<K, V>::reserve(size_type n)
+{
+    if (n > npos / (4 * group::width))
+	return false;
+    finish_rehash();
+    if (_t.size + _t.growth_left < n) {
+	size_type ngroups = 1;
+	while (ngroups * group::width - ngroups * group::width / 8 < n)
+	    ngroups *= 2;
+	if (!start_rehash(ngroups))
+	    return false;
+	finish_rehash();
+    }
+    return true;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::copy_elements(const FlatHashTable<K, V> &x)
+{
+    if (!reserve(x.size()))
+	return;
+    for (const_iterator it = x.begin(); it; ++it)
+	insert_in(_t, *it, hash(it.key()));
+}
+
+template <typename K, typename V>
+FlatHashTable<K, V> &
+FlatHashTable<K, V>::operator=(const FlatHashTable<K, V> &x)
+{
+    if (&x != this) {
+	clear();
+	_default_value = x._default_value;
+	copy_elements(x);
+    }
+    return *this;
+}
+
+template <typename K, typename V>
+inline void
+click_swap(FlatHashTable<K, V> &a, FlatHashTable<K, V> &b)
+{
+    a.swap(b);
+}
+
+template <typename K, typename V>
+inline void
+assign_consume(FlatHashTable<K, V> &a, FlatHashTable<K, V> &b)
+{
+    a.swap(b);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -5,6 +5,7 @@ CLICK_DECLS
 class Element;
 class ErrorHandler;
 class Handler;
+class StringAccum;
 
 /** @file <click/handler.hh>
  * @brief The Handler class for router handlers.
@@ -15,6 +16,8 @@ typedef int (*HandlerCallback)(int operation, String &data, Element *element,
 typedef String (*ReadHandlerCallback)(Element *handler, void *user_data);
 typedef int (*WriteHandlerCallback)(const String &data, Element *element,
 				    void *user_data, ErrorHandler *errh);
+typedef int (*ReadStreamHandlerCallback)(Element *element, void *user_data,
+					 StringAccum &sa, uint64_t &cursor);
 
 class Handler { public:
 
@@ -42,6 +45,8 @@ class Handler { public:
 	f_button = 0x2000,	///< @brief Write handler ignores data.
 	f_checkbox = 0x4000,	///< @brief Read/write handler is boolean and
 				///  should be rendered as a checkbox.
+	f_read_stream = 0x8000,	///< @brief Read handler produces its value
+				///  in chunks (see call_read_chunk()).
 	f_driver0 = 1U << 26,
         f_driver1 = 1U << 27,   ///< @brief Uninterpreted handler flags
 				///  available for drivers.
@@ -53,7 +58,7 @@ class Handler { public:
 
 	f_read_comprehensive = 0x0008,
 	f_write_comprehensive = 0x0010,
-	f_special = f_read | f_write | f_read_param | f_read_comprehensive | f_write_comprehensive
+	f_special = f_read | f_write | f_read_param | f_read_comprehensive | f_write_comprehensive | f_read_stream
 				///< @brief These flags may not be set by
 				///  Router::set_handler_flags().
     };
@@ -103,6 +108,17 @@ class Handler { public:
 	return _flags & f_read_param;
     }
 
+    /** @brief Test if this is a streaming read handler.
+     *
+     * Streaming read handlers produce their values in chunks, so that a
+     * driver can emit a large value, such as a table dump, without holding
+     * all of it in memory.  Such handlers are added with
+     * Router::add_read_stream_handler().  call_read() still returns a
+     * streaming handler's whole value. */
+    inline bool read_stream() const {
+	return _flags & f_read_stream;
+    }
+
     /** @brief Test if this is a public read handler.
      *
      * Private handlers may be not called from outside the router
@@ -187,6 +203,26 @@ class Handler { public:
 	return call_read(e, String(), errh);
     }
 
+    /** @brief Call a read handler without parameters, producing the next
+     *         chunk of its value.
+     * @param e element on which to call the handler
+     * @param sa the chunk is appended here
+     * @param cursor position in the handler's value
+     * @param errh optional error handler
+     * @return > 0 if more chunks follow, 0 if this was the last chunk, < 0
+     * on error
+     *
+     * Set @a cursor to 0 before the first call, then call again with the
+     * same @a cursor for as long as the return value is positive.  Each call
+     * appends roughly stream_chunk_size bytes to @a sa.  Non-streaming read
+     * handlers return their whole value in one chunk.
+     *
+     * Other threads may run between calls, so a streamed value need not be
+     * a consistent snapshot: for example, a table dump may miss or repeat
+     * entries that move while it is being read. */
+    int call_read_chunk(Element *e, StringAccum &sa, uint64_t &cursor,
+			ErrorHandler *errh = 0) const;
+
     /** @brief Call a write handler.
      * @param value value to write to the handler
      * @param e element on which to call the handler
@@ -224,6 +260,9 @@ class Handler { public:
 	return the_blank_handler;
     }
 
+    /** @brief Preferred chunk size, in bytes, for streaming read handlers. */
+    enum { stream_chunk_size = 65536 };
+
 
     /** @cond never */
     enum {
@@ -279,7 +318,7 @@ class Handler { public:
      * This function should only be used for special purposes.  It fails
      * unless called on a handler created with a ReadHandlerCallback. */
     inline String __call_read(Element *e, void *new_user_data) const {
-	assert((_flags & (f_read | f_read_comprehensive)) == f_read);
+	assert((_flags & (f_read | f_read_comprehensive | f_read_stream)) == f_read);
 	return _read_hook.r(e, new_user_data);
     }
     /** @endcond never */
@@ -290,6 +329,7 @@ class Handler { public:
     union {
 	HandlerCallback h;
 	ReadHandlerCallback r;
+	ReadStreamHandlerCallback s;
     } _read_hook;
     union {
 	HandlerCallback h;
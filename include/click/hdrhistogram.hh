@@ -0,0 +1,176 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HDRHISTOGRAM_HH
+#define CLICK_HDRHISTOGRAM_HH
+#include <click/glue.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+
+/** @file <click/hdrhistogram.hh>
+ * @brief A high-dynamic-range histogram.
+ */
+
+/** @class HdrHistogram include/click/hdrhistogram.hh <click/hdrhistogram.hh>
+ * @brief A fixed-size histogram of 64-bit values with bounded relative error.
+ *
+ * HdrHistogram records unsigned values, such as latencies in nanoseconds,
+ * in log-linear buckets.  Values less than 2<sup>sub_bucket_bits</sup> are
+ * recorded exactly.  Larger values are recorded with sub_bucket_bits
+ * significant bits, so a value's bucket covers at most 1/64 (about 1.6%) of
+ * the value.  Values of 2<sup>max_value_bits</sup> or more are recorded as
+ * 2<sup>max_value_bits</sup> - 1.  The exact minimum, maximum, and sum of
+ * recorded values are also kept.
+ *
+ * Recording a value takes constant time and never allocates.  Histograms
+ * with the same parameters merge by adding their buckets, so a multithreaded
+ * element can keep one histogram per thread and merge them when read. */
+class HdrHistogram { public:
+
+    enum {
+	sub_bucket_bits = 7,
+	max_value_bits = 48,
+	half_count = 1 << (sub_bucket_bits - 1),
+	nbuckets = (max_value_bits - sub_bucket_bits + 2) * half_count
+    };
+
+    /** @brief Construct an empty histogram. */
+    HdrHistogram() {
+	clear();
+    }
+
+    /** @brief Remove all values. */
+    void clear() {
+	memset(_counts, 0, sizeof(_counts));
+	_count = _sum = _max = 0;
+	_min = ~(uint64_t) 0;
+    }
+
+    /** @brief Record @a n occurrences of value @a v. */
+    inline void add(uint64_t v, uint64_t n = 1);
+
+    /** @brief Add the contents of @a x to this histogram. */
+    void merge(const HdrHistogram &x) {
+	for (int i = 0; i < nbuckets; ++i)
+	    _counts[i] += x._counts[i];
+	_count += x._count;
+	_sum += x._sum;
+	if (x._min < _min)
+	    _min = x._min;
+	if (x._max > _max)
+	    _max = x._max;
+    }
+
+    /** @brief Return the number of recorded values. */
+    uint64_t count() const {
+	return _count;
+    }
+    /** @brief Return the sum of recorded values. */
+    uint64_t sum() const {
+	return _sum;
+    }
+    /** @brief Return the smallest recorded value, or 0 if empty. */
+    uint64_t min() const {
+	return _count ? _min : 0;
+    }
+    /** @brief Return the largest recorded value, or 0 if empty. */
+    uint64_t max() const {
+	return _max;
+    }
+    /** @brief Return the mean of recorded values, rounded down. */
+    uint64_t mean() const {
+	return _count ? _sum / _count : 0;
+    }
+
+    /** @brief Return the value at percentile @a ppm, in parts per million.
+     *
+     * Returns the highest value equivalent to the smallest recorded value
+     * that is greater than or equal to @a ppm parts per million of all
+     * recorded values, but no more than max().  For example,
+     * value_at_percentile(990000) returns the 99th percentile.  Returns 0
+     * if the histogram is empty. */
+    inline uint64_t value_at_percentile(uint32_t ppm) const;
+
+    /** @brief Return the bucket index for value @a v. */
+    static inline int index_of(uint64_t v);
+    /** @brief Return the smallest value in bucket @a i. */
+    static inline uint64_t lowest_equivalent(int i);
+    /** @brief Return the largest value in bucket @a i. */
+    static inline uint64_t highest_equivalent(int i);
+    /** @brief Return the number of values in bucket @a i. */
+    uint64_t bucket_count(int i) const {
+	return _counts[i];
+    }
+
+  private:
+
+    uint64_t _counts[nbuckets];
+    uint64_t _count;
+    uint64_t _sum;
+    uint64_t _min;
+    uint64_t _max;
+
+};
+
+inline int
+HdrHistogram::index_of(uint64_t v)
+{
+    if (v < (2 << (sub_bucket_bits - 1)))
+	return v;
+    if (v >> max_value_bits)
+	v = ((uint64_t) 1 << max_value_bits) - 1;
+    int shift = 64 - ffs_msb(v) - sub_bucket_bits + 1;
+    return shift * half_count + (v >> shift);
+}
+
+inline uint64_t
+HdrHistogram::lowest_equivalent(int i)
+{
+    if (i < 2 * half_count)
+	return i;
+    int shift = i / half_count - 1;
+    return (uint64_t) (i - shift * half_count) << shift;
+}
+
+inline uint64_t
+HdrHistogram::highest_equivalent(int i)
+{
+    if (i < 2 * half_count)
+	return i;
+    int shift = i / half_count - 1;
+    return ((uint64_t) (i - shift * half_count + 1) << shift) - 1;
+}
+
+inline void
+HdrHistogram::add(uint64_t v, uint64_t n)
+{
+    _counts[index_of(v)] += n;
+    _count += n;
+    _sum += v * n;
+    if (v < _min)
+	_min = v;
+    if (v > _max)
+	_max = v;
+}
+
+inline uint64_t
+HdrHistogram::value_at_percentile(uint32_t ppm) const
+{
+    if (!_count)
+	return 0;
+    if (ppm > 1000000)
+	ppm = 1000000;
+    uint64_t rank = (_count * ppm + 999999) / 1000000;
+    if (rank == 0)
+	rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < nbuckets; ++i) {
+	seen += _counts[i];
+	if (seen >= rank) {
+	    uint64_t v = highest_equivalent(i);
+	    return v < _max ? v : _max;
+	}
+    }
+    return _max;
+}
+
+CLICK_ENDDECLS
+#endif
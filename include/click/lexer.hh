@@ -103,7 +103,12 @@ class Lexer { public:
     bool ydone() const			{ return !_ps; }
     void ystep();
 
-    Router *create_router(Master *);
+    Router *create_router(Master *, StringAccum *compiled = 0);
+#if CLICK_USERLEVEL
+    Router *create_compiled_router(const String &compiled, const String &data,
+				   const String &filename, LexerExtra *,
+				   Master *, ErrorHandler *);
+#endif
 
   private:
 
@@ -202,6 +207,11 @@ class Lexer { public:
     int make_compound_element(int);
     void expand_compound_element(int, VariableEnvironment &);
     void add_router_connections(int, const Vector<int> &);
+#if CLICK_USERLEVEL
+    uint64_t compiled_hash(const String &data, const String &filename,
+			   const Vector<String> &libraries, bool &ok) const;
+    void unparse_compiled(StringAccum &sa, const Vector<int> &router_id);
+#endif
     static Element* compound_element_factory(uintptr_t);
 
     void yport(bool isoutput);
@@ -32,6 +32,11 @@ class Master { public:
     inline RouterThread *thread(int id) const;
     void wake_somebody();
 
+#if HAVE_MULTITHREAD
+    bool work_stealing() const                  { return _work_stealing; }
+    void set_work_stealing(bool x)              { _work_stealing = x; }
+#endif
+
 #if CLICK_USERLEVEL
     int add_signal_handler(int signo, Router *router, String handler);
     int remove_signal_handler(int signo, Router *router, String handler);
@@ -76,6 +81,10 @@ class Master { public:
     Spinlock _master_lock;
 #endif
     atomic_uint32_t _master_paused;
+#if HAVE_MULTITHREAD
+    volatile bool _work_stealing;
+    atomic_uint32_t _steal_waiting;     // # threads waiting to steal work
+#endif
     inline void lock_master();
     inline void unlock_master();
 
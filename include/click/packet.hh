@@ -18,6 +18,9 @@
 #if (CLICK_USERLEVEL || CLICK_NS || CLICK_MINIOS) && (!HAVE_MULTITHREAD || HAVE___THREAD_STORAGE_CLASS)
 # define HAVE_CLICK_PACKET_POOL 1
 #endif
+#if CLICK_USERLEVEL && !CLICK_NS && HAVE_PACKET_HOT_LAYOUT
+# define CLICK_PACKET_HOT_LAYOUT 1
+#endif
 #ifndef CLICK_PACKET_DEPRECATED_ENUM
 # define CLICK_PACKET_DEPRECATED_ENUM CLICK_DEPRECATED_ENUM
 #endif
@@ -420,6 +423,15 @@ class Packet { public:
     /** @brief Set the previous packet annotation. */
     inline void set_prev(Packet *p);
 
+    /** @brief Prefetch the packet's metadata.
+     *
+     * Elements that process packets in sequence can call this on a packet
+     * they will handle soon, so its header pointers and annotations are in
+     * cache when needed.  Has no other effect. */
+    inline void prefetch() const;
+    /** @brief Prefetch the first cache line of the packet's data. */
+    inline void prefetch_data() const;
+
     enum {
 	dst_ip_anno_offset = 0, dst_ip_anno_size = 4,
 	dst_ip6_anno_offset = 0, dst_ip6_anno_size = 16
@@ -720,6 +732,16 @@ class Packet { public:
     // All packet annotations are stored in AllAnno so that
     // clear_annotations(true) can memset() the structure to zero.
     struct AllAnno {
+# if CLICK_PACKET_HOT_LAYOUT
+	Packet *next;
+	Packet *prev;
+	unsigned char *nh;
+	unsigned char *h;
+	Anno cb;
+	unsigned char *mac;
+	PacketType pkt_type;
+	char timestamp[sizeof(Timestamp)];
+# else
 	Anno cb;
 	unsigned char *mac;
 	unsigned char *nh;
@@ -728,12 +750,25 @@ class Packet { public:
 	char timestamp[sizeof(Timestamp)];
 	Packet *next;
 	Packet *prev;
+# endif
     };
 #endif
     /** @endcond never */
 
 #if !CLICK_LINUXMODULE
     // User-space and BSD kernel module implementations.
+# if CLICK_PACKET_HOT_LAYOUT
+    // The first cache line holds what most elements touch: data pointers,
+    // next/prev, header pointers, and the first 16 annotation bytes
+    // (including the destination address annotation).
+    unsigned char *_data CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    unsigned char *_tail;
+    AllAnno _aa;
+    atomic_uint32_t _use_count;
+    Packet *_data_packet;
+    unsigned char *_head;
+    unsigned char *_end;
+# else
     atomic_uint32_t _use_count;
     Packet *_data_packet;
     /* mimic Linux sk_buff */
@@ -741,10 +776,11 @@ class Packet { public:
     unsigned char *_data; /* where the packet starts */
     unsigned char *_tail; /* one beyond end of packet */
     unsigned char *_end;  /* one beyond end of allocated buffer */
-# if CLICK_BSDMODULE
+#  if CLICK_BSDMODULE
     struct mbuf *_m;
-# endif
+#  endif
     AllAnno _aa;
+# endif
 # if CLICK_NS
     SimPacketinfoWrapper _sim_packetinfo;
 # endif
@@ -852,7 +888,10 @@ Packet::clear_annotations(bool all)
 	set_prev(0);
     }
 #else
-    memset(&_aa, 0, all ? sizeof(AllAnno) : sizeof(Anno));
+    if (all)
+	memset(&_aa, 0, sizeof(AllAnno));
+    else
+	memset(xanno(), 0, sizeof(Anno));
 #endif
 }
 
@@ -1054,6 +1093,25 @@ Packet::set_prev(Packet *p)
 #endif
 }
 
+inline void
+Packet::prefetch() const
+{
+#if CLICK_LINUXMODULE
+    __builtin_prefetch(&skb()->len);
+    __builtin_prefetch(&skb()->cb[0]);
+#else
+    // Header pointers and most annotations fit in the first two lines.
+    __builtin_prefetch(this);
+    __builtin_prefetch(reinterpret_cast<const char *>(this) + CLICK_CACHE_LINE_SIZE);
+#endif
+}
+
+inline void
+Packet::prefetch_data() const
+{
+    __builtin_prefetch(data());
+}
+
 /** @brief Return true iff the packet's MAC header pointer is set.
  * @sa set_mac_header, clear_mac_header */
 inline bool
@@ -119,6 +119,17 @@
 # define SET_IPSEC_SA_DATA_REFERENCE_ANNO(p, v) ((p)->set_anno_u32(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET, (v)))
 #endif
 
+// bytes 40-41
+// If nonzero, the packet is a TCP or UDP super-packet that should be cut into
+// segments carrying this many bytes of transport payload before it is sent
+// on a link that cannot do so itself.  Overlaps PERFCTR_ANNO and the 64-bit
+// IPSEC_SA_DATA_REFERENCE_ANNO, so elements that produce super-packets set
+// it (to zero for other packets), and consumers check it for plausibility.
+#define GSO_SIZE_ANNO_OFFSET		40
+#define GSO_SIZE_ANNO_SIZE		2
+#define GSO_SIZE_ANNO(p)		((p)->anno_u16(GSO_SIZE_ANNO_OFFSET))
+#define SET_GSO_SIZE_ANNO(p, v)		((p)->set_anno_u16(GSO_SIZE_ANNO_OFFSET, (v)))
+
 #if HAVE_INT64_TYPES
 // bytes 40-47
 # define PERFCTR_ANNO_OFFSET		40
@@ -71,6 +71,7 @@ class Router { public:
     // 'const Handler *' results last until that element/handlername modified
     static const Handler *handler(const Element *e, const String &hname);
     static void add_read_handler(const Element *e, const String &hname, ReadHandlerCallback callback, void *user_data, uint32_t flags = 0);
+    static void add_read_stream_handler(const Element *e, const String &hname, ReadStreamHandlerCallback callback, void *user_data, uint32_t flags = 0);
     static void add_write_handler(const Element *e, const String &hname, WriteHandlerCallback callback, void *user_data, uint32_t flags = 0);
     static void set_handler(const Element *e, const String &hname, uint32_t flags, HandlerCallback callback, void *read_user_data = 0, void *write_user_data = 0);
     static int set_handler_flags(const Element *e, const String &hname, uint32_t set_flags, uint32_t clear_flags = 0);
@@ -341,6 +342,8 @@ class Router { public:
 
     // global handlers
     static String router_read_handler(Element *e, void *user_data);
+    void unparse_declaration(StringAccum &sa, const String &indent, int eindex) const;
+    static int router_read_stream_handler(Element *e, void *user_data, StringAccum &sa, uint64_t &cursor);
     static int router_write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
 
     /** @cond never */
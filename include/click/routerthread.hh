@@ -55,6 +55,11 @@ class RouterThread { public:
 
     inline bool stop_flag() const;
 
+#if HAVE_MULTITHREAD
+    uint32_t steals() const             { return _steals.value(); }
+    uint32_t steal_returns() const      { return _steal_returns; }
+#endif
+
     inline void mark_driver_entry();
     void driver();
 
@@ -152,11 +157,19 @@ class RouterThread { public:
     Task::Pending _pending_head;
     Task::Pending *_pending_tail;
     SpinlockIRQ _pending_lock;
+#if HAVE_MULTITHREAD
+    atomic_uint32_t _steal_waiting;     // 1 if idle and asking for work
+    atomic_uint32_t _steals;            // # tasks stolen by this thread
+    uint32_t _steal_returns;            // # stolen tasks sent home
+#endif
 
     // SHARED STATE GROUP
     Master *_master CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
     int _id;
     bool _driver_entered;
+#if TIMESTAMP_RECENT_CACHE
+    Timestamp _recent[2];               // system and steady time
+#endif
 #if HAVE_MULTITHREAD && !(CLICK_LINUXMODULE || CLICK_MINIOS)
     click_processor_t _running_processor;
 #endif
@@ -228,6 +241,13 @@ class RouterThread { public:
     inline void run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+    inline void update_recent();
+#if HAVE_MULTITHREAD
+    void run_work_stealing();
+    void give_stealable_task();
+    void stop_steal_waiting();
+    void return_stolen_task(Task *t);
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
@@ -108,10 +108,29 @@ int simclick_gettimeofday(struct timeval* tv);
 #define SIMCLICK_IPPREFIX_FROM_NAME	13 // const char *ifname, char *buf, int len
 #define SIMCLICK_GET_RANDOM_INT		14 // uint32_t *result, uint32_t max
 #define SIMCLICK_GET_DEFINES		15 // char *buf, size_t *size
+#define SIMCLICK_CONCURRENT		16 // none
 
 int simclick_sim_command(simclick_node_t *sim, int cmd, ...);
 int simclick_click_command(simclick_node_t *sim, int cmd, ...);
 
+/*
+ * Parallel simulation. simclick_click_command(sim, SIMCLICK_CONCURRENT)
+ * returns 1 if Click was built with multithreading support. If so, the
+ * simulator may call simclick_click_send, simclick_click_run, and the
+ * handler functions for different nodes from different threads at the
+ * same time, as long as calls for any one node do not overlap. Click calls
+ * simclick_sim_send and simclick_sim_command for a node on the thread that
+ * is running that node, so the simulator's side of those calls must be
+ * safe to run concurrently for different nodes. simclick_click_create and
+ * simclick_click_kill must still be called from one thread at a time.
+ *
+ * Nodes share no simulated state, so a conservative simulator can run
+ * every node up to the earliest time a packet sent by another node could
+ * arrive, then exchange packets. Click's random numbers are reproducible
+ * only if the simulator implements SIMCLICK_GET_RANDOM_INT with a separate
+ * generator per node. See ns/nsclick-test.cc for an example.
+ */
+
 #ifdef __cplusplus
 }
 #endif
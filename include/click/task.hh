@@ -274,6 +274,27 @@ class Task : private TaskLink { public:
      */
     void move_thread(int new_thread_id);
 
+#if HAVE_MULTITHREAD
+    /** @brief Return whether idle threads may steal the Task.
+     * @sa set_stealable */
+    inline bool stealable() const {
+        return _stealable;
+    }
+
+    /** @brief Set whether idle threads may steal the Task.
+     *
+     * When work stealing is enabled (see Master::set_work_stealing()), a
+     * thread with nothing to run may take a stealable Task from a busy
+     * thread.  The Task returns to its original home thread once it runs
+     * out of work.  Only mark a Task stealable if its callback is safe to
+     * run on any thread, for instance an Unqueue draining a
+     * ThreadSafeQueue.  Tasks are also stealable if the router's
+     * ThreadSched says so when the Task is initialized. */
+    inline void set_stealable(bool stealable) {
+        _stealable = stealable;
+    }
+#endif
+
 
 #if HAVE_STRIDE_SCHED
     inline int tickets() const;
@@ -330,6 +351,9 @@ class Task : private TaskLink { public:
 #if HAVE_MULTITHREAD
     DirectEWMA _cycles;
     unsigned _cycle_runs;
+    bool _stealable;
+    bool _steal_worked;         // did work when last fired
+    int16_t _steal_home;        // thread to return to, or -1 if not stolen
 #endif
 
     RouterThread *_thread;
@@ -391,7 +415,8 @@ Task::Task(TaskCallback f, void *user_data)
       _runs(0), _work_done(0),
 #endif
 #if HAVE_MULTITHREAD
-      _cycle_runs(0),
+      _cycle_runs(0), _stealable(false), _steal_worked(false),
+      _steal_home(-1),
 #endif
       _thread(0), _owner(0)
 {
@@ -414,7 +439,8 @@ Task::Task(Element* e)
       _runs(0), _work_done(0),
 #endif
 #if HAVE_MULTITHREAD
-      _cycle_runs(0),
+      _cycle_runs(0), _stealable(false), _steal_worked(false),
+      _steal_home(-1),
 #endif
       _thread(0), _owner(0)
 {
@@ -4,6 +4,7 @@
 #include <click/glue.hh>
 #include <click/type_traits.hh>
 #include <click/integers.hh>
+#include <click/machine.hh>
 #if !CLICK_LINUXMODULE && !CLICK_BSDMODULE
 # include <math.h>
 #endif
@@ -119,6 +120,24 @@ Timestamp operator+(Timestamp, const Timestamp &);
 #endif
 
 
+// TIMESTAMP_TSC is defined if Timestamp::now() can compute the time from the
+// CPU timestamp counter, calibrated against the system clock.
+
+#if CLICK_USERLEVEL && !CLICK_NS && HAVE_USE_CLOCK_GETTIME \
+    && TIMESTAMP_VALUE_INT64 && defined(__x86_64__)
+# define TIMESTAMP_TSC 1
+#endif
+
+
+// TIMESTAMP_RECENT_CACHE is defined if Timestamp::recent() returns a time
+// cached by the running RouterThread once per scheduling iteration.
+
+#if CLICK_USERLEVEL && !CLICK_NS \
+    && (!HAVE_MULTITHREAD || HAVE___THREAD_STORAGE_CLASS)
+# define TIMESTAMP_RECENT_CACHE 1
+#endif
+
+
 class Timestamp { public:
 
     /** @brief  Type represents a number of seconds. */
@@ -441,7 +460,10 @@ class Timestamp { public:
      *
      * The Timestamp::now() function calculates the current system time, which
      * is relatively expensive.  Timestamp::recent() can be faster, but is
-     * less precise: it returns a cached copy of a recent system time.
+     * less precise: it returns a cached copy of a recent system time.  At
+     * user level, this is the time of the first recent() call in the running
+     * RouterThread's current scheduling iteration, or since the thread last
+     * waited for events.
      * @sa now(), assign_recent() */
     static inline Timestamp recent();
 
@@ -667,6 +689,55 @@ class Timestamp { public:
     //@}
 #endif
 
+#if TIMESTAMP_TSC
+    /** @name Timestamp counter clock */
+    //@{
+    /** @brief Return true iff the CPU has an invariant timestamp counter.
+     *
+     * An invariant counter ticks at a constant rate in all power states and
+     * is synchronized across cores. */
+    static bool tsc_supported();
+
+    /** @brief Compute the time from the CPU timestamp counter.
+     *
+     * Calibrates the timestamp counter against the system clock, then makes
+     * now() and now_steady() compute the time from the counter instead of
+     * asking the operating system.  The counter clock is resynchronized with
+     * the system clock about once a second.  Steady-clock time never moves
+     * backwards: drift is slewed away, except that a counter clock more
+     * than 500 microseconds behind is stepped forward.  Returns
+     * false, leaving the system clock in use, if !tsc_supported().
+     * @sa tsc_stop(), tsc_resync() */
+    static bool tsc_start();
+
+    /** @brief Stop computing the time from the CPU timestamp counter.
+     *
+     * Time may step by the current drift. */
+    static void tsc_stop();
+
+    /** @brief Return true iff the time is computed from the timestamp
+     * counter. */
+    static inline bool tsc_active();
+
+    /** @brief Resynchronize the timestamp counter clock.
+     *
+     * Running RouterThreads call this about once a second.  Does nothing if
+     * !tsc_active() or another thread is resynchronizing. */
+    static void tsc_resync();
+
+    /** @brief Return the calibrated timestamp counter frequency in Hz. */
+    static inline double tsc_hz();
+
+    /** @brief Return the drift found by the last resynchronization.
+     *
+     * The drift is the counter clock's steady time minus the system's. */
+    static inline Timestamp tsc_drift();
+
+    /** @brief Return the number of resynchronizations since tsc_start(). */
+    static inline uint32_t tsc_resyncs();
+    //@}
+#endif
+
   private:
 
     rep_t _t;
@@ -754,6 +825,76 @@ inline Timestamp Timestamp::warped(bool steady) const {
 }
 #endif
 
+#if TIMESTAMP_TSC
+/** @cond never */
+class TimestampTSC {
+    // now() reads the parameters under a sequence lock: seq is odd while
+    // they change.
+    static volatile uint32_t seq;
+    static bool active;
+    static uint64_t base_cycles;
+    static Timestamp base_steady;
+    static Timestamp offset;            // system time minus steady time
+    static uint64_t mult;               // nanoseconds per cycle << 32
+
+    static uint64_t next_resync;
+    static uint64_t cal_cycles;
+    static Timestamp cal_steady;
+    static double hz;
+    static Timestamp drift;
+    static uint32_t nresyncs;
+    static volatile uint32_t resync_lock;
+
+    static inline Timestamp steady_at(uint64_t cycles);
+    static inline Timestamp now(bool steady);
+    static inline void maintain();
+    static void set(uint64_t cycles, const Timestamp &steady,
+                    const Timestamp &offset, double ns_per_cycle);
+
+    friend class Timestamp;
+    friend class RouterThread;
+};
+/** @endcond never */
+
+inline bool Timestamp::tsc_active() {
+    return TimestampTSC::active;
+}
+
+inline double Timestamp::tsc_hz() {
+    return TimestampTSC::hz;
+}
+
+inline Timestamp Timestamp::tsc_drift() {
+    return TimestampTSC::drift;
+}
+
+inline uint32_t Timestamp::tsc_resyncs() {
+    return TimestampTSC::nresyncs;
+}
+#endif
+
+#if TIMESTAMP_RECENT_CACHE
+/** @cond never */
+class TimestampRecent { public:
+    // Mark the cached times stale; the next recent() call refills them.
+    static void invalidate() {
+        if (cache)
+            cache[0] = cache[1] = Timestamp();
+    }
+  private:
+    // Points to the running RouterThread's cached system and steady times.
+    // A zero entry is stale.
+# if HAVE_MULTITHREAD
+    static __thread Timestamp *cache;
+# else
+    static Timestamp *cache;
+# endif
+    friend class Timestamp;
+    friend class RouterThread;
+};
+/** @endcond never */
+#endif
+
 
 /** @brief Create a Timestamp measuring @a tv.
     @param tv timeval structure */
@@ -884,12 +1025,19 @@ Timestamp::assign_now(bool recent, bool steady, bool unwarped)
     }
 
 #elif HAVE_USE_CLOCK_GETTIME
-    TIMESTAMP_DECLARE_TSP;
-    if (steady)
-        clock_gettime(CLOCK_MONOTONIC, &tsp);
+# if TIMESTAMP_TSC
+    if (TimestampTSC::active)
+        *this = TimestampTSC::now(steady);
     else
-        clock_gettime(CLOCK_REALTIME, &tsp);
-    TIMESTAMP_RESOLVE_TSP;
+# endif
+    {
+        TIMESTAMP_DECLARE_TSP;
+        if (steady)
+            clock_gettime(CLOCK_MONOTONIC, &tsp);
+        else
+            clock_gettime(CLOCK_REALTIME, &tsp);
+        TIMESTAMP_RESOLVE_TSP;
+    }
 
 #else
     TIMESTAMP_DECLARE_TVP;
@@ -926,6 +1074,14 @@ Timestamp::now()
 inline void
 Timestamp::assign_recent()
 {
+#if TIMESTAMP_RECENT_CACHE
+    if (Timestamp *cache = TimestampRecent::cache) {
+        if (!cache[0])
+            cache[0].assign_now();
+        *this = cache[0];
+        return;
+    }
+#endif
     assign_now(true, false, false);
 }
 
@@ -954,6 +1110,14 @@ Timestamp::now_steady()
 inline void
 Timestamp::assign_recent_steady()
 {
+#if TIMESTAMP_RECENT_CACHE
+    if (Timestamp *cache = TimestampRecent::cache) {
+        if (!cache[1])
+            cache[1].assign_now_steady();
+        *this = cache[1];
+        return;
+    }
+#endif
     assign_now(true, true, false);
 }
 
@@ -1515,6 +1679,45 @@ Timestamp::timespec() const
 # endif
 #endif
 
+#if TIMESTAMP_TSC
+/** @cond never */
+inline Timestamp
+TimestampTSC::steady_at(uint64_t cycles)
+{
+    Timestamp t = base_steady;
+    int64_t delta = cycles - base_cycles;
+    // Another core may read a counter value a little before base_cycles.
+    if (delta > 0)
+        t += Timestamp::make_nsec((Timestamp::value_type)
+                                  (((unsigned __int128) delta * mult) >> 32));
+    return t;
+}
+
+inline Timestamp
+TimestampTSC::now(bool steady)
+{
+    Timestamp t = Timestamp::uninitialized_t();
+    uint32_t s;
+    do {
+        s = seq;
+        click_compiler_fence();
+        t = steady_at(click_get_cycles());
+        if (!steady)
+            t += offset;
+        click_compiler_fence();
+    } while ((s & 1) || s != seq);
+    return t;
+}
+
+inline void
+TimestampTSC::maintain()
+{
+    if (active && click_get_cycles() >= next_resync)
+        Timestamp::tsc_resync();
+}
+/** @endcond never */
+#endif
+
 
 class ArgContext;
 extern const ArgContext blank_args;
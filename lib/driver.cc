@@ -480,8 +480,40 @@ click_static_cleanup()
 # endif /* HAVE_DYNAMIC_LINKING */
 }
 
+#if CLICK_USERLEVEL
+static void
+write_compiled_router(const String &compiled_filename, const String &data,
+                      ErrorHandler *errh)
+{
+    String tmp = compiled_filename + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f
+        || fwrite(data.data(), 1, data.length(), f) != (size_t) data.length()
+        || fclose(f) != 0
+        || rename(tmp.c_str(), compiled_filename.c_str()) != 0) {
+        errh->warning("%s: %s", compiled_filename.c_str(), strerror(errno));
+        if (f)
+            unlink(tmp.c_str());
+    }
+}
+#endif
+
+/** @brief Read a router configuration.
+ * @param filename configuration file name, or configuration text
+ * @param is_expr true iff @a filename is configuration text
+ * @param errh error handler
+ * @param initialize if true, initialize the router
+ * @param master router's master; if null, creates a new one
+ * @param compiled_filename compiled configuration file (user level only)
+ * @param compiled_hit set to true iff the compiled file was used
+ *
+ * If @a compiled_filename is set and names an up-to-date compiled version of
+ * the configuration, the router is built from it without parsing.
+ * Otherwise the configuration is parsed, and, if parsing succeeds, its
+ * compiled version is written to @a compiled_filename for next time. */
 Router *
-click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initialize, Master *master)
+click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initialize, Master *master,
+                  const String &compiled_filename, bool *compiled_hit)
 {
     if (!errh)
         errh = ErrorHandler::silent_handler();
@@ -517,14 +549,40 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
         }
     }
 
-    // lex
     Lexer *l = click_lexer();
     RequireLexerExtra lextra(&archive);
-    int cookie = l->begin_parse(config_str, filename, &lextra, errh);
-    while (!l->ydone())
-        l->ystep();
-    Router *router = l->create_router(master ? master : new Master(1));
-    l->end_parse(cookie);
+    if (!master)
+        master = new Master(1);
+    Router *router = 0;
+    if (compiled_hit)
+        *compiled_hit = false;
+
+#if CLICK_USERLEVEL
+    // use compiled configuration if it's up to date
+    if (compiled_filename) {
+        ErrorHandler *serrh = ErrorHandler::silent_handler();
+        int sbefore = serrh->nerrors();
+        String compiled = file_string(compiled_filename, serrh);
+        if (serrh->nerrors() == sbefore
+            && (router = l->create_compiled_router(compiled, config_str, filename, &lextra, master, errh))
+            && compiled_hit)
+            *compiled_hit = true;
+    }
+#endif
+
+    // lex
+    if (!router) {
+        StringAccum compiled;
+        int cookie = l->begin_parse(config_str, filename, &lextra, errh);
+        while (!l->ydone())
+            l->ystep();
+        router = l->create_router(master, compiled_filename ? &compiled : 0);
+        l->end_parse(cookie);
+#if CLICK_USERLEVEL
+        if (compiled_filename && errh->nerrors() == before)
+            write_compiled_router(compiled_filename, compiled.take_string(), errh);
+#endif
+    }
 
     // initialize if requested
     if (initialize)
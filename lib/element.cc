@@ -1825,6 +1825,56 @@ Element::add_read_handler(const char *name, ReadHandlerCallback read_callback, i
     Router::add_read_handler(this, String::make_stable(name), read_callback, (void *) u, flags);
 }
 
+/** @brief Register a streaming read handler named @a name.
+ *
+ * @param name handler name
+ * @param read_callback function called to produce each chunk of the value
+ * @param user_data user data parameter passed to @a read_callback
+ * @param flags flags to set
+ *
+ * Adds a read handler whose value is produced in chunks, which lets drivers
+ * such as ControlSocket emit large values without building them in memory
+ * first.  @a read_callback is called like this:
+ *
+ * @code
+ * int r = read_callback(e, user_data, sa, cursor);
+ * @endcode
+ *
+ * See Router::add_read_stream_handler() for the meaning of @a sa, @a cursor,
+ * and the return value.
+ *
+ * @sa add_read_handler, Handler::call_read_chunk
+ */
+void
+Element::add_read_stream_handler(const String &name, ReadStreamHandlerCallback read_callback, const void *user_data, uint32_t flags)
+{
+    Router::add_read_stream_handler(this, name, read_callback, (void *) user_data, flags);
+}
+
+/** @brief Register a streaming read handler named @a name.
+ *
+ * This version of add_read_stream_handler() is useful when @a user_data is
+ * an integer.
+ */
+void
+Element::add_read_stream_handler(const String &name, ReadStreamHandlerCallback read_callback, int user_data, uint32_t flags)
+{
+    uintptr_t u = (uintptr_t) user_data;
+    Router::add_read_stream_handler(this, name, read_callback, (void *) u, flags);
+}
+
+/** @brief Register a streaming read handler named @a name.
+ *
+ * This version of add_read_stream_handler() is useful when @a name is a
+ * static constant string.  @a name is passed to String::make_stable.
+ */
+void
+Element::add_read_stream_handler(const char *name, ReadStreamHandlerCallback read_callback, int user_data, uint32_t flags)
+{
+    uintptr_t u = (uintptr_t) user_data;
+    Router::add_read_stream_handler(this, String::make_stable(name), read_callback, (void *) u, flags);
+}
+
 /** @brief Register a write handler named @a name.
  *
  * @param name handler name
@@ -2171,7 +2171,7 @@ Lexer::expand_compound_element(int which, VariableEnvironment &ve)
 }
 
 Router *
-Lexer::create_router(Master *master)
+Lexer::create_router(Master *master, StringAccum *compiled)
 {
   Router *router = new Router(_file._big_string, master);
   if (!router)
@@ -2239,10 +2239,318 @@ Lexer::create_router(Master *master)
   for (int i = 0; i < _requirements.size(); i += 2)
       router->add_requirement(_requirements[i], _requirements[i+1]);
 
+#if CLICK_USERLEVEL
+  if (compiled)
+      unparse_compiled(*compiled, router_id);
+#else
+  (void) compiled;
+#endif
   return router;
 }
 
 
+//
+// COMPILED CONFIGURATIONS
+//
+
+#if CLICK_USERLEVEL
+// A compiled configuration is the flattened element graph that
+// create_router() built, so a later run can skip lexing and compound
+// expansion.  Integers are little-endian base-128 varints and strings are
+// length-prefixed.  The layout is:
+//
+//   magic, 8-byte source hash, libraries (count, then file names),
+//   requirements (count, then type/value pairs),
+//   element types (count, then names), file names (count, then names),
+//   elements (count, then type index, name, configuration, file index,
+//   line number), connections (count, then from, from port, to, to port).
+//
+// The hash covers the Click version, the configuration text and file name,
+// the global variable definitions, and the contents of required libraries,
+// so any change to those makes the compiled file stale.
+
+static const char compiled_magic[] = "\177ClickCC1";
+enum { compiled_magic_len = sizeof(compiled_magic) - 1 };
+
+static void
+compiled_put(StringAccum &sa, uint32_t x)
+{
+    while (x >= 0x80) {
+	sa << (char) (x | 0x80);
+	x >>= 7;
+    }
+    sa << (char) x;
+}
+
+static void
+compiled_put(StringAccum &sa, const String &s)
+{
+    compiled_put(sa, s.length());
+    sa << s;
+}
+
+namespace {
+struct CompiledReader {
+    String _s;
+    const char *_pos;
+    const char *_end;
+    CompiledReader(const String &s)
+	: _s(s), _pos(s.begin()), _end(s.end()) {
+    }
+    bool get(uint32_t &x) {
+	x = 0;
+	for (int shift = 0; _pos != _end && shift < 35; shift += 7) {
+	    unsigned char c = *_pos++;
+	    x |= (uint32_t) (c & 0x7F) << shift;
+	    if (!(c & 0x80))
+		return true;
+	}
+	return false;
+    }
+    bool get(String &str) {
+	uint32_t len;
+	if (!get(len) || len > (uint32_t) (_end - _pos))
+	    return false;
+	// substrings share the compiled file's memory
+	str = _s.substring(_pos, _pos + len);
+	_pos += len;
+	return true;
+    }
+};
+
+struct CompiledHash {
+    uint64_t _h;
+    CompiledHash()
+	: _h(0xCBF29CE484222325ULL) {
+    }
+    void add(const String &s) {
+	uint32_t len = s.length();
+	for (int i = 0; i < 4; ++i)
+	    add_byte(len >> (8 * i));
+	for (const char *x = s.begin(); x != s.end(); ++x)
+	    add_byte(*x);
+    }
+    void add_byte(unsigned char c) {
+	_h = (_h ^ c) * 0x100000001B3ULL;
+    }
+};
+}
+
+uint64_t
+Lexer::compiled_hash(const String &data, const String &filename,
+		     const Vector<String> &libraries, bool &ok) const
+{
+    CompiledHash h;
+    h.add(String::make_stable(CLICK_VERSION));
+    h.add(filename);
+    h.add(data);
+    for (int i = 0; i < _global_scope.size(); ++i) {
+	h.add(_global_scope.name(i));
+	h.add(_global_scope.value(i));
+    }
+    ok = true;
+    for (const String *it = libraries.begin(); it != libraries.end(); ++it) {
+	ErrorHandler *errh = ErrorHandler::silent_handler();
+	int before = errh->nerrors();
+	String lib = file_string(*it, errh);
+	if (errh->nerrors() != before)
+	    ok = false;
+	h.add(*it);
+	h.add(lib);
+    }
+    return h._h;
+}
+
+void
+Lexer::unparse_compiled(StringAccum &sa, const Vector<int> &router_id)
+{
+    bool ok;
+    uint64_t hash = compiled_hash(_file._big_string, _file._original_filename,
+				  _libraries, ok);
+    sa.append(compiled_magic, compiled_magic_len);
+    for (int i = 0; i < 8; ++i)
+	sa << (char) (hash >> (8 * i));
+
+    compiled_put(sa, _libraries.size());
+    for (const String *it = _libraries.begin(); it != _libraries.end(); ++it)
+	compiled_put(sa, *it);
+
+    compiled_put(sa, _requirements.size() / 2);
+    for (const String *it = _requirements.begin(); it != _requirements.end(); ++it)
+	compiled_put(sa, *it);
+
+    // element types and file names are written once and referenced by index
+    Vector<int> type_index(_element_types.size(), -1);
+    Vector<int> types;
+    HashTable<String, int> file_index(-1);
+    Vector<String> files;
+    int nelements = 0;
+    for (int i = 0; i < _c->_elements.size(); ++i)
+	if (router_id[i] >= 0) {
+	    int &ti = type_index[_c->_elements[i]];
+	    if (ti < 0) {
+		ti = types.size();
+		types.push_back(_c->_elements[i]);
+	    }
+	    int &fi = file_index[_c->_element_filenames[i]];
+	    if (fi < 0) {
+		fi = files.size();
+		files.push_back(_c->_element_filenames[i]);
+	    }
+	    ++nelements;
+	}
+
+    compiled_put(sa, types.size());
+    for (int *it = types.begin(); it != types.end(); ++it)
+	compiled_put(sa, _element_types[*it].name);
+    compiled_put(sa, files.size());
+    for (String *it = files.begin(); it != files.end(); ++it)
+	compiled_put(sa, *it);
+
+    compiled_put(sa, nelements);
+    for (int i = 0; i < _c->_elements.size(); ++i)
+	if (router_id[i] >= 0) {
+	    compiled_put(sa, type_index[_c->_elements[i]]);
+	    compiled_put(sa, _c->_element_names[i]);
+	    compiled_put(sa, _c->_element_configurations[i]);
+	    compiled_put(sa, file_index[_c->_element_filenames[i]]);
+	    compiled_put(sa, _c->_element_linenos[i]);
+	}
+
+    // create_router() has already renumbered and sorted the connections
+    int nconn = 0;
+    for (Connection *cp = _c->_conn.begin(); cp != _c->_conn.end(); ++cp)
+	if ((*cp)[0].idx >= 0 && (*cp)[1].idx >= 0)
+	    ++nconn;
+    compiled_put(sa, nconn);
+    for (Connection *cp = _c->_conn.begin(); cp != _c->_conn.end(); ++cp)
+	if ((*cp)[0].idx >= 0 && (*cp)[1].idx >= 0) {
+	    compiled_put(sa, (*cp)[1].idx);
+	    compiled_put(sa, (*cp)[1].port);
+	    compiled_put(sa, (*cp)[0].idx);
+	    compiled_put(sa, (*cp)[0].port);
+	}
+}
+
+/** @brief Create a router from a compiled configuration.
+ * @param compiled compiled configuration, from create_router()
+ * @param data configuration text
+ * @param filename configuration file name
+ * @param lextra handles requirements
+ * @param master router's master
+ * @param errh error handler for requirements
+ *
+ * Returns null, without reporting errors, if @a compiled is malformed, was
+ * compiled from a different configuration, or names an unknown element
+ * class.  The caller should then parse @a data as usual.  Otherwise
+ * returns an uninitialized router equivalent to the one create_router()
+ * built.  Requirements are passed to @a lextra only once the whole file has
+ * been read.  Element classes must therefore already be known; a class
+ * provided by a package that is not yet loaded makes this function return
+ * null, and the text parser then loads the package. */
+Router *
+Lexer::create_compiled_router(const String &compiled, const String &data,
+			      const String &filename, LexerExtra *lextra,
+			      Master *master, ErrorHandler *errh)
+{
+    CompiledReader r(compiled);
+    if (compiled.length() < compiled_magic_len + 8
+	|| memcmp(compiled.data(), compiled_magic, compiled_magic_len) != 0)
+	return 0;
+    r._pos += compiled_magic_len;
+    uint64_t hash = 0;
+    for (int i = 0; i < 8; ++i)
+	hash |= (uint64_t) (unsigned char) *r._pos++ << (8 * i);
+
+    uint32_t n;
+    Vector<String> libraries;
+    if (!r.get(n))
+	return 0;
+    libraries.resize(n);
+    for (uint32_t i = 0; i < n; ++i)
+	if (!r.get(libraries[i]))
+	    return 0;
+    bool ok;
+    if (compiled_hash(data, filename, libraries, ok) != hash || !ok)
+	return 0;
+
+    Vector<String> requirements;
+    if (!r.get(n))
+	return 0;
+    requirements.resize(2 * n);
+    for (uint32_t i = 0; i < 2 * n; ++i)
+	if (!r.get(requirements[i]))
+	    return 0;
+
+    Vector<int> types;
+    Vector<String> files;
+    String str;
+    if (!r.get(n))
+	return 0;
+    for (uint32_t i = 0; i < n; ++i) {
+	int t;
+	if (!r.get(str) || (t = element_type(str)) < 0
+	    || t == TUNNEL_TYPE || t == ERROR_TYPE
+	    || _element_types[t].compound())
+	    return 0;
+	types.push_back(t);
+    }
+    if (!r.get(n))
+	return 0;
+    files.resize(n);
+    for (uint32_t i = 0; i < n; ++i)
+	if (!r.get(files[i]))
+	    return 0;
+
+    Router *router = new Router(data, master);
+    if (!router)
+	return 0;
+    uint32_t nelements, nconn;
+    if (!r.get(nelements))
+	goto stale;
+    for (uint32_t i = 0; i < nelements; ++i) {
+	uint32_t ti, fi, lineno;
+	String name, conf;
+	if (!r.get(ti) || ti >= (uint32_t) types.size()
+	    || !r.get(name) || !r.get(conf)
+	    || !r.get(fi) || fi >= (uint32_t) files.size()
+	    || !r.get(lineno))
+	    goto stale;
+	const ElementType &et = _element_types[types[ti]];
+	Element *e = et.factory(et.thunk);
+	if (!e)
+	    goto stale;
+	router->add_element(e, name, conf, files[fi], lineno);
+    }
+
+    if (!r.get(nconn))
+	goto stale;
+    for (uint32_t i = 0; i < nconn; ++i) {
+	uint32_t from, from_port, to, to_port;
+	if (!r.get(from) || from >= nelements || !r.get(from_port)
+	    || !r.get(to) || to >= nelements || !r.get(to_port))
+	    goto stale;
+	router->add_connection(from, from_port, to, to_port);
+    }
+    if (r._pos != r._end)
+	goto stale;
+
+    // Apply requirements only now, so a stale file doesn't run them before
+    // the text parser runs them again.
+    for (int i = 0; i < requirements.size(); i += 2) {
+	if (lextra)
+	    lextra->require(requirements[i], requirements[i+1], errh);
+	router->add_requirement(requirements[i], requirements[i+1]);
+    }
+    return router;
+
+  stale:
+    delete router;
+    return 0;
+}
+#endif
+
+
 //
 // LEXEREXTRA
 //
@@ -27,6 +27,9 @@
 #if CLICK_USERLEVEL || CLICK_MINIOS
 # include <unistd.h>
 #endif
+#if CLICK_PACKET_HOT_LAYOUT && __cpp_aligned_new
+# include <new>
+#endif
 CLICK_DECLS
 
 /** @file packet.hh
@@ -258,6 +261,16 @@ struct PacketPool {
 };
 }
 
+/** @brief Free the memory of a pooled packet whose destructor has run. */
+static inline void free_packet_memory(WritablePacket *p) {
+#  if CLICK_PACKET_HOT_LAYOUT && __cpp_aligned_new
+    // The hot layout over-aligns Packet, so new used the aligned allocator.
+    ::operator delete((void *) p, std::align_val_t(alignof(WritablePacket)));
+#  else
+    ::operator delete((void *) p);
+#  endif
+}
+
 #  if HAVE_MULTITHREAD
 static __thread PacketPool *thread_packet_pool;
 
@@ -402,7 +415,7 @@ WritablePacket::recycle(WritablePacket *p)
 	    if (global_packet_pool.pbatchcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
 		while (WritablePacket *p = packet_pool.p) {
 		    packet_pool.p = static_cast<WritablePacket *>(p->next());
-		    ::operator delete((void *) p);
+		    free_packet_memory(p);
 		}
 	    } else {
 		packet_pool.p->set_prev(global_packet_pool.pbatch);
@@ -435,7 +448,7 @@ WritablePacket::recycle(WritablePacket *p)
     }
 #  else /* !HAVE_MULTITHREAD */
     if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	::operator delete((void *) p);
+	free_packet_memory(p);
 	p = 0;
     }
     if (data && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
@@ -940,7 +953,7 @@ cleanup_pool(PacketPool *pp, int global)
     while (WritablePacket *p = pp->p) {
 	++pcount;
 	pp->p = static_cast<WritablePacket *>(p->next());
-	::operator delete((void *) p);
+	free_packet_memory(p);
     }
     while (PacketData *pd = pp->pd) {
 	++pdcount;
@@ -1305,7 +1305,7 @@ Handler::combine(const Handler &x)
     if (!(_flags & f_read) && (x._flags & f_read)) {
         _read_hook = x._read_hook;
         _read_user_data = x._read_user_data;
-        _flags |= x._flags & (f_read | f_read_comprehensive | ~f_special);
+        _flags |= x._flags & (f_read | f_read_comprehensive | f_read_stream | ~f_special);
     }
     if (!(_flags & f_write) && (x._flags & f_write)) {
         _write_hook = x._write_hook;
@@ -1334,9 +1334,19 @@ Handler::call_read(Element* e, const String& param, ErrorHandler* errh) const
     LocalErrorHandler lerrh(errh);
     if (param && !(_flags & f_read_param))
         lerrh.error("read handler %<%s%> does not take parameters", unparse_name(e).c_str());
-    else if ((_flags & (f_read | f_read_comprehensive)) == f_read)
+    else if ((_flags & (f_read | f_read_comprehensive | f_read_stream)) == f_read)
         return _read_hook.r(e, _read_user_data);
-    else if (_flags & f_read) {
+    else if (_flags & f_read_stream) {
+        StringAccum sa;
+        uint64_t cursor = 0;
+        int r;
+        do {
+            r = _read_hook.s(e, _read_user_data, sa, cursor);
+        } while (r > 0);
+        if (r == 0)
+            return sa.take_string();
+        lerrh.error("%<%s%> read error %d", unparse_name(e).c_str(), -r);
+    } else if (_flags & f_read) {
         String s(param);
         if (_read_hook.h(f_read, s, e, this, &lerrh) >= 0)
             return s;
@@ -1346,6 +1356,27 @@ Handler::call_read(Element* e, const String& param, ErrorHandler* errh) const
     return String();
 }
 
+int
+Handler::call_read_chunk(Element *e, StringAccum &sa, uint64_t &cursor,
+                         ErrorHandler *errh) const
+{
+    if ((_flags & (f_read | f_read_stream)) == (f_read | f_read_stream)) {
+        int r = _read_hook.s(e, _read_user_data, sa, cursor);
+        if (r < 0) {
+            LocalErrorHandler lerrh(errh);
+            lerrh.error("%<%s%> read error %d", unparse_name(e).c_str(), -r);
+        }
+        return r;
+    } else {
+        LocalErrorHandler lerrh(errh);
+        String s = call_read(e, String(), &lerrh);
+        if (lerrh.nerrors())
+            return -EINVAL;
+        sa << s;
+        return 0;
+    }
+}
+
 int
 Handler::call_write(const String& value, Element* e, ErrorHandler* errh) const
 {
@@ -1727,6 +1758,44 @@ Router::add_read_handler(const Element *e, const String &hname,
     store_handler(e, to_add);
 }
 
+/** @brief Add an @a e.@a hname streaming read handler.
+ * @param e element, if any
+ * @param hname handler name
+ * @param callback read callback
+ * @param user_data user data for read callback
+ * @param flags additional flags to set (Handler::flags())
+ *
+ * Adds a streaming read handler named @a hname for element @a e.  If @a e is
+ * NULL or equal to some root_element(), then adds a global read handler.
+ * The handler's value is produced in chunks by calls like this:
+ *
+ * @code
+ * int r = callback(e, user_data, sa, cursor);
+ * @endcode
+ *
+ * Each call should append about Handler::stream_chunk_size bytes to @a sa
+ * and update @a cursor, which is 0 on the first call and otherwise
+ * uninterpreted.  It should return a positive number if more chunks follow,
+ * 0 after the last chunk, or a negative errno value on error.  Drivers may
+ * run the router between calls, so @a cursor should name a position, such
+ * as a bucket number, that stays meaningful as the underlying data changes.
+ *
+ * Otherwise the handler acts like one added by add_read_handler().
+ *
+ * @sa add_read_handler(), Handler::call_read_chunk()
+ */
+void
+Router::add_read_stream_handler(const Element *e, const String &hname,
+                                ReadStreamHandlerCallback callback,
+                                void *user_data, uint32_t flags)
+{
+    Handler to_add(hname);
+    to_add._read_hook.s = callback;
+    to_add._read_user_data = user_data;
+    to_add._flags = Handler::f_read | Handler::f_read_stream | (flags & ~Handler::f_special);
+    store_handler(e, to_add);
+}
+
 /** @brief Add an @a e.@a hname write handler.
  * @param e element, if any
  * @param hname handler name
@@ -1946,6 +2015,12 @@ ThreadSched::initial_home_thread_id(const Element *)
     return 0;
 }
 
+bool
+ThreadSched::initial_task_stealable(const Element *)
+{
+    return false;
+}
+
 /** @cond never */
 /** @brief  Create (if necessary) and return the NameInfo object for this router.
  *
@@ -1990,19 +2065,23 @@ void
 Router::unparse_declarations(StringAccum &sa, const String &indent) const
 {
   // element classes
-  Vector<String> conf;
-  for (int i = 0; i < nelements(); i++) {
-    sa << indent << _element_names[i] << " :: " << _elements[i]->class_name();
-    String conf = (initialized() ? _elements[i]->configuration() : _element_configurations[i]);
-    if (conf.length())
-      sa << "(" << conf << ")";
-    sa << ";\n";
-  }
+  for (int i = 0; i < nelements(); i++)
+    unparse_declaration(sa, indent, i);
 
   if (nelements() > 0)
     sa << "\n";
 }
 
+void
+Router::unparse_declaration(StringAccum &sa, const String &indent, int eindex) const
+{
+  sa << indent << _element_names[eindex] << " :: " << _elements[eindex]->class_name();
+  String conf = (initialized() ? _elements[eindex]->configuration() : _element_configurations[eindex]);
+  if (conf.length())
+    sa << "(" << conf << ")";
+  sa << ";\n";
+}
+
 /** @brief Unparse the router's connections into @a sa.
  *
  * Appends this router's connections to @a sa in parseable format. */
@@ -2207,16 +2286,6 @@ Router::router_read_handler(Element *e, void *thunk)
       case GH_VERSION:
         return String(CLICK_VERSION);
 
-      case GH_CONFIG:
-        if (r)
-            return r->configuration_string();
-        break;
-
-      case GH_FLATCONFIG:
-        if (r)
-            r->unparse(sa);
-        break;
-
       case GH_LIST:
         if (r) {
             sa << r->nelements() << "\n";
@@ -2407,6 +2476,52 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
     return 0;
 }
 
+/* The config and flatconfig handlers stream.  config hands out the stored
+   configuration string a chunk at a time.  flatconfig unparses element
+   declarations a chunk at a time, using the next element index as the
+   cursor; the connections are unparsed in one final chunk, since chaining
+   them needs the whole connection graph. */
+int
+Router::router_read_stream_handler(Element *e, void *thunk, StringAccum &sa,
+                                   uint64_t &cursor)
+{
+    Router *r = (e ? e->router() : 0);
+    if (!r)
+        return 0;
+
+    if (reinterpret_cast<intptr_t>(thunk) == GH_CONFIG && r->_have_configuration) {
+        const String &config = r->_configuration;
+        uint64_t len = config.length();
+        if (cursor < len) {
+            uint64_t n = len - cursor;
+            if (n > Handler::stream_chunk_size)
+                n = Handler::stream_chunk_size;
+            sa.append(config.data() + cursor, (int) n);
+            cursor += n;
+        }
+        return cursor < len;
+    }
+
+    // GH_FLATCONFIG, or GH_CONFIG without a stored configuration string
+    uint64_t n = r->nelements();
+    if (cursor > n)
+        return 0;
+    if (cursor == 0)
+        r->unparse_requirements(sa);
+    int start_length = sa.length();
+    while (cursor < n && sa.length() - start_length < Handler::stream_chunk_size) {
+        r->unparse_declaration(sa, String(), (int) cursor);
+        ++cursor;
+    }
+    if (cursor < n)
+        return 1;
+    if (n > 0)
+        sa << "\n";
+    r->unparse_connections(sa);
+    cursor = n + 1;
+    return 0;
+}
+
 void
 Router::static_initialize()
 {
@@ -2414,8 +2529,8 @@ Router::static_initialize()
         Handler::the_blank_handler = new Handler("<bad handler>");
         add_read_handler(0, "version", router_read_handler, (void *)GH_VERSION);
         add_read_handler(0, "driver", router_read_handler, (void *)GH_DRIVER);
-        add_read_handler(0, "config", router_read_handler, (void *)GH_CONFIG);
-        add_read_handler(0, "flatconfig", router_read_handler, (void *)GH_FLATCONFIG);
+        add_read_stream_handler(0, "config", router_read_stream_handler, (void *)GH_CONFIG);
+        add_read_stream_handler(0, "flatconfig", router_read_stream_handler, (void *)GH_FLATCONFIG);
         add_read_handler(0, "requirements", router_read_handler, (void *)GH_REQUIREMENTS);
         add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
         add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
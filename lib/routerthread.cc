@@ -83,6 +83,11 @@ RouterThread::RouterThread(Master *master, int id)
 
     _task_blocker = 0;
     _task_blocker_waiting = 0;
+#if HAVE_MULTITHREAD
+    _steal_waiting = 0;
+    _steals = 0;
+    _steal_returns = 0;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _max_click_share = 80 * Task::MAX_UTILIZATION / 100;
     _min_click_share = Task::MAX_UTILIZATION / 200;
@@ -396,6 +401,12 @@ RouterThread::run_tasks(int ntasks)
             unsigned delta = click_get_cycles() - cycles;
             t->update_cycles(delta/32 + (t->cycles()*31)/32);
         }
+
+        if (unlikely(t->_stealable)) {
+            t->_steal_worked = work_done;
+            if (t->_steal_home >= 0 && (!work_done || !t->scheduled()))
+                return_stolen_task(t);
+        }
 #endif
 
         // fix task list
@@ -528,6 +539,113 @@ RouterThread::run_os()
     driver_lock_tasks();
 }
 
+inline void
+RouterThread::update_recent()
+{
+#if TIMESTAMP_TSC
+    TimestampTSC::maintain();
+#endif
+#if TIMESTAMP_RECENT_CACHE
+# if TIMESTAMP_WARPABLE
+    // Warped time moves on every call to now(); don't cache it.
+    if (Timestamp::warp_class()) {
+        TimestampRecent::cache = 0;
+        return;
+    }
+# endif
+    // Fill the cache lazily, so iterations that don't ask for the time
+    // don't pay for reading the clocks.
+    TimestampRecent::cache = _recent;
+    TimestampRecent::invalidate();
+#endif
+}
+
+#if HAVE_MULTITHREAD
+/******************************/
+/* Work stealing              */
+/******************************/
+
+// Work stealing is receiver-initiated, but tasks only ever leave a thread's
+// scheduled list on that thread.  An idle thread raises _steal_waiting; a
+// busy thread that notices hands one of its stealable tasks to a waiting
+// thread with move_thread(), which migrates it through the pending lists
+// as usual.  A stolen task goes home as soon as it runs out of work.
+
+void
+RouterThread::run_work_stealing()
+{
+    if (!active()) {
+        if (!_steal_waiting.value() && !_stop_flag) {
+            ++_master->_steal_waiting;
+            _steal_waiting = 1;
+        }
+    } else {
+        if (_steal_waiting.value())
+            stop_steal_waiting();
+        if (_master->_steal_waiting.value())
+            give_stealable_task();
+    }
+}
+
+void
+RouterThread::stop_steal_waiting()
+{
+    if (_steal_waiting.compare_swap(1, 0) == 1)
+        --_master->_steal_waiting;
+}
+
+void
+RouterThread::give_stealable_task()
+{
+    // must be called with thread's lock acquired
+
+    // keep at least one task
+    Task *t = task_begin();
+    if (t == task_end() || task_next(t) == task_end())
+        return;
+
+    Task::Status want_status;
+    want_status.home_thread_id = thread_id();
+    want_status.is_scheduled = true;
+    want_status.is_strong_unscheduled = false;
+    for (; t != task_end(); t = task_next(t))
+        if (t->_stealable && t->_steal_worked
+            && t->_status.status == want_status.status
+            && !t->on_pending_list())
+            break;
+    if (t == task_end())
+        return;
+
+    int n = _master->nthreads();
+    for (int i = 1; i < n; ++i) {
+        RouterThread *thief = _master->thread((_id + i) % n);
+        if (thief->_steal_waiting.value()
+            && thief->_steal_waiting.compare_swap(1, 0) == 1) {
+            --_master->_steal_waiting;
+            if (t->_steal_home < 0)
+                t->_steal_home = _id;
+            else if (t->_steal_home == thief->_id)
+                t->_steal_home = -1;
+            ++thief->_steals;
+            t->move_thread(thief->_id);
+            return;
+        }
+    }
+}
+
+void
+RouterThread::return_stolen_task(Task *t)
+{
+    int home = t->_steal_home;
+    t->_steal_home = -1;
+    // leave the task alone if someone else has moved it
+    if (home != _id && t->_status.home_thread_id == _id) {
+        ++_steal_returns;
+        t->move_thread(home);
+    }
+}
+#endif
+
 void
 RouterThread::process_pending()
 {
@@ -598,6 +716,7 @@ RouterThread::driver()
 
         // run occasional tasks: timers, select, etc.
         iter++;
+        update_recent();
 
         // run task requests
         click_compiler_fence();
@@ -613,6 +732,11 @@ RouterThread::driver()
             run_tasks(_tasks_per_iter);
         } while (0);
 
+#if HAVE_MULTITHREAD
+        if (_master->_work_stealing)
+            run_work_stealing();
+#endif
+
 #if CLICK_USERLEVEL
         // run signals
         run_signals();
@@ -652,9 +776,15 @@ RouterThread::driver()
 #endif
     }
 
+#if HAVE_MULTITHREAD
+    stop_steal_waiting();
+#endif
     driver_unlock_tasks();
 
     _driver_entered = false;
+#if TIMESTAMP_RECENT_CACHE
+    TimestampRecent::cache = 0;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _cur_click_share = 0;
 #endif
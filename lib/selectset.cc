@@ -338,6 +338,11 @@ SelectSet::post_select(RouterThread *thread, bool acquire)
     (void) acquire;
 #endif
 
+    // Time has passed while we blocked; make recent() read the clock again.
+#if TIMESTAMP_RECENT_CACHE
+    TimestampRecent::invalidate();
+#endif
+
     if (_wake_pipe_pending) {
 	_wake_pipe_pending = false;
 	char crap[64];
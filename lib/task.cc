@@ -25,6 +25,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/standard/threadsched.hh>
 CLICK_DECLS
 
 /** @file task.hh
@@ -286,6 +287,10 @@ Task::initialize(Element *owner, bool schedule)
 #if HAVE_STRIDE_SCHED
     set_tickets(DEFAULT_TICKETS);
 #endif
+#if HAVE_MULTITHREAD
+    if (!_stealable && router->thread_sched())
+        _stealable = router->thread_sched()->initial_task_stealable(owner);
+#endif
 
     _status.home_thread_id = _thread->thread_id();
     _status.is_scheduled = schedule;
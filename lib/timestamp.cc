@@ -24,6 +24,10 @@
 # include <unistd.h>
 # include <sys/ioctl.h>
 #endif
+#if TIMESTAMP_TSC
+# include <click/atomic.hh>
+# include <cpuid.h>
+#endif
 CLICK_DECLS
 
 /** @file timestamp.hh
@@ -146,6 +150,140 @@ Timestamp::warp_jump_steady(const Timestamp &expiry)
 }
 #endif
 
+#if TIMESTAMP_TSC
+volatile uint32_t TimestampTSC::seq;
+bool TimestampTSC::active;
+uint64_t TimestampTSC::base_cycles;
+Timestamp TimestampTSC::base_steady;
+Timestamp TimestampTSC::offset;
+uint64_t TimestampTSC::mult;
+uint64_t TimestampTSC::next_resync;
+uint64_t TimestampTSC::cal_cycles;
+Timestamp TimestampTSC::cal_steady;
+double TimestampTSC::hz;
+Timestamp TimestampTSC::drift;
+uint32_t TimestampTSC::nresyncs;
+volatile uint32_t TimestampTSC::resync_lock;
+
+void
+TimestampTSC::set(uint64_t cycles, const Timestamp &steady,
+                  const Timestamp &off, double ns_per_cycle)
+{
+    seq = seq + 1;
+    click_compiler_fence();
+    base_cycles = cycles;
+    base_steady = steady;
+    offset = off;
+    mult = (uint64_t) (ns_per_cycle * 4294967296.0);
+    click_compiler_fence();
+    seq = seq + 1;
+}
+
+// Reads the timestamp counter and the system clocks, retrying to keep the
+// reads close together.  Returns the counter value.
+static uint64_t
+tsc_sample(Timestamp &steady, Timestamp &system)
+{
+    uint64_t best = ~(uint64_t) 0, cycles = 0;
+    for (int i = 0; i < 5; ++i) {
+        struct timespec ts, tr;
+        uint64_t c0 = click_get_cycles();
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        clock_gettime(CLOCK_REALTIME, &tr);
+        uint64_t c1 = click_get_cycles();
+        if (c1 - c0 < best) {
+            best = c1 - c0;
+            cycles = c0 + best / 2;
+            steady = Timestamp(ts);
+            system = Timestamp(tr);
+        }
+    }
+    return cycles;
+}
+
+bool
+Timestamp::tsc_supported()
+{
+    unsigned eax, ebx, ecx, edx;
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)
+        && (edx & (1U << 8));
+}
+
+bool
+Timestamp::tsc_start()
+{
+    if (TimestampTSC::active)
+        return true;
+    if (!tsc_supported())
+        return false;
+
+    // Calibrate for 10 milliseconds; resynchronization refines the frequency
+    // over longer periods.
+    Timestamp s0, r0, s1, r1;
+    uint64_t c0 = tsc_sample(s0, r0), c1;
+    do {
+        c1 = tsc_sample(s1, r1);
+    } while (s1 - s0 < Timestamp::make_msec(10));
+
+    TimestampTSC::cal_cycles = c0;
+    TimestampTSC::cal_steady = s0;
+    TimestampTSC::hz = (c1 - c0) / (s1 - s0).doubleval();
+    TimestampTSC::drift = Timestamp();
+    TimestampTSC::nresyncs = 0;
+    TimestampTSC::set(c1, s1, r1 - s1, 1e9 / TimestampTSC::hz);
+    TimestampTSC::next_resync = c1 + (uint64_t) TimestampTSC::hz;
+    click_compiler_fence();
+    TimestampTSC::active = true;
+    return true;
+}
+
+void
+Timestamp::tsc_stop()
+{
+    TimestampTSC::active = false;
+}
+
+void
+Timestamp::tsc_resync()
+{
+    if (!TimestampTSC::active
+        || atomic_uint32_t::compare_swap(TimestampTSC::resync_lock, 0, 1) != 0)
+        return;
+
+    Timestamp s, r;
+    uint64_t c = tsc_sample(s, r);
+    Timestamp predicted = TimestampTSC::steady_at(c);
+    TimestampTSC::drift = predicted - s;
+    TimestampTSC::hz = (c - TimestampTSC::cal_cycles)
+        / (s - TimestampTSC::cal_steady).doubleval();
+
+    // Run slightly slow or fast so as to meet the system clock at the next
+    // resynchronization, a second from now.  Steady time must not go
+    // backwards, so only step forward, when the counter clock is far behind.
+    // When it is far ahead, run at most half speed until the system clock
+    // catches up.
+    double ns_per_cycle = 1e9 / TimestampTSC::hz;
+    double d = TimestampTSC::drift.doubleval();
+    if (d <= -0.0005)
+        TimestampTSC::set(c, s, r - s, ns_per_cycle);
+    else
+        TimestampTSC::set(c, predicted, r - s, ns_per_cycle * (1 - (d < 0.5 ? d : 0.5)));
+    TimestampTSC::next_resync = c + (uint64_t) TimestampTSC::hz;
+    ++TimestampTSC::nresyncs;
+
+    click_compiler_fence();
+    TimestampTSC::resync_lock = 0;
+}
+#endif
+
+#if TIMESTAMP_RECENT_CACHE
+# if HAVE_MULTITHREAD
+__thread Timestamp *TimestampRecent::cache;
+# else
+Timestamp *TimestampRecent::cache;
+# endif
+#endif
+
 #if !CLICK_LINUXMODULE && !CLICK_BSDMODULE && !CLICK_MINIOS
 /** @brief Set this timestamp to a timeval obtained by calling ioctl.
     @param fd file descriptor
@@ -4,6 +4,28 @@
  * decided I wanted to use an existing template heap class, and
  * it seemed like as good a time as any to exercise my rusty
  * STL skills.
+ *
+ * Usage: nsclick-test [-n NODES] [-t SECONDS] [-l USEC] [-j THREADS]
+ *                     [-h ELEMENT.HANDLER]... [-q] ROUTERFILE
+ *
+ * Runs NODES copies of ROUTERFILE (default 3) for SECONDS simulated
+ * seconds (default 10). The nodes form a ring: eth1 of each node shares a
+ * link with eth0 of the next, and packets take USEC microseconds
+ * (default 100) to cross a link. Each router sees its node number as
+ * $NODE and the number of nodes as $NNODES. Prints every packet sent and
+ * received, unless -q, then the value of each handler on every node.
+ *
+ * By default, one event loop runs every node, as a serial simulator
+ * would. With -j, THREADS worker threads run the nodes in parallel,
+ * conservatively: no packet can arrive sooner than one link latency after
+ * it is sent, so every node can run up to the earliest pending event plus
+ * that latency without hearing from the others. Workers run nodes up to
+ * that horizon, leaving the packets they send in the receivers' inboxes;
+ * at a barrier, each node moves its inbox into its event queue, and the
+ * next window begins. Each node's events are ordered by time, then by the
+ * node that caused them, then by that node's own count, and each node has
+ * its own random number generator, so the output is the same for any
+ * number of threads, and the same as the serial run's.
  */
 
 #include <stdlib.h>
@@ -12,7 +34,11 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <algorithm>
 #include <map>
+#include <string>
 #include <vector>
 #include <stdarg.h>
 #include "CUT_BinHeap.h"
@@ -27,9 +53,6 @@ public:
   Simulator();
   virtual ~Simulator();
 
-  int nextevent();
-  struct timeval gettime() { return cursimtime_; };
-
   class SimTime : public timeval {
   public:
     SimTime() {tv_sec = 0, tv_usec = 0;};
@@ -49,7 +72,7 @@ public:
     }
     bool operator>(const struct timeval& tv) const {
       return ((tv_sec > tv.tv_sec) ||
-	      ((tv_usec == tv.tv_usec) && (tv_usec > tv.tv_usec)));
+	      ((tv_sec == tv.tv_sec) && (tv_usec > tv.tv_usec)));
     }
     SimTime operator+(SimTime rhs) const {
       SimTime result;
@@ -59,6 +82,31 @@ public:
     }
   };
 
+  // Events are ordered by time, then by the node they happen on, then by
+  // the node that caused them and that node's count of events caused.
+  // This order is total, so simultaneous events always run in the same
+  // order however the simulation is divided among threads.
+  class EventKey {
+  public:
+    EventKey() : node(0), src(0), seq(0) {};
+    EventKey(SimTime t,int n,int s,unsigned q) : when(t), node(n), src(s), seq(q) {};
+
+    bool operator<=(const EventKey& k) const {
+      if (!(when == k.when))
+	return when < k.when;
+      if (node != k.node)
+	return node < k.node;
+      if (src != k.src)
+	return src < k.src;
+      return seq <= k.seq;
+    }
+
+    SimTime when;
+    int node;
+    int src;
+    unsigned seq;
+  };
+
   // Base class for all simulator events
   class SimEvent {
   public:
@@ -67,9 +115,7 @@ public:
     virtual int go(SimTime* when) = 0;
   };
 protected:
-  SimTime cursimtime_;
-  typedef CUT_BinHeap< SimTime,SimEvent*,less_equal<SimTime> > SimBinHeap;
-  SimBinHeap eventheap_;
+  typedef CUT_BinHeap< EventKey,SimEvent*,less_equal<EventKey> > SimBinHeap;
 };
 
 Simulator::Simulator() {
@@ -78,26 +124,45 @@ Simulator::Simulator() {
 Simulator::~Simulator() {
 }
 
-int
-Simulator::nextevent() {
-  SimBinHeap::Pix pix = eventheap_.find_top();
-  SimTime etime = eventheap_.key(pix);
-  SimEvent* event = eventheap_.data(pix);
-  cursimtime_ = etime;
-  event->go(&etime);
-  eventheap_.deq();
-  delete event;
-  return eventheap_.size();
-}
-
 Simulator::SimEvent::~SimEvent() {}
 
+// A barrier for a fixed number of threads.
+class SimBarrier {
+public:
+  SimBarrier(int n) : n_(n), waiting_(0), generation_(0) {
+    pthread_mutex_init(&lock_,0);
+    pthread_cond_init(&cond_,0);
+  }
+  ~SimBarrier() {
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&lock_);
+  }
+  void wait() {
+    pthread_mutex_lock(&lock_);
+    unsigned gen = generation_;
+    if (++waiting_ == n_) {
+      waiting_ = 0;
+      generation_++;
+      pthread_cond_broadcast(&cond_);
+    } else
+      while (gen == generation_)
+	pthread_cond_wait(&cond_,&lock_);
+    pthread_mutex_unlock(&lock_);
+  }
+private:
+  int n_;
+  int waiting_;
+  unsigned generation_;
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_;
+};
+
 class TestClickSimulator : public Simulator {
 public:
   TestClickSimulator();
   virtual ~TestClickSimulator();
 
-  int add_node(char* clickfile);
+  int add_node(const char* clickfile);
   void handle_packet_from_click(simclick_node_t *node,int ifid,int ptype,
 				const unsigned char* data,int len);
   void handle_schedule_from_click(simclick_node_t *node,const struct timeval* when);
@@ -105,6 +170,18 @@ public:
   void add_lan_entry(int nodenum,int ifid,int lanid);
   simclick_node_t *get_node(int nodenum);
 
+  void set_latency(SimTime latency) { latency_ = latency; };
+  void set_trace(bool trace) { trace_ = trace; };
+  int run(SimTime endtime,int nthreads);
+  void print_trace();
+  void print_handler(const char* hname);
+  void kill_nodes();
+
+  uint32_t random(simclick_node_t *node);
+  int node_id(simclick_node_t *node);
+  int get_defines(simclick_node_t *node,char* buf,size_t* size);
+  void trace(simclick_node_t *node,const char* fmt,...);
+
   class PacketEvent : public Simulator::SimEvent {
   public:
     PacketEvent();
@@ -139,34 +216,112 @@ protected:
       }
   };
 
+    struct traceline {
+	SimTime when;
+	int node;
+	string text;
+	bool operator<(const traceline& rhs) const {
+	    return when < rhs.when || (when == rhs.when && node < rhs.node);
+	}
+    };
+
+    struct inboxentry {
+	EventKey key;
+	SimEvent *event;
+    };
+
+    // Everything the simulator knows about one node. A node is only
+    // touched by the thread running it, except for its inbox, which other
+    // nodes' threads fill under inbox_lock.
     struct clicknode : public simclick_node_t {
 	TestClickSimulator *sim;
+	int id;
+	uint32_t rng;
+	unsigned seq;
+	int next_pkt_id;
+	SimBinHeap events;
+	pthread_mutex_t inbox_lock;
+	vector<inboxentry> inbox;
+	vector<traceline> trace;
     };
+
+    void schedule(clicknode *node,const EventKey& key,SimEvent *event);
+    void run_event(SimBinHeap& heap);
+    bool next_window();
+    void run_worker(bool coordinator);
+    static void *worker_thread(void *);
+
     vector<clicknode *> clickrouters_;
     map<netif,int> netiftolanid_;
     map< int,vector<netif> > lanidtonetif_;
+
+    SimTime latency_;
+    bool trace_;
+
+    // serial mode: one event queue for all nodes
+    SimBinHeap eventheap_;
+
+    // parallel mode: per-node event queues, run in windows
+    bool parallel_;
+    SimTime endtime_;
+    SimTime window_end_;
+    bool done_;
+    SimBarrier *barrier_;
+    volatile int next_node_;
+    volatile int next_inbox_;
+    unsigned long windows_;
 };
 
-TestClickSimulator::TestClickSimulator() {
+TestClickSimulator::TestClickSimulator()
+  : latency_(0,100), trace_(true), parallel_(false), done_(false),
+    barrier_(0), next_node_(0), next_inbox_(0), windows_(0) {
 }
 
 TestClickSimulator::~TestClickSimulator() {
 }
 
 int
-TestClickSimulator::add_node(char* clickfile) {
+TestClickSimulator::add_node(const char* clickfile) {
   int result = -1;
   clicknode *c = new clicknode;
   c->sim = this;
+  c->id = clickrouters_.size();
+  c->rng = 2463534242U + 0x9E3779B9U * c->id;
+  c->seq = 0;
+  c->next_pkt_id = 0;
+  pthread_mutex_init(&c->inbox_lock,0);
   timerclear(&c->curtime);
   if (simclick_click_create(c, clickfile) >= 0) {
       clickrouters_.push_back(c);
+      // Give every router a first chance to run, so it can schedule its
+      // timers.
+      handle_schedule_from_click(c,&c->curtime);
       result = clickrouters_.size();
   } else
       delete c;
   return result;
 }
 
+void
+TestClickSimulator::schedule(clicknode *node,const EventKey& key,
+			     SimEvent *event)
+{
+  if (!parallel_)
+    eventheap_.insert(key,event);
+  else if (key.src == node->id)
+    node->events.insert(key,event);
+  else {
+    // Another node's packet: it arrives no sooner than the end of the
+    // current window, so leave it for the barrier.
+    inboxentry e;
+    e.key = key;
+    e.event = event;
+    pthread_mutex_lock(&node->inbox_lock);
+    node->inbox.push_back(e);
+    pthread_mutex_unlock(&node->inbox_lock);
+  }
+}
+
 void
 TestClickSimulator::handle_packet_from_click(simclick_node_t *node,int ifid,
 					     int ptype,
@@ -174,26 +329,30 @@ TestClickSimulator::handle_packet_from_click(simclick_node_t *node,int ifid,
 {
   // Use the node-ifid combo to find the lanid, and then use the lanid
   // to get the list of node-ifid combos attached to it.
+  clicknode *from = (clicknode *) node;
   netif fromif(node,ifid);
+  map<netif,int>::iterator it = netiftolanid_.find(fromif);
+  if (it == netiftolanid_.end())
+    return;
 
-  int onlan = netiftolanid_[fromif];
+  const vector<netif>& lan = lanidtonetif_.find(it->second)->second;
   int i = 0;
-  int n = lanidtonetif_[onlan].size();
+  int n = lan.size();
+  SimTime newtime = SimTime(node->curtime) + latency_;
 
   for (i=0;i<n;i++) {
+    if (lan[i] == fromif)
+      continue;
     // Load up the simulator queue with packets to send
-    SimTime newtime = cursimtime_;
-    // Assume overhead of 0.1ms (pulled out of air)
-    newtime.tv_usec += 100;
+    clicknode *to = (clicknode *) lan[i].node;
     PacketEvent* pkt = new PacketEvent();
-    pkt->simnode_ = lanidtonetif_[onlan][i].node;
-    pkt->ifid_ = lanidtonetif_[onlan][i].ifid;
+    pkt->simnode_ = to;
+    pkt->ifid_ = lan[i].ifid;
     pkt->data_ = new unsigned char[len];
     pkt->len_ = len;
     pkt->ptype_ = ptype;
     memcpy(pkt->data_,data,len);
-    eventheap_.insert(newtime,pkt);
-    fprintf(stderr,"Added send packet event: clickinst: %d ifid: %d time: %d %d\n",(int)(pkt->simnode_),pkt->ifid_,(int)newtime.tv_sec,(int)newtime.tv_usec);
+    schedule(to,EventKey(newtime,to->id,from->id,from->seq++),pkt);
   }
 }
 
@@ -201,10 +360,13 @@ void
 TestClickSimulator::handle_schedule_from_click(simclick_node_t *node,
 					       const struct timeval* when) {
   // Stuff a click trigger event into the simulator queue
+  clicknode *c = (clicknode *) node;
   ScheduledEvent* sevent = new ScheduledEvent;
   SimTime newtime(*when);
+  if (newtime < node->curtime)
+    newtime = node->curtime;
   sevent->simnode_ = node;
-  eventheap_.insert(newtime,sevent);
+  schedule(c,EventKey(newtime,c->id,c->id,c->seq++),sevent);
 }
 
 simclick_node_t *
@@ -224,15 +386,228 @@ TestClickSimulator::add_lan_entry(simclick_node_t *node,int ifid,int lanid) {
   lanidtonetif_[lanid].push_back(newif);
 }
 
+uint32_t
+TestClickSimulator::random(simclick_node_t *node) {
+  // xorshift32, one generator per node
+  clicknode *c = (clicknode *) node;
+  uint32_t x = c->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return c->rng = x;
+}
+
+int
+TestClickSimulator::node_id(simclick_node_t *node) {
+  return ((clicknode *) node)->id;
+}
+
+int
+TestClickSimulator::get_defines(simclick_node_t *node,char* buf,size_t* size) {
+  // NUL-separated name, value pairs
+  char defines[64];
+  int len = sprintf(defines,"NODE%c%d%cNNODES%c%d",0,node_id(node),0,0,
+		    (int) clickrouters_.size()) + 1;
+  if (*size < (size_t) len) {
+    *size = len;
+    return -1;
+  }
+  memcpy(buf,defines,len);
+  *size = len;
+  return 0;
+}
+
+void
+TestClickSimulator::trace(simclick_node_t *node,const char* fmt,...) {
+  if (!trace_)
+    return;
+  clicknode *c = (clicknode *) node;
+  char buf[256];
+  va_list val;
+  va_start(val,fmt);
+  vsnprintf(buf,sizeof(buf),fmt,val);
+  va_end(val);
+  traceline t;
+  t.when = node->curtime;
+  t.node = c->id;
+  t.text = buf;
+  c->trace.push_back(t);
+}
+
+void
+TestClickSimulator::run_event(SimBinHeap& heap) {
+  SimBinHeap::Pix pix = heap.find_top();
+  SimTime etime = heap.key(pix).when;
+  SimEvent* event = heap.data(pix);
+  heap.deq();
+  event->go(&etime);
+  delete event;
+}
+
+// Chooses the next window, or returns false if the simulation is over.
+// Runs between barriers, with every inbox empty.
+bool
+TestClickSimulator::next_window() {
+  bool any = false;
+  SimTime start;
+  for (size_t i = 0; i < clickrouters_.size(); i++) {
+    SimBinHeap& heap = clickrouters_[i]->events;
+    if (heap.size()) {
+      const SimTime& t = heap.key(heap.find_top()).when;
+      if (!any || t < start)
+	start = t, any = true;
+    }
+  }
+  if (!any || !(start < endtime_))
+    return false;
+  window_end_ = start + latency_;
+  if (endtime_ < window_end_)
+    window_end_ = endtime_;
+  windows_++;
+  return true;
+}
+
+void
+TestClickSimulator::run_worker(bool coordinator) {
+  int n = clickrouters_.size();
+  int i;
+  while (1) {
+    // The coordinator picks the next window while the others wait.
+    if (coordinator) {
+      done_ = !next_window();
+      next_node_ = next_inbox_ = 0;
+    }
+    barrier_->wait();
+    if (done_)
+      break;
+
+    // Run every node to the end of the window.
+    while ((i = __sync_fetch_and_add(&next_node_,1)) < n) {
+      clicknode *c = clickrouters_[i];
+      while (c->events.size()
+	     && c->events.key(c->events.find_top()).when < window_end_)
+	run_event(c->events);
+    }
+    barrier_->wait();
+
+    // Deliver the window's packets.
+    while ((i = __sync_fetch_and_add(&next_inbox_,1)) < n) {
+      clicknode *c = clickrouters_[i];
+      for (size_t j = 0; j < c->inbox.size(); j++)
+	c->events.insert(c->inbox[j].key,c->inbox[j].event);
+      c->inbox.clear();
+    }
+    barrier_->wait();
+  }
+}
+
+void *
+TestClickSimulator::worker_thread(void *arg) {
+  ((TestClickSimulator *) arg)->run_worker(false);
+  return 0;
+}
+
+int
+TestClickSimulator::run(SimTime endtime,int nthreads) {
+  endtime_ = endtime;
+  if (nthreads <= 0) {
+    while (eventheap_.size()
+	   && eventheap_.key(eventheap_.find_top()).when < endtime)
+      run_event(eventheap_);
+    return 0;
+  }
+
+  if (!simclick_click_command(0,SIMCLICK_SUPPORTS,SIMCLICK_CONCURRENT)
+      || !simclick_click_command(0,SIMCLICK_CONCURRENT)) {
+    fprintf(stderr,"Click was built without multithreading; -j not supported\n");
+    return -1;
+  }
+
+  // Move the initial events into the nodes' own queues.
+  parallel_ = true;
+  while (eventheap_.size()) {
+    SimBinHeap::Pix pix = eventheap_.find_top();
+    EventKey key = eventheap_.key(pix);
+    clickrouters_[key.node]->events.insert(key,eventheap_.data(pix));
+    eventheap_.deq();
+  }
+
+  barrier_ = new SimBarrier(nthreads);
+  vector<pthread_t> threads(nthreads - 1);
+  for (int i = 0; i < nthreads - 1; i++)
+    pthread_create(&threads[i],0,worker_thread,this);
+  run_worker(true);
+  for (int i = 0; i < nthreads - 1; i++)
+    pthread_join(threads[i],0);
+  delete barrier_;
+  barrier_ = 0;
+  fprintf(stderr,"%lu windows\n",windows_);
+  return 0;
+}
+
+void
+TestClickSimulator::print_trace() {
+  vector<traceline> all;
+  for (size_t i = 0; i < clickrouters_.size(); i++)
+    all.insert(all.end(),clickrouters_[i]->trace.begin(),
+	       clickrouters_[i]->trace.end());
+  // Stable, so each node's simultaneous lines stay in the order it made them
+  stable_sort(all.begin(),all.end());
+  for (size_t i = 0; i < all.size(); i++)
+    printf("%ld.%06ld node %d %s\n",(long) all[i].when.tv_sec,
+	   (long) all[i].when.tv_usec,all[i].node,all[i].text.c_str());
+}
+
+void
+TestClickSimulator::print_handler(const char* hname) {
+  string element(hname),handler;
+  size_t dot = element.rfind('.');
+  if (dot != string::npos) {
+    handler = element.substr(dot + 1);
+    element = element.substr(0,dot);
+  }
+  for (size_t i = 0; i < clickrouters_.size(); i++) {
+    clicknode *c = clickrouters_[i];
+    c->curtime = endtime_;
+    char *result = simclick_click_read_handler(c,element.c_str(),
+					       handler.c_str(),0,0);
+    printf("node %d %s: %s",c->id,hname,result ? result : "(error)\n");
+    if (result && (!*result || result[strlen(result) - 1] != '\n'))
+      printf("\n");
+    free(result);
+  }
+}
+
+void
+TestClickSimulator::kill_nodes() {
+  for (size_t i = 0; i < clickrouters_.size(); i++) {
+    clicknode *c = clickrouters_[i];
+    simclick_click_kill(c);
+    while (c->events.size()) {
+      delete c->events.data(c->events.find_top());
+      c->events.deq();
+    }
+    pthread_mutex_destroy(&c->inbox_lock);
+    delete c;
+  }
+  clickrouters_.clear();
+  while (eventheap_.size()) {
+    delete eventheap_.data(eventheap_.find_top());
+    eventheap_.deq();
+  }
+}
+
 int
 TestClickSimulator::PacketEvent::go(SimTime* when) {
   int result = 0;
   simclick_simpacketinfo pinfo;
+  clicknode *c = (clicknode *) simnode_;
 
   simnode_->curtime = *when;
-  pinfo.id = 2;
-  pinfo.fid =2;
-  fprintf(stderr,"Dispatching send packet event: clickinst: %d ifid: %d time: %d %d pid %d fid %d\n",(int)simnode_,ifid_,(int)when->tv_sec,(int)when->tv_usec,pinfo.id,pinfo.fid);
+  pinfo.id = c->next_pkt_id++;
+  pinfo.fid = 0;
+  pinfo.simtype = 0;
+  c->sim->trace(simnode_,"recv eth%d len %d",ifid_ - TESTSIM_IFID_FIRSTIF,len_);
   simclick_click_send(simnode_,ifid_,ptype_,data_,len_,&pinfo);
 
   return result;
@@ -267,56 +642,52 @@ TestClickSimulator::ScheduledEvent::go(SimTime* when) {
 
 static TestClickSimulator thesim;
 
-int main(int,char**) {
-  int result = 0;
-  int i = 0;
-  const int numclicks = 3;
-
-  printf("Testing the simclick interface...\n");
+static void usage() {
+  fprintf(stderr,"Usage: nsclick-test [-n NODES] [-t SECONDS] [-l USEC] [-j THREADS]\n\
+                    [-h ELEMENT.HANDLER]... [-q] ROUTERFILE\n");
+  exit(1);
+}
 
-  char* scripts[numclicks] = {"../conf/test-simclick-udpgen.click", \
-				"../conf/test-simclick-device.click", \
-				"../conf/test-simclick-device.click"};
+int main(int argc,char** argv) {
+  int numclicks = 3;
+  int endtime = 10;
+  int latency = 100;
+  int nthreads = 0;
+  vector<const char *> handlers;
+  int opt;
+
+  while ((opt = getopt(argc,argv,"n:t:l:j:h:q")) != -1)
+    switch (opt) {
+    case 'n': numclicks = atoi(optarg); break;
+    case 't': endtime = atoi(optarg); break;
+    case 'l': latency = atoi(optarg); break;
+    case 'j': nthreads = atoi(optarg); break;
+    case 'h': handlers.push_back(optarg); break;
+    case 'q': thesim.set_trace(false); break;
+    default: usage();
+    }
+  if (optind != argc - 1 || numclicks < 1 || endtime < 0 || latency < 1)
+    usage();
 
-  for (i=0;i<numclicks;i++) {
-    printf("Creating a SimClick click instance with %s\n",scripts[i]);
-    thesim.add_node(scripts[i]);
-  }
+  for (int i = 0; i < numclicks; i++)
+    if (thesim.add_node(argv[optind]) < 0)
+      return 1;
 
-  // eth0 of the traffic source (node 0) goes on the same
-  // lan as eth0 of node 1
-  thesim.add_lan_entry(0,1,1);
-  thesim.add_lan_entry(1,1,1);
-
-  // Put eth1 of node 0 and eth0 of node 1 on the same lan
-  thesim.add_lan_entry(1,2,2);
-  thesim.add_lan_entry(2,1,2);
-
-  // Put eth1 of node1 and eth0 of node 1 on the same lan
-  //thesim.add_lan_entry(1,1,3);
-  //thesim.add_lan_entry(2,2,3);
-
-  // Send a packet out to eth0 of node 0.
-  //printf("About to send out test packet on node 0, eth0...\n");
-  //simclick_click_send(thesim.get_node(0),TESTSIM_IFID_FIRSTIF,
-  //		      SIMCLICK_PTYPE_ETHER,mypacket,sizeof(mypacket));
-
-  // Prime the simulator pump
-  Simulator::SimTime now;
-  int endtime = 60;
-  Simulator::SimTime tick(0,10000);
-
-  printf("About to start pumping the simulator...\n");
-  while (thesim.gettime().tv_sec < endtime) {
-    // Insert a clock tick, then run the simulator for a step.
-    thesim.handle_schedule_from_click(thesim.get_node(0),&now);
-    thesim.nextevent();
-    now = now + tick;
+  // eth1 of each node is on a lan with eth0 of the next
+  for (int i = 0; i < numclicks && numclicks > 1; i++) {
+    thesim.add_lan_entry(i,TESTSIM_IFID_FIRSTIF + 1,i);
+    thesim.add_lan_entry((i + 1) % numclicks,TESTSIM_IFID_FIRSTIF,i);
   }
 
-  printf("Done.\n");
+  thesim.set_latency(Simulator::SimTime(latency / 1000000,latency % 1000000));
+  if (thesim.run(Simulator::SimTime(endtime,0),nthreads) < 0)
+    return 1;
 
-  return result;
+  thesim.print_trace();
+  for (size_t i = 0; i < handlers.size(); i++)
+    thesim.print_handler(handlers[i]);
+  thesim.kill_nodes();
+  return 0;
 }
 
 extern "C" {
@@ -337,7 +708,13 @@ simclick_sim_command(simclick_node_t *simnode, int cmd, ...) {
 	  int othercmd = va_arg(val, int);
 	  r = (othercmd == SIMCLICK_VERSION || othercmd == SIMCLICK_SUPPORTS
 	       || othercmd == SIMCLICK_IFID_FROM_NAME
-	       || othercmd == SIMCLICK_SCHEDULE);
+	       || othercmd == SIMCLICK_SCHEDULE
+	       || othercmd == SIMCLICK_GET_NODE_NAME
+	       || othercmd == SIMCLICK_IF_READY
+	       || othercmd == SIMCLICK_TRACE
+	       || othercmd == SIMCLICK_GET_NODE_ID
+	       || othercmd == SIMCLICK_GET_RANDOM_INT
+	       || othercmd == SIMCLICK_GET_DEFINES);
 	  break;
       }
 
@@ -345,7 +722,6 @@ simclick_sim_command(simclick_node_t *simnode, int cmd, ...) {
 	  const char *ifname = va_arg(val, const char *);
 	  r = -1;
 
-	  fprintf(stderr,"Woo! Got a request for %s\n",ifname);
 	  /*
 	   * Provide a mapping between a textual interface name
 	   * and the id numbers used. This is so that click scripts
@@ -368,7 +744,6 @@ simclick_sim_command(simclick_node_t *simnode, int cmd, ...) {
 	      if (*devname)
 		  r = atoi(devname) + TESTSIM_IFID_FIRSTIF;
 	  }
-	  fprintf(stderr,"Corresponds to simdev number %d\n", r);
 	  break;
       }
 
@@ -379,6 +754,45 @@ simclick_sim_command(simclick_node_t *simnode, int cmd, ...) {
 	  break;
       }
 
+      case SIMCLICK_GET_NODE_NAME: {
+	  char *buf = va_arg(val, char *);
+	  int len = va_arg(val, int);
+	  snprintf(buf, len, "node%d", thesim.node_id(simnode));
+	  r = 0;
+	  break;
+      }
+
+      case SIMCLICK_IF_READY:
+	r = 1;
+	break;
+
+      case SIMCLICK_TRACE: {
+	  const char *event = va_arg(val, const char *);
+	  thesim.trace(simnode, "trace %s", event);
+	  r = 0;
+	  break;
+      }
+
+      case SIMCLICK_GET_NODE_ID:
+	r = thesim.node_id(simnode);
+	break;
+
+      case SIMCLICK_GET_RANDOM_INT: {
+	  uint32_t *result = va_arg(val, uint32_t *);
+	  uint32_t max = va_arg(val, uint32_t);
+	  uint32_t x = thesim.random(simnode);
+	  *result = (max == 0xFFFFFFFFU ? x : x % (max + 1));
+	  r = 0;
+	  break;
+      }
+
+      case SIMCLICK_GET_DEFINES: {
+	  char *buf = va_arg(val, char *);
+	  size_t *size = va_arg(val, size_t *);
+	  r = thesim.get_defines(simnode, buf, size);
+	  break;
+      }
+
       default:
 	r = -1;
 	break;
@@ -395,10 +809,13 @@ simclick_sim_send(simclick_node_t *simnode,
 		  int ifid,int type,const unsigned char* data,int len,
 		  simclick_simpacketinfo*) {
   int result = 0;
-  // XXX print pinfo data
-  fprintf(stderr,"Packet incoming on clickinst %d ifid %d\n",(int)simnode,ifid);
+  // Checksum the data, so traces show any difference in contents
+  uint32_t h = 2166136261U;
+  for (int i = 0; i < len; i++)
+    h = (h ^ data[i]) * 16777619U;
+  thesim.trace(simnode,"send eth%d len %d hash %08x",
+	       ifid - TESTSIM_IFID_FIRSTIF,len,h);
   thesim.handle_packet_from_click(simnode,ifid,type,data,len);
-  fprintf(stderr,"Exiting simclick_send_to_if...\n");
   return result;
 }
 
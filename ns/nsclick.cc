@@ -67,16 +67,17 @@ CLICK_USING_DECLS
 #define EXPRESSION_OPT		313
 
 
+// The node whose router is running.  A parallel simulator may run
+// different nodes on different threads at once (see SIMCLICK_CONCURRENT in
+// simclick.h), so with multithreading, each thread has its own.
+#if HAVE_MULTITHREAD
+static __thread simclick_node_t *cursimnode = NULL;
+#else
 static simclick_node_t *cursimnode = NULL;
+#endif
 int click_nthreads = 1;
 
 
-//
-// XXX
-// OK, this bit of code here should work fine as long as your simulator
-// isn't multithreaded. If it is, there could be multiple threads stomping
-// on each other and potentially causing subtle or unsubtle problems.
-//
 static void setsimstate(simclick_node_t *newstate) {
     cursimnode = newstate;
 }
@@ -269,7 +270,14 @@ int simclick_click_command(simclick_node_t *, int cmd, ...)
 	r = 0;
     else if (cmd == SIMCLICK_SUPPORTS) {
 	int othercmd = va_arg(val, int);
-	r = othercmd >= SIMCLICK_VERSION && othercmd <= SIMCLICK_SUPPORTS;
+	r = (othercmd >= SIMCLICK_VERSION && othercmd <= SIMCLICK_SUPPORTS)
+	    || othercmd == SIMCLICK_CONCURRENT;
+    } else if (cmd == SIMCLICK_CONCURRENT) {
+#if HAVE_MULTITHREAD
+	r = 1;
+#else
+	r = 0;
+#endif
     } else
 	r = 1;
 
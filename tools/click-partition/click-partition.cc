@@ -0,0 +1,728 @@
+/*
+ * click-partition.cc -- split a Click configuration into pipeline stages
+ * running on separate threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/pathvars.h>
+
+#include "routert.hh"
+#include "lexert.hh"
+#include "processingt.hh"
+#include "elementmap.hh"
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/driver.hh>
+#include <click/clp.h>
+#include "toolutils.hh"
+#include <click/bitvector.hh>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define HELP_OPT		300
+#define VERSION_OPT		301
+#define CLICKPATH_OPT		302
+#define ROUTER_OPT		303
+#define EXPRESSION_OPT		304
+#define OUTPUT_OPT		305
+#define THREADS_OPT		306
+#define PROFILE_OPT		307
+#define CUT_COST_OPT		308
+#define CAPACITY_OPT		309
+#define BURST_OPT		310
+#define QUIET_OPT		311
+
+static const Clp_Option options[] = {
+    { "burst", 0, BURST_OPT, Clp_ValUnsigned, 0 },
+    { "capacity", 0, CAPACITY_OPT, Clp_ValUnsigned, 0 },
+    { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
+    { "cut-cost", 0, CUT_COST_OPT, Clp_ValDouble, 0 },
+    { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
+    { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
+    { "help", 0, HELP_OPT, 0, 0 },
+    { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
+    { "profile", 'p', PROFILE_OPT, Clp_ValString, 0 },
+    { "quiet", 'q', QUIET_OPT, 0, Clp_Negate },
+    { "threads", 'j', THREADS_OPT, Clp_ValInt, 0 },
+    { "version", 'v', VERSION_OPT, 0, 0 },
+};
+
+static const char *program_name;
+
+void
+short_usage()
+{
+    fprintf(stderr, "Usage: %s [OPTION]... [ROUTERFILE]\n\
+Try '%s --help' for more information.\n",
+	    program_name, program_name);
+}
+
+void
+usage()
+{
+    printf("\
+'Click-partition' transforms a router configuration so it runs as a pipeline\n\
+on several threads. It cuts long push and pull paths into stages, joined by\n\
+ThreadSafeQueue and Unqueue elements, and pins each stage's task to a thread\n\
+with StaticThreadSched. It reports the chosen partition on standard error.\n\
+\n\
+Usage: %s [OPTION]... [ROUTERFILE]\n\
+\n\
+Options:\n\
+  -f, --file FILE               Read router configuration from FILE.\n\
+  -e, --expression EXPR         Use EXPR as router configuration.\n\
+  -o, --output FILE             Write output to FILE.\n\
+  -j, --threads N               Partition for N threads (default 2).\n\
+  -p, --profile FILE            Read element costs from FILE, as written by\n\
+                                the element_cycles.csv or class_cycles.csv\n\
+                                handlers.\n\
+      --cut-cost COST           Cost of one cut (default: 2 average elements).\n\
+      --capacity N              Capacity of inserted queues (default 1024).\n\
+      --burst N                 Burst of inserted Unqueues (default 32).\n\
+  -q, --quiet                   Do not report the partition.\n\
+  -C, --clickpath PATH          Use PATH for CLICKPATH.\n\
+      --help                    Print this message and exit.\n\
+  -v, --version                 Print version number and exit.\n\
+\n\
+Report bugs to <click@librelist.com>.\n", program_name);
+}
+
+
+// costs
+
+static HashTable<String, double> element_costs;
+static HashTable<String, double> class_costs;
+static bool have_profile;
+
+static int
+read_profile(const char *filename, ErrorHandler *errh)
+{
+    int before = errh->nerrors();
+    String text = file_string(filename, errh);
+    if (errh->nerrors() != before)
+	return -1;
+
+    int key_type = -1, cost_column = -1, lineno = 0;
+    const char *s = text.begin(), *end = text.end();
+    while (s != end) {
+	const char *eol = (const char *) memchr(s, '\n', end - s);
+	if (!eol)
+	    eol = end;
+	String line = text.substring(s, eol);
+	s = (eol == end ? eol : eol + 1);
+	++lineno;
+	if (!line || line[0] == '#')
+	    continue;
+
+	Vector<String> fields;
+	const char *f = line.begin();
+	while (1) {
+	    const char *comma = (const char *) memchr(f, ',', line.end() - f);
+	    fields.push_back(cp_uncomment(line.substring(f, comma ? comma : line.end())));
+	    if (!comma)
+		break;
+	    f = comma + 1;
+	}
+
+	if (key_type < 0) {
+	    if (fields[0] == "name")
+		key_type = 0;
+	    else if (fields[0] == "class")
+		key_type = 1;
+	    else
+		return errh->error("%s:%d: expected %<name%> or %<class%> header", filename, lineno);
+	    cost_column = fields.size() - 1;
+	    for (int i = 1; i < fields.size(); ++i)
+		if (fields[i] == "cycles_per_any")
+		    cost_column = i;
+	    continue;
+	}
+
+	double cost;
+	if (fields.size() <= cost_column
+	    || !DoubleArg().parse(fields[cost_column], cost) || cost < 0) {
+	    errh->warning("%s:%d: bad cost, ignoring line", filename, lineno);
+	    continue;
+	}
+	if (key_type == 0)
+	    element_costs[fields[0]] = cost;
+	else
+	    class_costs[fields[0]] = cost;
+    }
+    have_profile = true;
+    return 0;
+}
+
+static double
+element_cost(const ElementT *e)
+{
+    if (const double *c = element_costs.get_pointer(e->name()))
+	return *c;
+    if (const double *c = class_costs.get_pointer(e->type_name()))
+	return *c;
+    // profiles omit elements that used no cycles
+    return have_profile ? 0 : 1;
+}
+
+
+// partitioning
+
+namespace {
+
+struct Stage {
+    int root;
+    Bitvector elements;
+    double cost;
+    int thread;
+};
+
+struct Cut {
+    int conn;
+    bool push;
+    double near_cost;
+    double far_cost;
+};
+
+class Partitioner { public:
+
+    Partitioner(RouterT *router, ProcessingT *processing);
+
+    void find_stages(Vector<Stage> &stages);
+    bool best_cut(const Vector<Stage> &stages, int si, double cut_cost,
+		  Cut &cut);
+    const ConnectionT &conn(int ci) const {
+	return _conn[ci];
+    }
+
+  private:
+
+    RouterT *_router;
+    ProcessingT *_processing;
+    Vector<ConnectionT> _conn;
+    Vector<Vector<int> > _from;	// connections by output pidx
+    Vector<Vector<int> > _to;	// connections by input pidx
+
+    bool is_root(const ElementT *e) const;
+    void reach(const PortT &port, bool isoutput, int skip, Bitvector &elements) const;
+    void stage_elements(int root, int skip, Bitvector &elements) const;
+    void far_elements(int ci, Bitvector &elements) const;
+    double cost(const Bitvector &elements) const;
+
+};
+
+Partitioner::Partitioner(RouterT *router, ProcessingT *processing)
+    : _router(router), _processing(processing),
+      _from(processing->noutput_pidx(), Vector<int>()),
+      _to(processing->ninput_pidx(), Vector<int>())
+{
+    for (RouterT::conn_iterator it = router->begin_connections();
+	 it != router->end_connections(); ++it) {
+	_from[_processing->output_pidx(it->from())].push_back(_conn.size());
+	_to[_processing->input_pidx(it->to())].push_back(_conn.size());
+	_conn.push_back(*it);
+    }
+}
+
+// A root is an element whose task drives packets: it has pull inputs or
+// push outputs, but nobody pushes to it or pulls from it.
+bool
+Partitioner::is_root(const ElementT *e) const
+{
+    bool active = false;
+    for (int p = 0; p < e->ninputs(); ++p)
+	if (_processing->input_is_pull(e->eindex(), p))
+	    active = active || _to[_processing->input_pidx(PortT(const_cast<ElementT *>(e), p))].size();
+	else if (_to[_processing->input_pidx(PortT(const_cast<ElementT *>(e), p))].size())
+	    return false;
+    for (int p = 0; p < e->noutputs(); ++p)
+	if (_processing->output_is_push(e->eindex(), p))
+	    active = active || _from[_processing->output_pidx(PortT(const_cast<ElementT *>(e), p))].size();
+	else if (_from[_processing->output_pidx(PortT(const_cast<ElementT *>(e), p))].size())
+	    return false;
+    return active && e->type_name() != "Idle";
+}
+
+// Mark the elements that a packet path starting at @a port can reach:
+// downstream through push connections if @a isoutput, upstream through pull
+// connections otherwise.  Connection @a skip is not followed.
+void
+Partitioner::reach(const PortT &port, bool isoutput, int skip,
+		   Bitvector &elements) const
+{
+    Vector<PortT> work;
+    Bitvector seen(isoutput ? _processing->noutput_pidx() : _processing->ninput_pidx());
+    work.push_back(port);
+    while (work.size()) {
+	PortT p = work.back();
+	work.pop_back();
+	int pidx = (isoutput ? _processing->output_pidx(p) : _processing->input_pidx(p));
+	if (seen[pidx])
+	    continue;
+	seen[pidx] = true;
+	const Vector<int> &cv = (isoutput ? _from[pidx] : _to[pidx]);
+	for (const int *cp = cv.begin(); cp != cv.end(); ++cp) {
+	    if (*cp == skip)
+		continue;
+	    const PortT &next = _conn[*cp].end(!isoutput);
+	    elements[next.eindex()] = true;
+	    Bitvector flow;
+	    _processing->port_flow(next, !isoutput, &flow);
+	    for (int q = 0; q < flow.size(); ++q)
+		if (flow[q]
+		    && (isoutput ? _processing->output_is_push(next.eindex(), q)
+			: _processing->input_is_pull(next.eindex(), q)))
+		    work.push_back(PortT(next.element, q));
+	}
+    }
+}
+
+void
+Partitioner::stage_elements(int root, int skip, Bitvector &elements) const
+{
+    ElementT *e = _router->element(root);
+    elements.assign(_router->nelements(), false);
+    elements[root] = true;
+    for (int p = 0; p < e->ninputs(); ++p)
+	if (_processing->input_is_pull(root, p))
+	    reach(PortT(e, p), false, skip, elements);
+    for (int p = 0; p < e->noutputs(); ++p)
+	if (_processing->output_is_push(root, p))
+	    reach(PortT(e, p), true, skip, elements);
+}
+
+// Mark the elements on the far side of connection @a ci from its stage's
+// root: downstream of a push connection, or upstream of a pull connection.
+void
+Partitioner::far_elements(int ci, Bitvector &elements) const
+{
+    const ConnectionT &c = _conn[ci];
+    bool push = _processing->output_is_push(c.from_eindex(), c.from_port());
+    const PortT &far = (push ? c.to() : c.from());
+    elements.assign(_router->nelements(), false);
+    elements[far.eindex()] = true;
+    Bitvector flow;
+    _processing->port_flow(far, !push, &flow);
+    for (int q = 0; q < flow.size(); ++q)
+	if (flow[q]
+	    && (push ? _processing->output_is_push(far.eindex(), q)
+		: _processing->input_is_pull(far.eindex(), q)))
+	    reach(PortT(far.element, q), push, -1, elements);
+}
+
+double
+Partitioner::cost(const Bitvector &elements) const
+{
+    double c = 0;
+    for (int i = 0; i < elements.size(); ++i)
+	if (elements[i])
+	    c += element_cost(_router->element(i));
+    return c;
+}
+
+void
+Partitioner::find_stages(Vector<Stage> &stages)
+{
+    stages.clear();
+    for (RouterT::iterator x = _router->begin_elements(); x; x++)
+	if (is_root(x.get())) {
+	    Stage s;
+	    s.root = x->eindex();
+	    stage_elements(s.root, -1, s.elements);
+	    s.cost = cost(s.elements);
+	    s.thread = -1;
+	    stages.push_back(s);
+	}
+}
+
+// Find the cut of stages[si] that minimizes the cost of its costlier half.
+// A cut must split the stage into disjoint parts.  Elements shared with
+// other stages, such as Queues, stay shared by the same number of tasks.
+bool
+Partitioner::best_cut(const Vector<Stage> &stages, int si, double cut_cost,
+		      Cut &cut)
+{
+    const Stage &s = stages[si];
+    bool found = false;
+    double best = s.cost;
+    for (int ci = 0; ci < _conn.size(); ++ci) {
+	const ConnectionT &c = _conn[ci];
+	if (!s.elements[c.from_eindex()] || !s.elements[c.to_eindex()])
+	    continue;
+	Bitvector far, near;
+	far_elements(ci, far);
+	if (far[s.root])
+	    continue;
+	stage_elements(s.root, ci, near);
+	if (near.nonzero_intersection(far))
+	    continue;
+	// the near side gets the queue; the far side gets the Unqueue, and
+	// shares the queue
+	double near_cost = cost(near) + cut_cost / 2;
+	double far_cost = cost(far) + cut_cost;
+	double worst = (near_cost > far_cost ? near_cost : far_cost);
+	if (worst < best) {
+	    best = worst;
+	    cut.conn = ci;
+	    cut.push = _processing->output_is_push(c.from_eindex(), c.from_port());
+	    cut.near_cost = near_cost;
+	    cut.far_cost = far_cost;
+	    found = true;
+	}
+    }
+    return found;
+}
+
+}
+
+// Assign costs to threads, longest first, each to the least loaded thread.
+// Returns the largest thread load.
+static double
+assign_threads(const Vector<double> &costs, int nthreads, Vector<int> &thread)
+{
+    Vector<int> order;
+    for (int i = 0; i < costs.size(); ++i)
+	order.push_back(i);
+    for (int i = 1; i < order.size(); ++i)
+	for (int j = i; j > 0 && costs[order[j]] > costs[order[j-1]]; --j) {
+	    int t = order[j];
+	    order[j] = order[j-1];
+	    order[j-1] = t;
+	}
+
+    Vector<double> load(nthreads, 0);
+    thread.assign(costs.size(), 0);
+    for (int *it = order.begin(); it != order.end(); ++it) {
+	int t = 0;
+	for (int i = 1; i < nthreads; ++i)
+	    if (load[i] < load[t])
+		t = i;
+	thread[*it] = t;
+	load[t] += costs[*it];
+    }
+    double max = 0;
+    for (int i = 0; i < nthreads; ++i)
+	if (load[i] > max)
+	    max = load[i];
+    return max;
+}
+
+static double
+assign_threads(Vector<Stage> &stages, int nthreads)
+{
+    Vector<double> costs;
+    Vector<int> thread;
+    for (Stage *s = stages.begin(); s != stages.end(); ++s)
+	costs.push_back(s->cost);
+    double max = assign_threads(costs, nthreads, thread);
+    for (int i = 0; i < stages.size(); ++i)
+	stages[i].thread = thread[i];
+    return max;
+}
+
+static String
+unique_name(RouterT *r, const char *prefix, int &anonymizer)
+{
+    String name;
+    do {
+	name = String(prefix) + "@click_partition@" + String(anonymizer);
+	++anonymizer;
+    } while (r->eindex(name) >= 0);
+    return name;
+}
+
+static void
+insert_cut(RouterT *r, const ConnectionT &c, bool push, unsigned capacity,
+	   unsigned burst, double cut_cost, int &anonymizer)
+{
+    PortT from = c.from(), to = c.to();
+    for (RouterT::conn_iterator it = r->find_connections_from(from); it; ++it)
+	if (it->to() == to) {
+	    r->erase(it);
+	    break;
+	}
+
+    LandmarkT landmark("<click-partition>");
+    ElementT *q = r->get_element(unique_name(r, "ThreadSafeQueue", anonymizer),
+				 ElementClassT::base_type("ThreadSafeQueue"),
+				 String(capacity), landmark);
+    ElementT *u = r->get_element(unique_name(r, "Unqueue", anonymizer),
+				 ElementClassT::base_type("Unqueue"),
+				 "BURST " + String(burst), landmark);
+    element_costs[q->name()] = cut_cost / 2;
+    element_costs[u->name()] = cut_cost / 2;
+    ElementT *first = (push ? q : u), *second = (push ? u : q);
+    r->add_connection(from, PortT(first, 0), landmark);
+    r->add_connection(PortT(first, 0), PortT(second, 0), landmark);
+    r->add_connection(PortT(second, 0), to, landmark);
+}
+
+static String
+unparse_cost(double cost)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.4g", cost);
+    return String(buf);
+}
+
+static void
+report(RouterT *r, const Vector<Stage> &stages, int nthreads, int ncuts,
+       double sequential, double makespan, ErrorHandler *errh)
+{
+    StringAccum sa;
+    sa << stages.size() << (stages.size() == 1 ? " stage" : " stages")
+       << " on " << nthreads << (nthreads == 1 ? " thread, " : " threads, ")
+       << ncuts << (ncuts == 1 ? " cut" : " cuts");
+    if (makespan > 0)
+	sa << ", estimated speedup " << unparse_cost(sequential / makespan);
+    errh->message("%s", sa.c_str());
+
+    for (int t = 0; t < nthreads; ++t) {
+	double load = 0;
+	for (const Stage *s = stages.begin(); s != stages.end(); ++s)
+	    if (s->thread == t)
+		load += s->cost;
+	errh->message("thread %d (cost %s):", t, unparse_cost(load).c_str());
+	for (const Stage *s = stages.begin(); s != stages.end(); ++s)
+	    if (s->thread == t) {
+		sa.clear();
+		sa << "  " << r->ename(s->root) << " (cost "
+		   << unparse_cost(s->cost) << "):";
+		for (int i = 0; i < s->elements.size(); ++i)
+		    if (s->elements[i] && i != s->root)
+			sa << ' ' << r->ename(i);
+		errh->message("%s", sa.c_str());
+	    }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    click_static_initialize();
+    CLICK_DEFAULT_PROVIDES;
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    ErrorHandler *p_errh = new PrefixErrorHandler(errh, "click-partition: ");
+
+    // read command line arguments
+    Clp_Parser *clp =
+	Clp_NewParser(argc, argv, sizeof(options) / sizeof(options[0]), options);
+    Clp_SetOptionChar(clp, '+', Clp_ShortNegated);
+    program_name = Clp_ProgramName(clp);
+
+    const char *router_file = 0;
+    bool file_is_expr = false;
+    const char *output_file = 0;
+    int nthreads = 2;
+    double cut_cost = -1;
+    unsigned capacity = 1024;
+    unsigned burst = 32;
+    bool quiet = false;
+
+    while (1) {
+	int opt = Clp_Next(clp);
+	switch (opt) {
+
+	  case HELP_OPT:
+	    usage();
+	    exit(0);
+	    break;
+
+	  case VERSION_OPT:
+	    printf("click-partition (Click) %s\n", CLICK_VERSION);
+	    printf("This is free software; see the source for copying conditions.\n\
+There is NO warranty, not even for merchantability or fitness for a\n\
+particular purpose.\n");
+	    exit(0);
+	    break;
+
+	  case CLICKPATH_OPT:
+	    set_clickpath(clp->vstr);
+	    break;
+
+	  case ROUTER_OPT:
+	  case EXPRESSION_OPT:
+	  router_file:
+	    if (router_file) {
+		p_errh->error("router configuration specified twice");
+		goto bad_option;
+	    }
+	    router_file = clp->vstr;
+	    file_is_expr = (opt == EXPRESSION_OPT);
+	    break;
+
+	  case Clp_NotOption:
+	    if (!click_maybe_define(clp->vstr, p_errh))
+		goto router_file;
+	    break;
+
+	  case OUTPUT_OPT:
+	    if (output_file) {
+		p_errh->error("output file specified twice");
+		goto bad_option;
+	    }
+	    output_file = clp->vstr;
+	    break;
+
+	  case THREADS_OPT:
+	    if (clp->val.i <= 0) {
+		p_errh->error("%<--threads%> must be positive");
+		goto bad_option;
+	    }
+	    nthreads = clp->val.i;
+	    break;
+
+	  case PROFILE_OPT:
+	    if (read_profile(clp->vstr, p_errh) < 0)
+		exit(1);
+	    break;
+
+	  case CUT_COST_OPT:
+	    if (clp->val.d < 0) {
+		p_errh->error("%<--cut-cost%> must be nonnegative");
+		goto bad_option;
+	    }
+	    cut_cost = clp->val.d;
+	    break;
+
+	  case CAPACITY_OPT:
+	    capacity = clp->val.u;
+	    break;
+
+	  case BURST_OPT:
+	    burst = clp->val.u;
+	    break;
+
+	  case QUIET_OPT:
+	    quiet = !clp->negated;
+	    break;
+
+	  bad_option:
+	  case Clp_BadOption:
+	    short_usage();
+	    exit(1);
+	    break;
+
+	  case Clp_Done:
+	    goto done;
+
+	}
+    }
+
+  done:
+    RouterT *r = read_router(router_file, file_is_expr, errh);
+    if (r)
+	r->flatten(errh);
+    if (!r || errh->nerrors() > 0)
+	exit(1);
+
+    ElementMap *emap = ElementMap::default_map();
+    emap->parse_all_files(r, CLICK_DATADIR, p_errh);
+    if (!emap->driver_compatible(r, Driver::USERLEVEL))
+	p_errh->warning("configuration not compatible with userlevel driver");
+    else
+	emap->set_driver(Driver::USERLEVEL);
+
+    // existing thread assignments would fight ours
+    ElementClassT *sched_class = ElementClassT::base_type("StaticThreadSched");
+    for (RouterT::type_iterator x = r->begin_elements(sched_class); x; x++) {
+	p_errh->lwarning(x->landmark(), "removing %<%s%>", x->declaration().c_str());
+	x->kill();
+    }
+    r->remove_dead_elements();
+
+    if (cut_cost < 0) {
+	double total = 0;
+	for (RouterT::iterator x = r->begin_elements(); x; x++)
+	    total += element_cost(x.get());
+	cut_cost = (r->nelements() ? 2 * total / r->nelements() : 2);
+    }
+
+    // Repeatedly cut the stage whose split most reduces the busiest
+    // thread's load, until no cut helps.
+    Vector<Stage> stages;
+    double sequential = -1, makespan = 0, predicted = 0;
+    int ncuts = 0, anonymizer = 1;
+    while (1) {
+	ProcessingT processing(r, emap, p_errh);
+	if (p_errh->nerrors() > 0)
+	    exit(1);
+	Partitioner part(r, &processing);
+	part.find_stages(stages);
+	makespan = assign_threads(stages, nthreads);
+	// A cut that doesn't split its stage means the element map doesn't
+	// know the queue elements' processing; cutting again would loop.
+	if (ncuts && makespan > predicted * 1.000001) {
+	    p_errh->error("cut did not split its stage (are %<ThreadSafeQueue%> and %<Unqueue%> in the element map?)");
+	    exit(1);
+	}
+	if (sequential < 0) {
+	    sequential = 0;
+	    for (Stage *s = stages.begin(); s != stages.end(); ++s)
+		sequential += s->cost;
+	}
+
+	Vector<int> order;
+	for (int i = 0; i < stages.size(); ++i)
+	    order.push_back(i);
+	for (int i = 1; i < order.size(); ++i)
+	    for (int j = i; j > 0 && stages[order[j]].cost > stages[order[j-1]].cost; --j) {
+		int t = order[j];
+		order[j] = order[j-1];
+		order[j-1] = t;
+	    }
+
+	bool changed = false;
+	for (int *it = order.begin(); it != order.end() && !changed; ++it) {
+	    Cut cut;
+	    if (!part.best_cut(stages, *it, cut_cost, cut))
+		continue;
+	    Vector<double> costs;
+	    Vector<int> thread;
+	    for (int i = 0; i < stages.size(); ++i)
+		costs.push_back(i == *it ? cut.near_cost : stages[i].cost);
+	    costs.push_back(cut.far_cost);
+	    predicted = assign_threads(costs, nthreads, thread);
+	    if (predicted < makespan) {
+		insert_cut(r, part.conn(cut.conn), cut.push, capacity, burst,
+			   cut_cost, anonymizer);
+		++ncuts;
+		changed = true;
+	    }
+	}
+	if (!changed)
+	    break;
+    }
+
+    // pin each stage's root to its thread
+    if (stages.size()) {
+	StringAccum sa;
+	for (Stage *s = stages.begin(); s != stages.end(); ++s) {
+	    if (sa.length())
+		sa << ", ";
+	    sa << r->ename(s->root) << ' ' << s->thread;
+	}
+	r->get_element(unique_name(r, "StaticThreadSched", anonymizer),
+		       sched_class, sa.take_string(),
+		       LandmarkT("<click-partition>"));
+    }
+
+    if (!quiet)
+	report(r, stages, nthreads, ncuts, sequential, makespan, p_errh);
+
+    if (write_router_file(r, output_file, errh) < 0)
+	exit(1);
+    return 0;
+}
@@ -82,10 +82,13 @@ CLICK_USING_DECLS
 #define SOCKET_OPT              318
 #define THREADS_AFF_OPT         319
 #define DPDK_OPT                320
+#define COMPILED_OPT            321
+#define TSC_CLOCK_OPT           322
 
 static const Clp_Option options[] = {
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
     { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
+    { "compiled", 0, COMPILED_OPT, Clp_ValString, 0 },
     { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
     { "dpdk", 0, DPDK_OPT, 0, 0 },
     { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
@@ -101,6 +104,7 @@ static const Clp_Option options[] = {
     { "cpu", 0, THREADS_AFF_OPT, Clp_ValInt, Clp_Optional | Clp_Negate },
     { "affinity", 'a', THREADS_AFF_OPT, Clp_ValInt, Clp_Optional | Clp_Negate },
     { "time", 't', TIME_OPT, 0, 0 },
+    { "tsc-clock", 0, TSC_CLOCK_OPT, 0, Clp_Negate },
     { "unix-socket", 'u', UNIX_SOCKET_OPT, Clp_ValString, 0 },
     { "version", 'v', VERSION_OPT, 0, 0 },
     { "warnings", 0, WARNINGS_OPT, 0, Clp_Negate },
@@ -149,10 +153,14 @@ Options:\n\
                                 driver and print result to standard output.\n\
   -x, --exit-handler ELEMENT.H  Use handler ELEMENT.H value for exit status.\n\
   -o, --output FILE             Write flat configuration to FILE.\n\
+      --compiled FILE           Load compiled configuration from FILE if it is\n\
+                                up to date; otherwise write it to FILE.\n\
   -q, --quit                    Do not run driver.\n\
   -t, --time                    Print information on how long driver took.\n\
   -w, --no-warnings             Do not print warnings.\n\
       --simtime                 Run in simulation time.\n\
+      --tsc-clock               Read time from the calibrated CPU timestamp\n\
+                                counter.\n\
   -C, --clickpath PATH          Use PATH for CLICKPATH.\n\
       --help                    Print this message and exit.\n\
   -v, --version                 Print version number and exit.\n\
@@ -218,10 +226,22 @@ call_read_handler(Element *e, String handler_name,
 
   if (print_name)
     fprintf(stdout, "%s:\n", full_name.c_str());
-  String result = rh->call_read(e);
-  if (!rh->raw() && result && result.back() != '\n')
-      result += '\n';
-  fputs(result.c_str(), stdout);
+  // Write the value a chunk at a time, so that streaming handlers never
+  // build their whole value in memory.
+  StringAccum sa;
+  uint64_t cursor = 0;
+  char last = '\n';
+  int r;
+  do {
+      r = rh->call_read_chunk(e, sa, cursor);
+      if (sa.length()) {
+          last = sa.back();
+          ignore_result(fwrite(sa.data(), 1, sa.length(), stdout));
+          sa.clear();
+      }
+  } while (r > 0);
+  if (!rh->raw() && last != '\n')
+      fputc('\n', stdout);
   if (print_name)
     fputs("\n", stdout);
 
@@ -334,6 +354,11 @@ static void* hotswap_threadfunc(void*)
 
 // switching configurations
 
+static String compiled_file;
+static Timestamp startup_parse_time;
+static Timestamp startup_initialize_time;
+static const char *startup_compiled = "off";
+
 static Vector<String> cs_unix_sockets;
 static Vector<String> cs_ports;
 static Vector<String> cs_sockets;
@@ -355,10 +380,20 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
                     ErrorHandler *errh)
 {
     int before_errors = errh->nerrors();
+    Timestamp start = Timestamp::now_unwarped();
+    // the compiled file belongs to the initial configuration
+    String compiled = (hotswap ? String() : compiled_file);
+    bool compiled_hit;
     Router *router = click_read_router(text, text_is_expr, errh, false,
-                                       click_master);
+                                       click_master, compiled, &compiled_hit);
     if (!router)
         return 0;
+    Timestamp parsed = Timestamp::now_unwarped();
+    // startup times describe the initial configuration only
+    if (!hotswap) {
+        startup_parse_time = parsed - start;
+        startup_compiled = (!compiled ? "off" : compiled_hit ? "hit" : "miss");
+    }
 
     // add new ControlSockets
     String retries = (hotswap ? ", RETRIES 1, RETRY_WARNINGS false" : "");
@@ -397,9 +432,11 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
       router->set_hotswap_router(click_router);
 
   if (errh->nerrors() == before_errors
-      && router->initialize(errh) >= 0)
+      && router->initialize(errh) >= 0) {
+    if (!hotswap)
+        startup_initialize_time = Timestamp::now_unwarped() - parsed;
     return router;
-  else {
+  } else {
     delete router;
     return 0;
   }
@@ -430,6 +467,17 @@ hotconfig_handler(const String &text, Element *, void *, ErrorHandler *errh)
 }
 
 
+static String
+startup_time_read_handler(Element *, void *)
+{
+    StringAccum sa;
+    sa << "parse " << startup_parse_time << '\n'
+       << "initialize " << startup_initialize_time << '\n'
+       << "compiled " << startup_compiled << '\n';
+    return sa.take_string();
+}
+
+
 // timewarping
 
 static String
@@ -460,6 +508,45 @@ timewarp_write_handler(const String &text, Element *, void *, ErrorHandler *errh
 }
 
 
+// clock
+
+static String
+clock_read_handler(Element *, void *)
+{
+    StringAccum sa;
+#if TIMESTAMP_TSC
+    if (Timestamp::tsc_active()) {
+        sa << "source tsc\n"
+           << "tsc_hz " << (uint64_t) Timestamp::tsc_hz() << '\n'
+           << "resyncs " << Timestamp::tsc_resyncs() << '\n'
+           << "drift " << Timestamp::tsc_drift() << '\n';
+        return sa.take_string();
+    }
+    sa << "source system\n"
+       << "tsc_supported " << (Timestamp::tsc_supported() ? "true" : "false") << '\n';
+#else
+    sa << "source system\n";
+#endif
+    return sa.take_string();
+}
+
+#if TIMESTAMP_TSC
+static int
+clock_write_handler(const String &text, Element *, void *, ErrorHandler *errh)
+{
+    String s = cp_uncomment(text);
+    if (s == "tsc") {
+        if (!Timestamp::tsc_start())
+            return errh->error("CPU timestamp counter is not invariant");
+    } else if (s == "system")
+        Timestamp::tsc_stop();
+    else
+        return errh->error("expected %<tsc%> or %<system%>");
+    return 0;
+}
+#endif
+
+
 // main
 
 static void
@@ -612,6 +699,10 @@ main(int argc, char **argv)
       quit_immediately = true;
       break;
 
+     case COMPILED_OPT:
+      compiled_file = clp->vstr;
+      break;
+
      case TIME_OPT:
       report_time = true;
       break;
@@ -661,6 +752,18 @@ main(int argc, char **argv)
 #endif
       break;
 
+    case TSC_CLOCK_OPT:
+#if TIMESTAMP_TSC
+        if (clp->negated)
+            Timestamp::tsc_stop();
+        else if (!Timestamp::tsc_start())
+            errh->warning("CPU timestamp counter is not invariant, using the system clock");
+#else
+        if (!clp->negated)
+            errh->warning("--tsc-clock is not supported on this platform");
+#endif
+        break;
+
     case SIMTIME_OPT: {
         Timestamp::warp_set_class(Timestamp::warp_simulation);
         Timestamp simbegin(clp->have_val ? clp->val.d : 1000000000);
@@ -722,8 +825,13 @@ particular purpose.\n");
   if (allow_reconfigure)
       Router::add_write_handler(0, "hotconfig", hotconfig_handler, 0, Handler::f_raw | Handler::f_nonexclusive);
   Router::add_read_handler(0, "timewarp", timewarp_read_handler, 0);
+  Router::add_read_handler(0, "startup_time", startup_time_read_handler, 0);
   if (Timestamp::warp_class() != Timestamp::warp_simulation)
       Router::add_write_handler(0, "timewarp", timewarp_write_handler, 0);
+  Router::add_read_handler(0, "clock", clock_read_handler, 0);
+#if TIMESTAMP_TSC
+  Router::add_write_handler(0, "clock", clock_write_handler, 0);
+#endif
 
   // parse configuration
   click_master = new Master(click_nthreads);